@@ -0,0 +1,147 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "Repo.h"
+#include "SyntheticRepo.h"
+
+// Benchmarks take their repository shape from the argument list as
+// {files, fileSize, depth, branches}.
+static SyntheticRepoSpec specFrom(const benchmark::State& state) {
+    SyntheticRepoSpec spec;
+    spec.files = static_cast<int>(state.range(0));
+    spec.fileSize = static_cast<int>(state.range(1));
+    spec.depth = static_cast<int>(state.range(2));
+    spec.branches = static_cast<int>(state.range(3));
+    return spec;
+}
+
+static void BM_AddAll(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    int generation = repo.getSpec().depth;
+    for (auto _ : state) {
+        // add stages only what differs from the commit, so every file gets
+        // contents no commit or earlier iteration has.
+        state.PauseTiming();
+        fs::remove(repo.getRoot() / ".gitlet/staging/stage.txt");
+        for (int i = 0; i < repo.getSpec().files; i++) {
+            repo.touchFile(i, generation);
+        }
+        generation++;
+        state.ResumeTiming();
+        Repo r;
+        r.add(".");
+    }
+    state.SetItemsProcessed(state.iterations() * repo.getSpec().files);
+    state.SetBytesProcessed(state.iterations() * repo.getSpec().files * repo.getSpec().fileSize);
+}
+BENCHMARK(BM_AddAll)->Args({100, 1024, 1, 0})->Args({1000, 1024, 1, 0})->Args({100, 1 << 20, 1, 0});
+
+static void BM_Commit(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    int generation = repo.getSpec().depth;
+    for (auto _ : state) {
+        state.PauseTiming();
+        int index = generation % repo.getSpec().files;
+        repo.touchFile(index, generation);
+        Repo().add(SyntheticRepo::fileName(index));
+        state.ResumeTiming();
+        Repo r;
+        r.commitment("bench commit " + std::to_string(generation++));
+    }
+}
+BENCHMARK(BM_Commit)->Args({100, 1024, 10, 0})->Args({1000, 1024, 10, 0});
+
+static void BM_Log(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    for (auto _ : state) {
+        Repo r;
+        for (const Commit& commit : r.log()) {
+            benchmark::DoNotOptimize(commit.getOwnHash());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * repo.getSpec().depth);
+}
+BENCHMARK(BM_Log)->Args({10, 64, 100, 0})->Args({10, 64, 1000, 0});
+
+static void BM_Status(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    for (auto _ : state) {
+        Repo r;
+        benchmark::DoNotOptimize(r.status());
+    }
+}
+BENCHMARK(BM_Status)->Args({100, 64, 1, 10})->Args({1000, 64, 1, 100});
+
+static void BM_Checkout(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    bool onBranch = false;
+    for (auto _ : state) {
+        Repo r;
+        r.checkout({onBranch ? std::string("master") : SyntheticRepo::branchName(0)});
+        onBranch = !onBranch;
+    }
+    state.SetItemsProcessed(state.iterations() * repo.getSpec().files);
+}
+BENCHMARK(BM_Checkout)->Args({100, 1024, 1, 1})->Args({1000, 1024, 1, 1});
+
+static void BM_Merge(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    for (auto _ : state) {
+        Repo r;
+        r.merge(SyntheticRepo::branchName(0));
+    }
+}
+BENCHMARK(BM_Merge)->Args({100, 64, 10, 1})->Args({100, 64, 200, 1});
+
+static void BM_Find(benchmark::State& state) {
+    SyntheticRepo repo(specFrom(state));
+    repo.enter();
+    QuietStdout quiet;
+    for (auto _ : state) {
+        Repo r;
+        benchmark::DoNotOptimize(r.find("commit 1"));
+    }
+    state.SetItemsProcessed(state.iterations() * repo.getSpec().depth);
+}
+BENCHMARK(BM_Find)->Args({10, 64, 100, 0})->Args({10, 64, 1000, 0});
+
+// Results are always written as JSON so runs can be compared across
+// releases; --benchmark_out on the command line overrides the default file.
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+    bool hasOut = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--benchmark_out=", 16) == 0) {
+            hasOut = true;
+        }
+    }
+    std::string out = "--benchmark_out=" + fs::absolute("gitlet-bench.json").string();
+    std::string format = "--benchmark_out_format=json";
+    if (!hasOut) {
+        args.push_back(out.data());
+        args.push_back(format.data());
+    }
+    int count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "SyntheticRepo.h"
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+#include "Repo.h"
+
+SyntheticRepo::SyntheticRepo(const SyntheticRepoSpec& spec) : spec(spec) {
+    std::string pattern = (fs::temp_directory_path() / "gitlet-bench-XXXXXX").string();
+    if (mkdtemp(pattern.data()) == nullptr) {
+        throw std::runtime_error("could not create a temporary directory");
+    }
+    root = pattern;
+    generate();
+}
+
+SyntheticRepo::~SyntheticRepo() {
+    std::error_code ec;
+    fs::current_path(fs::temp_directory_path(), ec);
+    fs::remove_all(root, ec);
+}
+
+const fs::path& SyntheticRepo::getRoot() const {
+    return root;
+}
+
+const SyntheticRepoSpec& SyntheticRepo::getSpec() const {
+    return spec;
+}
+
+void SyntheticRepo::enter() const {
+    fs::current_path(root);
+}
+
+std::string SyntheticRepo::fileName(int index) {
+    return "file" + std::to_string(index) + ".txt";
+}
+
+std::string SyntheticRepo::branchName(int index) {
+    return "branch" + std::to_string(index);
+}
+
+void SyntheticRepo::touchFile(int index, int generation) const {
+    std::mt19937 rng(index * 7919 + generation);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string contents(spec.fileSize, '\n');
+    for (size_t i = 0; i < contents.size(); i++) {
+        if (i % 64 != 63) {
+            contents[i] = static_cast<char>(letter(rng));
+        }
+    }
+    std::ofstream(root / fileName(index), std::ios::binary) << contents;
+}
+
+void SyntheticRepo::generate() {
+    QuietStdout quiet;
+    enter();
+    Repo().init();
+
+    for (int i = 0; i < spec.files; i++) {
+        touchFile(i, 0);
+    }
+    Repo().add(".");
+    Repo().commitment("commit 0");
+
+    // Each further commit on master rewrites one file.
+    for (int depth = 1; depth < spec.depth; depth++) {
+        int index = spec.files > 0 ? depth % spec.files : 0;
+        if (spec.files > 0) {
+            touchFile(index, depth);
+            Repo().add(fileName(index));
+        }
+        Repo().commitment("commit " + std::to_string(depth));
+    }
+
+    // Every branch adds a file of its own so merges back into master are clean.
+    for (int b = 0; b < spec.branches; b++) {
+        std::string name = branchName(b);
+        Repo().branch(name);
+        Repo().checkout({name});
+        std::ofstream(root / (name + ".txt")) << name << "\n";
+        Repo().add(name + ".txt");
+        Repo().commitment("work on " + name);
+        Repo().checkout({"master"});
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef SYNTHETICREPO_H
+#define SYNTHETICREPO_H
+
+#include <string>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// Shape of a generated repository.
+struct SyntheticRepoSpec {
+    int files = 100;        // regular files in the flat working directory
+    int fileSize = 1024;    // bytes per file
+    int depth = 10;         // commits on master, including the one adding every file
+    int branches = 1;       // branches forked off master, each with one extra commit
+};
+
+// Swallows everything Repo prints to std::cout while in scope.
+class QuietStdout {
+public:
+    QuietStdout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(saved); }
+
+private:
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+// Builds a gitlet repository in a fresh temporary directory by driving Repo
+// the same way the CLI does. The directory is removed on destruction.
+class SyntheticRepo {
+public:
+    explicit SyntheticRepo(const SyntheticRepoSpec& spec);
+    ~SyntheticRepo();
+
+    SyntheticRepo(const SyntheticRepo&) = delete;
+    SyntheticRepo& operator=(const SyntheticRepo&) = delete;
+
+    const fs::path& getRoot() const;
+    const SyntheticRepoSpec& getSpec() const;
+
+    // Makes the repository the current directory, since Repo works on the cwd.
+    void enter() const;
+
+    static std::string fileName(int index);
+    static std::string branchName(int index);
+
+    // Overwrites a working file with deterministic contents for `generation`.
+    void touchFile(int index, int generation) const;
+
+private:
+    SyntheticRepoSpec spec;
+    fs::path root;
+
+    void generate();
+};
+
+#endif // SYNTHETICREPO_H
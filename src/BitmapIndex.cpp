@@ -0,0 +1,253 @@
+#include "BitmapIndex.h"
+#include "Commit.h"
+#include "RefStore.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+const char bitmapMagic[4] = {'G', 'B', 'M', 'P'};
+const uint32_t formatVersion = 1;
+const size_t headerSize = 32;       // magic, version, commits, blobs, bitmaps
+const size_t recordSize = 40;       // id, 4 padding, offset, length
+
+// Position of id among count sorted 20-byte ids starting at ids.
+std::optional<size_t> search(const unsigned char* ids, size_t count, const ObjectId& id) {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = std::memcmp(id.bytes.data(), ids + mid * ObjectId::size, ObjectId::size);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return std::nullopt;
+}
+}
+
+BitmapIndex::BitmapIndex(const fs::path& gitletDir) : data(nullptr), size(0) {
+    int fd = ::open(path(gitletDir).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(mapped);
+            size = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    if (!valid() && data != nullptr) {
+        ::munmap(const_cast<unsigned char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+BitmapIndex::~BitmapIndex() {
+    if (data != nullptr) {
+        ::munmap(const_cast<unsigned char*>(data), size);
+    }
+}
+
+fs::path BitmapIndex::path(const fs::path& gitletDir) {
+    return gitletDir / "bitmaps" / "index.bitmap";
+}
+
+bool BitmapIndex::valid() const {
+    if (data == nullptr || size < headerSize || std::memcmp(data, bitmapMagic, 4) != 0) {
+        return false;
+    }
+    uint64_t objects = field(8) + field(16);
+    return size >= headerSize + objects * ObjectId::size + field(24) * recordSize;
+}
+
+uint64_t BitmapIndex::field(size_t offset) const {
+    return Utils::get64(data + offset);
+}
+
+size_t BitmapIndex::commitCount() const {
+    return data ? field(8) : 0;
+}
+
+size_t BitmapIndex::blobCount() const {
+    return data ? field(16) : 0;
+}
+
+size_t BitmapIndex::bitmapCount() const {
+    return data ? field(24) : 0;
+}
+
+const unsigned char* BitmapIndex::id(size_t index) const {
+    return data + headerSize + index * ObjectId::size;
+}
+
+const unsigned char* BitmapIndex::record(size_t index) const {
+    return id(commitCount() + blobCount()) + index * recordSize;
+}
+
+std::optional<size_t> BitmapIndex::indexOf(ObjectType type, const ObjectId& objectId) const {
+    if (type == ObjectType::Commit) {
+        return search(id(0), commitCount(), objectId);
+    }
+    std::optional<size_t> index = search(id(commitCount()), blobCount(), objectId);
+    if (index) {
+        return commitCount() + *index;
+    }
+    return std::nullopt;
+}
+
+std::optional<EwahBitmap> BitmapIndex::bitmap(const ObjectId& commit) const {
+    size_t lo = 0;
+    size_t hi = bitmapCount();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = std::memcmp(commit.bytes.data(), record(mid), ObjectId::size);
+        if (cmp == 0) {
+            uint64_t offset = Utils::get64(record(mid) + 24);
+            uint64_t length = Utils::get64(record(mid) + 32);
+            if (offset + length > size) {
+                return std::nullopt;
+            }
+            Trace::count("bitmaps loaded");
+            return EwahBitmap::deserialize(reinterpret_cast<const char*>(data + offset), length);
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t BitmapIndex::write(const fs::path& gitletDir, const ObjectStore& objects, const RefStore& refs, size_t interval) {
+    GITLET_TRACE_SCOPE("BitmapIndex::write");
+    interval = std::max<size_t>(interval, 1);
+    std::vector<ObjectId> commits = objects.list(ObjectType::Commit);
+    std::vector<ObjectId> blobs = objects.list(ObjectType::Blob);
+    auto indexOf = [&](ObjectType type, const std::string& hex) -> std::optional<size_t> {
+        std::optional<ObjectId> id = ObjectId::fromHex(hex);
+        if (!id) {
+            return std::nullopt;
+        }
+        const std::vector<ObjectId>& ids = type == ObjectType::Commit ? commits : blobs;
+        auto it = std::lower_bound(ids.begin(), ids.end(), *id);
+        if (it == ids.end() || *it != *id) {
+            return std::nullopt;
+        }
+        return type == ObjectType::Commit ? size_t(it - ids.begin()) : commits.size() + (it - ids.begin());
+    };
+
+    // Load every commit reachable from a branch once, with its depth from the
+    // root of its chain.
+    struct Node {
+        std::optional<size_t> parent;
+        std::vector<size_t> blobs;
+        size_t depth = 0;
+    };
+    std::unordered_map<size_t, Node> nodes;
+    std::vector<size_t> selected;
+    for (const auto& [branchName, commitID] : refs.list()) {
+        std::optional<size_t> tip = indexOf(ObjectType::Commit, commitID);
+        if (!tip) {
+            continue;
+        }
+        selected.push_back(*tip);
+        std::vector<size_t> chain;
+        for (std::optional<size_t> current = tip; current && !nodes.count(*current);) {
+            std::optional<std::vector<char>> contents = objects.read(ObjectType::Commit, commits[*current].hex());
+            Node node;
+            if (contents) {
+                Commit commit;
+                commit.deserializeFromString(std::string(contents->begin(), contents->end()));
+                for (const auto& [fileName, blobHash] : commit.getBlobs()) {
+                    std::optional<size_t> blob = indexOf(ObjectType::Blob, blobHash);
+                    if (blob) {
+                        node.blobs.push_back(*blob);
+                    }
+                }
+                node.parent = indexOf(ObjectType::Commit, commit.getParentHash());
+            }
+            nodes.emplace(*current, std::move(node));
+            chain.push_back(*current);
+            current = nodes.at(*current).parent;
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            Node& node = nodes.at(*it);
+            node.depth = node.parent ? nodes.at(*node.parent).depth + 1 : 0;
+            if (node.depth % interval == 0) {
+                selected.push_back(*it);
+            }
+        }
+    }
+    std::sort(selected.begin(), selected.end(), [&](size_t a, size_t b) {
+        return nodes.at(a).depth != nodes.at(b).depth ? nodes.at(a).depth < nodes.at(b).depth : a < b;
+    });
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+    // Shallower checkpoints are built first, so each bitmap only sets the
+    // bits of the segment down to the previous one and ORs that in.
+    size_t words = (commits.size() + blobs.size() + 63) / 64;
+    std::unordered_map<size_t, EwahBitmap> built;
+    for (size_t commit : selected) {
+        std::vector<uint64_t> plain(words);
+        auto set = [&](size_t bit) { plain[bit / 64] |= uint64_t(1) << (bit % 64); };
+        std::optional<size_t> current = commit;
+        while (current && !built.count(*current)) {
+            const Node& node = nodes.at(*current);
+            set(*current);
+            for (size_t blob : node.blobs) {
+                set(blob);
+            }
+            current = node.parent;
+        }
+        EwahBitmap bitmap = EwahBitmap::fromWords(plain);
+        if (current) {
+            bitmap = bitmap | built.at(*current);
+        }
+        built.emplace(commit, std::move(bitmap));
+    }
+
+    // Commits are numbered in id order, so sorting by number sorts the records.
+    std::sort(selected.begin(), selected.end());
+    std::string out(bitmapMagic, 4);
+    Utils::put32(out, formatVersion);
+    Utils::put64(out, commits.size());
+    Utils::put64(out, blobs.size());
+    Utils::put64(out, selected.size());
+    for (const std::vector<ObjectId>* ids : {&commits, &blobs}) {
+        for (const ObjectId& id : *ids) {
+            out.append(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+        }
+    }
+    std::vector<std::string> serialized;
+    uint64_t offset = out.size() + selected.size() * recordSize;
+    for (size_t commit : selected) {
+        serialized.push_back(built.at(commit).serialize());
+        out.append(reinterpret_cast<const char*>(commits[commit].bytes.data()), ObjectId::size);
+        out.append(4, '\0');
+        Utils::put64(out, offset);
+        Utils::put64(out, serialized.back().size());
+        offset += serialized.back().size();
+    }
+    for (const std::string& bitmap : serialized) {
+        out += bitmap;
+    }
+
+    fs::create_directories(path(gitletDir).parent_path());
+    Utils::writeAtomic(path(gitletDir), out.data(), out.size());
+    return selected.size();
+}
@@ -0,0 +1,60 @@
+#ifndef BITMAPINDEX_H
+#define BITMAPINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include "EwahBitmap.h"
+#include "ObjectId.h"
+#include "ObjectStore.h"
+
+namespace fs = std::filesystem;
+
+class RefStore;
+
+// Reachability bitmaps, stored in .gitlet/bitmaps/index.bitmap:
+//
+//   "GBMP", version, commit count C, blob count B, bitmap count S
+//   C sorted commit ids, then B sorted blob ids
+//   S records sorted by commit id: id, 4 padding, offset, length
+//   the EWAH bitmaps the records point at
+//
+// Object i is commit i for i < C and blob i - C after that, the numbering gc
+// uses. A commit's bitmap has a bit set for every commit and blob reachable
+// from it. Bitmaps are kept for branch tips and every bitmap.interval-th
+// commit of a chain, so a query about any commit walks back only as far as
+// the nearest one that has a bitmap. Commits made after the index was written
+// have no number in it and are always walked.
+class BitmapIndex {
+public:
+    explicit BitmapIndex(const fs::path& gitletDir);
+    ~BitmapIndex();
+
+    BitmapIndex(const BitmapIndex&) = delete;
+    BitmapIndex& operator=(const BitmapIndex&) = delete;
+
+    static fs::path path(const fs::path& gitletDir);
+
+    // False when there is no index or it is damaged; it then holds nothing.
+    bool valid() const;
+    size_t commitCount() const;
+    size_t blobCount() const;
+    size_t bitmapCount() const;
+
+    std::optional<size_t> indexOf(ObjectType type, const ObjectId& id) const;
+    std::optional<EwahBitmap> bitmap(const ObjectId& commit) const;
+
+    // Builds bitmaps for the commits reachable from a branch, one chain
+    // segment at a time, and replaces the index. Returns how many it wrote.
+    static size_t write(const fs::path& gitletDir, const ObjectStore& objects, const RefStore& refs, size_t interval);
+
+private:
+    const unsigned char* data;
+    size_t size;
+
+    uint64_t field(size_t offset) const;
+    const unsigned char* id(size_t index) const;
+    const unsigned char* record(size_t index) const;
+};
+
+#endif // BITMAPINDEX_H
@@ -0,0 +1,192 @@
+#include "Blame.h"
+#include "LineDiff.h"
+#include "ObjectId.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace {
+const char cacheMagic[4] = {'G', 'L', 'B', 'M'};
+const uint32_t formatVersion = 1;
+const size_t headerSize = 16;  // magic, version, line count, commit count
+}
+
+Blame::Blame(const fs::path& gitletDir, std::function<Commit(const std::string&)> readCommit,
+             std::function<std::vector<char>(const std::string&)> readBlob,
+             std::function<std::string(const Commit&)> parentOf)
+    : directory(gitletDir / "blame"), readCommit(std::move(readCommit)), readBlob(std::move(readBlob)),
+      parentOf(std::move(parentOf)) {}
+
+std::optional<std::vector<BlameLine>> Blame::run(const std::string& commitID, const std::string& path) {
+    GITLET_TRACE_SCOPE("Blame::run");
+    Commit commit = readCommit(commitID);
+    std::unordered_map<std::string, std::string> blobs = commit.getBlobs();
+    auto found = blobs.find(path);
+    if (found == blobs.end()) {
+        return std::nullopt;
+    }
+    std::string blobHash = found->second;
+    std::vector<char> content = readBlob(blobHash);
+    std::vector<std::string_view> lines = LineDiff::lines(std::string_view(content.data(), content.size()));
+
+    std::vector<std::string> owners(lines.size());
+    std::optional<std::vector<std::string>> cached = load(commitID, path, lines.size());
+    bool shallow = false;
+    if (cached) {
+        Trace::count("blame cache hits");
+        owners = std::move(*cached);
+    } else {
+        // Lines still without an owner: their index in the commit being
+        // looked at, and in the file asked about.
+        std::vector<std::pair<size_t, size_t>> open;
+        for (size_t i = 0; i < lines.size(); i++) {
+            open.emplace_back(i, i);
+        }
+        // Holds the blob currentLines point into once the walk moves on.
+        std::vector<char> current;
+        std::vector<std::string_view> currentLines = lines;
+        while (!open.empty()) {
+            if (commit.getOwnHash() != commitID) {
+                if (std::optional<std::vector<std::string>> known = load(commit.getOwnHash(), path, currentLines.size())) {
+                    Trace::count("blame cache hits");
+                    for (const auto& [at, line] : open) {
+                        owners[line] = (*known)[at];
+                    }
+                    break;
+                }
+            }
+            std::string parentID = parentOf(commit);
+            std::optional<Commit> parent;
+            std::string parentBlob;
+            if (!parentID.empty()) {
+                parent = readCommit(parentID);
+                std::unordered_map<std::string, std::string> parentBlobs = parent->getBlobs();
+                auto it = parentBlobs.find(path);
+                if (it != parentBlobs.end()) {
+                    parentBlob = it->second;
+                }
+            } else if (!commit.getParentHash().empty()) {
+                shallow = true;
+            }
+            if (parentBlob.empty()) {
+                for (const auto& [at, line] : open) {
+                    owners[line] = commit.getOwnHash();
+                }
+                break;
+            }
+            if (parentBlob == blobHash) {
+                Trace::count("blame commits passed over");
+                commit = std::move(*parent);
+                continue;
+            }
+
+            Trace::count("blame diffs");
+            std::vector<char> previous = readBlob(parentBlob);
+            std::vector<std::string_view> previousLines = LineDiff::lines(std::string_view(previous.data(), previous.size()));
+            std::vector<size_t> kept(currentLines.size(), SIZE_MAX);
+            for (const auto& [before, after] : LineDiff::matching(previousLines, currentLines)) {
+                kept[after] = before;
+            }
+            std::vector<std::pair<size_t, size_t>> next;
+            for (const auto& [at, line] : open) {
+                if (kept[at] == SIZE_MAX) {
+                    owners[line] = commit.getOwnHash();
+                } else {
+                    next.emplace_back(kept[at], line);
+                }
+            }
+            open = std::move(next);
+            commit = std::move(*parent);
+            blobHash = parentBlob;
+            current = std::move(previous);
+            currentLines = std::move(previousLines);
+        }
+        if (!shallow) {
+            save(commitID, path, owners);
+        }
+    }
+
+    std::vector<BlameLine> result;
+    result.reserve(lines.size());
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::string_view text = lines[i];
+        if (!text.empty() && text.back() == '\n') {
+            text.remove_suffix(1);
+        }
+        result.push_back({owners[i], std::string(text)});
+    }
+    return result;
+}
+
+fs::path Blame::cachePath(const std::string& commitID, const std::string& path) const {
+    std::string key = commitID + '\0' + path;
+    return directory / Utils::sha1(std::vector<char>(key.begin(), key.end()));
+}
+
+std::optional<std::vector<std::string>> Blame::load(const std::string& commitID, const std::string& path, size_t lines) const {
+    std::ifstream file(cachePath(commitID, path), std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data.data());
+    if (data.size() < headerSize || data.compare(0, 4, cacheMagic, 4) != 0 || Utils::get32(in + 4) != formatVersion ||
+        Utils::get32(in + 8) != lines) {
+        return std::nullopt;
+    }
+    size_t commits = Utils::get32(in + 12);
+    if (data.size() != headerSize + commits * ObjectId::size + lines * 4) {
+        return std::nullopt;
+    }
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < commits; i++) {
+        ObjectId id;
+        std::copy(in + headerSize + i * ObjectId::size, in + headerSize + (i + 1) * ObjectId::size, id.bytes.begin());
+        ids.push_back(id.hex());
+    }
+    std::vector<std::string> owners;
+    const unsigned char* indexes = in + headerSize + commits * ObjectId::size;
+    for (size_t i = 0; i < lines; i++) {
+        uint32_t index = Utils::get32(indexes + i * 4);
+        if (index >= commits) {
+            return std::nullopt;
+        }
+        owners.push_back(ids[index]);
+    }
+    return owners;
+}
+
+void Blame::save(const std::string& commitID, const std::string& path, const std::vector<std::string>& owners) const {
+    std::vector<ObjectId> ids;
+    std::unordered_map<std::string, uint32_t> indexOf;
+    std::string indexes;
+    for (const auto& owner : owners) {
+        auto [it, added] = indexOf.emplace(owner, static_cast<uint32_t>(ids.size()));
+        if (added) {
+            std::optional<ObjectId> id = ObjectId::fromHex(owner);
+            if (!id) {
+                return;
+            }
+            ids.push_back(*id);
+        }
+        Utils::put32(indexes, it->second);
+    }
+    std::string out(cacheMagic, 4);
+    Utils::put32(out, formatVersion);
+    Utils::put32(out, static_cast<uint32_t>(owners.size()));
+    Utils::put32(out, static_cast<uint32_t>(ids.size()));
+    for (const ObjectId& id : ids) {
+        out.append(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+    }
+    out += indexes;
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    try {
+        Utils::writeAtomic(cachePath(commitID, path), out.data(), out.size());
+    } catch (const std::exception&) {
+        // An answer that is not cached is worked out again next time.
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef BLAME_H
+#define BLAME_H
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Commit.h"
+
+namespace fs = std::filesystem;
+
+// One line of a file and the commit that last changed it.
+struct BlameLine {
+    std::string commitID;
+    std::string text;
+};
+
+// Finds which commit last changed each line of a file.
+//
+// The walk follows the first-parent chain from the commit asked about and
+// only looks at commits whose blob for the path differs from their
+// parent's: a commit with the same blob id is passed over without reading
+// the blob. At each change the parent's blob is compared with LineDiff, and
+// the lines it kept are handed on to the parent while the rest belong to
+// the commit. The walk stops when every line has an owner, or at the
+// commit that added the path.
+//
+// The answer for each (path, commit) is kept in .gitlet/blame:
+//
+//   <sha1 of commit id and path>   "GLBM", version, line count, count of
+//                                  owning commits, their 20-byte ids, then
+//                                  each line's owner as an index into them
+//
+// and a later walk that reaches a commit with an answer takes its lines'
+// owners from it, so blaming a file again after a few commits only walks
+// those commits. Answers are written with Utils::writeAtomic; history does
+// not change, so they never go stale, but one found through a shallow
+// boundary is not kept.
+class Blame {
+public:
+    Blame(const fs::path& gitletDir, std::function<Commit(const std::string&)> readCommit,
+          std::function<std::vector<char>(const std::string&)> readBlob,
+          std::function<std::string(const Commit&)> parentOf);
+
+    // Every line of path as commitID has it; nullopt if commitID lacks path.
+    std::optional<std::vector<BlameLine>> run(const std::string& commitID, const std::string& path);
+
+private:
+    fs::path directory;
+    std::function<Commit(const std::string&)> readCommit;
+    std::function<std::vector<char>(const std::string&)> readBlob;
+    std::function<std::string(const Commit&)> parentOf;
+
+    fs::path cachePath(const std::string& commitID, const std::string& path) const;
+    // The owners kept for (path, commitID) if they cover exactly lines lines.
+    std::optional<std::vector<std::string>> load(const std::string& commitID, const std::string& path, size_t lines) const;
+    void save(const std::string& commitID, const std::string& path, const std::vector<std::string>& owners) const;
+};
+
+#endif // BLAME_H
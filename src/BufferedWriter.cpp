@@ -0,0 +1,57 @@
+#include "BufferedWriter.h"
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+BufferedWriter::BufferedWriter(int fd, size_t capacity) : fd(fd), buffer(capacity), used(0), failed(false) {}
+
+BufferedWriter::~BufferedWriter() {
+    flush();
+}
+
+BufferedWriter& BufferedWriter::operator<<(const std::string& str) {
+    const char* data = str.data();
+    size_t remaining = str.size();
+    while (remaining > 0 && !failed) {
+        if (used == buffer.size()) {
+            flush();
+        }
+        size_t chunk = std::min(remaining, buffer.size() - used);
+        std::memcpy(buffer.data() + used, data, chunk);
+        used += chunk;
+        data += chunk;
+        remaining -= chunk;
+    }
+    return *this;
+}
+
+BufferedWriter& BufferedWriter::operator<<(char c) {
+    if (used == buffer.size()) {
+        flush();
+    }
+    if (!failed) {
+        buffer[used++] = c;
+    }
+    return *this;
+}
+
+void BufferedWriter::flush() {
+    size_t written = 0;
+    while (written < used && !failed) {
+        ssize_t n = ::write(fd, buffer.data() + written, used - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            failed = true;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    used = 0;
+}
+
+bool BufferedWriter::good() const {
+    return !failed;
+}
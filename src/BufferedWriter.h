@@ -0,0 +1,35 @@
+#ifndef BUFFEREDWRITER_H
+#define BUFFEREDWRITER_H
+
+#include <string>
+#include <vector>
+
+// Collects output in a large buffer and hands it to a file descriptor with
+// write(2) only when the buffer fills or the writer is flushed, instead of
+// flushing line by line like std::endl does. Once a write fails (for example
+// the reader of a pipe went away) good() turns false so callers can stop
+// producing output early.
+class BufferedWriter {
+public:
+    static constexpr size_t defaultCapacity = 64 * 1024;
+
+    explicit BufferedWriter(int fd = 1, size_t capacity = defaultCapacity);
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    BufferedWriter& operator<<(const std::string& str);
+    BufferedWriter& operator<<(char c);
+
+    void flush();
+    bool good() const;
+
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t used;
+    bool failed;
+};
+
+#endif // BUFFEREDWRITER_H
@@ -0,0 +1,237 @@
+#include "ChangedPathIndex.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+const char filterMagic[4] = {'G', 'C', 'P', 'F'};
+const uint32_t formatVersion = 1;
+const size_t headerSize = 24;       // magic, version, commits, hashes, padding
+const size_t recordSize = 16;       // parent, length, offset
+const uint32_t none = 0xffffffff;
+
+// The two hashes a path's bit positions are made from; the second is odd so
+// the positions differ for any filter size that is a power of two.
+std::pair<uint64_t, uint64_t> pathHashes(std::string_view path) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : path) {
+        h = (h ^ c) * 0x100000001b3ull;
+    }
+    uint64_t second = h;
+    second = (second ^ (second >> 33)) * 0xff51afd7ed558ccdull;
+    second = (second ^ (second >> 33)) * 0xc4ceb9fe1a85ec53ull;
+    second ^= second >> 33;
+    return {h, second | 1};
+}
+
+uint64_t bitOf(const std::pair<uint64_t, uint64_t>& hashes, uint32_t i, uint64_t bits) {
+    return (hashes.first + i * hashes.second) % bits;
+}
+}
+
+ChangedPathIndex::ChangedPathIndex(const fs::path& gitletDir) : data(nullptr), size(0) {
+    int fd = ::open(path(gitletDir).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(mapped);
+            size = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    if (!valid() && data != nullptr) {
+        ::munmap(const_cast<unsigned char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+ChangedPathIndex::~ChangedPathIndex() {
+    if (data != nullptr) {
+        ::munmap(const_cast<unsigned char*>(data), size);
+    }
+}
+
+fs::path ChangedPathIndex::path(const fs::path& gitletDir) {
+    return gitletDir / "changed-paths";
+}
+
+bool ChangedPathIndex::valid() const {
+    if (data == nullptr || size < headerSize || std::memcmp(data, filterMagic, 4) != 0 ||
+        Utils::get32(data + 4) != formatVersion || Utils::get32(data + 16) == 0) {
+        return false;
+    }
+    return size >= headerSize + field(8) * (ObjectId::size + recordSize);
+}
+
+uint64_t ChangedPathIndex::field(size_t offset) const {
+    return Utils::get64(data + offset);
+}
+
+size_t ChangedPathIndex::commitCount() const {
+    return data ? field(8) : 0;
+}
+
+const unsigned char* ChangedPathIndex::record(size_t index) const {
+    return data + headerSize + commitCount() * ObjectId::size + index * recordSize;
+}
+
+std::optional<size_t> ChangedPathIndex::indexOf(const ObjectId& commit) const {
+    const unsigned char* ids = data + headerSize;
+    size_t lo = 0;
+    size_t hi = commitCount();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = std::memcmp(commit.bytes.data(), ids + mid * ObjectId::size, ObjectId::size);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return std::nullopt;
+}
+
+ObjectId ChangedPathIndex::id(size_t index) const {
+    ObjectId out;
+    std::memcpy(out.bytes.data(), data + headerSize + index * ObjectId::size, ObjectId::size);
+    return out;
+}
+
+std::optional<size_t> ChangedPathIndex::parent(size_t index) const {
+    uint32_t parent = Utils::get32(record(index));
+    if (parent == none || parent >= commitCount()) {
+        return std::nullopt;
+    }
+    return parent;
+}
+
+bool ChangedPathIndex::mayChange(size_t index, const std::string& path) const {
+    uint32_t length = Utils::get32(record(index) + 4);
+    uint64_t offset = Utils::get64(record(index) + 8);
+    if (length == none || offset + length > size) {
+        return true;
+    }
+    if (length == 0) {
+        return false;
+    }
+    const unsigned char* filter = data + offset;
+    uint64_t bits = uint64_t(length) * 8;
+    std::pair<uint64_t, uint64_t> hashes = pathHashes(path);
+    for (uint32_t i = 0, count = Utils::get32(data + 16); i < count; i++) {
+        uint64_t bit = bitOf(hashes, i, bits);
+        if (!(filter[bit / 8] & (1 << (bit % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ChangedPathIndex::write(const fs::path& gitletDir, const std::vector<Commit>& commits, double falsePositiveRate,
+                               size_t maxPaths) {
+    GITLET_TRACE_SCOPE("ChangedPathIndex::write");
+    falsePositiveRate = std::clamp(falsePositiveRate, 1e-9, 0.5);
+    double bitsPerPath = -std::log(falsePositiveRate) / (std::log(2.0) * std::log(2.0));
+    uint32_t hashCount = static_cast<uint32_t>(std::max(1.0, std::round(bitsPerPath * std::log(2.0))));
+
+    std::vector<std::pair<ObjectId, const Commit*>> sorted;
+    for (const Commit& commit : commits) {
+        if (std::optional<ObjectId> id = ObjectId::fromHex(commit.getOwnHash())) {
+            sorted.emplace_back(*id, &commit);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first == b.first; }),
+                 sorted.end());
+    auto numberOf = [&](const std::string& hex) -> std::optional<size_t> {
+        std::optional<ObjectId> id = ObjectId::fromHex(hex);
+        if (!id) {
+            return std::nullopt;
+        }
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), *id, [](const auto& entry, const ObjectId& key) {
+            return entry.first < key;
+        });
+        if (it == sorted.end() || it->first != *id) {
+            return std::nullopt;
+        }
+        return size_t(it - sorted.begin());
+    };
+
+    std::string records;
+    std::string filters;
+    uint64_t base = headerSize + sorted.size() * (ObjectId::size + recordSize);
+    size_t written = 0;
+    for (const auto& [id, commit] : sorted) {
+        std::optional<size_t> parent = numberOf(commit->getParentHash());
+        std::unordered_map<std::string, std::string> blobs = commit->getBlobs();
+        std::vector<std::string> changed;
+        if (parent) {
+            std::unordered_map<std::string, std::string> before = sorted[*parent].second->getBlobs();
+            for (const auto& [fileName, blobHash] : blobs) {
+                auto it = before.find(fileName);
+                if (it == before.end() || it->second != blobHash) {
+                    changed.push_back(fileName);
+                }
+            }
+            for (const auto& [fileName, blobHash] : before) {
+                if (blobs.find(fileName) == blobs.end()) {
+                    changed.push_back(fileName);
+                }
+            }
+        } else if (commit->getParentHash().empty()) {
+            for (const auto& [fileName, blobHash] : blobs) {
+                changed.push_back(fileName);
+            }
+        }
+
+        Utils::put32(records, parent ? static_cast<uint32_t>(*parent) : none);
+        // Without its parent a commit's changes are unknown, like a commit
+        // with too many.
+        if ((!parent && !commit->getParentHash().empty()) || changed.size() > maxPaths) {
+            Utils::put32(records, none);
+            Utils::put64(records, 0);
+            continue;
+        }
+        size_t bytes = changed.empty() ? 0 : static_cast<size_t>(std::ceil(changed.size() * bitsPerPath / 8));
+        std::string filter(bytes, '\0');
+        for (const auto& fileName : changed) {
+            std::pair<uint64_t, uint64_t> hashes = pathHashes(fileName);
+            for (uint32_t i = 0; i < hashCount; i++) {
+                uint64_t bit = bitOf(hashes, i, uint64_t(bytes) * 8);
+                filter[bit / 8] = static_cast<char>(filter[bit / 8] | (1 << (bit % 8)));
+            }
+        }
+        Utils::put32(records, static_cast<uint32_t>(bytes));
+        Utils::put64(records, base + filters.size());
+        filters += filter;
+        written++;
+    }
+
+    std::string out(filterMagic, 4);
+    Utils::put32(out, formatVersion);
+    Utils::put64(out, sorted.size());
+    Utils::put32(out, hashCount);
+    Utils::put32(out, 0);
+    for (const auto& [id, commit] : sorted) {
+        out.append(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+    }
+    out += records;
+    out += filters;
+    Utils::writeAtomic(path(gitletDir), out.data(), out.size());
+    Trace::count("changed-path filters written", written);
+    return written;
+}
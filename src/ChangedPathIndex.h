@@ -0,0 +1,67 @@
+#ifndef CHANGEDPATHINDEX_H
+#define CHANGEDPATHINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Commit.h"
+#include "ObjectId.h"
+
+namespace fs = std::filesystem;
+
+// Which paths each commit changed from its parent, as Bloom filters stored
+// in .gitlet/changed-paths:
+//
+//   "GCPF", version, commit count C, hash count K, 4 padding
+//   C sorted commit ids
+//   C records: parent's number or 0xffffffff, filter length in bytes or
+//              0xffffffff for "too many paths to say", filter offset
+//   the filters
+//
+// A path's K bit positions come from two hashes of it, h1 + i * h2. A
+// filter without any of a path's bits proves the commit left the path as
+// its parent had it, so a walk limited to that path goes on to the parent,
+// whose number is in the record, without reading either commit. A filter
+// has all the bits of a path it holds, and those of a few it does not: for
+// changedPaths.falsePositiveRate p, each path gets -ln p / ln^2 2 bits and
+// K = that times ln 2. A commit changing more than changedPaths.maxPaths
+// paths gets no filter and always has to be read. Commits made after the
+// index was written are not in it and are always read.
+class ChangedPathIndex {
+public:
+    explicit ChangedPathIndex(const fs::path& gitletDir);
+    ~ChangedPathIndex();
+
+    ChangedPathIndex(const ChangedPathIndex&) = delete;
+    ChangedPathIndex& operator=(const ChangedPathIndex&) = delete;
+
+    static fs::path path(const fs::path& gitletDir);
+
+    // False when there is no index or it is damaged; it then holds nothing.
+    bool valid() const;
+    size_t commitCount() const;
+
+    std::optional<size_t> indexOf(const ObjectId& commit) const;
+    ObjectId id(size_t index) const;
+    // The parent's number, if the commit has a parent the index holds.
+    std::optional<size_t> parent(size_t index) const;
+    // False only when the commit certainly did not change path.
+    bool mayChange(size_t index, const std::string& path) const;
+
+    // Replaces the index with filters for commits, which must include each
+    // one's parent, if it has one, for the parent's number to be recorded.
+    // Returns how many commits have a filter.
+    static size_t write(const fs::path& gitletDir, const std::vector<Commit>& commits, double falsePositiveRate,
+                        size_t maxPaths);
+
+private:
+    const unsigned char* data;
+    size_t size;
+
+    uint64_t field(size_t offset) const;
+    const unsigned char* record(size_t index) const;
+};
+
+#endif // CHANGEDPATHINDEX_H
@@ -1,6 +1,7 @@
 #include "Commit.h"
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
+#include <cctype>
 #include <fstream>
 #include <sstream>
 #include <chrono>
@@ -15,6 +16,12 @@ Commit::Commit(const std::string& msg, const std::unordered_map<std::string, std
     ownHash = calcHash();
 }
 
+Commit::Commit(const std::string& msg, const std::unordered_map<std::string, std::string>& blobMap, const std::string& parent,
+               const std::string& datetime)
+    : message(msg), blobs(blobMap), parentHash(parent), datetime(datetime) {
+    ownHash = calcHash();
+}
+
 std::string Commit::calcHash() const {
     std::ostringstream archive_stream;
     boost::archive::text_oarchive archive(archive_stream);
@@ -24,6 +31,70 @@ std::string Commit::calcHash() const {
     return Utils::sha1(commitData);
 }
 
+Commit Commit::withArchive(const std::string& msg, const std::unordered_map<std::string, std::string>& blobMap,
+                           const std::string& parent, const std::string& datetime, std::string& archive) {
+    Commit commit;
+    commit.message = msg;
+    commit.blobs = blobMap;
+    commit.parentHash = parent;
+    commit.datetime = datetime.empty() ? commit.currentDateTime() : datetime;
+    // What calcHash() hashes, with ownHash still empty.
+    std::ostringstream archive_stream;
+    boost::archive::text_oarchive out(archive_stream);
+    out << commit;
+    archive = archive_stream.str();
+    commit.ownHash = Utils::sha1(std::vector<char>(archive.begin(), archive.end()));
+    std::optional<size_t> field = ownHashField(archive);
+    if (!field || archive.compare(*field, 4, " 0  ") != 0) {
+        archive = commit.serializeToString();
+        return commit;
+    }
+    archive.replace(*field, 4, " " + std::to_string(commit.ownHash.size()) + " " + commit.ownHash + " ");
+    archive += '\n';
+    return commit;
+}
+
+std::optional<size_t> Commit::ownHashField(const std::string& text) {
+    // The text before ownHash, split around boost's library version, which
+    // differs between boost releases: "22 serialization::archive " and, for
+    // the commit itself, " 0 0".
+    static const std::pair<std::string, std::string> header = [] {
+        Commit probe;
+        probe.ownHash = "x";
+        std::string probeText = probe.serializeToString();
+        std::string before = probeText.substr(0, probeText.find(" 1 x "));
+        size_t version = before.find("archive ") + 8;
+        return std::make_pair(before.substr(0, version), before.substr(before.find(' ', version)));
+    }();
+
+    const auto& [lead, tail] = header;
+    if (text.compare(0, lead.size(), lead) != 0) {
+        return std::nullopt;
+    }
+    size_t at = lead.size();
+    while (at < text.size() && std::isdigit(static_cast<unsigned char>(text[at]))) {
+        at++;
+    }
+    if (at == lead.size() || text.compare(at, tail.size(), tail) != 0) {
+        return std::nullopt;
+    }
+    return at + tail.size();
+}
+
+std::string Commit::contentHash(const std::string& archive, const std::string& ownHash) {
+    std::string text = archive;
+    if (!text.empty() && text.back() == '\n') {
+        text.pop_back();
+    }
+    // A text archive writes a string as its length, a space and the string.
+    std::string stored = " " + std::to_string(ownHash.size()) + " " + ownHash + " ";
+    std::optional<size_t> field = ownHashField(text);
+    if (field && !ownHash.empty() && text.compare(*field, stored.size(), stored) == 0) {
+        text.replace(*field, stored.size(), " 0  ");
+    }
+    return Utils::sha1(std::vector<char>(text.begin(), text.end()));
+}
+
 std::string Commit::getOwnHash() const {
     return ownHash;
 }
@@ -45,14 +116,33 @@ std::unordered_map<std::string, std::string> Commit::getBlobs() const {
 }
 
 std::string Commit::globalLog() const {
+    return globalLog(ownHash);
+}
+
+std::string Commit::globalLog(const std::string& shownID) const {
     std::ostringstream log;
     log << "===\n"
-        << "Commit " << ownHash << "\n"
+        << "Commit " << shownID << "\n"
         << datetime << "\n"
         << message << "\n\n";
     return log.str();
 }
 
+std::string Commit::serializeToString() const {
+    std::ostringstream archive_stream;
+    {
+        boost::archive::text_oarchive archive(archive_stream);
+        archive << *this;
+    }
+    return archive_stream.str();
+}
+
+void Commit::deserializeFromString(const std::string& str) {
+    std::istringstream archive_stream(str);
+    boost::archive::text_iarchive archive(archive_stream);
+    archive >> *this;
+}
+
 std::string Commit::currentDateTime() const {
     auto now = std::chrono::system_clock::now();
     auto in_time_t = std::chrono::system_clock::to_time_t(now);
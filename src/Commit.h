@@ -1,12 +1,14 @@
 #ifndef COMMIT_H
 #define COMMIT_H
 
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
 
+#include <boost/serialization/library_version_type.hpp>
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/string.hpp>
 #include <boost/archive/text_oarchive.hpp>
@@ -16,14 +18,36 @@ class Commit {
 public:
     Commit();
     Commit(const std::string& msg, const std::unordered_map<std::string, std::string>& blobMap, const std::string& parent);
+    // A commit dated datetime rather than now, as fast-import makes them.
+    Commit(const std::string& msg, const std::unordered_map<std::string, std::string>& blobMap, const std::string& parent,
+           const std::string& datetime);
+
+    // A commit made as the constructors make it, dated now if datetime is
+    // empty, along with archive, the text serializeToString() would give,
+    // from one serialization instead of two.
+    static Commit withArchive(const std::string& msg, const std::unordered_map<std::string, std::string>& blobMap,
+                              const std::string& parent, const std::string& datetime, std::string& archive);
 
     std::string calcHash() const;
+    // The hash calcHash() took in the constructor, recovered from archive
+    // as serializeToString() stored it: the same text but for ownHash, then
+    // empty, and the closing newline. Only the field right after the archive
+    // header is taken for ownHash; an archive without it there hashes as it
+    // is. Loading the archive and hashing again would not do, as the blob
+    // map's order and bucket count go into the text and a loaded map need
+    // not have them.
+    static std::string contentHash(const std::string& archive, const std::string& ownHash);
     std::string getOwnHash() const;
     std::string getParentHash() const;
     std::string getMessage() const;
     std::string getDatetime() const;
     std::unordered_map<std::string, std::string> getBlobs() const;
     std::string globalLog() const;
+    // The same entry naming the commit as shownID, e.g. an abbreviation.
+    std::string globalLog(const std::string& shownID) const;
+
+    std::string serializeToString() const;
+    void deserializeFromString(const std::string& str);
 
 private:
     friend class boost::serialization::access;
@@ -44,6 +68,9 @@ private:
     std::unordered_map<std::string, std::string> blobs; // <fileName, SHA1>
 
     std::string currentDateTime() const;
+    // Where the ownHash field starts in text, the " <length> " before the
+    // id, if text is laid out as this boost writes a commit.
+    static std::optional<size_t> ownHashField(const std::string& text);
 };
 
 #endif // COMMIT_H
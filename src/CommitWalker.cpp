@@ -0,0 +1,398 @@
+#include "CommitWalker.h"
+#include "ObjectStore.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+ConcurrentIdSet::ConcurrentIdSet(size_t capacity) {
+    // At most half full, so probe runs stay short.
+    size_t size = 64;
+    while (size < 2 * capacity) {
+        size *= 2;
+    }
+    slots = std::make_unique<Slot[]>(size);
+    mask = size - 1;
+}
+
+bool ConcurrentIdSet::insert(const ObjectId& id) {
+    uint64_t tag;
+    std::memcpy(&tag, id.bytes.data(), sizeof(tag));
+    tag |= 1;  // 0 marks an empty slot
+    size_t start = ObjectIdHash()(id) & mask;
+    for (size_t probe = 0; probe <= mask; probe++) {
+        Slot& slot = slots[(start + probe) & mask];
+        uint64_t seen = slot.tag.load(std::memory_order_acquire);
+        if (seen == 0) {
+            if (slot.tag.compare_exchange_strong(seen, tag, std::memory_order_acq_rel)) {
+                slot.id = id;
+                slot.ready.store(true, std::memory_order_release);
+                return true;
+            }
+        }
+        if (seen == tag) {
+            while (!slot.ready.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            if (slot.id == id) {
+                return false;
+            }
+        }
+    }
+    throw std::length_error("id set is full");
+}
+
+CommitWalker::CommitWalker(const ObjectStore& objects, std::function<std::string(const Commit&)> parentOf, unsigned threads)
+    : objects(objects), parentOf(std::move(parentOf)),
+      threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+void CommitWalker::walk(const std::vector<std::string>& starts, const std::function<void(const Commit&)>& visit) {
+    traverse(starts, [&](unsigned, bool, Commit& commit) { visit(commit); });
+}
+
+std::vector<Commit> CommitWalker::history(const std::vector<std::string>& starts) {
+    std::vector<std::vector<std::vector<Commit>>> chains(threads);
+    traverse(starts, [&](unsigned worker, bool startsChain, Commit& commit) {
+        if (startsChain) {
+            chains[worker].emplace_back();
+        }
+        chains[worker].back().push_back(std::move(commit));
+    });
+
+    GITLET_TRACE_SCOPE("CommitWalker::merge");
+    std::vector<std::vector<Commit>*> all;
+    size_t total = 0;
+    for (auto& perWorker : chains) {
+        for (auto& chain : perWorker) {
+            all.push_back(&chain);
+            total += chain.size();
+        }
+    }
+    // Heads of the chains, newest first; a chain's next commit enters only
+    // after the one before it left, and a commit another chain ends above
+    // only after that chain has left entirely, so children stay ahead of
+    // parents even when their dates are equal.
+    std::unordered_map<std::string, size_t> children;
+    for (auto* chain : all) {
+        if (!chain->empty()) {
+            children[parentOf(chain->back())]++;
+        }
+    }
+    std::unordered_map<std::string, std::pair<size_t, size_t>> waiting;
+    auto older = [&](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+        const Commit& x = (*all[a.first])[a.second];
+        const Commit& y = (*all[b.first])[b.second];
+        if (x.getDatetime() != y.getDatetime()) {
+            return x.getDatetime() < y.getDatetime();
+        }
+        return x.getOwnHash() > y.getOwnHash();
+    };
+    std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>, decltype(older)> heads(older);
+    auto enter = [&](size_t chain, size_t position) {
+        const std::string& commitID = (*all[chain])[position].getOwnHash();
+        auto it = children.find(commitID);
+        if (it != children.end() && it->second > 0) {
+            waiting.emplace(commitID, std::make_pair(chain, position));
+        } else {
+            heads.emplace(chain, position);
+        }
+    };
+    for (size_t i = 0; i < all.size(); i++) {
+        if (!all[i]->empty()) {
+            enter(i, 0);
+        }
+    }
+    std::vector<Commit> merged;
+    merged.reserve(total);
+    while (!heads.empty()) {
+        auto [chain, position] = heads.top();
+        heads.pop();
+        merged.push_back(std::move((*all[chain])[position]));
+        if (position + 1 < all[chain]->size()) {
+            enter(chain, position + 1);
+            continue;
+        }
+        std::string parent = parentOf(merged.back());
+        auto it = children.find(parent);
+        if (it != children.end() && --it->second == 0) {
+            auto held = waiting.find(parent);
+            if (held != waiting.end()) {
+                heads.emplace(held->second);
+                waiting.erase(held);
+            }
+        }
+    }
+    return merged;
+}
+
+// Each round takes every commit dated like the newest one left, together
+// with the ancestors they reach through commits of that same date. No
+// commit outside the group can be a child of one in it, so ordering the
+// group by its own parent links, ties by id, keeps children ahead.
+void CommitWalker::newestFirst(const std::vector<std::string>& starts,
+                               const std::function<bool(const Commit&)>& visit) {
+    GITLET_TRACE_SCOPE("CommitWalker::newestFirst");
+    std::unordered_set<std::string> seen;
+    auto read = [&](const std::string& commitID) -> std::optional<Commit> {
+        if (commitID.empty() || !seen.insert(commitID).second) {
+            return std::nullopt;
+        }
+        std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, commitID);
+        if (!data) {
+            return std::nullopt;
+        }
+        Commit commit;
+        commit.deserializeFromString(std::string(data->begin(), data->end()));
+        Trace::count("commits walked");
+        return commit;
+    };
+    auto older = [](const Commit& a, const Commit& b) { return a.getDatetime() < b.getDatetime(); };
+    std::priority_queue<Commit, std::vector<Commit>, decltype(older)> frontier(older);
+    for (const auto& start : starts) {
+        if (std::optional<Commit> commit = read(start)) {
+            frontier.push(std::move(*commit));
+        }
+    }
+    while (!frontier.empty()) {
+        std::string date = frontier.top().getDatetime();
+        std::vector<Commit> group;
+        while (!frontier.empty() && frontier.top().getDatetime() == date) {
+            group.push_back(frontier.top());
+            frontier.pop();
+        }
+        for (size_t i = 0; i < group.size(); i++) {
+            if (std::optional<Commit> parent = read(parentOf(group[i]))) {
+                if (parent->getDatetime() == date) {
+                    group.push_back(std::move(*parent));
+                } else {
+                    frontier.push(std::move(*parent));
+                }
+            }
+        }
+
+        std::unordered_map<std::string, size_t> indexOf;
+        std::vector<size_t> children(group.size(), 0);
+        for (size_t i = 0; i < group.size(); i++) {
+            indexOf.emplace(group[i].getOwnHash(), i);
+        }
+        for (const Commit& commit : group) {
+            auto parent = indexOf.find(parentOf(commit));
+            if (parent != indexOf.end()) {
+                children[parent->second]++;
+            }
+        }
+        auto later = [&](size_t a, size_t b) { return group[a].getOwnHash() > group[b].getOwnHash(); };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> ready(later);
+        for (size_t i = 0; i < group.size(); i++) {
+            if (children[i] == 0) {
+                ready.push(i);
+            }
+        }
+        while (!ready.empty()) {
+            size_t i = ready.top();
+            ready.pop();
+            if (!visit(group[i])) {
+                return;
+            }
+            auto parent = indexOf.find(parentOf(group[i]));
+            if (parent != indexOf.end() && --children[parent->second] == 0) {
+                ready.push(parent->second);
+            }
+        }
+    }
+}
+
+void CommitWalker::forEach(const std::vector<ObjectId>& ids, const std::function<void(const Commit&)>& visit) {
+    GITLET_TRACE_SCOPE("CommitWalker::forEach");
+    if (ids.empty()) {
+        return;
+    }
+    warmUp(ids.front().hex());
+    std::atomic<size_t> next{0};
+    runWorkers([&](unsigned) {
+        // Small slices keep the threads even when commits differ in size.
+        const size_t slice = 64;
+        for (size_t begin = next.fetch_add(slice); begin < ids.size(); begin = next.fetch_add(slice)) {
+            for (size_t i = begin; i < std::min(ids.size(), begin + slice); i++) {
+                std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, ids[i].hex());
+                if (data) {
+                    Commit commit;
+                    commit.deserializeFromString(std::string(data->begin(), data->end()));
+                    Trace::count("commits walked");
+                    visit(commit);
+                }
+            }
+        }
+    });
+}
+
+void CommitWalker::traverse(const std::vector<std::string>& starts,
+                            const std::function<void(unsigned, bool, Commit&)>& visit) {
+    GITLET_TRACE_SCOPE("CommitWalker::traverse");
+    if (starts.empty()) {
+        return;
+    }
+    warmUp(starts.front());
+    // With fewer starts than threads the idle workers read ahead from every
+    // commit there is, so one deep history is not read by one thread.
+    std::vector<ObjectId> seeds;
+    if (starts.size() < threads) {
+        seeds = objects.list(ObjectType::Commit);
+    }
+    // A bound on how many commits there are, plus the starts themselves,
+    // which may name missing commits.
+    ConcurrentIdSet claimed(objects.countBound(ObjectType::Commit) + starts.size());
+    std::vector<std::vector<Chain>> ahead(threads);
+    std::vector<std::vector<ObjectId>> stops(threads);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> nextSeed{0};
+    runWorkers([&](unsigned worker) {
+        for (size_t i = next.fetch_add(1); i < starts.size(); i = next.fetch_add(1)) {
+            std::optional<ObjectId> id = ObjectId::fromHex(starts[i]);
+            bool startsChain = true;
+            while (id && claimed.insert(*id)) {
+                std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, id->hex());
+                if (!data) {
+                    break;
+                }
+                Commit commit;
+                commit.deserializeFromString(std::string(data->begin(), data->end()));
+                Trace::count("commits walked");
+                id = ObjectId::fromHex(parentOf(commit));
+                visit(worker, startsChain, commit);
+                startsChain = false;
+            }
+            if (id) {
+                stops[worker].push_back(*id);
+            }
+        }
+        const size_t slice = 64;
+        for (size_t begin = nextSeed.fetch_add(slice); begin < seeds.size(); begin = nextSeed.fetch_add(slice)) {
+            for (size_t i = begin; i < std::min(seeds.size(), begin + slice); i++) {
+                Chain chain = readAhead(seeds[i], claimed);
+                if (!chain.ids.empty()) {
+                    ahead[worker].push_back(std::move(chain));
+                }
+            }
+        }
+    });
+    if (seeds.empty()) {
+        return;
+    }
+
+    // The part of each chain read ahead that a walk from the starts ran
+    // into, from where it ran in; what the starts do not reach is dropped.
+    std::vector<Chain*> chains;
+    std::unordered_map<ObjectId, std::pair<size_t, size_t>, ObjectIdHash> where;
+    for (auto& perWorker : ahead) {
+        for (Chain& chain : perWorker) {
+            for (size_t i = 0; i < chain.ids.size(); i++) {
+                where.emplace(chain.ids[i], std::make_pair(chains.size(), i));
+            }
+            chains.push_back(&chain);
+        }
+    }
+    std::vector<size_t> from(chains.size(), SIZE_MAX);
+    std::vector<ObjectId> pending;
+    for (auto& perWorker : stops) {
+        pending.insert(pending.end(), perWorker.begin(), perWorker.end());
+    }
+    while (!pending.empty()) {
+        auto it = where.find(pending.back());
+        pending.pop_back();
+        if (it == where.end()) {
+            continue;
+        }
+        auto [chain, position] = it->second;
+        if (from[chain] == SIZE_MAX && chains[chain]->stop) {
+            pending.push_back(*chains[chain]->stop);
+        }
+        from[chain] = std::min(from[chain], position);
+    }
+    std::vector<size_t> reached;
+    for (size_t i = 0; i < chains.size(); i++) {
+        if (from[i] != SIZE_MAX) {
+            reached.push_back(i);
+        }
+    }
+    Trace::count("commit chains read ahead", chains.size());
+
+    std::atomic<size_t> nextChain{0};
+    runWorkers([&](unsigned worker) {
+        for (size_t i = nextChain.fetch_add(1); i < reached.size(); i = nextChain.fetch_add(1)) {
+            const Chain& chain = *chains[reached[i]];
+            for (size_t j = from[reached[i]]; j < chain.ids.size(); j++) {
+                std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, chain.ids[j].hex());
+                if (!data) {
+                    break;
+                }
+                Commit commit;
+                commit.deserializeFromString(std::string(data->begin(), data->end()));
+                Trace::count("commits walked");
+                visit(worker, j == from[reached[i]], commit);
+            }
+        }
+    });
+}
+
+// Reading ahead may meet commits nothing reaches, so one that does not load
+// only ends the chain here; the walk that reaches it reads it again.
+CommitWalker::Chain CommitWalker::readAhead(const ObjectId& seed, ConcurrentIdSet& claimed) const {
+    Chain chain;
+    std::optional<ObjectId> id = seed;
+    while (id && claimed.insert(*id)) {
+        chain.ids.push_back(*id);
+        std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, id->hex());
+        if (!data) {
+            return chain;
+        }
+        Commit commit;
+        try {
+            commit.deserializeFromString(std::string(data->begin(), data->end()));
+        } catch (const std::exception&) {
+            return chain;
+        }
+        Trace::count("commits read ahead");
+        id = ObjectId::fromHex(parentOf(commit));
+    }
+    chain.stop = id;
+    return chain;
+}
+
+void CommitWalker::warmUp(const std::string& commitID) const {
+    objects.packs();
+    std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, commitID);
+    if (data) {
+        Commit commit;
+        commit.deserializeFromString(std::string(data->begin(), data->end()));
+    }
+}
+
+void CommitWalker::runWorkers(const std::function<void(unsigned)>& work) const {
+    std::vector<std::exception_ptr> failures(std::max(1u, threads));
+    auto run = [&work, &failures](unsigned worker) {
+        try {
+            work(worker);
+        } catch (...) {
+            failures[worker] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; i++) {
+        pool.emplace_back(run, i);
+    }
+    run(0);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    for (const std::exception_ptr& failure : failures) {
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef COMMITWALKER_H
+#define COMMITWALKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Commit.h"
+#include "ObjectId.h"
+
+class ObjectStore;
+
+// A set of ids that many threads insert into at once without a lock. It is
+// open addressing over a fixed table sized for at most `capacity` ids: a
+// thread claims an empty slot by compare-and-swap of the id's leading eight
+// bytes, then publishes the whole id, and a thread that meets the same
+// leading bytes waits for that id before comparing all twenty.
+class ConcurrentIdSet {
+public:
+    explicit ConcurrentIdSet(size_t capacity);
+
+    // Adds the id and returns whether it was absent. Throws
+    // std::length_error past capacity.
+    bool insert(const ObjectId& id);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> tag{0};
+        std::atomic<bool> ready{false};
+        ObjectId id;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+};
+
+// Walks the commit graph on several threads.
+//
+// Every starting commit is a task. A worker takes one, claims it in a
+// shared ConcurrentIdSet and follows its parents, claiming each, until it
+// meets a commit another walk claimed first; so the walks partition the
+// graph into chains, each read by one thread. With fewer starts than
+// threads, workers left without one take every commit id there is as a
+// start and read ahead, keeping only ids. Once all have joined, the parts
+// of those chains the starts reach are read again, a chain per task, so a
+// single deep history is read by all the threads, at the cost of reading
+// its commits twice. Each chain comes out newest first, and history()
+// merges the chains into one stream by date.
+class CommitWalker {
+public:
+    // parentOf names the parent a walk follows, "" for none. threads 0 means
+    // one per core.
+    CommitWalker(const ObjectStore& objects, std::function<std::string(const Commit&)> parentOf, unsigned threads = 0);
+
+    // Calls visit once for every commit reachable from starts, from several
+    // threads at once.
+    void walk(const std::vector<std::string>& starts, const std::function<void(const Commit&)>& visit);
+    // Every commit reachable from starts, newest first, each before its
+    // parent.
+    std::vector<Commit> history(const std::vector<std::string>& starts);
+    // The same order, read on this thread one commit at a time, until visit
+    // returns false. Commits are taken newest first, so a caller that stops
+    // early reads little more than it was shown. Order agrees with
+    // history() as long as no commit is dated before its parent.
+    void newestFirst(const std::vector<std::string>& starts, const std::function<bool(const Commit&)>& visit);
+    // Reads every commit of ids, from several threads at once, and calls
+    // visit for each one found.
+    void forEach(const std::vector<ObjectId>& ids, const std::function<void(const Commit&)>& visit);
+
+private:
+    // Ids read ahead from a seed, newest first, and the parent the chain
+    // ran into, already claimed, if it has one.
+    struct Chain {
+        std::vector<ObjectId> ids;
+        std::optional<ObjectId> stop;
+    };
+
+    const ObjectStore& objects;
+    std::function<std::string(const Commit&)> parentOf;
+    unsigned threads;
+
+    // Calls visit(worker, startsChain, commit) for every reachable commit;
+    // a worker's calls for one chain are consecutive, newest first.
+    void traverse(const std::vector<std::string>& starts,
+                  const std::function<void(unsigned, bool, Commit&)>& visit);
+    Chain readAhead(const ObjectId& seed, ConcurrentIdSet& claimed) const;
+    // Loads the pack list and decodes one commit, so nothing lazily
+    // initialized is left for the workers to race on.
+    void warmUp(const std::string& commitID) const;
+    // Runs work(worker) on each of the threads. A worker that throws stops
+    // only itself; once all have joined, the first failure is rethrown.
+    void runWorkers(const std::function<void(unsigned)>& work) const;
+};
+
+#endif // COMMITWALKER_H
@@ -0,0 +1,124 @@
+#include "Config.h"
+#include "LockFile.h"
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace {
+std::string trim(const std::string& str) {
+    size_t begin = str.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(begin, end - begin + 1);
+}
+}
+
+Config::Config(const fs::path& gitletDir) : path(gitletDir / "config") {
+    load();
+}
+
+void Config::load() {
+    values.clear();
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string trimmed = trim(line);
+        size_t eq = trimmed.find('=');
+        if (trimmed.empty() || trimmed[0] == '#' || eq == std::string::npos) {
+            continue;
+        }
+        values[trim(trimmed.substr(0, eq))] = trim(trimmed.substr(eq + 1));
+    }
+}
+
+void Config::save(LockFile& lock) {
+    std::ostringstream out;
+    for (const auto& [key, value] : values) {
+        out << key << " = " << value << "\n";
+    }
+    lock.commit(out.str());
+}
+
+std::optional<std::string> Config::get(const std::string& key) const {
+    auto it = values.find(key);
+    if (it == values.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::string Config::getString(const std::string& key, const std::string& fallback) const {
+    return get(key).value_or(fallback);
+}
+
+std::optional<long long> Config::parseInt(const std::string& value) {
+    if (value.empty()) {
+        return std::nullopt;
+    }
+    size_t used = 0;
+    long long number;
+    try {
+        number = std::stoll(value, &used);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+    std::string suffix = value.substr(used);
+    if (suffix.empty()) {
+        return number;
+    }
+    if (suffix.size() != 1) {
+        return std::nullopt;
+    }
+    switch (std::tolower(static_cast<unsigned char>(suffix[0]))) {
+        case 'k': return number << 10;
+        case 'm': return number << 20;
+        case 'g': return number << 30;
+        default: return std::nullopt;
+    }
+}
+
+long long Config::getInt(const std::string& key, long long fallback) const {
+    std::optional<std::string> value = get(key);
+    if (!value) {
+        return fallback;
+    }
+    return parseInt(*value).value_or(fallback);
+}
+
+bool Config::getBool(const std::string& key, bool fallback) const {
+    std::optional<std::string> value = get(key);
+    if (!value) {
+        return fallback;
+    }
+    if (*value == "true" || *value == "yes" || *value == "on" || *value == "1") {
+        return true;
+    }
+    if (*value == "false" || *value == "no" || *value == "off" || *value == "0") {
+        return false;
+    }
+    return fallback;
+}
+
+// Reloads under the lock so a concurrent set() of another key is kept.
+void Config::set(const std::string& key, const std::string& value) {
+    LockFile lock(path);
+    load();
+    values[key] = value;
+    save(lock);
+}
+
+bool Config::unset(const std::string& key) {
+    LockFile lock(path);
+    load();
+    if (values.erase(key) == 0) {
+        return false;
+    }
+    save(lock);
+    return true;
+}
+
+const std::map<std::string, std::string>& Config::entries() const {
+    return values;
+}
@@ -0,0 +1,39 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Repository settings in .gitlet/config, one "key = value" per line with
+// dotted keys such as gc.pruneExpire. Lines starting with '#' are ignored.
+class LockFile;
+
+class Config {
+public:
+    explicit Config(const fs::path& gitletDir);
+
+    std::optional<std::string> get(const std::string& key) const;
+    std::string getString(const std::string& key, const std::string& fallback) const;
+    // Integers may carry a k, m or g suffix (powers of 1024).
+    long long getInt(const std::string& key, long long fallback) const;
+    bool getBool(const std::string& key, bool fallback) const;
+
+    void set(const std::string& key, const std::string& value);
+    bool unset(const std::string& key);
+    const std::map<std::string, std::string>& entries() const;
+
+    static std::optional<long long> parseInt(const std::string& value);
+
+private:
+    fs::path path;
+    std::map<std::string, std::string> values;
+
+    void load();
+    void save(LockFile& lock);
+};
+
+#endif // CONFIG_H
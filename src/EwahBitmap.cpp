@@ -0,0 +1,287 @@
+#include "EwahBitmap.h"
+#include "Utils.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace {
+const uint64_t maxRun = (uint64_t(1) << 32) - 1;
+const uint64_t maxLiterals = (uint64_t(1) << 31) - 1;
+const uint64_t allOnes = ~uint64_t(0);
+}
+
+// Appends runs and literal words, merging runs into the current marker.
+class EwahBitmap::Builder {
+public:
+    Builder() : marker(0), words(0) {
+        buffer.push_back(0);
+    }
+
+    void addRun(bool bit, uint64_t n) {
+        while (n > 0) {
+            uint64_t m = buffer[marker];
+            uint64_t literals = m >> 33;
+            uint64_t run = (m >> 1) & maxRun;
+            bool runBit = m & 1;
+            if (literals == 0 && (run == 0 || runBit == bit) && run < maxRun) {
+                uint64_t add = std::min(n, maxRun - run);
+                run += add;
+                n -= add;
+                words += add;
+                buffer[marker] = (bit ? 1 : 0) | run << 1;
+            } else {
+                buffer.push_back(0);
+                marker = buffer.size() - 1;
+            }
+        }
+    }
+
+    void addLiteral(uint64_t word) {
+        if (word == 0 || word == allOnes) {
+            addRun(word != 0, 1);
+            return;
+        }
+        if ((buffer[marker] >> 33) >= maxLiterals) {
+            buffer.push_back(0);
+            marker = buffer.size() - 1;
+        }
+        uint64_t m = buffer[marker];
+        buffer[marker] = (m & ((uint64_t(1) << 33) - 1)) | ((m >> 33) + 1) << 33;
+        buffer.push_back(word);
+        words++;
+    }
+
+    EwahBitmap finish() {
+        EwahBitmap bitmap;
+        bitmap.buffer = std::move(buffer);
+        bitmap.words = words;
+        return bitmap;
+    }
+
+private:
+    std::vector<uint64_t> buffer;
+    size_t marker;
+    size_t words;
+};
+
+// Walks a compressed buffer as a sequence of runs and literal words.
+class EwahBitmap::Cursor {
+public:
+    explicit Cursor(const EwahBitmap& bitmap) : buffer(bitmap.buffer), pos(0), runBit(false), runLeft(0), literalsLeft(0) {
+        normalize();
+    }
+
+    bool done() const { return runLeft == 0 && literalsLeft == 0; }
+    bool inRun() const { return runLeft > 0; }
+    bool bit() const { return runBit; }
+    uint64_t run() const { return runLeft; }
+    uint64_t literals() const { return literalsLeft; }
+    uint64_t runWord() const { return runBit ? allOnes : 0; }
+    uint64_t literal() const { return buffer[pos]; }
+
+    void skipRun(uint64_t n) {
+        runLeft -= n;
+        normalize();
+    }
+
+    void skipLiterals(uint64_t n) {
+        pos += n;
+        literalsLeft -= n;
+        normalize();
+    }
+
+private:
+    const std::vector<uint64_t>& buffer;
+    size_t pos;
+    bool runBit;
+    uint64_t runLeft;
+    uint64_t literalsLeft;
+
+    // Loads markers until there is a word to read or the buffer ends.
+    void normalize() {
+        while (runLeft == 0 && literalsLeft == 0 && pos < buffer.size()) {
+            uint64_t m = buffer[pos++];
+            runBit = m & 1;
+            runLeft = (m >> 1) & maxRun;
+            literalsLeft = m >> 33;
+        }
+    }
+};
+
+EwahBitmap::EwahBitmap() : buffer{0}, words(0) {}
+
+EwahBitmap EwahBitmap::fromWords(const std::vector<uint64_t>& plain) {
+    Builder builder;
+    for (uint64_t word : plain) {
+        builder.addLiteral(word);
+    }
+    return builder.finish();
+}
+
+std::vector<uint64_t> EwahBitmap::toWords() const {
+    std::vector<uint64_t> plain;
+    plain.reserve(words);
+    for (Cursor c(*this); !c.done();) {
+        if (c.inRun()) {
+            plain.insert(plain.end(), c.run(), c.runWord());
+            c.skipRun(c.run());
+        } else {
+            plain.push_back(c.literal());
+            c.skipLiterals(1);
+        }
+    }
+    return plain;
+}
+
+bool EwahBitmap::test(size_t bit) const {
+    size_t target = bit / 64;
+    size_t word = 0;
+    for (Cursor c(*this); !c.done();) {
+        if (c.inRun()) {
+            if (target < word + c.run()) {
+                return c.bit();
+            }
+            word += c.run();
+            c.skipRun(c.run());
+        } else {
+            if (target < word + c.literals()) {
+                c.skipLiterals(target - word);
+                return (c.literal() >> (bit % 64)) & 1;
+            }
+            word += c.literals();
+            c.skipLiterals(c.literals());
+        }
+    }
+    return false;
+}
+
+size_t EwahBitmap::count() const {
+    size_t total = 0;
+    for (Cursor c(*this); !c.done();) {
+        if (c.inRun()) {
+            total += c.bit() ? c.run() * 64 : 0;
+            c.skipRun(c.run());
+        } else {
+            total += std::popcount(c.literal());
+            c.skipLiterals(1);
+        }
+    }
+    return total;
+}
+
+size_t EwahBitmap::sizeInWords() const {
+    return words;
+}
+
+void EwahBitmap::forEach(const std::function<void(size_t)>& visit) const {
+    size_t word = 0;
+    for (Cursor c(*this); !c.done();) {
+        if (c.inRun()) {
+            if (c.bit()) {
+                for (size_t bit = word * 64; bit < (word + c.run()) * 64; bit++) {
+                    visit(bit);
+                }
+            }
+            word += c.run();
+            c.skipRun(c.run());
+        } else {
+            for (uint64_t bits = c.literal(); bits != 0; bits &= bits - 1) {
+                visit(word * 64 + std::countr_zero(bits));
+            }
+            word++;
+            c.skipLiterals(1);
+        }
+    }
+}
+
+template<class Op>
+EwahBitmap EwahBitmap::combine(const EwahBitmap& a, const EwahBitmap& b, Op op, bool keepRestOfA, bool keepRestOfB) {
+    Builder out;
+    Cursor ca(a);
+    Cursor cb(b);
+    while (!ca.done() && !cb.done()) {
+        if (ca.inRun() && cb.inRun()) {
+            uint64_t n = std::min(ca.run(), cb.run());
+            out.addRun(op(ca.runWord(), cb.runWord()) != 0, n);
+            ca.skipRun(n);
+            cb.skipRun(n);
+        } else if (ca.inRun() || cb.inRun()) {
+            Cursor& run = ca.inRun() ? ca : cb;
+            Cursor& lit = ca.inRun() ? cb : ca;
+            auto apply = [&](uint64_t literal) {
+                return ca.inRun() ? op(run.runWord(), literal) : op(literal, run.runWord());
+            };
+            uint64_t ifZero = apply(0);
+            if (ifZero == apply(allOnes) && (ifZero == 0 || ifZero == allOnes)) {
+                // The run alone decides the result, so skip the literals in bulk.
+                uint64_t n = std::min(run.run(), lit.literals());
+                out.addRun(ifZero != 0, n);
+                run.skipRun(n);
+                lit.skipLiterals(n);
+            } else {
+                out.addLiteral(apply(lit.literal()));
+                run.skipRun(1);
+                lit.skipLiterals(1);
+            }
+        } else {
+            out.addLiteral(op(ca.literal(), cb.literal()));
+            ca.skipLiterals(1);
+            cb.skipLiterals(1);
+        }
+    }
+
+    for (Cursor* rest : {keepRestOfA ? &ca : nullptr, keepRestOfB ? &cb : nullptr}) {
+        while (rest != nullptr && !rest->done()) {
+            if (rest->inRun()) {
+                out.addRun(rest->bit(), rest->run());
+                rest->skipRun(rest->run());
+            } else {
+                out.addLiteral(rest->literal());
+                rest->skipLiterals(1);
+            }
+        }
+    }
+    return out.finish();
+}
+
+EwahBitmap EwahBitmap::operator|(const EwahBitmap& other) const {
+    return combine(*this, other, [](uint64_t x, uint64_t y) { return x | y; }, true, true);
+}
+
+EwahBitmap EwahBitmap::operator&(const EwahBitmap& other) const {
+    return combine(*this, other, [](uint64_t x, uint64_t y) { return x & y; }, false, false);
+}
+
+EwahBitmap EwahBitmap::andNot(const EwahBitmap& other) const {
+    return combine(*this, other, [](uint64_t x, uint64_t y) { return x & ~y; }, true, false);
+}
+
+std::string EwahBitmap::serialize() const {
+    std::string out;
+    Utils::put64(out, buffer.size());
+    Utils::put64(out, words);
+    for (uint64_t word : buffer) {
+        Utils::put64(out, word);
+    }
+    return out;
+}
+
+EwahBitmap EwahBitmap::deserialize(const char* data, size_t size) {
+    if (size < 16) {
+        throw std::invalid_argument("truncated bitmap");
+    }
+    uint64_t count = Utils::get64(data);
+    if (size < 16 + count * 8) {
+        throw std::invalid_argument("truncated bitmap");
+    }
+    EwahBitmap bitmap;
+    bitmap.words = Utils::get64(data + 8);
+    bitmap.buffer.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        bitmap.buffer[i] = Utils::get64(data + 16 + i * 8);
+    }
+    if (bitmap.buffer.empty()) {
+        bitmap.buffer.push_back(0);
+    }
+    return bitmap;
+}
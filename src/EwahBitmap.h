@@ -0,0 +1,53 @@
+#ifndef EWAHBITMAP_H
+#define EWAHBITMAP_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Compressed bitmap in the EWAH (Enhanced Word-Aligned Hybrid) format.
+// The bits are split into 64-bit words, and the buffer is a sequence of
+// marker words, each followed by literal words. A marker holds:
+//
+//   bit 0        value of the run of clean (all 0 or all 1) words
+//   bits 1-32    number of clean words in the run
+//   bits 33-63   number of literal words that follow the marker
+//
+// OR, AND and AND-NOT work directly on the compressed form, so long runs
+// cost one step each. This is the format git uses for reachability bitmaps.
+class EwahBitmap {
+public:
+    EwahBitmap();
+
+    // Compresses plain 64-bit words, bit i living in words[i / 64].
+    static EwahBitmap fromWords(const std::vector<uint64_t>& words);
+    std::vector<uint64_t> toWords() const;
+
+    bool test(size_t bit) const;
+    size_t count() const;
+    // Number of uncompressed words covered.
+    size_t sizeInWords() const;
+    void forEach(const std::function<void(size_t)>& visit) const;
+
+    EwahBitmap operator|(const EwahBitmap& other) const;
+    EwahBitmap operator&(const EwahBitmap& other) const;
+    // Bits set here and not in other.
+    EwahBitmap andNot(const EwahBitmap& other) const;
+
+    // Little-endian word count, covered words, then the buffer.
+    std::string serialize() const;
+    static EwahBitmap deserialize(const char* data, size_t size);
+
+private:
+    class Builder;
+    class Cursor;
+
+    std::vector<uint64_t> buffer;
+    size_t words;
+
+    template<class Op>
+    static EwahBitmap combine(const EwahBitmap& a, const EwahBitmap& b, Op op, bool keepRestOfA, bool keepRestOfB);
+};
+
+#endif // EWAHBITMAP_H
@@ -0,0 +1,53 @@
+#include "Executor.h"
+#include "Trace.h"
+#include <algorithm>
+
+std::unique_ptr<Executor> Executor::create(const std::string& kind, unsigned threads) {
+    if (kind == "inline") {
+        return std::make_unique<InlineExecutor>();
+    }
+    // Most of what runs here waits on I/O, so even one core gets two workers.
+    return std::make_unique<ThreadPoolExecutor>(threads ? threads : std::max(2u, std::thread::hardware_concurrency()));
+}
+
+ThreadPoolExecutor::ThreadPoolExecutor(unsigned threads) {
+    for (unsigned i = 0; i < std::max(1u, threads); i++) {
+        workers.emplace_back([this]() { work(); });
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPoolExecutor::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(handle);
+    }
+    Trace::count("coroutines scheduled");
+    ready.notify_one();
+}
+
+void ThreadPoolExecutor::work() {
+    while (true) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            handle = queue.front();
+            queue.pop_front();
+        }
+        handle.resume();
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where coroutines resume. `co_await executor.schedule()` moves the rest of
+// a coroutine onto the executor: the inline executor keeps running it right
+// there, so the same code runs synchronously, and the thread pool hands it
+// to a worker so it overlaps with whatever the caller does next.
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    virtual void post(std::coroutine_handle<> handle) = 0;
+    virtual bool isInline() const = 0;
+
+    struct ScheduleAwaiter {
+        Executor& executor;
+        bool await_ready() const noexcept { return executor.isInline(); }
+        void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    ScheduleAwaiter schedule() { return ScheduleAwaiter{*this}; }
+
+    // "inline" or "threads"; threads may be 0 for the default count.
+    static std::unique_ptr<Executor> create(const std::string& kind, unsigned threads = 0);
+};
+
+class InlineExecutor : public Executor {
+public:
+    void post(std::coroutine_handle<> handle) override { handle.resume(); }
+    bool isInline() const override { return true; }
+};
+
+class ThreadPoolExecutor : public Executor {
+public:
+    explicit ThreadPoolExecutor(unsigned threads);
+    // Runs what is queued, then joins the workers.
+    ~ThreadPoolExecutor() override;
+
+    void post(std::coroutine_handle<> handle) override;
+    bool isInline() const override { return false; }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::coroutine_handle<>> queue;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void work();
+};
+
+#endif // EXECUTOR_H
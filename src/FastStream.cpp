@@ -0,0 +1,290 @@
+#include "FastStream.h"
+#include "RefStore.h"
+#include "Trace.h"
+#include "Transport.h"
+#include "Utils.h"
+
+namespace {
+const uint64_t maxDataSize = uint64_t(1) << 40;
+const size_t recentCommits = 16;
+
+bool isCommand(const std::string& line) {
+    return line == "blob" || line == "commit" || line.rfind("commit ", 0) == 0 || line.rfind("reset ", 0) == 0 ||
+           line == "done";
+}
+}
+
+FastImport::FastImport(ObjectStore& objects, RefStore& refs,
+                       std::function<std::optional<Commit>(const std::string&)> readCommit)
+    : objects(objects), refs(refs), readCommit(std::move(readCommit)) {}
+
+ImportResult FastImport::run(Channel& in) {
+    GITLET_TRACE_SCOPE("FastImport::run");
+    ImportResult result;
+    ObjectStore::PackWriter pack(objects.packsDir());
+    std::string line;
+    while (nextLine(in, line) && line != "done") {
+        bool ok;
+        if (line.empty()) {
+            continue;
+        } else if (line == "blob") {
+            ok = importBlob(in, pack, result);
+        } else if (line == "commit" || line.rfind("commit ", 0) == 0) {
+            ok = importCommit(in, line.size() > 7 ? line.substr(7) : "", pack, result);
+        } else if (line.rfind("reset ", 0) == 0 && line.size() > 6) {
+            ok = importReset(in, line.substr(6), result);
+        } else {
+            ok = fail(result, "unknown command \"" + line + "\"");
+        }
+        if (!ok) {
+            return result;
+        }
+    }
+
+    pack.finish();
+    objects.rescanPacks();
+    std::map<std::string, std::pair<std::string, std::string>> moves;
+    for (const auto& [branch, commitID] : tips) {
+        if (commitID != previous.at(branch)) {
+            moves.emplace(branch, std::make_pair(commitID, previous.at(branch)));
+        }
+    }
+    if (!refs.updateAll(moves)) {
+        result.error = "a branch was moved during the import";
+        return result;
+    }
+    result.branches = moves.size();
+    return result;
+}
+
+bool FastImport::importBlob(Channel& in, ObjectStore::PackWriter& pack, ImportResult& result) {
+    std::optional<uint64_t> mark;
+    std::vector<char> data;
+    if (!readMark(in, mark, result) || !readData(in, data, result)) {
+        return false;
+    }
+    std::string blobHash = Utils::sha1(data);
+    if (blobs.insert(blobHash).second && !objects.has(ObjectType::Blob, blobHash)) {
+        pack.add(ObjectType::Blob, *ObjectId::fromHex(blobHash), data.data(), data.size());
+        result.blobs++;
+    }
+    if (mark) {
+        marks[*mark] = blobHash;
+    }
+    return true;
+}
+
+bool FastImport::importCommit(Channel& in, const std::string& branch, ObjectStore::PackWriter& pack,
+                              ImportResult& result) {
+    std::optional<uint64_t> mark;
+    if (!readMark(in, mark, result)) {
+        return false;
+    }
+    std::string line;
+    std::string datetime;
+    if (nextLine(in, line) && line.rfind("date ", 0) == 0) {
+        datetime = line.substr(5);
+    } else {
+        pushedBack = line;
+    }
+    std::vector<char> message;
+    if (!readData(in, message, result)) {
+        return false;
+    }
+
+    std::string parent = branch.empty() ? "" : tipOf(branch);
+    Files files;
+    bool started = false;
+    auto start = [&]() {
+        if (!started && !parent.empty()) {
+            files = filesOf(parent, pack);
+        }
+        started = true;
+    };
+    bool first = true;
+    while (nextLine(in, line)) {
+        if (line.empty()) {
+            // The newline that may follow the message's data.
+            if (first) {
+                first = false;
+                continue;
+            }
+            break;
+        }
+        first = false;
+        if (isCommand(line)) {
+            pushedBack = line;
+            break;
+        }
+        if (line.rfind("from ", 0) == 0 && !started) {
+            std::optional<std::string> from = resolve(line.substr(5), true);
+            if (!from) {
+                return fail(result, "no commit " + line.substr(5));
+            }
+            parent = *from;
+        } else if (line == "deleteall") {
+            start();
+            files.clear();
+        } else if (line.rfind("M ", 0) == 0) {
+            size_t space = line.find(' ', 2);
+            std::optional<std::string> blob = space == std::string::npos ? std::nullopt : resolve(line.substr(2, space - 2), false);
+            if (!blob || space + 1 >= line.size()) {
+                return fail(result, "bad file \"" + line + "\"");
+            }
+            start();
+            files[line.substr(space + 1)] = *blob;
+        } else if (line.rfind("D ", 0) == 0 && line.size() > 2) {
+            start();
+            files.erase(line.substr(2));
+        } else {
+            return fail(result, "unexpected \"" + line + "\" in a commit");
+        }
+    }
+    start();
+
+    std::string msg(message.begin(), message.end());
+    std::string archive;
+    Commit commit = Commit::withArchive(msg, files, parent, datetime, archive);
+    std::string commitID = commit.getOwnHash();
+    if (commits.find(commitID) == commits.end() && !objects.has(ObjectType::Commit, commitID)) {
+        commits.emplace(commitID, pack.count());
+        pack.add(ObjectType::Commit, *ObjectId::fromHex(commitID), archive.data(), archive.size());
+        result.commits++;
+    }
+    recentFiles.emplace_front(commitID, std::move(files));
+    if (recentFiles.size() > recentCommits) {
+        recentFiles.pop_back();
+    }
+    if (mark) {
+        marks[*mark] = commitID;
+    }
+    if (!branch.empty()) {
+        tips[branch] = commitID;
+    }
+    return true;
+}
+
+bool FastImport::importReset(Channel& in, const std::string& branch, ImportResult& result) {
+    tipOf(branch);
+    std::string line;
+    if (nextLine(in, line) && line.rfind("from ", 0) == 0) {
+        std::optional<std::string> from = resolve(line.substr(5), true);
+        if (!from) {
+            return fail(result, "no commit " + line.substr(5));
+        }
+        tips[branch] = *from;
+    } else {
+        pushedBack = line;
+    }
+    return true;
+}
+
+bool FastImport::nextLine(Channel& in, std::string& line) {
+    if (pushedBack) {
+        line = std::move(*pushedBack);
+        pushedBack.reset();
+        return true;
+    }
+    lineNumber++;
+    if (!in.readLine(line)) {
+        line.clear();
+        return false;
+    }
+    return true;
+}
+
+bool FastImport::readMark(Channel& in, std::optional<uint64_t>& mark, ImportResult& result) {
+    std::string line;
+    if (!nextLine(in, line) || line.rfind("mark :", 0) != 0) {
+        pushedBack = line;
+        return true;
+    }
+    try {
+        mark = std::stoull(line.substr(6));
+    } catch (const std::exception&) {
+        return fail(result, "bad mark \"" + line + "\"");
+    }
+    return true;
+}
+
+bool FastImport::readData(Channel& in, std::vector<char>& data, ImportResult& result) {
+    std::string line;
+    if (!nextLine(in, line) || line.rfind("data ", 0) != 0) {
+        return fail(result, "expected data");
+    }
+    uint64_t size;
+    try {
+        size = std::stoull(line.substr(5));
+    } catch (const std::exception&) {
+        return fail(result, "bad size \"" + line + "\"");
+    }
+    if (size > maxDataSize) {
+        return fail(result, "data too large");
+    }
+    data.resize(size);
+    if (!in.read(data.data(), size)) {
+        return fail(result, "stream ended inside data");
+    }
+    return true;
+}
+
+bool FastImport::fail(ImportResult& result, const std::string& message) const {
+    result.error = "line " + std::to_string(lineNumber) + ": " + message;
+    return false;
+}
+
+std::optional<std::string> FastImport::resolve(const std::string& ref, bool commit) const {
+    std::string id = ref;
+    if (!ref.empty() && ref[0] == ':') {
+        try {
+            auto it = marks.find(std::stoull(ref.substr(1)));
+            if (it == marks.end()) {
+                return std::nullopt;
+            }
+            id = it->second;
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+    if (commit) {
+        if (commits.find(id) != commits.end() || objects.has(ObjectType::Commit, id)) {
+            return id;
+        }
+    } else if (blobs.find(id) != blobs.end() || objects.has(ObjectType::Blob, id)) {
+        return id;
+    }
+    return std::nullopt;
+}
+
+FastImport::Files FastImport::filesOf(const std::string& commitID, ObjectStore::PackWriter& pack) {
+    for (auto it = recentFiles.begin(); it != recentFiles.end(); ++it) {
+        if (it->first == commitID) {
+            // A commit is usually made on it only once, so it moves out.
+            Files files = std::move(it->second);
+            recentFiles.erase(it);
+            return files;
+        }
+    }
+    Trace::count("fast-import parents read back");
+    auto packed = commits.find(commitID);
+    if (packed != commits.end()) {
+        std::vector<char> data = pack.read(packed->second);
+        Commit commit;
+        commit.deserializeFromString(std::string(data.begin(), data.end()));
+        return commit.getBlobs();
+    }
+    std::optional<Commit> commit = readCommit(commitID);
+    return commit ? commit->getBlobs() : Files();
+}
+
+// A branch's tip as the stream has left it so far; the first time, as the
+// repository has it.
+std::string FastImport::tipOf(const std::string& branch) {
+    auto it = tips.find(branch);
+    if (it == tips.end()) {
+        std::string current = refs.resolve(branch).value_or("");
+        previous[branch] = current;
+        it = tips.emplace(branch, current).first;
+    }
+    return it->second;
+}
@@ -0,0 +1,90 @@
+#ifndef FASTSTREAM_H
+#define FASTSTREAM_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Commit.h"
+#include "ObjectStore.h"
+
+class Channel;
+class RefStore;
+
+// A whole history as one stream, for moving it in or out of a repository
+// without running add and commit for every file. Commands are lines:
+//
+//   blob                   a blob: an optional "mark :<n>", then its data
+//   commit [<branch>]      a commit: an optional mark, an optional
+//                          "date <YYYY-MM-DD HH:MM:SS>", the message as
+//                          data, then any of "from <ref>" for the parent,
+//                          "deleteall", "M <ref> <path>" and "D <path>";
+//                          a blank line ends it. Without "from" the parent
+//                          is the branch's tip, if it has one
+//   reset <branch>         "from <ref>" on the next line moves the branch
+//   done                   the end, also implied by the end of the stream
+//
+// Data is "data <size>", a newline, then exactly size bytes, which may be
+// followed by one more newline. A <ref> is ":<mark>" or an object id that
+// the repository already has.
+//
+// The importer keeps its marks and the commits it made in memory and
+// writes every new object straight into one pack. Branches move only after
+// the pack is published, all together and only if nobody moved any of them
+// meanwhile; a stream with an error moves none and leaves no pack.
+struct ImportResult {
+    size_t blobs = 0;       // blobs written to the pack
+    size_t commits = 0;     // commits written to the pack
+    size_t branches = 0;    // branches created or moved
+    std::string error;      // why the stream was rejected; empty if it was not
+};
+
+class FastImport {
+public:
+    // readCommit reads a commit the repository already has.
+    FastImport(ObjectStore& objects, RefStore& refs, std::function<std::optional<Commit>(const std::string&)> readCommit);
+
+    ImportResult run(Channel& in);
+
+private:
+    ObjectStore& objects;
+    RefStore& refs;
+    std::function<std::optional<Commit>(const std::string&)> readCommit;
+
+    using Files = std::unordered_map<std::string, std::string>;
+
+    std::unordered_map<uint64_t, std::string> marks;
+    std::unordered_map<std::string, size_t> commits;   // written by this import, to its place in the pack
+    std::unordered_set<std::string> blobs;             // written by this import
+    // The files of the last few commits made, most recent first, so a
+    // commit on a tip does not read its parent back.
+    std::list<std::pair<std::string, Files>> recentFiles;
+    std::map<std::string, std::string> tips;           // branch to its new tip
+    std::map<std::string, std::string> previous;       // branch to its tip before
+    std::optional<std::string> pushedBack;
+    size_t lineNumber = 0;
+
+    // Each reads one command's lines after its first and sets
+    // result.error when they are wrong.
+    bool importBlob(Channel& in, ObjectStore::PackWriter& pack, ImportResult& result);
+    bool importCommit(Channel& in, const std::string& branch, ObjectStore::PackWriter& pack, ImportResult& result);
+    bool importReset(Channel& in, const std::string& branch, ImportResult& result);
+
+    bool nextLine(Channel& in, std::string& line);
+    bool readMark(Channel& in, std::optional<uint64_t>& mark, ImportResult& result);
+    bool readData(Channel& in, std::vector<char>& data, ImportResult& result);
+    bool fail(ImportResult& result, const std::string& message) const;
+    // The id a ref names, if it names an object of that kind.
+    std::optional<std::string> resolve(const std::string& ref, bool commit) const;
+    // A commit's files, taken from recentFiles, read back from the pack or
+    // read from the repository.
+    Files filesOf(const std::string& commitID, ObjectStore::PackWriter& pack);
+    std::string tipOf(const std::string& branch);
+};
+
+#endif // FASTSTREAM_H
@@ -0,0 +1,229 @@
+#include "Fsck.h"
+#include "Commit.h"
+#include "Executor.h"
+#include "GarbageCollector.h"
+#include "RefStore.h"
+#include "StagingArea.h"
+#include "Task.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace {
+// A slice ends after this many bytes or objects, whichever comes first.
+const uint64_t sliceBytes = 8 << 20;
+const size_t sliceObjects = 256;
+
+const char* typeName(ObjectType type) {
+    return type == ObjectType::Commit ? "commit" : "blob";
+}
+
+Task<void> checkSlice(const std::function<void(size_t)>& check, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        check(i);
+    }
+    co_return;
+}
+}
+
+Fsck::Fsck(ObjectStore& objects, const RefStore& refs, const StagingArea& stage, Executor& executor,
+           std::function<bool(const std::string&)> isShallow, bool blobsMayBeMissing)
+    : objects(objects), refs(refs), stage(stage), executor(executor), isShallow(std::move(isShallow)),
+      blobsMayBeMissing(blobsMayBeMissing) {}
+
+std::optional<size_t> Fsck::indexOf(ObjectType type, const std::string& hex) const {
+    std::optional<ObjectId> id = ObjectId::fromHex(hex);
+    if (!id) {
+        return std::nullopt;
+    }
+    const std::vector<ObjectId>& ids = type == ObjectType::Commit ? commits : blobs;
+    auto it = std::lower_bound(ids.begin(), ids.end(), *id);
+    if (it == ids.end() || *it != *id) {
+        return std::nullopt;
+    }
+    size_t index = it - ids.begin();
+    return type == ObjectType::Commit ? index : commits.size() + index;
+}
+
+void Fsck::report(std::string error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    errors.push_back(std::move(error));
+}
+
+// Each pack's entries by offset, then the loose files by inode, which on
+// most file systems follows where they were written.
+std::vector<Fsck::Copy> Fsck::copies() const {
+    std::vector<Copy> out;
+    for (const auto& pack : objects.packs()) {
+        size_t first = out.size();
+        for (size_t i = 0; i < pack->count(); i++) {
+            ObjectStore::Entry entry = pack->entry(i);
+            out.push_back({entry.type, entry.id, pack.get(), entry, 0});
+        }
+        std::sort(out.begin() + first, out.end(), [](const Copy& a, const Copy& b) {
+            return a.entry.offset < b.entry.offset;
+        });
+    }
+    size_t firstLoose = out.size();
+    for (ObjectType type : {ObjectType::Commit, ObjectType::Blob}) {
+        for (const ObjectId& id : objects.listLoose(type)) {
+            struct stat st;
+            Copy copy{type, id, nullptr, {}, 0};
+            if (::stat(objects.loosePath(type, id.hex()).c_str(), &st) == 0) {
+                copy.inode = st.st_ino;
+                copy.entry.size = static_cast<uint64_t>(st.st_size);
+            }
+            out.push_back(copy);
+        }
+    }
+    std::sort(out.begin() + firstLoose, out.end(), [](const Copy& a, const Copy& b) { return a.inode < b.inode; });
+    return out;
+}
+
+void Fsck::check(const Copy& copy, ObjectBitmap& sound, ObjectBitmap& referenced) {
+    std::string hex = copy.id.hex();
+    std::string where = copy.pack ? copy.pack->getPath().filename().string() : "loose";
+    std::vector<char> data;
+    if (copy.pack) {
+        if (!copy.pack->holds(copy.entry)) {
+            report("damaged index entry for " + std::string(typeName(copy.type)) + " " + hex + " in " + where);
+            return;
+        }
+        const char* begin = copy.pack->data(copy.entry);
+        data.assign(begin, begin + copy.entry.size);
+    } else {
+        try {
+            data = Utils::readContents(objects.loosePath(copy.type, hex));
+        } catch (const std::exception&) {
+            report("unreadable " + std::string(typeName(copy.type)) + " " + hex + " (loose)");
+            return;
+        }
+    }
+    if (copy.type == ObjectType::Commit) {
+        checkCommit(hex, data, sound, referenced);
+        return;
+    }
+    if (Utils::sha1(data) != hex) {
+        report("hash mismatch in blob " + hex + " (" + where + ")");
+        return;
+    }
+    if (std::optional<size_t> index = indexOf(ObjectType::Blob, hex)) {
+        sound.testAndSet(*index);
+    }
+}
+
+void Fsck::checkCommit(const std::string& commitID, const std::vector<char>& data, ObjectBitmap& sound,
+                       ObjectBitmap& referenced) {
+    Commit commit;
+    std::string archive(data.begin(), data.end());
+    try {
+        commit.deserializeFromString(archive);
+    } catch (const std::exception&) {
+        report("unreadable commit " + commitID);
+        return;
+    }
+    // A damaged copy still names what the commit refers to, most likely
+    // rightly, so its parent and blobs count as referenced either way; what
+    // it names that is missing is only worth reporting for a sound copy.
+    bool intact = commit.getOwnHash() == commitID && Commit::contentHash(archive, commitID) == commitID;
+    if (!intact) {
+        report("hash mismatch in commit " + commitID);
+    } else if (std::optional<size_t> index = indexOf(ObjectType::Commit, commitID)) {
+        sound.testAndSet(*index);
+    }
+
+    std::string parent = commit.getParentHash();
+    if (!parent.empty()) {
+        if (std::optional<size_t> index = indexOf(ObjectType::Commit, parent)) {
+            referenced.testAndSet(*index);
+        } else if (intact && !isShallow(commitID)) {
+            report("missing parent " + parent + " of commit " + commitID);
+        }
+    }
+    std::unordered_map<std::string, std::string> files = commit.getBlobs();
+    for (const auto& [fileName, blobHash] : files) {
+        if (std::optional<size_t> index = indexOf(ObjectType::Blob, blobHash)) {
+            referenced.testAndSet(*index);
+        } else if (intact && !blobsMayBeMissing) {
+            report("missing blob " + blobHash + " for " + fileName + " in commit " + commitID);
+        }
+    }
+}
+
+FsckResult Fsck::run() {
+    GITLET_TRACE_SCOPE("Fsck::run");
+    FsckResult result;
+    objects.rescanPacks();
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(objects.packsDir(), ec)) {
+        if (entry.path().extension() == ".pack" && !ObjectStore::Pack(entry.path()).valid()) {
+            report("damaged pack " + entry.path().filename().string());
+        }
+    }
+    commits = objects.list(ObjectType::Commit);
+    blobs = objects.list(ObjectType::Blob);
+    result.commits = commits.size();
+    result.blobs = blobs.size();
+
+    // An object is sound once a copy of it has checked out, and referenced
+    // once a commit, branch or the stage names it.
+    ObjectBitmap sound(commits.size() + blobs.size());
+    ObjectBitmap referenced(commits.size() + blobs.size());
+    std::vector<Copy> all = copies();
+    std::function<void(size_t)> checkOne = [&](size_t i) { check(all[i], sound, referenced); };
+    std::vector<Future<void>> slices;
+    for (size_t begin = 0; begin < all.size();) {
+        size_t end = begin;
+        uint64_t bytes = 0;
+        while (end < all.size() && end - begin < sliceObjects && bytes < sliceBytes &&
+               (end == begin || all[end].pack == all[begin].pack)) {
+            bytes += all[end].entry.size;
+            end++;
+        }
+        result.bytes += bytes;
+        slices.push_back(spawn(executor, checkSlice(checkOne, begin, end)));
+        begin = end;
+    }
+    syncWait(whenAll(std::move(slices)));
+    Trace::count("object copies checked", all.size());
+
+    for (const auto& [branchName, commitID] : refs.list()) {
+        std::optional<size_t> index = indexOf(ObjectType::Commit, commitID);
+        if (!index) {
+            report("branch " + branchName + " points to missing commit " + commitID);
+            continue;
+        }
+        referenced.testAndSet(*index);
+        if (!sound.test(*index)) {
+            report("branch " + branchName + " points to damaged commit " + commitID);
+        }
+    }
+    std::string head = refs.head();
+    if (!refs.exists(head)) {
+        report("HEAD names missing branch " + head);
+    }
+    for (const auto& [fileName, blobHash] : stage.getAddedFiles()) {
+        std::optional<size_t> index = indexOf(ObjectType::Blob, blobHash);
+        if (!index) {
+            report("missing blob " + blobHash + " for staged " + fileName);
+            continue;
+        }
+        referenced.testAndSet(*index);
+        if (!sound.test(*index)) {
+            report("damaged blob " + blobHash + " for staged " + fileName);
+        }
+    }
+
+    for (size_t i = 0; i < commits.size() + blobs.size(); i++) {
+        if (!referenced.test(i)) {
+            bool commit = i < commits.size();
+            const ObjectId& id = commit ? commits[i] : blobs[i - commits.size()];
+            result.dangling.push_back(std::string("dangling ") + (commit ? "commit " : "blob ") + id.hex());
+        }
+    }
+    std::sort(errors.begin(), errors.end());
+    errors.erase(std::unique(errors.begin(), errors.end()), errors.end());
+    result.errors = std::move(errors);
+    return result;
+}
@@ -0,0 +1,82 @@
+#ifndef FSCK_H
+#define FSCK_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "ObjectId.h"
+#include "ObjectStore.h"
+
+namespace fs = std::filesystem;
+
+class Executor;
+class ObjectBitmap;
+class RefStore;
+class StagingArea;
+
+struct FsckResult {
+    size_t commits = 0;                 // distinct commits in the store
+    size_t blobs = 0;                   // distinct blobs in the store
+    size_t bytes = 0;                   // object bytes hashed
+    std::vector<std::string> errors;    // one line per problem, sorted
+    std::vector<std::string> dangling;  // "dangling <type> <id>", sorted
+};
+
+// Checks the repository against itself.
+//
+// Every copy of every object, loose or packed, is read and hashed: a blob
+// must hash to its id, and a commit must deserialize and its contents must
+// hash to the id it has and is stored under. The reads go in physical
+// order, a pack from its first entry to its last and loose files by inode
+// number, cut into slices that the executor hashes side by side. Each
+// commit read then has its parent and blobs looked up among the ids the
+// store lists: a parent may only be missing past the shallow boundary, a
+// blob only when a promisor remote can fetch it. Branches must point at a
+// sound commit, HEAD must name a branch, and every staged blob must be
+// there.
+//
+// An object nothing refers to, neither a branch, the stage, nor another
+// commit, is dangling: normal after a reset or a removed branch, and gone
+// at the next gc once its grace period has passed. Memory holds the sorted
+// ids, two bits per object, and the contents of one slice per thread.
+class Fsck {
+public:
+    Fsck(ObjectStore& objects, const RefStore& refs, const StagingArea& stage, Executor& executor,
+         std::function<bool(const std::string&)> isShallow, bool blobsMayBeMissing);
+
+    FsckResult run();
+
+private:
+    // One stored copy of an object: in a pack, or loose with its inode.
+    struct Copy {
+        ObjectType type;
+        ObjectId id;
+        const ObjectStore::Pack* pack;
+        ObjectStore::Entry entry;
+        uint64_t inode;
+    };
+
+    ObjectStore& objects;
+    const RefStore& refs;
+    const StagingArea& stage;
+    Executor& executor;
+    std::function<bool(const std::string&)> isShallow;
+    bool blobsMayBeMissing;
+    std::vector<ObjectId> commits;
+    std::vector<ObjectId> blobs;
+    std::mutex mutex;
+    std::vector<std::string> errors;
+
+    std::optional<size_t> indexOf(ObjectType type, const std::string& hex) const;
+    std::vector<Copy> copies() const;
+    void check(const Copy& copy, ObjectBitmap& sound, ObjectBitmap& referenced);
+    void checkCommit(const std::string& commitID, const std::vector<char>& data, ObjectBitmap& sound,
+                     ObjectBitmap& referenced);
+    void report(std::string error);
+};
+
+#endif // FSCK_H
@@ -0,0 +1,198 @@
+#include "GarbageCollector.h"
+#include "Commit.h"
+#include "CommitWalker.h"
+#include "IoEngine.h"
+#include "LockFile.h"
+#include "RefStore.h"
+#include "StagingArea.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+GarbageCollector::GarbageCollector(const fs::path& gitletDir, ObjectStore& objects, RefStore& refs, const StagingArea& stage,
+                                   IoEngine& io)
+    : gitletDir(gitletDir), objects(objects), refs(refs), stage(stage), io(io) {}
+
+std::optional<size_t> GarbageCollector::indexOf(ObjectType type, const std::string& hex) const {
+    std::optional<ObjectId> id = ObjectId::fromHex(hex);
+    if (!id) {
+        return std::nullopt;
+    }
+    const std::vector<ObjectId>& ids = type == ObjectType::Commit ? commits : blobs;
+    auto it = std::lower_bound(ids.begin(), ids.end(), *id);
+    if (it == ids.end() || *it != *id) {
+        return std::nullopt;
+    }
+    size_t index = it - ids.begin();
+    return type == ObjectType::Commit ? index : commits.size() + index;
+}
+
+bool GarbageCollector::expired(const fs::path& path, long long pruneExpire) const {
+    std::error_code ec;
+    auto modified = fs::last_write_time(path, ec);
+    if (ec) {
+        return true;
+    }
+    auto age = fs::file_time_type::clock::now() - modified;
+    return age >= std::chrono::seconds(pruneExpire);
+}
+
+GcResult GarbageCollector::run(const GcOptions& options) {
+    GITLET_TRACE_SCOPE("GarbageCollector::run");
+    LockFile gcLock(gitletDir / "gc");
+    GcResult result;
+    result.refsPacked = refs.pack();
+
+    objects.rescanPacks();
+    commits = objects.list(ObjectType::Commit);
+    blobs = objects.list(ObjectType::Blob);
+    result.commits = commits.size();
+    result.blobs = blobs.size();
+
+    ObjectBitmap marks(commits.size() + blobs.size());
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    mark(marks, threads);
+    for (size_t i = 0; i < commits.size() + blobs.size(); i++) {
+        result.reachable += marks.test(i);
+    }
+
+    // Unreachable loose objects: delete once they are past the grace period.
+    for (ObjectType type : {ObjectType::Commit, ObjectType::Blob}) {
+        for (const ObjectId& id : objects.listLoose(type)) {
+            std::string hex = id.hex();
+            // One written since the listing is treated as live.
+            std::optional<size_t> index = indexOf(type, hex);
+            if (!index || marks.test(*index)) {
+                continue;
+            }
+            fs::path path = objects.loosePath(type, hex);
+            if (expired(path, options.pruneExpire)) {
+                fs::remove(path);
+                result.pruned++;
+            } else {
+                result.kept++;
+            }
+        }
+    }
+
+    // Repack every reachable object, reading a batch of them at a time.
+    std::vector<std::shared_ptr<ObjectStore::Pack>> oldPacks = objects.packs();
+    ObjectStore::PackWriter writer(objects.packsDir());
+    // Only what went into the new pack may lose its other copies.
+    ObjectBitmap packed(commits.size() + blobs.size());
+    std::vector<std::string> unreadable;
+    // A batch holds objects of one type, so it is flushed where commits end.
+    std::vector<size_t> batch;
+    auto flush = [&]() {
+        ObjectType type = batch.front() < commits.size() ? ObjectType::Commit : ObjectType::Blob;
+        std::vector<std::string> ids;
+        for (size_t i : batch) {
+            ids.push_back(type == ObjectType::Commit ? commits[i].hex() : blobs[i - commits.size()].hex());
+        }
+        std::vector<std::optional<std::vector<char>>> contents = objects.readAll(type, ids, io);
+        for (size_t j = 0; j < batch.size(); j++) {
+            if (contents[j]) {
+                const ObjectId& id = type == ObjectType::Commit ? commits[batch[j]] : blobs[batch[j] - commits.size()];
+                writer.add(type, id, contents[j]->data(), contents[j]->size());
+                packed.testAndSet(batch[j]);
+            } else {
+                unreadable.push_back(ids[j]);
+            }
+        }
+        batch.clear();
+    };
+    for (size_t i = 0; i < commits.size() + blobs.size(); i++) {
+        if (!batch.empty() && (batch.size() == io.depth() || i == commits.size())) {
+            flush();
+        }
+        if (marks.test(i)) {
+            batch.push_back(i);
+        }
+    }
+    if (!batch.empty()) {
+        flush();
+    }
+    // The old packs would go with the only copy of what could not be read.
+    if (!unreadable.empty()) {
+        throw std::invalid_argument("gc: could not read " + std::to_string(unreadable.size()) +
+                                    " reachable objects, starting with " + unreadable.front() +
+                                    "; nothing was repacked");
+    }
+    for (const auto& pack : oldPacks) {
+        bool recent = !expired(pack->getPath(), options.pruneExpire);
+        for (size_t i = 0; i < pack->count(); i++) {
+            ObjectStore::Entry entry = pack->entry(i);
+            std::string hex = entry.id.hex();
+            std::optional<size_t> index = indexOf(entry.type, hex);
+            if (index && marks.test(*index)) {
+                continue;
+            }
+            fs::path loose = objects.loosePath(entry.type, hex);
+            if (fs::exists(loose)) {
+                continue; // already counted by the loose sweep
+            }
+            if (recent && pack->holds(entry)) {
+                const char* data = pack->data(entry);
+                Utils::writeContents(loose.string(), std::vector<char>(data, data + entry.size));
+                result.kept++;
+            } else {
+                result.pruned++;
+            }
+        }
+    }
+    result.packed = writer.count();
+    fs::path newPack = writer.finish();
+
+    // Only now that the new pack is published can the old copies go.
+    for (const auto& pack : oldPacks) {
+        if (pack->getPath() != newPack) {
+            fs::remove(pack->indexPath());
+            fs::remove(pack->getPath());
+            result.packsRemoved++;
+        }
+    }
+    oldPacks.clear();
+    objects.rescanPacks();
+    for (ObjectType type : {ObjectType::Commit, ObjectType::Blob}) {
+        for (const ObjectId& id : objects.listLoose(type)) {
+            std::string hex = id.hex();
+            std::optional<size_t> index = indexOf(type, hex);
+            if (index && packed.test(*index)) {
+                fs::remove(objects.loosePath(type, hex));
+            }
+        }
+    }
+    return result;
+}
+
+void GarbageCollector::mark(ObjectBitmap& marks, unsigned threads) {
+    GITLET_TRACE_SCOPE("GarbageCollector::mark");
+    std::vector<std::string> tips;
+    for (const auto& [branchName, commitID] : refs.list()) {
+        tips.push_back(commitID);
+    }
+    for (const auto& [fileName, blobHash] : stage.getAddedFiles()) {
+        std::optional<size_t> index = indexOf(ObjectType::Blob, blobHash);
+        if (index) {
+            marks.testAndSet(*index);
+        }
+    }
+
+    CommitWalker walker(objects, [](const Commit& commit) { return commit.getParentHash(); }, threads);
+    walker.walk(tips, [&](const Commit& commit) {
+        Trace::count("commits marked");
+        std::optional<size_t> index = indexOf(ObjectType::Commit, commit.getOwnHash());
+        if (index) {
+            marks.testAndSet(*index);
+        }
+        for (const auto& [fileName, blobHash] : commit.getBlobs()) {
+            std::optional<size_t> blob = indexOf(ObjectType::Blob, blobHash);
+            if (blob) {
+                marks.testAndSet(*blob);
+            }
+        }
+    });
+}
@@ -0,0 +1,90 @@
+#ifndef GARBAGECOLLECTOR_H
+#define GARBAGECOLLECTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+#include "ObjectId.h"
+#include "ObjectStore.h"
+
+namespace fs = std::filesystem;
+
+class IoEngine;
+class RefStore;
+class StagingArea;
+
+struct GcOptions {
+    long long pruneExpire = -1;     // seconds an unreachable object is kept; negative uses gc.pruneExpire
+    unsigned threads = 0;           // marking threads, 0 for one per core
+};
+
+struct GcResult {
+    size_t commits = 0;             // commits in the repository before collecting
+    size_t blobs = 0;               // blobs in the repository before collecting
+    size_t reachable = 0;           // objects reachable from a branch or the stage
+    size_t pruned = 0;              // unreachable objects deleted
+    size_t kept = 0;                // unreachable objects kept for the grace period
+    size_t packed = 0;              // objects written to the new pack
+    size_t packsRemoved = 0;        // packs replaced by the new one
+    size_t refsPacked = 0;          // loose branches moved into packed-refs
+    size_t bitmaps = 0;             // reachability bitmaps written afterwards
+    size_t changedPaths = 0;        // commits given changed-path filters afterwards
+};
+
+// One bit per object, settable from many threads at once.
+class ObjectBitmap {
+public:
+    explicit ObjectBitmap(size_t bits) : words((bits + 63) / 64) {}
+
+    // Sets the bit and returns whether it was clear before.
+    bool testAndSet(size_t bit) {
+        uint64_t mask = uint64_t(1) << (bit % 64);
+        return (words[bit / 64].fetch_or(mask, std::memory_order_relaxed) & mask) == 0;
+    }
+
+    bool test(size_t bit) const {
+        return (words[bit / 64].load(std::memory_order_relaxed) >> (bit % 64)) & 1;
+    }
+
+private:
+    std::vector<std::atomic<uint64_t>> words;
+};
+
+// Reachability-based collection of the object store.
+//
+// Every object gets an index: commits first, then blobs, each in sorted id
+// order. Marking starts from every branch and the staged blobs; a
+// CommitWalker walks the branches on several threads and sets the bit in an
+// ObjectBitmap of every commit and blob it reaches. Unreachable loose objects
+// older than the grace period are deleted, and every reachable object is
+// rewritten into a single new pack that replaces the old packs and loose
+// files. Unreachable objects from a pack still inside the grace period are
+// written back out as loose objects so they get the same grace as loose ones.
+// If a reachable object cannot be read, run throws std::invalid_argument
+// before the new pack is published, leaving the old packs and loose files.
+// Memory holds the sorted raw ids and the bitmap, and object contents only
+// for one batch of reads at a time.
+class GarbageCollector {
+public:
+    GarbageCollector(const fs::path& gitletDir, ObjectStore& objects, RefStore& refs, const StagingArea& stage,
+                     IoEngine& io);
+
+    GcResult run(const GcOptions& options);
+
+private:
+    fs::path gitletDir;
+    ObjectStore& objects;
+    RefStore& refs;
+    const StagingArea& stage;
+    IoEngine& io;
+    std::vector<ObjectId> commits;
+    std::vector<ObjectId> blobs;
+
+    std::optional<size_t> indexOf(ObjectType type, const std::string& hex) const;
+    void mark(ObjectBitmap& marks, unsigned threads);
+    bool expired(const fs::path& path, long long pruneExpire) const;
+};
+
+#endif // GARBAGECOLLECTOR_H
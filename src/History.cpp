@@ -0,0 +1,82 @@
+#include "History.h"
+#include "Repo.h"
+
+History::iterator::iterator() : repo(nullptr), options(nullptr), skipped(0), emitted(0) {}
+
+History::iterator::iterator(const Repo* repo, const std::string& commitID, const LogOptions* options)
+    : repo(repo), options(options), skipped(0), emitted(0) {
+    if (!commitID.empty() && options->maxCount != 0) {
+        current = repo->getCommit(options->path.empty() ? commitID : repo->skipUnchanged(commitID, options->path));
+        settle();
+    }
+}
+
+History::iterator::reference History::iterator::operator*() const {
+    return current;
+}
+
+History::iterator::pointer History::iterator::operator->() const {
+    return &current;
+}
+
+History::iterator& History::iterator::operator++() {
+    emitted++;
+    if (options->maxCount >= 0 && emitted >= options->maxCount) {
+        // Done: do not even load the parent.
+        current = Commit();
+        return *this;
+    }
+    advance();
+    settle();
+    return *this;
+}
+
+// Every exhausted iterator holds an empty commit, which is what end() holds.
+bool History::iterator::operator==(const iterator& other) const {
+    return current.getOwnHash() == other.current.getOwnHash();
+}
+
+bool History::iterator::operator!=(const iterator& other) const {
+    return !(*this == other);
+}
+
+// Limited to a path, commits the changed-path filters rule out are never
+// read.
+void History::iterator::advance() {
+    std::string parent = repo->parentOf(current);
+    if (!parent.empty() && !options->path.empty()) {
+        parent = repo->skipUnchanged(parent, options->path);
+    }
+    current = parent.empty() ? Commit() : repo->getCommit(parent);
+}
+
+// Moves forward until current is a commit the options allow, or the end.
+// Parents are never newer than their children, so the walk stops at the
+// first commit older than --since.
+void History::iterator::settle() {
+    while (!current.getOwnHash().empty()) {
+        if (!options->since.empty() && current.getDatetime() < options->since) {
+            current = Commit();
+        } else if (!options->path.empty() && !repo->changes(current, options->path)) {
+            advance();
+        } else if (!options->until.empty() && current.getDatetime() > options->until) {
+            advance();
+        } else if (skipped < options->skip) {
+            skipped++;
+            advance();
+        } else {
+            break;
+        }
+    }
+}
+
+History::History(const Repo& repo, const std::string& startID, const LogOptions& options)
+    : repo(&repo), startID(startID), options(options) {}
+
+History::iterator History::begin() const {
+    return iterator(repo, startID, &options);
+}
+
+History::iterator History::end() const {
+    return iterator();
+}
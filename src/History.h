@@ -0,0 +1,68 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <string>
+#include <iterator>
+#include <cstddef>
+#include "Commit.h"
+
+class Repo;
+
+// Limits applied while walking history. Dates use the commit datetime format
+// ("YYYY-MM-DD HH:MM:SS") and are compared as strings; empty means unbounded.
+struct LogOptions {
+    long maxCount = -1;     // -n, negative for no limit
+    long skip = 0;          // --skip
+    std::string since;      // --since, oldest datetime to show
+    std::string until;      // --until, newest datetime to show
+    size_t abbrev = 0;      // --abbrev, fewest id digits shown; 0 for the whole id
+    bool all = false;       // --all, every branch's history merged by date
+    std::string path;       // -- <file>, only commits that changed it
+};
+
+// First-parent history starting at a commit. Commits are read from the
+// repository one at a time as the iterator advances, and the walk ends as soon
+// as the options are satisfied, so a caller that stops early never loads the
+// rest of the chain.
+class History {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Commit;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Commit*;
+        using reference = const Commit&;
+
+        iterator();
+        iterator(const Repo* repo, const std::string& commitID, const LogOptions* options);
+
+        reference operator*() const;
+        pointer operator->() const;
+        iterator& operator++();
+        bool operator==(const iterator& other) const;
+        bool operator!=(const iterator& other) const;
+
+    private:
+        const Repo* repo;
+        const LogOptions* options;
+        Commit current;
+        long skipped;
+        long emitted;
+
+        void advance();
+        void settle();
+    };
+
+    History(const Repo& repo, const std::string& startID, const LogOptions& options = LogOptions());
+
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    const Repo* repo;
+    std::string startID;
+    LogOptions options;
+};
+
+#endif // HISTORY_H
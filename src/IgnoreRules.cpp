@@ -0,0 +1,210 @@
+#include "IgnoreRules.h"
+#include <fstream>
+
+IgnoreRules IgnoreRules::load(const fs::path& workingDir) {
+    IgnoreRules rules;
+    std::ifstream in(workingDir / ".gitletignore");
+    std::string line;
+    while (std::getline(in, line)) {
+        rules.add(line);
+    }
+    return rules;
+}
+
+void IgnoreRules::add(const std::string& line) {
+    std::string text = line;
+    if (!text.empty() && text.back() == '\r') {
+        text.pop_back();
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.pop_back();
+    }
+    if (text.empty() || text[0] == '#') {
+        return;
+    }
+
+    Pattern pattern;
+    if (text[0] == '!') {
+        pattern.negated = true;
+        text.erase(0, 1);
+    } else if (text[0] == '\\') {
+        text.erase(0, 1);
+    }
+    if (!text.empty() && text.back() == '/') {
+        pattern.directoryOnly = true;
+        text.pop_back();
+    }
+    if (text.find('/') != std::string::npos) {
+        pattern.anchored = true;
+        if (text[0] == '/') {
+            text.erase(0, 1);
+        }
+    }
+    if (text.empty()) {
+        return;
+    }
+
+    const std::string special = "*?[\\";
+    size_t firstSpecial = text.find_first_of(special);
+    if (firstSpecial == std::string::npos) {
+        pattern.kind = Kind::Literal;
+        pattern.text = text;
+    } else if (!pattern.anchored && text[0] == '*' && text.find_first_of(special, 1) == std::string::npos) {
+        pattern.kind = Kind::Suffix;
+        pattern.text = text.substr(1);
+    } else if (!pattern.anchored && firstSpecial == text.size() - 1 && text.back() == '*') {
+        pattern.kind = Kind::Prefix;
+        pattern.text = text.substr(0, text.size() - 1);
+    } else {
+        pattern.kind = Kind::Glob;
+        pattern.pieces = compile(text);
+    }
+    patterns.push_back(std::move(pattern));
+}
+
+std::vector<IgnoreRules::Piece> IgnoreRules::compile(const std::string& glob) {
+    std::vector<Piece> pieces;
+    auto literal = [&](char c) {
+        if (pieces.empty() || pieces.back().token != Token::Literal) {
+            pieces.push_back({Token::Literal, "", {}});
+        }
+        pieces.back().literal += c;
+    };
+    for (size_t i = 0; i < glob.size(); i++) {
+        char c = glob[i];
+        if (c == '*' && i + 1 < glob.size() && glob[i + 1] == '*') {
+            // "**/" also matches no directory at all, so the slash goes with it.
+            i++;
+            if (i + 1 < glob.size() && glob[i + 1] == '/') {
+                i++;
+            }
+            pieces.push_back({Token::DoubleStar, "", {}});
+        } else if (c == '*') {
+            pieces.push_back({Token::Star, "", {}});
+        } else if (c == '?') {
+            pieces.push_back({Token::Any, "", {}});
+        } else if (c == '[' && glob.find(']', i + 2) != std::string::npos) {
+            Piece piece{Token::Class, "", {}};
+            size_t j = i + 1;
+            bool negate = j < glob.size() && (glob[j] == '!' || glob[j] == '^');
+            if (negate) {
+                j++;
+            }
+            size_t start = j;
+            for (; j < glob.size() && (glob[j] != ']' || j == start); j++) {
+                unsigned char low = glob[j];
+                if (j + 2 < glob.size() && glob[j + 1] == '-' && glob[j + 2] != ']') {
+                    for (unsigned c2 = low; c2 <= static_cast<unsigned char>(glob[j + 2]); c2++) {
+                        piece.chars.set(c2);
+                    }
+                    j += 2;
+                } else {
+                    piece.chars.set(low);
+                }
+            }
+            if (negate) {
+                piece.chars.flip();
+            }
+            piece.chars.reset('/');
+            pieces.push_back(piece);
+            i = j;
+        } else if (c == '\\' && i + 1 < glob.size()) {
+            literal(glob[++i]);
+        } else {
+            literal(c);
+        }
+    }
+    return pieces;
+}
+
+bool IgnoreRules::match(const std::vector<Piece>& pieces, size_t piece, const std::string& text, size_t pos) {
+    for (; piece < pieces.size(); piece++) {
+        const Piece& p = pieces[piece];
+        switch (p.token) {
+        case Token::Literal:
+            if (text.compare(pos, p.literal.size(), p.literal) != 0) {
+                return false;
+            }
+            pos += p.literal.size();
+            break;
+        case Token::Any:
+            if (pos >= text.size() || text[pos] == '/') {
+                return false;
+            }
+            pos++;
+            break;
+        case Token::Class:
+            if (pos >= text.size() || !p.chars.test(static_cast<unsigned char>(text[pos]))) {
+                return false;
+            }
+            pos++;
+            break;
+        case Token::Star:
+            for (size_t end = pos;; end++) {
+                if (match(pieces, piece + 1, text, end)) {
+                    return true;
+                }
+                if (end >= text.size() || text[end] == '/') {
+                    return false;
+                }
+            }
+        case Token::DoubleStar:
+            // Only whole directories: try here and right after every '/'.
+            if (piece + 1 == pieces.size()) {
+                return true;
+            }
+            for (size_t end = pos;;) {
+                if (match(pieces, piece + 1, text, end)) {
+                    return true;
+                }
+                size_t slash = text.find('/', end);
+                if (slash == std::string::npos) {
+                    return false;
+                }
+                end = slash + 1;
+            }
+        }
+    }
+    return pos == text.size();
+}
+
+bool IgnoreRules::matches(const Pattern& pattern, const std::string& subject) {
+    switch (pattern.kind) {
+    case Kind::Literal:
+        return subject == pattern.text;
+    case Kind::Suffix:
+        return subject.size() >= pattern.text.size()
+            && subject.compare(subject.size() - pattern.text.size(), pattern.text.size(), pattern.text) == 0;
+    case Kind::Prefix:
+        return subject.compare(0, pattern.text.size(), pattern.text) == 0;
+    case Kind::Glob:
+        return match(pattern.pieces, 0, subject, 0);
+    }
+    return false;
+}
+
+bool IgnoreRules::ignored(const std::string& path, bool isDirectory) const {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (path == ".gitlet" || path == "Gitlet") {
+        return true;
+    }
+    for (auto it = patterns.rbegin(); it != patterns.rend(); ++it) {
+        if (it->directoryOnly && !isDirectory) {
+            continue;
+        }
+        if (matches(*it, it->anchored ? path : name)) {
+            return !it->negated;
+        }
+    }
+    return false;
+}
+
+bool IgnoreRules::ignoredPath(const std::string& path) const {
+    for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        if (ignored(path.substr(0, slash), true)) {
+            return true;
+        }
+    }
+    return ignored(path, false);
+}
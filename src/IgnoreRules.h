@@ -0,0 +1,61 @@
+#ifndef IGNORERULES_H
+#define IGNORERULES_H
+
+#include <bitset>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Patterns from .gitletignore, one per line, in the .gitignore syntax:
+//
+//   # comment          blank lines and comments are skipped
+//   *.o                no '/': matches the name at any depth
+//   build/             trailing '/': matches directories only
+//   /notes.txt         a '/' anywhere else anchors it to the working directory
+//   docs/**/*.tmp      '**' matches any number of directories
+//   !keep.o            re-includes what an earlier pattern ignored
+//
+// Every pattern is compiled once when loaded: plain names and "*.ext" or
+// "name*" patterns become string compares, anything else a token list. The
+// last matching pattern decides, and nothing under an ignored directory can
+// be re-included. .gitlet and the Gitlet executable are always ignored.
+class IgnoreRules {
+public:
+    IgnoreRules() = default;
+
+    static IgnoreRules load(const fs::path& workingDir);
+    void add(const std::string& line);
+
+    // Whether a path relative to the working directory, with '/' separators,
+    // is ignored by a pattern for itself alone.
+    bool ignored(const std::string& path, bool isDirectory) const;
+    // Whether path or any directory above it is ignored.
+    bool ignoredPath(const std::string& path) const;
+
+private:
+    enum class Kind { Literal, Suffix, Prefix, Glob };
+    enum class Token { Literal, Any, Star, DoubleStar, Class };
+    struct Piece {
+        Token token;
+        std::string literal;
+        std::bitset<256> chars;
+    };
+    struct Pattern {
+        Kind kind;
+        std::string text;
+        std::vector<Piece> pieces;
+        bool negated = false;
+        bool directoryOnly = false;
+        bool anchored = false;
+    };
+
+    std::vector<Pattern> patterns;
+
+    static std::vector<Piece> compile(const std::string& glob);
+    static bool match(const std::vector<Piece>& pieces, size_t piece, const std::string& text, size_t pos);
+    static bool matches(const Pattern& pattern, const std::string& subject);
+};
+
+#endif // IGNORERULES_H
@@ -0,0 +1,502 @@
+#include "IoEngine.h"
+#include "Trace.h"
+#include "Transaction.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+// The kernel takes a 32-bit length per read or write.
+const size_t maxChunk = size_t(1) << 30;
+
+std::atomic<unsigned> tmpSequence{0};
+
+fs::path tmpPathFor(const fs::path& file) {
+    fs::path tmp = file;
+    tmp += ".tmp-" + std::to_string(::getpid()) + "-io" + std::to_string(tmpSequence++);
+    return tmp;
+}
+}
+
+#ifdef __linux__
+// A submission and a completion queue shared with the kernel. Operations run
+// in rounds: run() keeps the submission queue full until every operation of
+// the round has completed.
+class IoEngine::Ring {
+public:
+    using Prepare = std::function<void(size_t, io_uring_sqe&)>;
+
+    static std::unique_ptr<Ring> create(unsigned entries) {
+        io_uring_params params{};
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return nullptr;
+        }
+        std::unique_ptr<Ring> ring(new Ring(fd));
+        if (!ring->map(params) || !ring->supportsAll()) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            ::munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            ::munmap(sqRing, sqRingSize);
+        }
+        ::close(fd);
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    // Runs count operations, prepare(i, entry) filling in the i-th. Each
+    // result is the operation's return value or a negated errno.
+    std::vector<int> run(size_t count, const Prepare& prepare) {
+        std::vector<int> results(count, 0);
+        size_t next = 0;
+        size_t done = 0;
+        unsigned inFlight = 0;
+        unsigned unsubmitted = 0;
+        while (done < count) {
+            while (next < count && inFlight < entries) {
+                unsigned tail = *sqTail;
+                unsigned index = tail & *sqMask;
+                io_uring_sqe& sqe = sqes[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                prepare(next, sqe);
+                sqe.user_data = next;
+                sqArray[index] = index;
+                __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+                next++;
+                inFlight++;
+                unsubmitted++;
+            }
+            int submitted = static_cast<int>(
+                ::syscall(__NR_io_uring_enter, fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (submitted < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::invalid_argument("io_uring_enter failed: " + std::string(std::strerror(errno)));
+            }
+            Trace::count("io requests submitted", submitted);
+            unsubmitted -= static_cast<unsigned>(submitted);
+
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                results[cqe.user_data] = cqe.res;
+                done++;
+                inFlight--;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+        return results;
+    }
+
+private:
+    int fd;
+    unsigned entries = 0;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    explicit Ring(int fd) : fd(fd) {}
+
+    bool map(const io_uring_params& params) {
+        entries = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            return false;
+        }
+        cqRing = single ? sqRing
+                        : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                 IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Every operation the engine uses; older kernels lack some.
+    bool supportsAll() const {
+        const unsigned slots = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + slots * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, slots) < 0) {
+            return false;
+        }
+        for (unsigned op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC,
+                            IORING_OP_CLOSE, IORING_OP_RENAMEAT}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+#else
+class IoEngine::Ring {};
+#endif
+
+IoEngine::IoEngine(const std::string& backend, unsigned queueDepth)
+    : chosen(Backend::Threads), queueDepth(std::max(1u, queueDepth)) {
+    if (backend == "sync") {
+        chosen = Backend::Sync;
+        return;
+    }
+#ifdef __linux__
+    if (backend == "auto" || backend == "io_uring") {
+        ring = Ring::create(this->queueDepth);
+        if (ring) {
+            chosen = Backend::IoUring;
+        }
+    }
+#endif
+}
+
+IoEngine::~IoEngine() = default;
+
+IoEngine::Backend IoEngine::backend() const {
+    return chosen;
+}
+
+unsigned IoEngine::depth() const {
+    return queueDepth;
+}
+
+const char* IoEngine::name(Backend backend) {
+    switch (backend) {
+    case Backend::IoUring:
+        return "io_uring";
+    case Backend::Threads:
+        return "threads";
+    case Backend::Sync:
+        return "sync";
+    }
+    return "";
+}
+
+void IoEngine::parallelFor(size_t count, const std::function<void(size_t)>& work) const {
+    // The work waits on the device rather than the CPU, so the pool is wider
+    // than the core count.
+    size_t threads = chosen == Backend::Sync ? 1 : std::min<size_t>(count, std::max(8u, 2 * std::thread::hardware_concurrency()));
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            work(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+std::vector<std::optional<std::vector<char>>> IoEngine::readFiles(const std::vector<fs::path>& paths) {
+    GITLET_TRACE_SCOPE("IoEngine::readFiles");
+    Trace::count("io files read", paths.size());
+    if (ring) {
+        return readWithRing(paths);
+    }
+    std::vector<std::optional<std::vector<char>>> contents(paths.size());
+    parallelFor(paths.size(), [&](size_t i) {
+        try {
+            contents[i] = Utils::readContents(paths[i]);
+        } catch (const std::invalid_argument&) {
+        }
+    });
+    return contents;
+}
+
+void IoEngine::writeFiles(const std::vector<Write>& writes) {
+    GITLET_TRACE_SCOPE("IoEngine::writeFiles");
+    Trace::count("io files written", writes.size());
+    if (ring) {
+        writeWithRing(writes);
+        return;
+    }
+    std::atomic<bool> failed{false};
+    parallelFor(writes.size(), [&](size_t i) {
+        try {
+            Utils::writeAtomic(writes[i].path, writes[i].data, writes[i].size);
+        } catch (const std::invalid_argument&) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        throw std::invalid_argument("could not write to file");
+    }
+}
+
+#ifdef __linux__
+// Each chunk of at most queueDepth files goes open, statx, read until done,
+// close; the chunk bounds how many descriptors are open at once.
+std::vector<std::optional<std::vector<char>>> IoEngine::readWithRing(const std::vector<fs::path>& paths) {
+    std::vector<std::optional<std::vector<char>>> contents(paths.size());
+    for (size_t begin = 0; begin < paths.size(); begin += queueDepth) {
+        size_t count = std::min<size_t>(queueDepth, paths.size() - begin);
+        std::vector<int> fds = ring->run(count, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_OPENAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uint64_t>(paths[begin + i].c_str());
+            sqe.open_flags = O_RDONLY | O_CLOEXEC;
+        });
+
+        std::vector<struct statx> stats(count);
+        static const char empty[] = "";
+        std::vector<int> statted = ring->run(count, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_STATX;
+            sqe.fd = fds[i];
+            sqe.addr = reinterpret_cast<uint64_t>(empty);
+            sqe.len = STATX_SIZE;
+            sqe.addr2 = reinterpret_cast<uint64_t>(&stats[i]);
+            sqe.statx_flags = AT_EMPTY_PATH;
+        });
+
+        // Reads repeat for files not yet complete; a short read at the end
+        // of a file that shrank meanwhile trims it.
+        std::vector<size_t> filled(count, 0);
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0 && statted[i] >= 0) {
+                contents[begin + i].emplace(stats[i].stx_size);
+                if (stats[i].stx_size > 0) {
+                    pending.push_back(i);
+                }
+            }
+        }
+        while (!pending.empty()) {
+            std::vector<int> read = ring->run(pending.size(), [&](size_t j, io_uring_sqe& sqe) {
+                size_t i = pending[j];
+                std::vector<char>& buffer = *contents[begin + i];
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = fds[i];
+                sqe.addr = reinterpret_cast<uint64_t>(buffer.data() + filled[i]);
+                sqe.len = static_cast<uint32_t>(std::min(maxChunk, buffer.size() - filled[i]));
+                sqe.off = filled[i];
+            });
+            std::vector<size_t> still;
+            for (size_t j = 0; j < pending.size(); j++) {
+                size_t i = pending[j];
+                std::vector<char>& buffer = *contents[begin + i];
+                if (read[j] < 0) {
+                    contents[begin + i].reset();
+                } else if (read[j] == 0) {
+                    buffer.resize(filled[i]);
+                } else {
+                    filled[i] += static_cast<size_t>(read[j]);
+                    Trace::count("bytes read", read[j]);
+                    if (filled[i] < buffer.size()) {
+                        still.push_back(i);
+                    }
+                }
+            }
+            pending = std::move(still);
+        }
+
+        std::vector<size_t> open;
+        for (size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                open.push_back(i);
+            } else {
+                contents[begin + i].reset();
+            }
+        }
+        ring->run(open.size(), [&](size_t j, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_CLOSE;
+            sqe.fd = fds[open[j]];
+        });
+    }
+    return contents;
+}
+
+// Each chunk goes statx of the targets for their permissions, open of the
+// temporary files, write until done, datasync when no Transaction collects
+// the files, close and rename; a failed file is cleaned up and reported
+// once the chunk is through.
+void IoEngine::writeWithRing(const std::vector<Write>& writes) {
+    Transaction* transaction = Transaction::current();
+    bool failed = false;
+    for (size_t begin = 0; begin < writes.size(); begin += queueDepth) {
+        size_t count = std::min<size_t>(queueDepth, writes.size() - begin);
+        std::vector<fs::path> tmps;
+        for (size_t i = 0; i < count; i++) {
+            tmps.push_back(tmpPathFor(writes[begin + i].path));
+        }
+
+        std::vector<struct statx> stats(count);
+        std::vector<int> statted = ring->run(count, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_STATX;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uint64_t>(writes[begin + i].path.c_str());
+            sqe.len = STATX_MODE;
+            sqe.addr2 = reinterpret_cast<uint64_t>(&stats[i]);
+        });
+        std::vector<int> fds = ring->run(count, [&](size_t i, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_OPENAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uint64_t>(tmps[i].c_str());
+            sqe.open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+            sqe.len = statted[i] == 0 ? stats[i].stx_mode & 07777 : 0666;
+        });
+
+        std::vector<bool> ok(count);
+        std::vector<size_t> written(count, 0);
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < count; i++) {
+            ok[i] = fds[i] >= 0;
+            if (ok[i] && writes[begin + i].size > 0) {
+                pending.push_back(i);
+            }
+        }
+        while (!pending.empty()) {
+            std::vector<int> wrote = ring->run(pending.size(), [&](size_t j, io_uring_sqe& sqe) {
+                size_t i = pending[j];
+                const Write& write = writes[begin + i];
+                sqe.opcode = IORING_OP_WRITE;
+                sqe.fd = fds[i];
+                sqe.addr = reinterpret_cast<uint64_t>(write.data + written[i]);
+                sqe.len = static_cast<uint32_t>(std::min(maxChunk, write.size - written[i]));
+                sqe.off = written[i];
+            });
+            std::vector<size_t> still;
+            for (size_t j = 0; j < pending.size(); j++) {
+                size_t i = pending[j];
+                if (wrote[j] <= 0) {
+                    ok[i] = false;
+                    continue;
+                }
+                written[i] += static_cast<size_t>(wrote[j]);
+                Trace::count("bytes written", wrote[j]);
+                if (written[i] < writes[begin + i].size) {
+                    still.push_back(i);
+                }
+            }
+            pending = std::move(still);
+        }
+
+        std::vector<size_t> open;
+        for (size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                open.push_back(i);
+            }
+        }
+        if (transaction == nullptr) {
+            std::vector<int> synced = ring->run(open.size(), [&](size_t j, io_uring_sqe& sqe) {
+                sqe.opcode = IORING_OP_FSYNC;
+                sqe.fd = fds[open[j]];
+                sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+            });
+            for (size_t j = 0; j < open.size(); j++) {
+                ok[open[j]] = ok[open[j]] && synced[j] == 0;
+            }
+        }
+        ring->run(open.size(), [&](size_t j, io_uring_sqe& sqe) {
+            sqe.opcode = IORING_OP_CLOSE;
+            sqe.fd = fds[open[j]];
+        });
+
+        std::vector<size_t> renaming;
+        for (size_t i = 0; i < count; i++) {
+            if (ok[i]) {
+                renaming.push_back(i);
+            } else if (fds[i] >= 0) {
+                ::unlink(tmps[i].c_str());
+                failed = true;
+            } else {
+                failed = true;
+            }
+        }
+        std::vector<int> renamed = ring->run(renaming.size(), [&](size_t j, io_uring_sqe& sqe) {
+            size_t i = renaming[j];
+            sqe.opcode = IORING_OP_RENAMEAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uint64_t>(tmps[i].c_str());
+            sqe.len = static_cast<uint32_t>(AT_FDCWD);
+            sqe.addr2 = reinterpret_cast<uint64_t>(writes[begin + i].path.c_str());
+        });
+
+        std::set<fs::path> directories;
+        for (size_t j = 0; j < renaming.size(); j++) {
+            const fs::path& path = writes[begin + renaming[j]].path;
+            if (renamed[j] != 0) {
+                ::unlink(tmps[renaming[j]].c_str());
+                failed = true;
+            } else if (transaction != nullptr) {
+                transaction->track(path);
+            } else {
+                directories.insert(path.has_parent_path() ? path.parent_path() : fs::path("."));
+            }
+        }
+        for (const auto& directory : directories) {
+            Utils::syncParentDirectory(directory / ".");
+        }
+    }
+    if (failed) {
+        throw std::invalid_argument("could not write to file");
+    }
+}
+#else
+std::vector<std::optional<std::vector<char>>> IoEngine::readWithRing(const std::vector<fs::path>&) {
+    return {};
+}
+
+void IoEngine::writeWithRing(const std::vector<Write>&) {}
+#endif
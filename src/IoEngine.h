@@ -0,0 +1,69 @@
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Reads and writes many whole files at once.
+//
+// A batch goes through in phases (open, read or write, sync, close, rename),
+// and every request of a phase is in flight together, so the device sees a
+// queue as deep as the batch instead of one request at a time. On Linux the
+// phases are submitted to an io_uring set up with raw system calls; where
+// io_uring is missing or forbidden, or lacks an operation, the same requests
+// run on a pool of threads. Writes have Utils::writeAtomic's semantics: a
+// temporary file renamed over the target, the target's permissions kept,
+// and durability through the open Transaction or a sync of each file.
+class IoEngine {
+public:
+    enum class Backend {
+        IoUring,
+        Threads,
+        Sync,
+    };
+
+    struct Write {
+        fs::path path;
+        const char* data;
+        size_t size;
+    };
+
+    // Backend "auto" picks io_uring when the kernel allows it.
+    explicit IoEngine(const std::string& backend = "auto", unsigned queueDepth = 256);
+    ~IoEngine();
+
+    IoEngine(const IoEngine&) = delete;
+    IoEngine& operator=(const IoEngine&) = delete;
+
+    Backend backend() const;
+    // How many files a caller should hand over per batch.
+    unsigned depth() const;
+    static const char* name(Backend backend);
+
+    // Contents of each file in request order; nothing for one that could not
+    // be read.
+    std::vector<std::optional<std::vector<char>>> readFiles(const std::vector<fs::path>& paths);
+    // Replaces every file. Throws std::invalid_argument if any write fails,
+    // after the others have finished.
+    void writeFiles(const std::vector<Write>& writes);
+
+private:
+    class Ring;
+
+    Backend chosen;
+    unsigned queueDepth;
+    std::unique_ptr<Ring> ring;
+
+    std::vector<std::optional<std::vector<char>>> readWithRing(const std::vector<fs::path>& paths);
+    void writeWithRing(const std::vector<Write>& writes);
+    // Runs work(i) for every i < count on the pool, or inline for Sync.
+    void parallelFor(size_t count, const std::function<void(size_t)>& work) const;
+};
+
+#endif // IOENGINE_H
@@ -0,0 +1,652 @@
+#include "LfsStore.h"
+#include "Config.h"
+#include "Task.h"
+#include "Trace.h"
+#include "Transaction.h"
+#include "Transport.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <openssl/evp.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace {
+const std::string pointerVersion = "version gitlet-lfs/1";
+const size_t pointerMaxSize = 200;
+const size_t chunkSize = 1 << 20;
+// Requests sent before their answers are read, so neither side's socket
+// buffer fills while the other waits.
+const size_t requestsInFlight = 64;
+const std::string statCacheHeader = "# gitlet lfs stat cache";
+const int64_t racyNanoseconds = 2'000'000'000;
+
+int64_t nanoseconds(const struct timespec& time) {
+    return static_cast<int64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec;
+}
+
+class Sha256 {
+public:
+    Sha256() : ctx(EVP_MD_CTX_new()) { EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr); }
+    ~Sha256() { EVP_MD_CTX_free(ctx); }
+
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    void update(const char* data, size_t size) { EVP_DigestUpdate(ctx, data, size); }
+
+    std::string hex() {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(ctx, digest, &length);
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (unsigned int i = 0; i < length; i++) {
+            out += digits[digest[i] >> 4];
+            out += digits[digest[i] & 0xf];
+        }
+        return out;
+    }
+
+private:
+    EVP_MD_CTX* ctx;
+};
+
+bool validOid(const std::string& oid) {
+    return oid.size() == 64 && std::all_of(oid.begin(), oid.end(), [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+}
+
+fs::path temporaryIn(const fs::path& directory) {
+    static std::atomic<unsigned> sequence{0};
+    return directory / ("tmp-" + std::to_string(::getpid()) + "-" + std::to_string(sequence++));
+}
+
+// Streams everything read returns (0 at the end, negative on failure) into
+// a new read-only file at tmp, hashing it on the way.
+std::optional<LfsStore::Pointer> copyIn(const fs::path& tmp, const std::function<ssize_t(char*, size_t)>& read,
+                                        bool sync) {
+    GITLET_TRACE_SCOPE("LfsStore::copyIn");
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    Sha256 hash;
+    LfsStore::Pointer pointer;
+    std::vector<char> buffer(chunkSize);
+    bool ok = true;
+    while (ok) {
+        ssize_t n = read(buffer.data(), buffer.size());
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        hash.update(buffer.data(), n);
+        for (ssize_t written = 0; ok && written < n;) {
+            ssize_t w = ::write(fd, buffer.data() + written, n - written);
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = w > 0;
+            written += w;
+        }
+        pointer.size += n;
+    }
+    if (ok && sync) {
+        ::fdatasync(fd);
+    }
+    ::close(fd);
+    if (!ok) {
+        ::unlink(tmp.c_str());
+        return std::nullopt;
+    }
+    Trace::count("lfs bytes stored", pointer.size);
+    pointer.oid = hash.hex();
+    return pointer;
+}
+
+// Moves tmp to object, or drops it if the store already has the object.
+bool publish(const fs::path& tmp, const fs::path& object) {
+    std::error_code ec;
+    if (fs::exists(object, ec)) {
+        ::unlink(tmp.c_str());
+        return true;
+    }
+    fs::create_directories(object.parent_path(), ec);
+    if (::rename(tmp.c_str(), object.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::function<ssize_t(char*, size_t)> fileReader(int fd) {
+    return [fd](char* data, size_t size) {
+        ssize_t n;
+        do {
+            n = ::read(fd, data, size);
+        } while (n < 0 && errno == EINTR);
+        return n;
+    };
+}
+
+std::function<ssize_t(char*, size_t)> channelReader(Channel& channel, uint64_t& remaining) {
+    return [&channel, &remaining](char* data, size_t size) -> ssize_t {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(size, remaining));
+        if (n == 0) {
+            return 0;
+        }
+        if (!channel.read(data, n)) {
+            return -1;
+        }
+        remaining -= n;
+        return static_cast<ssize_t>(n);
+    };
+}
+
+// Copies with copy_file_range, which can share extents on filesystems that
+// support it, or with read and write where it is unavailable.
+bool copyOut(int in, int out) {
+    bool kernelCopy = true;
+    while (true) {
+        if (kernelCopy) {
+            ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, chunkSize * 64, 0);
+            if (n > 0) {
+                continue;
+            }
+            if (n == 0) {
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+                return false;
+            }
+            kernelCopy = false;
+        }
+        char buffer[1 << 16];
+        ssize_t n = ::read(in, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n == 0;
+        }
+        for (ssize_t written = 0; written < n;) {
+            ssize_t w = ::write(out, buffer + written, n - written);
+            if (w < 0 && errno == EINTR) {
+                continue;
+            }
+            if (w <= 0) {
+                return false;
+            }
+            written += w;
+        }
+    }
+}
+
+Task<void> runTask(std::function<void()> work) {
+    work();
+    co_return;
+}
+}
+
+LfsStore::LfsStore(const fs::path& gitletDir, const Config& config)
+    : tracking(false), statCachePath(gitletDir / "lfs" / "stat-cache"), statCacheDirty(false) {
+    std::istringstream track(config.getString("lfs.track", ""));
+    std::string pattern;
+    while (track >> pattern) {
+        patterns.add(pattern);
+        tracking = true;
+    }
+    std::string store = config.getString("lfs.store", "");
+    if (store.rfind("ext::", 0) == 0) {
+        remote = store;
+        store.clear();
+    }
+    directory = fs::absolute(store.empty() ? gitletDir / "lfs" / "objects" : fs::path(store));
+    durableHere = store.empty();
+    std::string alternateStore = config.getString("lfs.alternate", "");
+    if (!alternateStore.empty()) {
+        alternate = fs::absolute(alternateStore);
+    }
+}
+
+LfsStore::~LfsStore() {
+    try {
+        saveStatCache();
+    } catch (const std::exception&) {
+        // Losing the cache only costs hashing the files again.
+    }
+}
+
+bool LfsStore::tracks(const std::string& path) const {
+    return tracking && patterns.ignoredPath(path);
+}
+
+std::string LfsStore::location() const {
+    return remote.empty() ? directory.string() : remote;
+}
+
+std::optional<LfsStore::Pointer> LfsStore::parse(const std::vector<char>& blob) {
+    if (blob.size() > pointerMaxSize || blob.size() < pointerVersion.size()
+        || !std::equal(pointerVersion.begin(), pointerVersion.end(), blob.begin())) {
+        return std::nullopt;
+    }
+    std::istringstream in(std::string(blob.begin(), blob.end()));
+    std::string version, oid, size;
+    if (!std::getline(in, version) || !std::getline(in, oid) || !std::getline(in, size)
+        || oid.rfind("oid sha256:", 0) != 0 || size.rfind("size ", 0) != 0) {
+        return std::nullopt;
+    }
+    std::optional<long long> bytes = Config::parseInt(size.substr(5));
+    Pointer pointer{oid.substr(11), bytes ? static_cast<uint64_t>(*bytes) : 0};
+    if (!bytes || *bytes < 0 || !validOid(pointer.oid) || format(pointer) != blob) {
+        return std::nullopt;
+    }
+    return pointer;
+}
+
+std::vector<char> LfsStore::format(const Pointer& pointer) {
+    std::string text = pointerVersion + "\noid sha256:" + pointer.oid + "\nsize " + std::to_string(pointer.size) + "\n";
+    return std::vector<char>(text.begin(), text.end());
+}
+
+fs::path LfsStore::objectPath(const fs::path& directory, const std::string& oid) {
+    return directory / oid.substr(0, 2) / oid;
+}
+
+LfsStore::Pointer LfsStore::store(const fs::path& file) {
+    GITLET_TRACE_SCOPE("LfsStore::store");
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::invalid_argument("must be a normal file");
+    }
+    fs::create_directories(directory);
+    struct stat before;
+    bool known = ::fstat(fd, &before) == 0;
+    Transaction* transaction = durableHere ? Transaction::current() : nullptr;
+    fs::path tmp = temporaryIn(directory);
+    std::optional<Pointer> pointer = copyIn(tmp, fileReader(fd), transaction == nullptr);
+    if (pointer && known) {
+        remember(file, fd, before, *pointer);
+    }
+    ::close(fd);
+    if (!pointer || !publish(tmp, objectPath(directory, pointer->oid))) {
+        throw std::invalid_argument("could not store large file");
+    }
+    if (transaction != nullptr) {
+        transaction->track(objectPath(directory, pointer->oid));
+    } else {
+        Utils::syncParentDirectory(objectPath(directory, pointer->oid));
+    }
+    if (!remote.empty()) {
+        pending.push_back(*pointer);
+    }
+    return *pointer;
+}
+
+LfsStore::Pointer LfsStore::pointerFor(const fs::path& file) const {
+    GITLET_TRACE_SCOPE("LfsStore::pointerFor");
+    std::error_code ec;
+    if (fs::file_size(file, ec) <= pointerMaxSize && !ec) {
+        std::optional<Pointer> itself = parse(Utils::readContents(file));
+        if (itself) {
+            return *itself;
+        }
+    }
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat before;
+    if (fd < 0 || ::fstat(fd, &before) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::invalid_argument("must be a normal file");
+    }
+    auto cached = stats().find(file.string());
+    if (cached != stats().end() && cached->second.mtime != 0 && cached->second.mtime == nanoseconds(before.st_mtim)
+        && cached->second.size == static_cast<uint64_t>(before.st_size) && cached->second.inode == before.st_ino) {
+        ::close(fd);
+        Trace::count("lfs files unchanged");
+        return {cached->second.oid, cached->second.size};
+    }
+    Sha256 hash;
+    Pointer pointer;
+    std::vector<char> buffer(chunkSize);
+    auto read = fileReader(fd);
+    for (ssize_t n; (n = read(buffer.data(), buffer.size())) > 0;) {
+        hash.update(buffer.data(), n);
+        pointer.size += n;
+    }
+    Trace::count("lfs bytes hashed", pointer.size);
+    pointer.oid = hash.hex();
+    remember(file, fd, before, pointer);
+    ::close(fd);
+    return pointer;
+}
+
+std::unordered_map<std::string, LfsStore::Stat>& LfsStore::stats() const {
+    if (statCache) {
+        return *statCache;
+    }
+    // A torn cache is dropped whole, so it only costs hashing the files again.
+    statCache.emplace();
+    std::ifstream in(statCachePath);
+    std::string line;
+    if (!std::getline(in, line) || line != statCacheHeader) {
+        return *statCache;
+    }
+    std::unordered_map<std::string, Stat> loaded;
+    while (std::getline(in, line)) {
+        if (line == "end") {
+            *statCache = std::move(loaded);
+            break;
+        }
+        std::istringstream entry(line);
+        Stat stat;
+        std::string file;
+        if (!(entry >> stat.size >> stat.mtime >> stat.inode >> stat.oid) || entry.get() != ' '
+            || !std::getline(entry, file) || !validOid(stat.oid)) {
+            break;
+        }
+        loaded[file] = stat;
+    }
+    return *statCache;
+}
+
+void LfsStore::remember(const fs::path& file, int fd, const struct stat& before, const Pointer& pointer) const {
+    struct stat after;
+    if (::fstat(fd, &after) != 0 || nanoseconds(after.st_mtim) != nanoseconds(before.st_mtim)
+        || after.st_size != before.st_size || static_cast<uint64_t>(after.st_size) != pointer.size
+        || file.string().find('\n') != std::string::npos) {
+        return;
+    }
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    int64_t nowNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    int64_t mtime = nanoseconds(after.st_mtim);
+    Stat& stat = stats()[file.string()];
+    stat = {pointer.size, mtime > nowNanoseconds - racyNanoseconds ? 0 : mtime, static_cast<uint64_t>(after.st_ino),
+            pointer.oid};
+    statCacheDirty = true;
+}
+
+void LfsStore::saveStatCache() const {
+    if (!statCacheDirty || !fs::exists(statCachePath.parent_path().parent_path())) {
+        return;
+    }
+    std::string out = statCacheHeader + "\n";
+    for (const auto& [file, stat] : *statCache) {
+        out += std::to_string(stat.size) + " " + std::to_string(stat.mtime) + " " + std::to_string(stat.inode) + " "
+             + stat.oid + " " + file + "\n";
+    }
+    out += "end\n";
+    fs::create_directories(statCachePath.parent_path());
+    Utils::writeAtomic(statCachePath, out.data(), out.size());
+    statCacheDirty = false;
+}
+
+bool LfsStore::upload() {
+    if (remote.empty() || pending.empty()) {
+        return true;
+    }
+    GITLET_TRACE_SCOPE("LfsStore::upload");
+    Connection connection(remote.substr(5) + " lfs-serve");
+    if (!connection.valid()) {
+        return false;
+    }
+    Channel& channel = connection.channel();
+    bool ok = true;
+    for (size_t begin = 0; ok && begin < pending.size(); begin += requestsInFlight) {
+        size_t end = std::min(pending.size(), begin + requestsInFlight);
+        for (size_t i = begin; ok && i < end; i++) {
+            const Pointer& pointer = pending[i];
+            int fd = ::open(objectPath(directory, pointer.oid).c_str(), O_RDONLY | O_CLOEXEC);
+            ok = fd >= 0;
+            if (!ok) {
+                break;
+            }
+            channel.write("put " + pointer.oid + " " + std::to_string(pointer.size) + "\n");
+            std::vector<char> buffer(chunkSize);
+            uint64_t sent = 0;
+            auto read = fileReader(fd);
+            for (ssize_t n; sent < pointer.size && (n = read(buffer.data(), buffer.size())) > 0; sent += n) {
+                channel.write(buffer.data(), std::min<uint64_t>(n, pointer.size - sent));
+            }
+            ::close(fd);
+            ok = sent == pointer.size;
+        }
+        channel.flush();
+        std::string line;
+        for (size_t i = begin; ok && i < end; i++) {
+            ok = channel.readLine(line) && line == "ok";
+        }
+    }
+    ok = connection.finish() && ok;
+    if (ok) {
+        Trace::count("lfs objects uploaded", pending.size());
+        pending.clear();
+    }
+    return ok;
+}
+
+bool LfsStore::copyFromAlternate(const Pointer& pointer) {
+    int fd = ::open(objectPath(alternate, pointer.oid).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    fs::create_directories(directory);
+    Transaction* transaction = Transaction::current();
+    fs::path tmp = temporaryIn(directory);
+    std::optional<Pointer> copied = copyIn(tmp, fileReader(fd), transaction == nullptr);
+    ::close(fd);
+    if (!copied) {
+        return false;
+    }
+    if (copied->oid != pointer.oid) {
+        ::unlink(tmp.c_str());
+        Trace::count("lfs alternate objects damaged");
+        return false;
+    }
+    if (!publish(tmp, objectPath(directory, pointer.oid))) {
+        return false;
+    }
+    if (transaction != nullptr) {
+        transaction->track(objectPath(directory, pointer.oid));
+    } else {
+        Utils::syncParentDirectory(objectPath(directory, pointer.oid));
+    }
+    Trace::count("lfs objects copied from alternate");
+    return true;
+}
+
+void LfsStore::fetch(const std::vector<Pointer>& wanted) {
+    std::vector<Pointer> missing;
+    for (const Pointer& pointer : wanted) {
+        if (alternate.empty() || !copyFromAlternate(pointer)) {
+            missing.push_back(pointer);
+        }
+    }
+    if (remote.empty() || missing.empty()) {
+        return;
+    }
+    GITLET_TRACE_SCOPE("LfsStore::fetch");
+    Connection connection(remote.substr(5) + " lfs-serve");
+    if (!connection.valid()) {
+        return;
+    }
+    fs::create_directories(directory);
+    Transaction* transaction = Transaction::current();
+    Channel& channel = connection.channel();
+    bool ok = true;
+    for (size_t begin = 0; ok && begin < missing.size(); begin += requestsInFlight) {
+        size_t end = std::min(missing.size(), begin + requestsInFlight);
+        for (size_t i = begin; i < end; i++) {
+            channel.write("get " + missing[i].oid + "\n");
+        }
+        channel.flush();
+        for (size_t i = begin; ok && i < end; i++) {
+            std::string line;
+            ok = channel.readLine(line);
+            if (!ok || line == "missing") {
+                continue;
+            }
+            std::optional<long long> size = line.rfind("found ", 0) == 0 ? Config::parseInt(line.substr(6)) : std::nullopt;
+            ok = size && *size >= 0;
+            if (!ok) {
+                break;
+            }
+            uint64_t remaining = static_cast<uint64_t>(*size);
+            fs::path tmp = temporaryIn(directory);
+            std::optional<Pointer> received = copyIn(tmp, channelReader(channel, remaining), transaction == nullptr);
+            ok = received.has_value();
+            if (ok && received->oid != missing[i].oid) {
+                ::unlink(tmp.c_str());
+                continue;
+            }
+            if (ok && publish(tmp, objectPath(directory, received->oid))) {
+                Trace::count("lfs objects fetched");
+                if (transaction != nullptr) {
+                    transaction->track(objectPath(directory, received->oid));
+                }
+            }
+        }
+    }
+    connection.finish();
+}
+
+std::vector<fs::path> LfsStore::materialize(const std::vector<std::pair<fs::path, Pointer>>& files, Executor& executor) {
+    GITLET_TRACE_SCOPE("LfsStore::materialize");
+    std::vector<Pointer> missing;
+    std::unordered_set<std::string> seen;
+    for (const auto& [path, pointer] : files) {
+        if (seen.insert(pointer.oid).second && !fs::exists(objectPath(directory, pointer.oid))) {
+            missing.push_back(pointer);
+        }
+    }
+    fetch(missing);
+
+    std::vector<char> placed(files.size(), 0);
+    std::vector<Future<void>> writes;
+    for (size_t i = 0; i < files.size(); i++) {
+        writes.push_back(spawn(executor, runTask([this, &files, &placed, i]() {
+            placed[i] = place(files[i].first, files[i].second);
+        })));
+    }
+    syncWait(whenAll(std::move(writes)));
+
+    std::vector<fs::path> unplaced;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!placed[i]) {
+            std::vector<char> text = format(files[i].second);
+            Utils::writeAtomic(files[i].first, text.data(), text.size());
+            unplaced.push_back(files[i].first);
+        }
+    }
+    return unplaced;
+}
+
+bool LfsStore::place(const fs::path& target, const Pointer& pointer) const {
+    fs::path object = objectPath(directory, pointer.oid);
+    struct stat source;
+    if (::stat(object.c_str(), &source) != 0) {
+        return false;
+    }
+    struct stat existing;
+    bool exists = ::stat(target.c_str(), &existing) == 0;
+
+    static std::atomic<unsigned> sequence{0};
+    fs::path tmp = target;
+    tmp += ".tmp-" + std::to_string(::getpid()) + "-lfs" + std::to_string(sequence++);
+    int in = ::open(object.c_str(), O_RDONLY | O_CLOEXEC);
+    // A file the store made read-only is still the user's to edit.
+    mode_t mode = exists && existing.st_ino != source.st_ino ? existing.st_mode & 07777 : 0666;
+    int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    bool ok = in >= 0 && out >= 0 && copyOut(in, out);
+    if (ok && Transaction::current() == nullptr) {
+        ::fdatasync(out);
+    }
+    if (in >= 0) {
+        ::close(in);
+    }
+    if (out >= 0) {
+        ::close(out);
+    }
+    if (!ok) {
+        ::unlink(tmp.c_str());
+        throw std::invalid_argument("could not write large file " + target.string());
+    }
+    if (::rename(tmp.c_str(), target.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        throw std::invalid_argument("could not replace file " + target.string());
+    }
+    Trace::count("lfs files copied");
+    if (Transaction::current() != nullptr) {
+        Transaction::current()->track(target);
+    } else {
+        Utils::syncParentDirectory(target);
+    }
+    return true;
+}
+
+int LfsStore::serve(const fs::path& directory, Channel& channel) {
+    std::string line;
+    while (channel.readLine(line)) {
+        std::istringstream request(line);
+        std::string verb, oid;
+        request >> verb >> oid;
+        if (verb == "get" && validOid(oid)) {
+            int fd = ::open(objectPath(directory, oid).c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || ::fstat(fd, &st) != 0) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                channel.write("missing\n");
+            } else {
+                channel.write("found " + std::to_string(st.st_size) + "\n");
+                std::vector<char> buffer(chunkSize);
+                auto read = fileReader(fd);
+                for (ssize_t n; (n = read(buffer.data(), buffer.size())) > 0;) {
+                    channel.write(buffer.data(), n);
+                }
+                ::close(fd);
+            }
+        } else if (verb == "put" && validOid(oid)) {
+            long long size = -1;
+            request >> size;
+            if (size < 0) {
+                return 1;
+            }
+            fs::create_directories(directory);
+            uint64_t remaining = static_cast<uint64_t>(size);
+            fs::path tmp = temporaryIn(directory);
+            std::optional<Pointer> received = copyIn(tmp, channelReader(channel, remaining), true);
+            if (!received) {
+                return 1;
+            }
+            if (received->oid != oid) {
+                ::unlink(tmp.c_str());
+                channel.write("error content does not match its id\n");
+            } else if (publish(tmp, objectPath(directory, oid))) {
+                Utils::syncParentDirectory(objectPath(directory, oid));
+                channel.write("ok\n");
+            } else {
+                channel.write("error could not store object\n");
+            }
+        } else {
+            channel.write("error bad request\n");
+        }
+        channel.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef LFSSTORE_H
+#define LFSSTORE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "IgnoreRules.h"
+
+namespace fs = std::filesystem;
+
+class Channel;
+class Config;
+class Executor;
+
+// Large files kept out of the object store.
+//
+// A working file matching a pattern of lfs.track (.gitletignore syntax,
+// separated by spaces) is staged as a pointer blob:
+//
+//   version gitlet-lfs/1
+//   oid sha256:<64 hex digits>
+//   size <bytes>
+//
+// and its content goes to a content-addressed store, one read-only file per
+// SHA-256 under <store>/<first two digits>/<oid>. lfs.store names the store:
+// a directory, which may be shared between repositories, or
+// "ext::<command>", a server reached by running `<command> lfs-serve`, with
+// .gitlet/lfs/objects as the local cache. Without it the store is
+// .gitlet/lfs/objects itself. lfs.alternate names another store directory
+// that is only read from: content missing here is copied in from it, and
+// checked against its oid on the way, before the remote is asked. A local
+// clone gets the source's private store as its alternate. Content is copied
+// in while it is hashed, so a file is read once; nothing holds it in memory.
+//
+// Each file's oid is remembered in .gitlet/lfs/stat-cache with its size,
+// mtime and inode, so status only hashes a large file again once one of
+// them changed. As with the untracked cache, a file changed within the last
+// two seconds is not remembered.
+//
+// Checkout is lazy: only the content of the files it writes is fetched, in
+// one request for all that are missing, and then every file is written in
+// parallel, copied with copy_file_range, which shares the extents on file
+// systems that can. A working file is never a link to the store's copy,
+// since writing to it in place would change the store. Content the store
+// lacks leaves the pointer in the working file.
+class LfsStore {
+public:
+    struct Pointer {
+        std::string oid;
+        uint64_t size = 0;
+    };
+
+    LfsStore(const fs::path& gitletDir, const Config& config);
+    // Writes the stat cache if it changed.
+    ~LfsStore();
+
+    // Whether path, relative to the working directory, matches lfs.track.
+    bool tracks(const std::string& path) const;
+    // The store as lfs.store names it: "ext::<command>" or a directory.
+    std::string location() const;
+
+    static std::optional<Pointer> parse(const std::vector<char>& blob);
+    static std::vector<char> format(const Pointer& pointer);
+
+    // Copies the file into the store and returns its pointer.
+    Pointer store(const fs::path& file);
+    // The pointer the file would be staged as; a file holding a pointer is
+    // its own pointer.
+    Pointer pointerFor(const fs::path& file) const;
+    // Sends what store() added to an "ext::" store, in one connection.
+    bool upload();
+    // Writes every file from its pointer's content, fetching what is
+    // missing first. Returns the files left holding their pointer.
+    std::vector<fs::path> materialize(const std::vector<std::pair<fs::path, Pointer>>& files, Executor& executor);
+
+    // The server side: "get <oid>" answered by "found <size>" and the
+    // content or "missing"; "put <oid> <size>" and the content answered by
+    // "ok" or "error <reason>". Returns an exit status.
+    static int serve(const fs::path& directory, Channel& channel);
+
+private:
+    // What a file looked like when it hashed to oid.
+    struct Stat {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t inode = 0;
+        std::string oid;
+    };
+
+    IgnoreRules patterns;
+    bool tracking;
+    fs::path directory;
+    std::string remote;
+    fs::path alternate;
+    bool durableHere;
+    std::vector<Pointer> pending;
+    fs::path statCachePath;
+    mutable std::optional<std::unordered_map<std::string, Stat>> statCache;    // file to its stat
+    mutable bool statCacheDirty;
+
+    static fs::path objectPath(const fs::path& directory, const std::string& oid);
+    // Fetches the missing objects from the alternate, then from remote, into
+    // directory.
+    void fetch(const std::vector<Pointer>& missing);
+    // Copies one object from the alternate; false if it lacks it or its
+    // copy does not hash to the oid.
+    bool copyFromAlternate(const Pointer& pointer);
+    // Writes one working file; false if the store lacks its content.
+    bool place(const fs::path& target, const Pointer& pointer) const;
+    std::unordered_map<std::string, Stat>& stats() const;
+    // Remembers the pointer of the file open as fd, if it still looks as it
+    // did before (st) once it has been read.
+    void remember(const fs::path& file, int fd, const struct stat& before, const Pointer& pointer) const;
+    void saveStatCache() const;
+};
+
+#endif // LFSSTORE_H
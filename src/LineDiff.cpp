@@ -0,0 +1,125 @@
+#include "LineDiff.h"
+#include <unordered_map>
+
+namespace {
+struct Snake {
+    size_t x0, y0, x1, y1;
+};
+
+class Comparison {
+public:
+    Comparison(const std::vector<int>& a, const std::vector<int>& b, std::vector<std::pair<size_t, size_t>>& out)
+        : a(a), b(b), out(out), forward(2 * (a.size() + b.size()) + 3), backward(forward.size()) {}
+
+    void compare(size_t aLo, size_t aHi, size_t bLo, size_t bHi) {
+        while (aLo < aHi && bLo < bHi && a[aLo] == b[bLo]) {
+            out.emplace_back(aLo++, bLo++);
+        }
+        size_t tail = 0;
+        while (aLo < aHi && bLo < bHi && a[aHi - 1] == b[bHi - 1]) {
+            aHi--;
+            bHi--;
+            tail++;
+        }
+        if (aLo < aHi && bLo < bHi) {
+            Snake snake = middleSnake(aLo, aHi, bLo, bHi);
+            compare(aLo, aLo + snake.x0, bLo, bLo + snake.y0);
+            for (size_t x = snake.x0, y = snake.y0; x < snake.x1; x++, y++) {
+                out.emplace_back(aLo + x, bLo + y);
+            }
+            compare(aLo + snake.x1, aHi, bLo + snake.y1, bHi);
+        }
+        for (size_t i = 0; i < tail; i++) {
+            out.emplace_back(aHi + i, bHi + i);
+        }
+    }
+
+private:
+    const std::vector<int>& a;
+    const std::vector<int>& b;
+    std::vector<std::pair<size_t, size_t>>& out;
+    std::vector<long> forward;
+    std::vector<long> backward;
+
+    // Myers' middle snake of a[aLo, aHi) against b[bLo, bHi), relative to
+    // their starts. Both ranges are non-empty and differ at both ends.
+    Snake middleSnake(size_t aLo, size_t aHi, size_t bLo, size_t bHi) {
+        long n = static_cast<long>(aHi - aLo);
+        long m = static_cast<long>(bHi - bLo);
+        long delta = n - m;
+        bool odd = delta & 1;
+        long limit = (n + m + 1) / 2;
+        long offset = limit + 1;
+        forward[offset + 1] = 0;
+        backward[offset + 1] = 0;
+        for (long d = 0; d <= limit; d++) {
+            for (long k = -d; k <= d; k += 2) {
+                long x = k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1])
+                             ? forward[offset + k + 1]
+                             : forward[offset + k - 1] + 1;
+                long y = x - k;
+                long x0 = x;
+                long y0 = y;
+                while (x < n && y < m && a[aLo + x] == b[bLo + y]) {
+                    x++;
+                    y++;
+                }
+                forward[offset + k] = x;
+                long c = delta - k;
+                if (odd && c >= -(d - 1) && c <= d - 1 && x + backward[offset + c] >= n) {
+                    return {static_cast<size_t>(x0), static_cast<size_t>(y0), static_cast<size_t>(x), static_cast<size_t>(y)};
+                }
+            }
+            for (long k = -d; k <= d; k += 2) {
+                long x = k == -d || (k != d && backward[offset + k - 1] < backward[offset + k + 1])
+                             ? backward[offset + k + 1]
+                             : backward[offset + k - 1] + 1;
+                long y = x - k;
+                long x0 = x;
+                long y0 = y;
+                while (x < n && y < m && a[aHi - 1 - x] == b[bHi - 1 - y]) {
+                    x++;
+                    y++;
+                }
+                backward[offset + k] = x;
+                long c = delta - k;
+                if (!odd && c >= -d && c <= d && x + forward[offset + c] >= n) {
+                    return {static_cast<size_t>(n - x), static_cast<size_t>(m - y), static_cast<size_t>(n - x0), static_cast<size_t>(m - y0)};
+                }
+            }
+        }
+        // Unreachable: the two searches meet by d = limit.
+        return {0, 0, 0, 0};
+    }
+};
+}
+
+std::vector<std::string_view> LineDiff::lines(std::string_view text) {
+    std::vector<std::string_view> out;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t newline = text.find('\n', start);
+        size_t stop = newline == std::string_view::npos ? text.size() : newline + 1;
+        out.push_back(text.substr(start, stop - start));
+        start = stop;
+    }
+    return out;
+}
+
+std::vector<std::pair<size_t, size_t>> LineDiff::matching(const std::vector<std::string_view>& a,
+                                                          const std::vector<std::string_view>& b) {
+    std::unordered_map<std::string_view, int> numbers;
+    std::vector<int> left;
+    std::vector<int> right;
+    left.reserve(a.size());
+    right.reserve(b.size());
+    for (std::string_view line : a) {
+        left.push_back(numbers.emplace(line, static_cast<int>(numbers.size())).first->second);
+    }
+    for (std::string_view line : b) {
+        right.push_back(numbers.emplace(line, static_cast<int>(numbers.size())).first->second);
+    }
+    std::vector<std::pair<size_t, size_t>> out;
+    Comparison(left, right, out).compare(0, left.size(), 0, right.size());
+    return out;
+}
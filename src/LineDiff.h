@@ -0,0 +1,27 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Line-by-line comparison of two texts.
+//
+// Lines are first numbered so equal lines compare as equal integers, the
+// common head and tail are set aside, and what differs is compared with
+// Myers' algorithm in linear space: the middle snake of the shortest edit
+// script is found by searching from both ends at once, and the halves on
+// either side of it are compared the same way. Time is O((N+M)D) for D
+// differing lines and memory O(N+M).
+class LineDiff {
+public:
+    // The lines of text, each with its '\n'; a last line without one is
+    // still a line.
+    static std::vector<std::string_view> lines(std::string_view text);
+    // Pairs (i, j) of lines a[i] == b[j] kept by a shortest edit script,
+    // increasing in both.
+    static std::vector<std::pair<size_t, size_t>> matching(const std::vector<std::string_view>& a,
+                                                           const std::vector<std::string_view>& b);
+};
+
+#endif // LINEDIFF_H
@@ -0,0 +1,84 @@
+#include "LockFile.h"
+#include "Trace.h"
+#include "Transaction.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+LockFile::LockFile(const fs::path& target, std::chrono::milliseconds timeout)
+    : target(target), lockPath(fs::path(target) += ".lock"), fd(-1) {
+    GITLET_TRACE_SCOPE("LockFile::acquire");
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto backoff = std::chrono::milliseconds(1);
+    while (true) {
+        fd = ::open(lockPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd >= 0) {
+            return;
+        }
+        if (errno != EEXIST) {
+            throw LockError("Unable to create '" + lockPath.string() + "': " + std::strerror(errno));
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            throw LockError("Unable to create '" + lockPath.string() + "': File exists.\n"
+                            "Another gitlet process seems to be running in this repository. "
+                            "If it crashed, remove the file manually.");
+        }
+        Trace::count("lock retries");
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, std::chrono::milliseconds(100));
+    }
+}
+
+LockFile::~LockFile() {
+    release();
+}
+
+const fs::path& LockFile::getTarget() const {
+    return target;
+}
+
+void LockFile::commit(const std::string& contents) {
+    if (fd < 0) {
+        throw LockError("lock on '" + target.string() + "' is not held");
+    }
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t n = ::write(fd, contents.data() + written, contents.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            release();
+            throw std::invalid_argument("could not write to file");
+        }
+        written += static_cast<size_t>(n);
+    }
+
+    Transaction* transaction = Transaction::current();
+    if (transaction == nullptr) {
+        ::fdatasync(fd);
+    }
+    ::close(fd);
+    fd = -1;
+    if (::rename(lockPath.c_str(), target.c_str()) != 0) {
+        ::unlink(lockPath.c_str());
+        throw std::invalid_argument("could not replace file");
+    }
+    if (transaction != nullptr) {
+        transaction->track(target);
+    } else {
+        Utils::syncParentDirectory(target);
+    }
+}
+
+void LockFile::release() {
+    if (fd >= 0) {
+        ::close(fd);
+        ::unlink(lockPath.c_str());
+        fd = -1;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef LOCKFILE_H
+#define LOCKFILE_H
+
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Raised when a lock cannot be taken before the timeout.
+class LockError : public std::runtime_error {
+public:
+    explicit LockError(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Exclusive lock on one repository file, taken by creating <file>.lock with
+// O_EXCL. The new contents are written into the lock file and commit()
+// renames it over the target, so the lock doubles as the atomic write.
+// Dropping the lock without committing leaves the target untouched.
+//
+// Only writers lock: readers never wait, because every published file is
+// replaced by a rename. Content-addressed objects need no lock at all,
+// since two processes writing the same id write the same bytes.
+class LockFile {
+public:
+    static constexpr std::chrono::milliseconds defaultTimeout{10000};
+
+    explicit LockFile(const fs::path& target, std::chrono::milliseconds timeout = defaultTimeout);
+    ~LockFile();
+
+    LockFile(const LockFile&) = delete;
+    LockFile& operator=(const LockFile&) = delete;
+
+    const fs::path& getTarget() const;
+
+    // Publishes contents as the new target and releases the lock.
+    void commit(const std::string& contents);
+    // Releases the lock without touching the target.
+    void release();
+
+private:
+    fs::path target;
+    fs::path lockPath;
+    int fd;
+};
+
+#endif // LOCKFILE_H
@@ -0,0 +1,112 @@
+#include "LooseIndex.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char indexMagic[4] = {'G', 'L', 'I', 'X'};
+const uint32_t formatVersion = 1;
+const size_t headerSize = 24;  // magic, version, mtime, count
+const int64_t racyNanoseconds = 2'000'000'000;
+}
+
+LooseIndex::LooseIndex(const fs::path& directory, const fs::path& indexPath, std::function<std::vector<ObjectId>()> list)
+    : directory(directory), indexPath(indexPath), list(std::move(list)), loaded(false),
+      mapped(nullptr), mappedSize(0), records(nullptr), count(0) {}
+
+LooseIndex::~LooseIndex() {
+    if (mapped != nullptr) {
+        ::munmap(const_cast<unsigned char*>(mapped), mappedSize);
+    }
+}
+
+std::vector<ObjectId> LooseIndex::match(const ObjectIdPrefix& prefix, size_t limit) {
+    load();
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (std::memcmp(records + mid * ObjectId::size, prefix.low.bytes.data(), ObjectId::size) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    std::vector<ObjectId> ids;
+    for (size_t i = lo; i < count && ids.size() < limit; i++) {
+        ObjectId id;
+        std::memcpy(id.bytes.data(), records + i * ObjectId::size, ObjectId::size);
+        if (!prefix.matches(id)) {
+            break;
+        }
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+size_t LooseIndex::size() {
+    load();
+    return count;
+}
+
+void LooseIndex::load() {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+    struct stat st;
+    if (::stat(directory.c_str(), &st) != 0) {
+        return;
+    }
+    int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+
+    int fd = ::open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        struct stat ist;
+        if (::fstat(fd, &ist) == 0 && static_cast<size_t>(ist.st_size) >= headerSize) {
+            void* m = ::mmap(nullptr, ist.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) {
+                mapped = static_cast<const unsigned char*>(m);
+                mappedSize = static_cast<size_t>(ist.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    if (mapped != nullptr && std::memcmp(mapped, indexMagic, 4) == 0 && Utils::get32(mapped + 4) == formatVersion
+        && Utils::get64(mapped + 8) != 0 && static_cast<int64_t>(Utils::get64(mapped + 8)) == mtime
+        && mappedSize == headerSize + Utils::get64(mapped + 16) * ObjectId::size) {
+        Trace::count("loose index hits");
+        records = mapped + headerSize;
+        count = static_cast<size_t>(Utils::get64(mapped + 16));
+        return;
+    }
+
+    Trace::count("loose index rebuilds");
+    for (const ObjectId& id : list()) {
+        built.append(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+    }
+    records = reinterpret_cast<const unsigned char*>(built.data());
+    count = built.size() / ObjectId::size;
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    int64_t nowNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    save(mtime > nowNanoseconds - racyNanoseconds ? 0 : mtime);
+}
+
+void LooseIndex::save(int64_t stamp) const {
+    std::string out(indexMagic, 4);
+    Utils::put32(out, formatVersion);
+    Utils::put64(out, static_cast<uint64_t>(stamp));
+    Utils::put64(out, count);
+    out += built;
+    try {
+        Utils::writeAtomic(indexPath, out.data(), out.size());
+    } catch (const std::exception&) {
+        // Without the file the next lookup lists the directory again.
+    }
+}
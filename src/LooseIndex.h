@@ -0,0 +1,52 @@
+#ifndef LOOSEINDEX_H
+#define LOOSEINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include "ObjectId.h"
+
+namespace fs = std::filesystem;
+
+// Sorted ids of the loose objects in one directory, so an abbreviation is
+// found by binary search instead of by listing the directory.
+//
+//   <name>   "GLIX", version, the directory's mtime in nanoseconds, count,
+//            then count sorted 20-byte ids
+//
+// Adding or removing an object changes the directory's mtime, so an index
+// stamped with the current mtime is complete and is used memory-mapped. One
+// that is stale is rebuilt from a listing and rewritten; as with the
+// untracked cache, a directory changed within the last two seconds is
+// stamped 0 so the next lookup lists it again.
+class LooseIndex {
+public:
+    // list returns the directory's ids, sorted.
+    LooseIndex(const fs::path& directory, const fs::path& indexPath, std::function<std::vector<ObjectId>()> list);
+    ~LooseIndex();
+
+    LooseIndex(const LooseIndex&) = delete;
+    LooseIndex& operator=(const LooseIndex&) = delete;
+
+    // Ids starting with prefix, sorted, at most limit of them.
+    std::vector<ObjectId> match(const ObjectIdPrefix& prefix, size_t limit);
+    size_t size();
+
+private:
+    fs::path directory;
+    fs::path indexPath;
+    std::function<std::vector<ObjectId>()> list;
+    bool loaded;
+    const unsigned char* mapped;
+    size_t mappedSize;
+    std::string built;
+    const unsigned char* records;
+    size_t count;
+
+    void load();
+    void save(int64_t stamp) const;
+};
+
+#endif // LOOSEINDEX_H
@@ -0,0 +1,75 @@
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <atomic>
+#include <mutex>
+
+namespace {
+std::atomic<uint64_t> budget{0};
+std::atomic<uint64_t> used{0};
+std::mutex directoryMutex;
+fs::path directory;
+
+void add(uint64_t bytes) {
+    uint64_t now = used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    Trace::peak("memory budget peak bytes", now);
+}
+
+void release(uint64_t bytes) {
+    used.fetch_sub(bytes, std::memory_order_relaxed);
+}
+}
+
+MemoryBudget::Charge::Charge(uint64_t bytes) : held(bytes) {
+    add(bytes);
+}
+
+MemoryBudget::Charge::~Charge() {
+    release(held);
+}
+
+MemoryBudget::Charge::Charge(Charge&& other) noexcept : held(other.held) {
+    other.held = 0;
+}
+
+MemoryBudget::Charge& MemoryBudget::Charge::operator=(Charge&& other) noexcept {
+    if (this != &other) {
+        release(held);
+        held = other.held;
+        other.held = 0;
+    }
+    return *this;
+}
+
+void MemoryBudget::Charge::resize(uint64_t bytes) {
+    if (bytes > held) {
+        add(bytes - held);
+    } else {
+        release(held - bytes);
+    }
+    held = bytes;
+}
+
+void MemoryBudget::configure(uint64_t limit, const fs::path& spillDirectory) {
+    budget = limit;
+    std::lock_guard<std::mutex> lock(directoryMutex);
+    directory = spillDirectory;
+}
+
+uint64_t MemoryBudget::limit() {
+    return budget;
+}
+
+bool MemoryBudget::limited() {
+    return budget != 0;
+}
+
+bool MemoryBudget::fits(uint64_t bytes) {
+    uint64_t limit = budget;
+    uint64_t now = used.load(std::memory_order_relaxed);
+    return limit == 0 || (now <= limit && bytes <= limit - now);
+}
+
+fs::path MemoryBudget::spillDirectory() {
+    std::lock_guard<std::mutex> lock(directoryMutex);
+    return directory.empty() ? fs::temp_directory_path() : directory;
+}
@@ -0,0 +1,46 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <cstdint>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// A limit on the memory held by gitlet's large buffers, set by
+// core.memoryBudget in bytes or with a k, m or g suffix; 0, the default,
+// is no limit. It is not enforced on the allocator: code that would hold a
+// whole file or a whole set of ids asks fits() first and, told no, streams
+// the data in pieces or spills it to files under spillDirectory() instead.
+// What it does hold it charges while holding it. The peak of the charged
+// total goes into the trace counters as "memory budget peak bytes", next
+// to the process's "peak resident bytes".
+class MemoryBudget {
+public:
+    // Holds bytes against the budget until destroyed.
+    class Charge {
+    public:
+        explicit Charge(uint64_t bytes = 0);
+        ~Charge();
+
+        Charge(Charge&& other) noexcept;
+        Charge& operator=(Charge&& other) noexcept;
+        Charge(const Charge&) = delete;
+        Charge& operator=(const Charge&) = delete;
+
+        // Changes the amount held to bytes.
+        void resize(uint64_t bytes);
+
+    private:
+        uint64_t held;
+    };
+
+    static void configure(uint64_t limit, const fs::path& spillDirectory);
+
+    static uint64_t limit();
+    static bool limited();
+    // Whether bytes more can be held without going over the limit.
+    static bool fits(uint64_t bytes);
+    static fs::path spillDirectory();
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,95 @@
+#ifndef OBJECTID_H
+#define OBJECTID_H
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Raw 20-byte SHA-1 naming a blob or commit. Used wherever many ids are held
+// at once, since it is a third the size of the 40-character hex form.
+struct ObjectId {
+    static constexpr size_t size = 20;
+    std::array<unsigned char, size> bytes{};
+
+    static std::optional<ObjectId> fromHex(std::string_view hex) {
+        if (hex.size() != size * 2) {
+            return std::nullopt;
+        }
+        ObjectId id;
+        for (size_t i = 0; i < size; i++) {
+            int hi = nibble(hex[2 * i]);
+            int lo = nibble(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                return std::nullopt;
+            }
+            id.bytes[i] = static_cast<unsigned char>(hi << 4 | lo);
+        }
+        return id;
+    }
+
+    std::string hex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(size * 2, '0');
+        for (size_t i = 0; i < size; i++) {
+            out[2 * i] = digits[bytes[i] >> 4];
+            out[2 * i + 1] = digits[bytes[i] & 0xf];
+        }
+        return out;
+    }
+
+    bool operator==(const ObjectId& other) const { return bytes == other.bytes; }
+    bool operator!=(const ObjectId& other) const { return bytes != other.bytes; }
+    bool operator<(const ObjectId& other) const { return bytes < other.bytes; }
+
+private:
+    static int nibble(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+};
+
+// Leading hex digits of an id, as typed for an abbreviation. low is the
+// smallest id with the prefix, so sorted ids matching it start at
+// lower_bound(low) and run while matches() holds.
+struct ObjectIdPrefix {
+    ObjectId low;
+    size_t digits = 0;
+
+    // Anything from one to 40 hex digits.
+    static std::optional<ObjectIdPrefix> fromHex(std::string_view hex) {
+        if (hex.empty() || hex.size() > ObjectId::size * 2) {
+            return std::nullopt;
+        }
+        std::string padded(hex);
+        padded.resize(ObjectId::size * 2, '0');
+        std::optional<ObjectId> id = ObjectId::fromHex(padded);
+        if (!id) {
+            return std::nullopt;
+        }
+        return ObjectIdPrefix{*id, hex.size()};
+    }
+
+    bool matches(const ObjectId& id) const {
+        size_t whole = digits / 2;
+        if (std::memcmp(id.bytes.data(), low.bytes.data(), whole) != 0) {
+            return false;
+        }
+        return digits % 2 == 0 || (id.bytes[whole] & 0xf0) == low.bytes[whole];
+    }
+};
+
+// Ids are already uniformly distributed, so their leading bytes are the hash.
+struct ObjectIdHash {
+    size_t operator()(const ObjectId& id) const {
+        size_t h;
+        std::memcpy(&h, id.bytes.data(), sizeof(h));
+        return h;
+    }
+};
+
+#endif // OBJECTID_H
@@ -0,0 +1,494 @@
+#include "ObjectStore.h"
+#include "IoEngine.h"
+#include "LooseIndex.h"
+#include "Trace.h"
+#include "Transaction.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char packMagic[4] = {'G', 'P', 'A', 'K'};
+const char indexMagic[4] = {'G', 'I', 'D', 'X'};
+const uint32_t formatVersion = 1;
+const size_t headerSize = 16;                               // magic, version, count
+const size_t packEntryHeaderSize = 1 + ObjectId::size + 8;  // type, id, size
+const size_t indexRecordSize = 40;                          // id, type, 3 padding, offset, size
+
+std::string header(const char magic[4], uint64_t count) {
+    std::string out(magic, 4);
+    Utils::put32(out, formatVersion);
+    Utils::put64(out, count);
+    return out;
+}
+
+// Maps a whole file read-only; returns nullptr for a missing or empty file.
+const void* mapFile(const fs::path& path, size_t& size) {
+    size = 0;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    const void* mapped = nullptr;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* m = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            mapped = m;
+            size = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    return mapped;
+}
+}
+
+ObjectStore::ObjectStore(const fs::path& gitletDir) : gitletDir(gitletDir) {}
+
+ObjectStore::~ObjectStore() = default;
+
+fs::path ObjectStore::looseDir(ObjectType type) const {
+    return gitletDir / (type == ObjectType::Blob ? "blobs" : "commits");
+}
+
+fs::path ObjectStore::loosePath(ObjectType type, const std::string& id) const {
+    return looseDir(type) / (id + ".txt");
+}
+
+fs::path ObjectStore::packsDir() const {
+    return gitletDir / "packs";
+}
+
+bool ObjectStore::has(ObjectType type, const std::string& id) const {
+    if (fs::exists(loosePath(type, id))) {
+        return true;
+    }
+    std::optional<ObjectId> raw = ObjectId::fromHex(id);
+    if (!raw) {
+        return false;
+    }
+    for (const auto& pack : packs()) {
+        std::optional<Entry> entry = pack->find(*raw);
+        if (entry && entry->type == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<std::vector<char>> ObjectStore::read(ObjectType type, const std::string& id) const {
+    GITLET_TRACE_SCOPE("ObjectStore::read");
+    fs::path path = loosePath(type, id);
+    std::ifstream loose(path, std::ios::binary);
+    if (loose) {
+        loose.close();
+        return Utils::readContents(path);
+    }
+    return readPacked(type, id);
+}
+
+std::optional<std::vector<char>> ObjectStore::readPacked(ObjectType type, const std::string& id) const {
+    std::optional<ObjectId> raw = ObjectId::fromHex(id);
+    if (!raw) {
+        return std::nullopt;
+    }
+    // An entry the pack does not hold, from an index that does not match
+    // its pack, is passed over rather than read out of bounds.
+    for (const auto& pack : packs()) {
+        std::optional<Entry> entry = pack->find(*raw);
+        if (entry && entry->type == type && pack->holds(*entry)) {
+            const char* data = pack->data(*entry);
+            Trace::count("bytes read", entry->size);
+            return std::vector<char>(data, data + entry->size);
+        }
+    }
+    return std::nullopt;
+}
+
+// Loose files that are missing cost one failed open each within the batch.
+std::vector<std::optional<std::vector<char>>> ObjectStore::readAll(ObjectType type, const std::vector<std::string>& ids,
+                                                                   IoEngine& io) const {
+    GITLET_TRACE_SCOPE("ObjectStore::readAll");
+    std::vector<fs::path> paths;
+    paths.reserve(ids.size());
+    for (const auto& id : ids) {
+        paths.push_back(loosePath(type, id));
+    }
+    std::vector<std::optional<std::vector<char>>> contents = io.readFiles(paths);
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (!contents[i]) {
+            contents[i] = readPacked(type, ids[i]);
+        }
+    }
+    return contents;
+}
+
+bool ObjectStore::writeLoose(ObjectType type, const std::string& id, const std::vector<char>& data) {
+    if (has(type, id)) {
+        return false;
+    }
+    Utils::writeContents(loosePath(type, id).string(), data);
+    return true;
+}
+
+std::string ObjectStore::writeLooseFrom(ObjectType type, const fs::path& source) {
+    std::string id = Utils::sha1(source);
+    if (has(type, id)) {
+        return id;
+    }
+    Utils::writeAtomic(loosePath(type, id), [&](const Utils::Sink& sink) {
+        Sha1Stream copied;
+        Utils::readInPieces(source, [&](const char* data, size_t size) {
+            copied.update(data, size);
+            sink(data, size);
+        });
+        if (copied.hex() != id) {
+            throw std::invalid_argument(source.string() + " changed while it was stored");
+        }
+    });
+    return id;
+}
+
+std::optional<uint64_t> ObjectStore::sizeOf(ObjectType type, const std::string& id) const {
+    std::error_code ec;
+    uintmax_t size = fs::file_size(loosePath(type, id), ec);
+    if (!ec) {
+        return size;
+    }
+    std::optional<ObjectId> raw = ObjectId::fromHex(id);
+    if (!raw) {
+        return std::nullopt;
+    }
+    for (const auto& pack : packs()) {
+        std::optional<Entry> entry = pack->find(*raw);
+        if (entry && entry->type == type) {
+            return entry->size;
+        }
+    }
+    return std::nullopt;
+}
+
+bool ObjectStore::readInPieces(ObjectType type, const std::string& id,
+                               const std::function<void(const char*, size_t)>& sink) const {
+    fs::path path = loosePath(type, id);
+    if (fs::exists(path)) {
+        Utils::readInPieces(path, sink);
+        return true;
+    }
+    std::optional<ObjectId> raw = ObjectId::fromHex(id);
+    if (!raw) {
+        return false;
+    }
+    for (const auto& pack : packs()) {
+        std::optional<Entry> entry = pack->find(*raw);
+        if (entry && entry->type == type && pack->holds(*entry)) {
+            const char* data = pack->data(*entry);
+            const uint64_t piece = 64 * 1024;
+            for (uint64_t done = 0; done < entry->size; done += piece) {
+                sink(data + done, static_cast<size_t>(std::min(piece, entry->size - done)));
+            }
+            Trace::count("bytes read", entry->size);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<ObjectId> ObjectStore::listLoose(ObjectType type) const {
+    GITLET_TRACE_SCOPE("ObjectStore::listLoose");
+    std::vector<ObjectId> ids;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(looseDir(type), ec)) {
+        if (entry.path().extension() != ".txt") {
+            continue;
+        }
+        std::optional<ObjectId> id = ObjectId::fromHex(entry.path().stem().string());
+        if (id) {
+            ids.push_back(*id);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+std::vector<ObjectId> ObjectStore::list(ObjectType type) const {
+    std::vector<ObjectId> ids = listLoose(type);
+    for (const auto& pack : packs()) {
+        for (size_t i = 0; i < pack->count(); i++) {
+            Entry entry = pack->entry(i);
+            if (entry.type == type) {
+                ids.push_back(entry.id);
+            }
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+std::vector<ObjectId> ObjectStore::matchPrefix(ObjectType type, const ObjectIdPrefix& prefix, size_t limit) const {
+    GITLET_TRACE_SCOPE("ObjectStore::matchPrefix");
+    // Each source's first limit matches hold the first limit of the union.
+    std::vector<ObjectId> ids = looseIndex(type).match(prefix, limit);
+    for (const auto& pack : packs()) {
+        size_t found = 0;
+        for (size_t i = pack->lowerBound(prefix.low); i < pack->count() && found < limit; i++) {
+            Entry entry = pack->entry(i);
+            if (!prefix.matches(entry.id)) {
+                break;
+            }
+            if (entry.type == type) {
+                ids.push_back(entry.id);
+                found++;
+            }
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    if (ids.size() > limit) {
+        ids.resize(limit);
+    }
+    return ids;
+}
+
+size_t ObjectStore::countBound(ObjectType type) const {
+    size_t count = looseIndex(type).size();
+    for (const auto& pack : packs()) {
+        count += pack->count();
+    }
+    return count;
+}
+
+LooseIndex& ObjectStore::looseIndex(ObjectType type) const {
+    std::unique_ptr<LooseIndex>& index = looseIndexes[type == ObjectType::Blob ? 0 : 1];
+    if (!index) {
+        fs::path directory = looseDir(type);
+        index = std::make_unique<LooseIndex>(directory, gitletDir / (directory.filename().string() + "-index"),
+                                             [this, type]() { return listLoose(type); });
+    }
+    return *index;
+}
+
+const std::vector<std::shared_ptr<ObjectStore::Pack>>& ObjectStore::packs() const {
+    if (!loadedPacks) {
+        loadedPacks.emplace();
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(packsDir(), ec)) {
+            if (entry.path().extension() == ".pack") {
+                auto pack = std::make_shared<Pack>(entry.path());
+                if (pack->valid()) {
+                    loadedPacks->push_back(pack);
+                }
+            }
+        }
+        std::sort(loadedPacks->begin(), loadedPacks->end(), [](const auto& a, const auto& b) {
+            return a->getPath() < b->getPath();
+        });
+    }
+    return *loadedPacks;
+}
+
+void ObjectStore::rescanPacks() {
+    loadedPacks.reset();
+    for (auto& index : looseIndexes) {
+        index.reset();
+    }
+}
+
+ObjectStore::Pack::Pack(const fs::path& packPath) : path(packPath), idx(nullptr), idxSize(0), pack(nullptr), packSize(0) {
+    pack = static_cast<const char*>(mapFile(path, packSize));
+    idx = static_cast<const unsigned char*>(mapFile(indexPath(), idxSize));
+}
+
+ObjectStore::Pack::~Pack() {
+    if (pack != nullptr) {
+        ::munmap(const_cast<char*>(pack), packSize);
+    }
+    if (idx != nullptr) {
+        ::munmap(const_cast<unsigned char*>(idx), idxSize);
+    }
+}
+
+const fs::path& ObjectStore::Pack::getPath() const {
+    return path;
+}
+
+fs::path ObjectStore::Pack::indexPath() const {
+    return fs::path(path).replace_extension(".idx");
+}
+
+bool ObjectStore::Pack::valid() const {
+    return pack != nullptr && idx != nullptr
+        && packSize >= headerSize && std::memcmp(pack, packMagic, 4) == 0
+        && idxSize >= headerSize && std::memcmp(idx, indexMagic, 4) == 0
+        && idxSize == headerSize + count() * indexRecordSize;
+}
+
+size_t ObjectStore::Pack::count() const {
+    return static_cast<size_t>(Utils::get64(idx + 8));
+}
+
+ObjectStore::Entry ObjectStore::Pack::entry(size_t index) const {
+    const unsigned char* record = idx + headerSize + index * indexRecordSize;
+    Entry entry;
+    std::memcpy(entry.id.bytes.data(), record, ObjectId::size);
+    entry.type = static_cast<ObjectType>(record[20]);
+    entry.offset = Utils::get64(record + 24);
+    entry.size = Utils::get64(record + 32);
+    return entry;
+}
+
+std::optional<ObjectStore::Entry> ObjectStore::Pack::find(const ObjectId& id) const {
+    size_t index = lowerBound(id);
+    if (index < count() && std::memcmp(id.bytes.data(), idx + headerSize + index * indexRecordSize, ObjectId::size) == 0) {
+        return entry(index);
+    }
+    return std::nullopt;
+}
+
+size_t ObjectStore::Pack::lowerBound(const ObjectId& id) const {
+    size_t lo = 0;
+    size_t hi = count();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const unsigned char* record = idx + headerSize + mid * indexRecordSize;
+        if (std::memcmp(record, id.bytes.data(), ObjectId::size) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const char* ObjectStore::Pack::data(const Entry& entry) const {
+    return pack + entry.offset;
+}
+
+bool ObjectStore::Pack::holds(const Entry& entry) const {
+    const size_t entryHeaderSize = 1 + ObjectId::size + 8;
+    if (entry.offset < headerSize + entryHeaderSize || entry.offset > packSize || entry.size > packSize - entry.offset) {
+        return false;
+    }
+    const char* header = pack + entry.offset - entryHeaderSize;
+    return static_cast<ObjectType>(header[0]) == entry.type
+        && std::memcmp(header + 1, entry.id.bytes.data(), ObjectId::size) == 0
+        && Utils::get64(reinterpret_cast<const unsigned char*>(header) + 1 + ObjectId::size) == entry.size;
+}
+
+ObjectStore::PackWriter::PackWriter(const fs::path& packsDir) : packsDir(packsDir), offset(0) {
+    static std::atomic<unsigned> sequence{0};
+    fs::create_directories(packsDir);
+    tmpPack = packsDir / ("tmp-pack-" + std::to_string(getpid()) + "-" + std::to_string(sequence++));
+    out.open(tmpPack, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::invalid_argument("could not open file for writing");
+    }
+    std::string head = header(packMagic, 0);
+    out.write(head.data(), head.size());
+    offset = head.size();
+}
+
+ObjectStore::PackWriter::~PackWriter() {
+    if (out.is_open()) {
+        out.close();
+        fs::remove(tmpPack);
+    }
+}
+
+void ObjectStore::PackWriter::add(ObjectType type, const ObjectId& id, const char* data, size_t size) {
+    std::string entryHeader(1, static_cast<char>(type));
+    entryHeader.append(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+    Utils::put64(entryHeader, size);
+    out.write(entryHeader.data(), entryHeader.size());
+    out.write(data, size);
+    offset += entryHeader.size();
+    entries.push_back({id, type, offset, size});
+    offset += size;
+    Trace::count("objects packed");
+}
+
+size_t ObjectStore::PackWriter::count() const {
+    return entries.size();
+}
+
+std::vector<char> ObjectStore::PackWriter::read(size_t index) {
+    const Entry& entry = entries.at(index);
+    out.flush();
+    std::ifstream in(tmpPack, std::ios::binary);
+    std::vector<char> data(entry.size);
+    if (!in.seekg(entry.offset) || !in.read(data.data(), data.size())) {
+        throw std::invalid_argument("could not read back " + entry.id.hex());
+    }
+    return data;
+}
+
+fs::path ObjectStore::PackWriter::finish() {
+    GITLET_TRACE_SCOPE("PackWriter::finish");
+    if (entries.empty()) {
+        out.close();
+        fs::remove(tmpPack);
+        return {};
+    }
+
+    std::string head = header(packMagic, entries.size());
+    out.seekp(0);
+    out.write(head.data(), head.size());
+    out.close();
+    if (!out) {
+        fs::remove(tmpPack);
+        throw std::invalid_argument("could not write to file");
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.id < b.id;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.id == b.id;
+    }), entries.end());
+
+    // The pack is named after the ids it holds.
+    std::vector<char> names;
+    names.reserve(entries.size() * ObjectId::size);
+    std::string index = header(indexMagic, entries.size());
+    for (const Entry& entry : entries) {
+        names.insert(names.end(), entry.id.bytes.begin(), entry.id.bytes.end());
+        index.append(reinterpret_cast<const char*>(entry.id.bytes.data()), ObjectId::size);
+        index += static_cast<char>(entry.type);
+        index.append(3, '\0');
+        Utils::put64(index, entry.offset);
+        Utils::put64(index, entry.size);
+    }
+    fs::path packPath = packsDir / ("pack-" + Utils::sha1(names) + ".pack");
+    fs::path indexPath = fs::path(packPath).replace_extension(".idx");
+
+    // Same name, same objects: a pack already there is kept as it is, since
+    // replacing it would leave its .idx describing the other layout for a
+    // while, to a crash or to a reader that opens it then.
+    if (Pack(packPath).valid()) {
+        fs::remove(tmpPack);
+        return packPath;
+    }
+
+    // Readers find packs by their .pack, so the .idx goes in place first and
+    // the .pack is never seen without its index.
+    Utils::writeAtomic(indexPath, index.data(), index.size());
+    Transaction* transaction = Transaction::current();
+    if (transaction == nullptr) {
+        int fd = ::open(tmpPack.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::fdatasync(fd);
+            ::close(fd);
+        }
+    }
+    fs::rename(tmpPack, packPath);
+    if (transaction != nullptr) {
+        transaction->track(packPath);
+    }
+    return packPath;
+}
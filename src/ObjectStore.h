@@ -0,0 +1,157 @@
+#ifndef OBJECTSTORE_H
+#define OBJECTSTORE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "ObjectId.h"
+
+namespace fs = std::filesystem;
+
+class IoEngine;
+class LooseIndex;
+
+enum class ObjectType : uint8_t {
+    Blob = 1,
+    Commit = 2,
+};
+
+// Storage for blobs and commits. An object is either loose, in
+// .gitlet/blobs/<id>.txt or .gitlet/commits/<id>.txt, or inside a pack under
+// .gitlet/packs. A pack is a pair of files:
+//
+//   pack-<name>.pack  "GPAK", version, count, then per object:
+//                     type (1 byte), id (20 bytes), size (8 bytes), contents
+//   pack-<name>.idx   "GIDX", version, count, then one fixed-size record per
+//                     object sorted by id: id, type, offset of the contents
+//                     in the pack, size
+//
+// Every entry in a .pack names itself, so a pack can be streamed on its own
+// and indexed by the receiver. Lookups check the loose file first and then
+// binary search each memory-mapped index. Abbreviations are matched the
+// same way, against the packs' indexes and a LooseIndex of the loose
+// objects.
+class ObjectStore {
+public:
+    class Pack;
+
+    struct Entry {
+        ObjectId id;
+        ObjectType type;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // Builds a pack one object at a time, so memory use does not depend on
+    // how much is packed. finish() writes the index and publishes both files.
+    class PackWriter {
+    public:
+        explicit PackWriter(const fs::path& packsDir);
+        ~PackWriter();
+
+        PackWriter(const PackWriter&) = delete;
+        PackWriter& operator=(const PackWriter&) = delete;
+
+        void add(ObjectType type, const ObjectId& id, const char* data, size_t size);
+        size_t count() const;
+        // Contents of the index-th object added, read back from the file.
+        std::vector<char> read(size_t index);
+        // Returns the path of the new .pack, or an empty path if nothing was added.
+        fs::path finish();
+
+    private:
+        fs::path packsDir;
+        fs::path tmpPack;
+        std::ofstream out;
+        std::vector<Entry> entries;
+        uint64_t offset;
+    };
+
+    explicit ObjectStore(const fs::path& gitletDir);
+    ~ObjectStore();
+
+    bool has(ObjectType type, const std::string& id) const;
+    std::optional<std::vector<char>> read(ObjectType type, const std::string& id) const;
+    // Reads many objects in one batch; nothing for an object not in the store.
+    std::vector<std::optional<std::vector<char>>> readAll(ObjectType type, const std::vector<std::string>& ids,
+                                                          IoEngine& io) const;
+
+    // Size of an object's contents, without reading them.
+    std::optional<uint64_t> sizeOf(ObjectType type, const std::string& id) const;
+    // Hands an object's contents to sink a piece at a time; false if the
+    // store does not have it.
+    bool readInPieces(ObjectType type, const std::string& id,
+                      const std::function<void(const char*, size_t)>& sink) const;
+
+    // Writes a loose object unless the store already has it. Objects are named
+    // by their contents, so this needs no lock. Returns whether it wrote.
+    bool writeLoose(ObjectType type, const std::string& id, const std::vector<char>& data);
+    // Stores a file as a loose object without holding it in memory, and
+    // returns its id. Throws if the file changes while it is copied.
+    std::string writeLooseFrom(ObjectType type, const fs::path& source);
+
+    fs::path loosePath(ObjectType type, const std::string& id) const;
+    fs::path looseDir(ObjectType type) const;
+    fs::path packsDir() const;
+
+    // Sorted ids of every loose object of a type.
+    std::vector<ObjectId> listLoose(ObjectType type) const;
+    // Sorted, de-duplicated ids of every object of a type, loose or packed.
+    std::vector<ObjectId> list(ObjectType type) const;
+    // The smallest limit ids of a type that start with prefix, sorted.
+    std::vector<ObjectId> matchPrefix(ObjectType type, const ObjectIdPrefix& prefix, size_t limit) const;
+    // At least how many objects of a type there are, from the indexes alone.
+    size_t countBound(ObjectType type) const;
+
+    const std::vector<std::shared_ptr<Pack>>& packs() const;
+    // Forgets the cached pack list and loose indexes after packs were added
+    // or removed.
+    void rescanPacks();
+
+private:
+    fs::path gitletDir;
+    mutable std::optional<std::vector<std::shared_ptr<Pack>>> loadedPacks;
+    mutable std::unique_ptr<LooseIndex> looseIndexes[2];
+
+    std::optional<std::vector<char>> readPacked(ObjectType type, const std::string& id) const;
+    LooseIndex& looseIndex(ObjectType type) const;
+};
+
+// A memory-mapped pack and its index.
+class ObjectStore::Pack {
+public:
+    explicit Pack(const fs::path& packPath);
+    ~Pack();
+
+    Pack(const Pack&) = delete;
+    Pack& operator=(const Pack&) = delete;
+
+    const fs::path& getPath() const;
+    fs::path indexPath() const;
+    bool valid() const;
+    size_t count() const;
+
+    std::optional<Entry> find(const ObjectId& id) const;
+    // Index of the first entry not less than id.
+    size_t lowerBound(const ObjectId& id) const;
+    Entry entry(size_t index) const;
+    // Contents of an entry; points into the mapping and lives as long as the pack.
+    const char* data(const Entry& entry) const;
+    // Whether an index entry lies inside the pack, after an entry header
+    // that agrees with it.
+    bool holds(const Entry& entry) const;
+
+private:
+    fs::path path;
+    const unsigned char* idx;
+    size_t idxSize;
+    const char* pack;
+    size_t packSize;
+};
+
+#endif // OBJECTSTORE_H
@@ -0,0 +1,280 @@
+#include "RefStore.h"
+#include "LockFile.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const std::string packedHeader = "# gitlet packed-refs\n";
+const size_t hashLength = 40;
+}
+
+// Read-only mapping of .gitlet/packed-refs; empty if the file does not exist.
+class RefStore::PackedFile {
+public:
+    explicit PackedFile(const fs::path& path) : data(nullptr), size(0) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const char*>(mapped);
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~PackedFile() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    PackedFile(const PackedFile&) = delete;
+    PackedFile& operator=(const PackedFile&) = delete;
+
+    // Offset of the first entry, past the header line.
+    size_t begin() const {
+        if (size >= packedHeader.size() && std::memcmp(data, packedHeader.data(), packedHeader.size()) == 0) {
+            return packedHeader.size();
+        }
+        return 0;
+    }
+
+    std::optional<std::string> find(const std::string& name) const {
+        GITLET_TRACE_SCOPE("RefStore::findPacked");
+        size_t lo = begin();
+        size_t hi = size;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            size_t lineStart = mid;
+            while (lineStart > lo && data[lineStart - 1] != '\n') {
+                lineStart--;
+            }
+            const char* newline = static_cast<const char*>(std::memchr(data + lineStart, '\n', size - lineStart));
+            size_t lineEnd = newline ? newline - data : size;
+            if (lineEnd < lineStart + hashLength + 1) {
+                return std::nullopt; // malformed line
+            }
+            std::string_view lineName(data + lineStart + hashLength + 1, lineEnd - lineStart - hashLength - 1);
+            int cmp = std::string_view(name).compare(lineName);
+            if (cmp == 0) {
+                return std::string(data + lineStart, hashLength);
+            } else if (cmp < 0) {
+                hi = lineStart;
+            } else {
+                lo = lineEnd + 1;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<std::pair<std::string, std::string>> entries() const {
+        std::vector<std::pair<std::string, std::string>> refs;
+        size_t pos = begin();
+        while (pos < size) {
+            const char* newline = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+            size_t lineEnd = newline ? newline - data : size;
+            if (lineEnd >= pos + hashLength + 1) {
+                refs.emplace_back(std::string(data + pos + hashLength + 1, lineEnd - pos - hashLength - 1),
+                                  std::string(data + pos, hashLength));
+            }
+            pos = lineEnd + 1;
+        }
+        return refs;
+    }
+
+private:
+    const char* data;
+    size_t size;
+};
+
+RefStore::RefStore(const fs::path& gitletDir) : gitletDir(gitletDir) {}
+
+std::string RefStore::head() const {
+    return Utils::readStringFromFile(gitletDir / "branches/HEAD.txt");
+}
+
+void RefStore::setHead(const std::string& branchName) {
+    LockFile lock(gitletDir / "branches/HEAD.txt");
+    lock.commit(branchName);
+}
+
+fs::path RefStore::loosePath(const std::string& branchName) const {
+    return gitletDir / "branches" / (branchName + ".txt");
+}
+
+std::optional<std::string> RefStore::resolve(const std::string& branchName) const {
+    if (branchName.empty() || branchName == "HEAD") {
+        return std::nullopt;
+    }
+    std::ifstream loose(loosePath(branchName));
+    if (loose) {
+        return std::string(std::istreambuf_iterator<char>(loose), std::istreambuf_iterator<char>());
+    }
+    return packedRefs().find(branchName);
+}
+
+bool RefStore::exists(const std::string& branchName) const {
+    return resolve(branchName).has_value();
+}
+
+bool RefStore::update(const std::string& branchName, const std::string& commitID,
+                      const std::optional<std::string>& expected) {
+    fs::path path = loosePath(branchName);
+    fs::create_directories(path.parent_path());
+    LockFile lock(path);
+    if (expected) {
+        packed.reset();
+        if (resolve(branchName).value_or("") != *expected) {
+            return false;
+        }
+    }
+    lock.commit(commitID);
+    return true;
+}
+
+bool RefStore::updateAll(const std::map<std::string, std::pair<std::string, std::string>>& moves) {
+    std::vector<std::unique_ptr<LockFile>> locks;
+    for (const auto& [branchName, move] : moves) {
+        fs::path path = loosePath(branchName);
+        fs::create_directories(path.parent_path());
+        locks.push_back(std::make_unique<LockFile>(path));
+    }
+    packed.reset();
+    for (const auto& [branchName, move] : moves) {
+        if (resolve(branchName).value_or("") != move.second) {
+            return false;
+        }
+    }
+    size_t i = 0;
+    for (const auto& [branchName, move] : moves) {
+        locks[i++]->commit(move.first);
+    }
+    return true;
+}
+
+// Locks the loose branch first and packed-refs second, the same order
+// update() and pack() use, so concurrent writers cannot deadlock.
+bool RefStore::remove(const std::string& branchName) {
+    fs::path path = loosePath(branchName);
+    std::optional<LockFile> looseLock;
+    if (fs::exists(path.parent_path())) {
+        looseLock.emplace(path);
+    }
+    bool removed = removeLoose(branchName);
+
+    LockFile packedLock(gitletDir / "packed-refs");
+    packed.reset();
+    if (packedRefs().find(branchName)) {
+        auto refs = packedRefs().entries();
+        refs.erase(std::remove_if(refs.begin(), refs.end(), [&](const auto& ref) {
+            return ref.first == branchName;
+        }), refs.end());
+        writePacked(packedLock, refs);
+        removed = true;
+    }
+    looseLock.reset();
+    pruneDirectories(branchName);
+    return removed;
+}
+
+std::vector<std::pair<std::string, std::string>> RefStore::list() const {
+    GITLET_TRACE_SCOPE("RefStore::list");
+    std::map<std::string, std::string> merged;
+    for (auto& [name, commitID] : packedRefs().entries()) {
+        merged[name] = commitID;
+    }
+    for (auto& [name, commitID] : listLoose()) {
+        merged[name] = commitID;
+    }
+    return {merged.begin(), merged.end()};
+}
+
+// Loose branches are pruned only if they still hold the value that was
+// packed, and only if their lock is free right now; a branch being updated
+// concurrently simply stays loose until the next pack.
+size_t RefStore::pack() {
+    LockFile packedLock(gitletDir / "packed-refs");
+    packed.reset();
+    auto loose = listLoose();
+    if (loose.empty()) {
+        return 0;
+    }
+    writePacked(packedLock, list());
+
+    size_t pruned = 0;
+    for (const auto& [name, commitID] : loose) {
+        try {
+            LockFile lock(loosePath(name), std::chrono::milliseconds(0));
+            if (Utils::readStringFromFile(loosePath(name)) != commitID) {
+                continue;
+            }
+            removeLoose(name);
+            pruned++;
+        } catch (const LockError&) {
+            continue;
+        }
+        pruneDirectories(name);
+    }
+    return pruned;
+}
+
+// Deletes a loose branch file. Its lock is still held, so the directories of
+// a nested name are left to pruneDirectories() once it is released.
+bool RefStore::removeLoose(const std::string& branchName) {
+    return fs::remove(loosePath(branchName));
+}
+
+// Removes the directories of a nested name (like remote/branch) that hold
+// nothing any more.
+void RefStore::pruneDirectories(const std::string& branchName) {
+    fs::path path = loosePath(branchName);
+    fs::path branchesDir = gitletDir / "branches";
+    std::error_code ec;
+    for (fs::path dir = path.parent_path(); dir != branchesDir && fs::is_empty(dir, ec); dir = dir.parent_path()) {
+        fs::remove(dir, ec);
+    }
+}
+
+const RefStore::PackedFile& RefStore::packedRefs() const {
+    if (!packed) {
+        packed = std::make_shared<PackedFile>(gitletDir / "packed-refs");
+    }
+    return *packed;
+}
+
+std::vector<std::pair<std::string, std::string>> RefStore::listLoose() const {
+    std::vector<std::pair<std::string, std::string>> refs;
+    fs::path branchesDir = gitletDir / "branches";
+    for (const auto& entry : fs::recursive_directory_iterator(branchesDir)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".txt") {
+            continue;
+        }
+        std::string name = fs::relative(entry.path(), branchesDir).replace_extension().generic_string();
+        if (name != "HEAD") {
+            refs.emplace_back(name, Utils::readStringFromFile(entry.path()));
+        }
+    }
+    return refs;
+}
+
+void RefStore::writePacked(LockFile& lock, const std::vector<std::pair<std::string, std::string>>& refs) {
+    std::string contents = packedHeader;
+    for (const auto& [name, commitID] : refs) {
+        contents += commitID + " " + name + "\n";
+    }
+    lock.commit(contents);
+    packed.reset();
+}
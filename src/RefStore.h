@@ -0,0 +1,69 @@
+#ifndef REFSTORE_H
+#define REFSTORE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <filesystem>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+// Branch storage. A branch is either a loose file .gitlet/branches/<name>.txt
+// holding its commit id, or a line "<commit id> <name>" in
+// .gitlet/packed-refs, which is kept sorted by name. A loose file overrides
+// the packed entry of the same name. Loose lookups cost one open, packed ones
+// a binary search over the memory-mapped file, and list() reads the packed
+// file once sequentially, so neither depends on how many branches there are.
+// HEAD.txt names the current branch and is always loose. Every write takes
+// the lock of the file it replaces (see LockFile); lookups take none.
+class LockFile;
+
+class RefStore {
+public:
+    explicit RefStore(const fs::path& gitletDir);
+
+    std::string head() const;
+    void setHead(const std::string& branchName);
+
+    // Commit id of a branch, if it exists.
+    std::optional<std::string> resolve(const std::string& branchName) const;
+    bool exists(const std::string& branchName) const;
+    // Points a branch at commitID under the branch's lock. With `expected`
+    // set, the update only happens if the branch still points there (an empty
+    // string meaning "does not exist"); returns whether it was applied.
+    bool update(const std::string& branchName, const std::string& commitID,
+                const std::optional<std::string>& expected = std::nullopt);
+    // update() with an expected commit for several branches at once: every
+    // branch's lock is taken, in name order, before any is checked, so
+    // either all move or, if one of them has moved meanwhile, none does.
+    // The moves are still one rename each, so a crash among them can leave
+    // some done. moves maps a branch to its new commit and the commit it
+    // must still point to. Returns whether they were applied.
+    bool updateAll(const std::map<std::string, std::pair<std::string, std::string>>& moves);
+    bool remove(const std::string& branchName);
+
+    // Every branch with its commit id, sorted by name.
+    std::vector<std::pair<std::string, std::string>> list() const;
+
+    // Moves every loose branch into packed-refs. Returns how many were packed.
+    size_t pack();
+
+    fs::path loosePath(const std::string& branchName) const;
+
+private:
+    class PackedFile;
+
+    fs::path gitletDir;
+    mutable std::shared_ptr<PackedFile> packed;
+
+    const PackedFile& packedRefs() const;
+    std::vector<std::pair<std::string, std::string>> listLoose() const;
+    bool removeLoose(const std::string& branchName);
+    void pruneDirectories(const std::string& branchName);
+    void writePacked(LockFile& lock, const std::vector<std::pair<std::string, std::string>>& refs);
+};
+
+#endif // REFSTORE_H
@@ -0,0 +1,292 @@
+#include "RenameDetector.h"
+#include "Task.h"
+#include "Trace.h"
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
+
+namespace {
+constexpr size_t pieceSize = 64;
+constexpr size_t rows = RenameDetector::hashes / RenameDetector::bands;
+constexpr size_t slice = 32;
+// Below this many source and destination pairs every pair is compared, so
+// small diffs do not depend on the LSH index finding pairs near the
+// threshold.
+constexpr size_t allPairs = 4096;
+
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+uint64_t hashBytes(std::string_view bytes) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : bytes) {
+        h = (h ^ c) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+const std::array<uint64_t, RenameDetector::hashes>& seeds() {
+    static const std::array<uint64_t, RenameDetector::hashes> values = []() {
+        std::array<uint64_t, RenameDetector::hashes> out{};
+        for (size_t i = 0; i < out.size(); i++) {
+            out[i] = mix(i + 1);
+        }
+        return out;
+    }();
+    return values;
+}
+
+template <typename Candidate>
+Task<void> sketchSlice(const RenameDetector::Loader& load, std::vector<Candidate>& candidates, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        std::vector<char> content = load(candidates[i].blobHash);
+        candidates[i].size = RenameDetector::sketch(content, candidates[i].sketch) ? content.size() : 0;
+    }
+    co_return;
+}
+}
+
+RenameDetector::RenameDetector(Loader load, Executor& executor, Detect detect, unsigned threshold)
+    : load(std::move(load)), executor(executor), detect(detect), threshold(std::min(threshold, 100u)) {}
+
+bool RenameDetector::sketch(const std::vector<char>& content, Sketch& out) {
+    out.fill(UINT64_MAX);
+    if (content.empty()) {
+        return false;
+    }
+    const std::array<uint64_t, hashes>& seed = seeds();
+    // A repeated piece counts once per occurrence, so the sets compared are
+    // really multisets.
+    std::unordered_map<uint64_t, uint32_t> seen;
+    std::string_view text(content.data(), content.size());
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t newline = text.find('\n', start);
+        size_t stop = std::min(newline == std::string_view::npos ? text.size() : newline + 1, start + pieceSize);
+        uint64_t piece = hashBytes(text.substr(start, stop - start));
+        uint64_t h = mix(piece ^ mix(seen[piece]++));
+        for (size_t i = 0; i < hashes; i++) {
+            out[i] = std::min(out[i], mix(h ^ seed[i]));
+        }
+        start = stop;
+    }
+    return true;
+}
+
+unsigned RenameDetector::similarity(const Sketch& a, const Sketch& b) {
+    size_t equal = 0;
+    for (size_t i = 0; i < hashes; i++) {
+        equal += a[i] == b[i];
+    }
+    return static_cast<unsigned>(equal * 100 / hashes);
+}
+
+void RenameDetector::sketchAll(std::vector<Candidate>& candidates) const {
+    GITLET_TRACE_SCOPE("sketch blobs");
+    std::vector<Future<void>> slices;
+    for (size_t begin = 0; begin < candidates.size(); begin += slice) {
+        size_t end = std::min(candidates.size(), begin + slice);
+        slices.push_back(spawn(executor, sketchSlice(load, candidates, begin, end)));
+    }
+    syncWait(whenAll(std::move(slices)));
+    Trace::count("blobs sketched", candidates.size());
+}
+
+std::vector<FileChange> RenameDetector::diff(const Blobs& before, const Blobs& after) const {
+    std::vector<FileChange> changes;
+    std::vector<std::string> deleted;
+    std::vector<std::string> added;
+    for (const auto& [path, blobHash] : before) {
+        auto it = after.find(path);
+        if (it == after.end()) {
+            deleted.push_back(path);
+        } else if (it->second != blobHash) {
+            changes.push_back({FileChange::Kind::Modified, path, "", 0});
+        }
+    }
+    for (const auto& [path, blobHash] : after) {
+        if (before.find(path) == before.end()) {
+            added.push_back(path);
+        }
+    }
+    std::sort(deleted.begin(), deleted.end());
+    std::sort(added.begin(), added.end());
+    bool copies = detect == Detect::Copies;
+
+    // Exact matches: deleted sources first, so they become renames.
+    std::unordered_map<std::string, std::vector<std::string>> sourcesByBlob;
+    for (const auto& path : deleted) {
+        sourcesByBlob[before.at(path)].push_back(path);
+    }
+    if (copies) {
+        std::vector<std::string> kept;
+        for (const auto& [path, blobHash] : before) {
+            if (after.find(path) != after.end()) {
+                kept.push_back(path);
+            }
+        }
+        std::sort(kept.begin(), kept.end());
+        for (const auto& path : kept) {
+            sourcesByBlob[before.at(path)].push_back(path);
+        }
+    }
+    std::unordered_set<std::string> renamed;
+    std::vector<std::string> unmatched;
+    for (const auto& path : added) {
+        if (detect == Detect::Nothing) {
+            unmatched.push_back(path);
+            continue;
+        }
+        auto it = sourcesByBlob.find(after.at(path));
+        const std::string* rename = nullptr;
+        if (it != sourcesByBlob.end()) {
+            for (const auto& source : it->second) {
+                if (after.find(source) == after.end() && renamed.find(source) == renamed.end()) {
+                    rename = &source;
+                    break;
+                }
+            }
+        }
+        if (rename) {
+            renamed.insert(*rename);
+            changes.push_back({FileChange::Kind::Renamed, path, *rename, 100});
+        } else if (copies && it != sourcesByBlob.end()) {
+            changes.push_back({FileChange::Kind::Copied, path, it->second.front(), 100});
+        } else {
+            unmatched.push_back(path);
+        }
+    }
+
+    // Similar matches among what is left.
+    std::vector<Candidate> candidates;
+    for (const auto& path : deleted) {
+        if (copies || renamed.find(path) == renamed.end()) {
+            candidates.push_back({path, before.at(path), 0, false, {}});
+        }
+    }
+    if (copies) {
+        for (const auto& [path, blobHash] : before) {
+            if (after.find(path) != after.end()) {
+                candidates.push_back({path, blobHash, 0, true, {}});
+            }
+        }
+    }
+    size_t sources = candidates.size();
+    for (const auto& path : unmatched) {
+        candidates.push_back({path, after.at(path), 0, false, {}});
+    }
+    std::vector<char> taken(candidates.size(), 0);
+    if (detect != Detect::Nothing && threshold > 0 && sources > 0 && candidates.size() > sources) {
+        sketchAll(candidates);
+
+        bool everyPair = sources * (candidates.size() - sources) <= allPairs;
+        std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+        auto bandKey = [](const Sketch& sketch, size_t band) {
+            uint64_t key = mix(band);
+            for (size_t r = band * rows; r < (band + 1) * rows; r++) {
+                key = mix(key ^ sketch[r]);
+            }
+            return key;
+        };
+        for (size_t i = 0; i < sources && !everyPair; i++) {
+            if (candidates[i].size > 0) {
+                for (size_t band = 0; band < bands; band++) {
+                    buckets[bandKey(candidates[i].sketch, band)].push_back(i);
+                }
+            }
+        }
+
+        struct Pair {
+            unsigned score;
+            size_t destination;
+            size_t source;
+        };
+        std::vector<Pair> pairs;
+        std::vector<size_t> near;
+        for (size_t d = sources; d < candidates.size(); d++) {
+            const Candidate& destination = candidates[d];
+            if (destination.size == 0) {
+                continue;
+            }
+            near.clear();
+            if (everyPair) {
+                for (size_t s = 0; s < sources; s++) {
+                    if (candidates[s].size > 0) {
+                        near.push_back(s);
+                    }
+                }
+            } else {
+                for (size_t band = 0; band < bands; band++) {
+                    auto it = buckets.find(bandKey(destination.sketch, band));
+                    if (it != buckets.end()) {
+                        near.insert(near.end(), it->second.begin(), it->second.end());
+                    }
+                }
+                std::sort(near.begin(), near.end());
+                near.erase(std::unique(near.begin(), near.end()), near.end());
+            }
+            for (size_t s : near) {
+                const Candidate& source = candidates[s];
+                // Files of very different sizes cannot share most of their
+                // content.
+                size_t small = std::min(source.size, destination.size);
+                size_t large = std::max(source.size, destination.size);
+                if (small * 100 < large * threshold) {
+                    continue;
+                }
+                // Different blobs are never reported as identical.
+                unsigned score = std::min(similarity(source.sketch, destination.sketch), 99u);
+                if (score >= threshold) {
+                    pairs.push_back({score, d, s});
+                }
+            }
+            Trace::count("rename pairs compared", near.size());
+        }
+        std::sort(pairs.begin(), pairs.end(), [&](const Pair& a, const Pair& b) {
+            if (a.score != b.score) {
+                return a.score > b.score;
+            }
+            if (candidates[a.destination].path != candidates[b.destination].path) {
+                return candidates[a.destination].path < candidates[b.destination].path;
+            }
+            if (candidates[a.source].present != candidates[b.source].present) {
+                return !candidates[a.source].present;
+            }
+            return candidates[a.source].path < candidates[b.source].path;
+        });
+        for (const Pair& pair : pairs) {
+            if (taken[pair.destination]) {
+                continue;
+            }
+            const Candidate& source = candidates[pair.source];
+            const std::string& path = candidates[pair.destination].path;
+            if (!source.present && renamed.insert(source.path).second) {
+                changes.push_back({FileChange::Kind::Renamed, path, source.path, pair.score});
+            } else if (copies) {
+                changes.push_back({FileChange::Kind::Copied, path, source.path, pair.score});
+            } else {
+                continue;
+            }
+            taken[pair.destination] = 1;
+        }
+    }
+
+    for (size_t d = sources; d < candidates.size(); d++) {
+        if (!taken[d]) {
+            changes.push_back({FileChange::Kind::Added, candidates[d].path, "", 0});
+        }
+    }
+    for (const auto& path : deleted) {
+        if (renamed.find(path) == renamed.end()) {
+            changes.push_back({FileChange::Kind::Deleted, path, "", 0});
+        }
+    }
+    std::sort(changes.begin(), changes.end(), [](const FileChange& a, const FileChange& b) {
+        return a.path != b.path ? a.path < b.path : a.kind < b.kind;
+    });
+    return changes;
+}
@@ -0,0 +1,76 @@
+#ifndef RENAMEDETECTOR_H
+#define RENAMEDETECTOR_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Executor;
+
+// One path's change between two commits.
+struct FileChange {
+    enum class Kind { Added, Deleted, Modified, Renamed, Copied };
+    Kind kind;
+    std::string path;   // the path after, or the deleted path
+    std::string from;   // the source path of a rename or copy
+    unsigned score = 0; // percent similarity of a rename or copy
+};
+
+// Pairs deleted (and, for copies, all earlier) files with added ones.
+//
+// Identical blobs pair first, by id. The rest are compared by MinHash: a
+// blob's content is cut into lines, and into 64-byte pieces within long
+// lines, each piece hashed with its occurrence count, and the sketch keeps
+// the least value of each of 64 hash functions over them. The fraction of
+// equal entries in two sketches estimates the Jaccard similarity of their
+// contents. Sketches are computed in parallel on the executor, and instead
+// of comparing every pair, an LSH index buckets each source by 16 bands of
+// 4 entries: only files sharing a bucket are compared, which finds pairs
+// around 50% similar or more with high probability. Small diffs, up to 4096
+// pairs, compare every pair.
+//
+// Pairs at or above the threshold are taken best first. The first pairing
+// of a deleted file is a rename; when copies are detected, further
+// pairings, and pairings with files that still exist, are copies.
+class RenameDetector {
+public:
+    enum class Detect { Nothing, Renames, Copies };
+    using Blobs = std::unordered_map<std::string, std::string>;
+    // Reads a blob by id; called from several threads at once.
+    using Loader = std::function<std::vector<char>(const std::string& blobHash)>;
+
+    RenameDetector(Loader load, Executor& executor, Detect detect = Detect::Renames, unsigned threshold = 50);
+
+    // Changes from `before` to `after`, both path to blob id, sorted by path.
+    std::vector<FileChange> diff(const Blobs& before, const Blobs& after) const;
+
+    static constexpr size_t hashes = 64;
+    static constexpr size_t bands = 16;
+    using Sketch = std::array<uint64_t, hashes>;
+    // A blob's sketch; false for empty content, which is never paired by
+    // similarity.
+    static bool sketch(const std::vector<char>& content, Sketch& out);
+    // Percent of equal entries.
+    static unsigned similarity(const Sketch& a, const Sketch& b);
+
+private:
+    Loader load;
+    Executor& executor;
+    Detect detect;
+    unsigned threshold;
+
+    struct Candidate {
+        std::string path;
+        std::string blobHash;
+        size_t size = 0;
+        bool present = false;
+        Sketch sketch{};
+    };
+    // Loads and sketches every candidate, in parallel.
+    void sketchAll(std::vector<Candidate>& candidates) const;
+};
+
+#endif // RENAMEDETECTOR_H
@@ -14,19 +14,33 @@
 #include <vector>
 #include <queue>
 #include <algorithm>
+#include <mutex>
+#include <optional>
 
 namespace fs = std::filesystem;
 
 #include "Utils.h" 
+#include "Trace.h"
+#include "Transaction.h"
+#include "Transport.h"
+#include "UntrackedFiles.h"
+#include "Watcher.h"
+
+namespace {
+// Shorter abbreviations are taken as names, never as ids.
+const size_t minimumAbbreviation = 4;
+}
+
+Repo::Repo() : Repo(fs::current_path()) {}
 
-Repo::Repo() {
-    workingDir = fs::current_path();
+Repo::Repo(const fs::path& dir) : refs(dir / ".gitlet"), objects(dir / ".gitlet"), config(dir / ".gitlet"), sparse(dir / ".gitlet"), shallow(dir / ".gitlet"), lfs(dir / ".gitlet", config) {
+    workingDir = dir;
     deserializeStage();
-    HEAD = Utils::readStringFromFile(workingDir / ".gitlet/branches/HEAD.txt");
+    HEAD = refs.head();
 }
 
 void Repo::init() {
-    fs::path repoPath = fs::current_path() / ".gitlet";
+    fs::path repoPath = workingDir / ".gitlet";
     fs::path blobsPath = repoPath / "blobs";
     fs::path commitsPath = repoPath / "commits";
     fs::path branchesPath = repoPath / "branches";
@@ -49,27 +63,25 @@ void Repo::init() {
     // Create the initial commit
     Commit initialCommit("initial commit", {}, ""); // Assuming constructor parameters match this signature
     std::string commitHash = initialCommit.getOwnHash(); // Assuming Commit objects can compute their own hash
-    serializeCommit(initialCommit, commitsPath / (commitHash + ".txt"));
+    storeCommit(initialCommit);
 
     // Set the master branch to point to the initial commit
     fs::path masterBranchPath = branchesPath / "master.txt";
-    std::ofstream masterFile(masterBranchPath.string());
-    if (!masterFile) {
+    try {
+        Utils::writeStringToFile(commitHash, masterBranchPath.string(), true);
+    } catch (const std::invalid_argument&) {
         std::cerr << "Failed to create the master branch file." << std::endl;
         return;
     }
-    masterFile << commitHash;
-    masterFile.close();
 
     // Set the HEAD to point to the master branch
     fs::path headPath = branchesPath / "HEAD.txt";
-    std::ofstream headFile(headPath.string());
-    if (!headFile) {
+    try {
+        Utils::writeStringToFile("master", headPath.string(), true);
+    } catch (const std::invalid_argument&) {
         std::cerr << "Failed to set the HEAD." << std::endl;
         return;
     }
-    headFile << "master";
-    headFile.close();
 
     // Initialize an empty staging area
     stage = StagingArea(); // Assuming 'stage' is a member of Repo and StagingArea has a default constructor
@@ -78,8 +90,7 @@ void Repo::init() {
     std::cout << "Initialized an empty gitlet repository in " << fs::absolute(repoPath) << std::endl;
 
     // Create the global log file
-    std::ofstream globalLogFile(globalLogPath / "gl.txt");
-    globalLogFile.close();
+    Utils::writeStringToFile("", globalLogPath / "gl.txt", true);
 
 }
 
@@ -90,36 +101,220 @@ std::string Repo::getHEAD() const {
 StagingArea Repo::getStage() const {
     return stage;
 }
-//if added file is . add all regular file in the flat non-recursive dir
-//except Gitlet itself and .gitlet directory    
+//if added file is . add every changed tracked file and every untracked file
+//that .gitletignore does not exclude, inside the sparse set
 void Repo::add(const std::string& fileName) {
+    StageLock lock(*this);
     if (fileName == ".") {
-        for (const auto& file : fs::directory_iterator(workingDir)) {
-            if (fs::is_regular_file(file) && file.path().extension() != ".gitlet" && file.path().filename() != "Gitlet") {
-                //slicing only the filename from the path
-                add(file.path().filename().string());
+        // Only files that differ from their tracked version are staged.
+        std::unordered_map<std::string, std::string> tracked = trackedFiles();
+        UntrackedFiles untracked(workingDir);
+        std::vector<std::string> files;
+        for (const auto& list : {workingTreeChanges(tracked).modified, untracked.list(tracked)}) {
+            for (const auto& file : list) {
+                if (sparse.includes(file)) {
+                    files.push_back(file);
+                }
             }
         }
+        stageFiles(files);
+    } else if (!stageFile(fileName)) {
+        return;
+    }
+    if (!lfs.upload()) {
+        std::cout << "Could not send large files to " << lfs.location() << "." << std::endl;
+        return;
+    }
+    serializeStage();
+}
+
+// Stores the file as a blob and records it in the in-memory stage. Blobs are
+// named by their contents, so they are written without taking any lock.
+bool Repo::stageFile(const std::string& fileName) {
+    if (!fs::exists(workingDir / fileName)) {
+        std::cout << "File does not exist." << std::endl;
+        return false;
+    }
+
+    fs::path file = workingDir / fileName;
+    if (!lfs.tracks(fileName) && !MemoryBudget::fits(fs::file_size(file))) {
+        stage.add(fileName, objects.writeLooseFrom(ObjectType::Blob, file));
+        return true;
+    }
+    std::vector<char> blob = stagedBlob(fileName);
+    MemoryBudget::Charge held(blob.size());
+    std::string sha1 = Utils::sha1(blob);
+    objects.writeLoose(ObjectType::Blob, sha1, blob);
+
+    stage.add(fileName, sha1);
+    return true;
+}
+
+std::vector<char> Repo::stagedBlob(const std::string& fileName) {
+    if (lfs.tracks(fileName)) {
+        return LfsStore::format(lfs.store(workingDir / fileName));
+    }
+    return Utils::readContents(workingDir / fileName);
+}
+
+std::string Repo::workingBlobHash(const std::string& fileName) const {
+    if (lfs.tracks(fileName)) {
+        return Utils::sha1(LfsStore::format(lfs.pointerFor(workingDir / fileName)));
+    }
+    return Utils::sha1(workingDir / fileName);
+}
+
+// A large file pointer is a few lines, so a blob over the budget is never
+// one and is copied as it is.
+void Repo::writeWorkingFile(const std::string& fileName, const std::string& blobHash) {
+    if (overBudget(blobHash)) {
+        Utils::writeAtomic(workingDir / fileName, [&](const Utils::Sink& sink) {
+            if (!objects.readInPieces(ObjectType::Blob, blobHash, sink)) {
+                throw std::invalid_argument("missing blob " + blobHash);
+            }
+        });
+        return;
+    }
+    std::vector<char> blob = readBlob(blobHash);
+    MemoryBudget::Charge held(blob.size());
+    std::optional<LfsStore::Pointer> pointer = LfsStore::parse(blob);
+    if (pointer) {
+        materializeLarge({{workingDir / fileName, *pointer}});
     } else {
-        if (!fs::exists(workingDir / fileName)) {
-            std::cout << "File does not exist." << std::endl;
-            return;
-        }
+        Utils::writeContents(workingDir / fileName, blob);
+    }
+}
+
+bool Repo::overBudget(const std::string& blobHash) const {
+    std::optional<uint64_t> size = objects.sizeOf(ObjectType::Blob, blobHash);
+    return size && !MemoryBudget::fits(*size);
+}
 
-        std::vector<char> fileContents = Utils::readContents(workingDir / fileName);
-        std::string sha1 = Utils::sha1(fileContents);
-        std::string blobPath = (workingDir / ".gitlet/blobs" / (sha1 + ".txt")).string();
-        if (!fs::exists(blobPath)) {
-            Utils::writeContents(blobPath, fileContents);
+void Repo::materializeLarge(const std::vector<std::pair<fs::path, LfsStore::Pointer>>& files) {
+    if (files.empty()) {
+        return;
+    }
+    for (const fs::path& path : lfs.materialize(files, executor())) {
+        std::cout << "Large file content for " << fs::relative(path, workingDir).string()
+                  << " is not in the store; its pointer was written instead." << std::endl;
+    }
+}
+
+
+void Repo::stageFiles(const std::vector<std::string>& names) {
+    GITLET_TRACE_SCOPE("Repo::stageFiles");
+    // Large files, and files the memory budget has no room for, are
+    // streamed one at a time instead of being read whole.
+    std::vector<std::string> fileNames;
+    for (const auto& fileName : names) {
+        std::error_code ec;
+        uintmax_t size = fs::file_size(workingDir / fileName, ec);
+        if (!lfs.tracks(fileName) && (ec || MemoryBudget::fits(size))) {
+            fileNames.push_back(fileName);
+        } else if (fs::is_regular_file(workingDir / fileName)) {
+            stageFile(fileName);
+        }
+    }
+    IoEngine& engine = ioEngine();
+    auto read = [&](size_t begin, size_t end, IoEngine& reader) {
+        std::vector<fs::path> paths;
+        for (size_t i = begin; i < end; i++) {
+            paths.push_back(workingDir / fileNames[i]);
         }
+        return reader.readFiles(paths);
+    };
+    // Hashing and writing one batch's blobs overlaps reading the next.
+    auto consume = [&](size_t begin, Contents& contents) {
+        uint64_t bytes = 0;
+        for (const auto& content : contents) {
+            bytes += content ? content->size() : 0;
+        }
+        MemoryBudget::Charge held(bytes);
+        std::vector<std::string> hashes(contents.size());
+        std::vector<IoEngine::Write> writes;
+        std::unordered_set<std::string> writing;
+        for (size_t i = 0; i < contents.size(); i++) {
+            if (!contents[i]) {
+                continue;
+            }
+            hashes[i] = Utils::sha1(*contents[i]);
+            if (!objects.has(ObjectType::Blob, hashes[i]) && writing.insert(hashes[i]).second) {
+                writes.push_back({objects.loosePath(ObjectType::Blob, hashes[i]), contents[i]->data(), contents[i]->size()});
+            }
+        }
+        engine.writeFiles(writes);
+        for (size_t i = 0; i < contents.size(); i++) {
+            if (contents[i]) {
+                stage.add(fileNames[begin + i], hashes[i]);
+            }
+        }
+    };
+    syncWait(pipelineReads(fileNames.size(), read, consume));
+}
 
-        stage.add(fileName, sha1);
-        serializeStage();
+IoEngine& Repo::ioEngine() const {
+    if (!io) {
+        io = makeIoEngine();
     }
+    return *io;
 }
 
+std::unique_ptr<IoEngine> Repo::makeIoEngine() const {
+    long long depth = std::clamp(config.getInt("core.ioQueueDepth", 256), 1LL, 4096LL);
+    return std::make_unique<IoEngine>(config.getString("core.ioEngine", "auto"), static_cast<unsigned>(depth));
+}
+
+Executor& Repo::executor() const {
+    if (!exec) {
+        long long threads = std::clamp(config.getInt("core.executorThreads", 0), 0LL, 256LL);
+        exec = Executor::create(config.getString("core.executor", "threads"), static_cast<unsigned>(threads));
+    }
+    return *exec;
+}
+
+namespace {
+Task<std::vector<std::optional<std::vector<char>>>> readBatch(
+    const std::function<std::vector<std::optional<std::vector<char>>>(size_t, size_t, IoEngine&)>& read,
+    size_t begin, size_t end, IoEngine& engine) {
+    co_return read(begin, end, engine);
+}
+}
+
+Task<void> Repo::pipelineReads(size_t count, std::function<Contents(size_t, size_t, IoEngine&)> read,
+                               std::function<void(size_t, Contents&)> consume) const {
+    // Packs are loaded here, before the reads and consume can race to.
+    objects.packs();
+    std::unique_ptr<IoEngine> reader = makeIoEngine();
+    size_t batch = reader->depth();
+    auto start = [&](size_t begin) {
+        return spawn(executor(), readBatch(read, begin, std::min(count, begin + batch), *reader));
+    };
+
+    Future<Contents> next;
+    if (count > 0) {
+        next = start(0);
+    }
+    std::exception_ptr failure;
+    for (size_t begin = 0; begin < count && !failure; begin += batch) {
+        try {
+            Contents contents = co_await next;
+            if (begin + batch < count) {
+                next = start(begin + batch);
+            }
+            consume(begin, contents);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+    }
+    if (failure) {
+        // A read in flight still uses reader and read.
+        co_await next.settled();
+        std::rethrow_exception(failure);
+    }
+}
 
 void Repo::commitment(const std::string& msg) {
+    StageLock lock(*this);
     if (stage.getAddedFiles().empty() && stage.getRemovedFiles().empty()) {
         std::cout << "No changes added to the commit." << std::endl;
         return;
@@ -138,22 +333,19 @@ void Repo::commitment(const std::string& msg) {
     }
 
     Commit newCommit(msg, copiedBlobs, curr.getOwnHash());
-    std::string commitPathString = (workingDir / ".gitlet/commits" / (newCommit.getOwnHash() + ".txt")).string();
-    std::ofstream ofs(commitPathString);
-    boost::archive::text_oarchive oa(ofs);
-    oa << newCommit;
-    ofs.close();
+    storeCommit(newCommit);
 
-    std::string branchPathString = (workingDir / ".gitlet/branches" / (HEAD + ".txt")).string();
-    std::ofstream branchFile(branchPathString);
-    branchFile << newCommit.getOwnHash();
-    branchFile.close();
+    if (!refs.update(HEAD, newCommit.getOwnHash(), curr.getOwnHash())) {
+        std::cout << "Branch " << HEAD << " was updated by another process; commit again." << std::endl;
+        return;
+    }
 
     stage.clear();
     serializeStage();
 }
 
 void Repo::rm(const std::string& fileName) {
+    StageLock lock(*this);
     bool isStaged = (stage.getAddedFiles().find(fileName) != stage.getAddedFiles().end());
     Commit curr = getCurrentCommit();
     bool isTracked = (curr.getBlobs().find(fileName) != curr.getBlobs().end());
@@ -173,131 +365,237 @@ void Repo::rm(const std::string& fileName) {
     }
 }
 
-void Repo::log() const {
-    //always show all commits
-    Commit curr = getCurrentCommit();
-    while (!curr.getOwnHash().empty()) {
-        std::cout << curr.globalLog();
-        if (curr.getParentHash().empty()) {
+History Repo::log(const LogOptions& options) const {
+    return History(*this, refs.resolve(HEAD).value_or(""), options);
+}
+
+std::vector<Commit> Repo::logAll(const LogOptions& options) const {
+    std::vector<std::string> tips;
+    for (const auto& [branchName, commitID] : refs.list()) {
+        tips.push_back(commitID);
+    }
+    std::vector<Commit> shown;
+    long skipped = 0;
+    // Returns whether later commits could still be shown.
+    auto consider = [&](const Commit& commit) {
+        if (options.maxCount >= 0 && static_cast<long>(shown.size()) >= options.maxCount) {
+            return false;
+        }
+        if (!options.since.empty() && commit.getDatetime() < options.since) {
+            return false;
+        }
+        if ((!options.until.empty() && commit.getDatetime() > options.until) ||
+            (!options.path.empty() && !changes(commit, options.path)) || skipped++ < options.skip) {
+            return true;
+        }
+        shown.push_back(commit);
+        return true;
+    };
+    // A bounded log reads commits newest first only until it is done; the
+    // whole history is faster read on every thread at once.
+    if (options.maxCount >= 0 || !options.since.empty()) {
+        commitWalker().newestFirst(tips, consider);
+        return shown;
+    }
+    for (const Commit& commit : commitWalker().history(tips)) {
+        if (!consider(commit)) {
             break;
         }
-        curr = deserializeCommit(workingDir / ".gitlet/commits" / (curr.getParentHash() + ".txt"));
     }
+    return shown;
 }
 
-void Repo::global() const {
-    std::ifstream inFile(workingDir / ".gitlet/global-log/gl.txt");
-    std::string line;
-    while (std::getline(inFile, line)) {
-        std::cout << line << std::endl;
-    }
+std::vector<Commit> Repo::global() const {
+    std::mutex mutex;
+    std::vector<Commit> commits;
+    commitWalker().forEach(objects.list(ObjectType::Commit), [&](const Commit& commit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        commits.push_back(commit);
+    });
+    std::sort(commits.begin(), commits.end(), [](const Commit& a, const Commit& b) {
+        if (a.getDatetime() != b.getDatetime()) {
+            return a.getDatetime() > b.getDatetime();
+        }
+        return a.getOwnHash() < b.getOwnHash();
+    });
+    return commits;
 }
 
-void Repo::find(const std::string& msg) const {
-    bool found = false;
-    for (const auto& entry : fs::directory_iterator(workingDir / ".gitlet/commits")) {
-        Commit currCommit = deserializeCommit(entry.path());
-        if (currCommit.getMessage() == msg) {
-            std::cout << currCommit.getOwnHash() << std::endl;
-            found = true;
+std::vector<std::string> Repo::find(const std::string& msg) const {
+    GITLET_TRACE_SCOPE("scan commits");
+    std::mutex mutex;
+    std::vector<std::string> found;
+    commitWalker().forEach(objects.list(ObjectType::Commit), [&](const Commit& commit) {
+        if (commit.getMessage() == msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            found.push_back(commit.getOwnHash());
         }
-    }
-    if (!found) {
-        std::cout << "Found no commit with that message." << std::endl;
-    }
+    });
+    std::sort(found.begin(), found.end());
+    return found;
 }
 
-void Repo::status() const {
-    // List branches
-    std::vector<std::string> branches;
-    for (const auto& entry : fs::directory_iterator(workingDir / ".gitlet/branches")) {
-        std::string branchName = entry.path().filename().string();
-        if (branchName != "HEAD.txt") {
-            branches.push_back(branchName == HEAD ? "*" + branchName : branchName);
-        }
+Status Repo::status() const {
+    Status result;
+    result.currentBranch = HEAD;
+
+    // List branches, already sorted by the ref store
+    for (const auto& [branchName, _] : refs.list()) {
+        result.branches.push_back(branchName);
     }
-    std::sort(branches.begin(), branches.end());
 
     // List staged files
-    std::vector<std::string> stagedFiles;
     for (const auto& [fileName, _] : stage.getAddedFiles()) {
-        stagedFiles.push_back(fileName);
+        result.stagedFiles.push_back(fileName);
     }
-    std::sort(stagedFiles.begin(), stagedFiles.end());
+    std::sort(result.stagedFiles.begin(), result.stagedFiles.end());
 
     // List removed files
-    std::vector<std::string> removedFiles(stage.getRemovedFiles().begin(), stage.getRemovedFiles().end());
-    std::sort(removedFiles.begin(), removedFiles.end());
-
-    // Display status
-    std::cout << "=== Branches ===\n";
-    for (const auto& branchName : branches) {
-        //remove txt extension from branch name
-        //read current branch name from HEAD.txt
-        
-        std::string branch = branchName.substr(0, branchName.size() - 4);
-        std::string headBranchPath = workingDir / ".gitlet/branches/HEAD.txt";
-        std::string currentBranch = Utils::readStringFromFile(headBranchPath);
-        
-        if (branch == currentBranch) {
-            std::cout << "*";
-        } 
-        
-        std::cout << branch << "\n";
-    }
-    std::cout << "\n=== Staged Files ===\n";
-    for (const auto& file : stagedFiles) {
-        std::cout << file << "\n";
-    }
-    std::cout << "\n=== Removed Files ===\n";
-    for (const auto& file : removedFiles) {
-        std::cout << file << "\n";
-    }
-    
-    std::cout << "\n=== Modifications Not Staged For Commit ===\n\n=== Untracked Files ===\n";
+    result.removedFiles = stage.getRemovedFiles();
+    std::sort(result.removedFiles.begin(), result.removedFiles.end());
+
+    // List modifications not staged, in name order
+    std::unordered_map<std::string, std::string> tracked = trackedFiles();
+    WorkingTreeChanges changes = workingTreeChanges(tracked);
+    std::vector<std::pair<std::string, std::string>> modified;
+    for (const auto& fileName : changes.modified) {
+        modified.emplace_back(fileName, " (modified)");
+    }
+    for (const auto& fileName : changes.deleted) {
+        modified.emplace_back(fileName, " (deleted)");
+    }
+    std::sort(modified.begin(), modified.end());
+    for (const auto& [fileName, state] : modified) {
+        result.modifiedFiles.push_back(fileName + state);
+    }
+
+    // List untracked files
+    result.untrackedFiles = UntrackedFiles(workingDir).list(tracked);
+
+    return result;
+}
+
+std::unordered_map<std::string, std::string> Repo::trackedFiles() const {
+    std::unordered_map<std::string, std::string> tracked = getCurrentCommit().getBlobs();
+    for (const auto& [fileName, blobHash] : stage.getAddedFiles()) {
+        tracked[fileName] = blobHash;
+    }
+    for (const auto& fileName : stage.getRemovedFiles()) {
+        tracked.erase(fileName);
+    }
+    return tracked;
+}
+
+// With a watcher running only the paths it saw touched, the paths that
+// differed last time and the paths whose tracked version changed since are
+// examined; otherwise every tracked file is. Paths outside the sparse set
+// are never examined.
+Repo::WorkingTreeChanges Repo::workingTreeChanges(const std::unordered_map<std::string, std::string>& tracked) const {
+    GITLET_TRACE_SCOPE("scan working directory");
+    WatchJournal journal(workingDir / ".gitlet");
+    WatchQuery query = journal.query();
+
+    std::vector<std::string> candidates;
+    std::unordered_set<std::string> seen;
+    auto consider = [&](const std::string& path) {
+        if (sparse.includes(path) && seen.insert(path).second) {
+            candidates.push_back(path);
+        }
+    };
+    if (query.complete) {
+        for (const auto& path : query.pending) {
+            consider(path);
+        }
+        for (const auto& path : query.files) {
+            consider(path);
+        }
+        for (const auto& [fileName, blobHash] : tracked) {
+            auto it = query.tracked.find(fileName);
+            if (it == query.tracked.end() || it->second != blobHash || query.touches(fileName)) {
+                consider(fileName);
+            }
+        }
+    } else {
+        for (const auto& [fileName, blobHash] : tracked) {
+            consider(fileName);
+        }
+    }
+
+    WorkingTreeChanges changes;
+    std::vector<std::string> pending;
+    std::vector<std::string> present;
+    for (const auto& path : candidates) {
+        if (tracked.find(path) == tracked.end()) {
+            continue;
+        }
+        Trace::count("paths examined");
+        if (!fs::is_regular_file(workingDir / path)) {
+            changes.deleted.push_back(path);
+            pending.push_back(path);
+        } else if (lfs.tracks(path)) {
+            if (workingBlobHash(path) != tracked.at(path)) {
+                changes.modified.push_back(path);
+                pending.push_back(path);
+            }
+        } else {
+            present.push_back(path);
+        }
+    }
+    auto read = [&](size_t begin, size_t end, IoEngine& reader) {
+        std::vector<fs::path> paths;
+        for (size_t i = begin; i < end; i++) {
+            paths.push_back(workingDir / present[i]);
+        }
+        return reader.readFiles(paths);
+    };
+    auto consume = [&](size_t begin, Contents& contents) {
+        for (size_t i = 0; i < contents.size(); i++) {
+            const std::string& path = present[begin + i];
+            if (!contents[i]) {
+                changes.deleted.push_back(path);
+            } else if (Utils::sha1(*contents[i]) != tracked.at(path)) {
+                changes.modified.push_back(path);
+            } else {
+                continue;
+            }
+            pending.push_back(path);
+        }
+    };
+    syncWait(pipelineReads(present.size(), read, consume));
+    journal.checkpoint(query, tracked, pending);
+
+    for (auto* list : {&changes.modified, &changes.deleted}) {
+        std::sort(list->begin(), list->end());
+    }
+    return changes;
 }
 
 Commit Repo::getCurrentCommit() const {
-    std::string headBranchPath = workingDir / ".gitlet/branches/HEAD.txt";
-    std::string currentBranch = Utils::readStringFromFile(headBranchPath);
-    std::string currentCommitHash = Utils::readStringFromFile(workingDir / ".gitlet/branches" / (currentBranch + ".txt"));
-    return deserializeCommit(workingDir / ".gitlet/commits" / (currentCommitHash + ".txt"));
+    return getCommit(refs.resolve(HEAD).value_or(""));
 }
 
 void Repo::checkout(const std::vector<std::string>& args) {
     if (args.size() == 1) {
         std::string branchName = args[0];
-        fs::path branchPath = workingDir / ".gitlet/branches" / (branchName + ".txt");
-        if (!fs::exists(branchPath)) {
+        std::optional<std::string> commitID = refs.resolve(branchName);
+        if (!commitID) {
             std::cout << "File does not exist in the most recent commit, or no such branch exists." << std::endl;
             return;
         }
 
-        std::string commitID = Utils::readStringFromFile(branchPath);
-        Commit commit = deserializeCommit(workingDir / ".gitlet/commits" / (commitID + ".txt"));
-        for (const auto& [fileName, blobHash] : commit.getBlobs()) {
-            checkoutFile(commit, fileName);
-        }
-
-        // Remove files that are not in the commit to reset to
-        for (const auto& file : fs::directory_iterator(workingDir)) {
-            if (fs::is_regular_file(file) && file.path().filename() != ".gitlet" && file.path().filename() != "Gitlet") {
-                std::string relativePath = fs::relative(file.path(), workingDir).string();
-                if (commit.getBlobs().find(relativePath) == commit.getBlobs().end()) {
-                    fs::remove(file);
-                }
-            }
+        if (!checkoutCommit(getCommit(*commitID))) {
+            return;
         }
 
         //overwrite current branch'name in HEAD.txt
-        std::string headBranchPath = (workingDir / ".gitlet/branches/HEAD.txt").string();
-        Utils::writeStringToFile(branchName, headBranchPath, true);
+        refs.setHead(branchName);
 
     } else if (args.size() == 3 && args[1] == "--") {
-        std::string commitID = args[0];
-        std::string fileName = args[2];
-        Commit commit = deserializeCommit(workingDir / ".gitlet/commits" / (commitID + ".txt"));
-        checkoutFile(commit, fileName);
+        std::optional<std::string> commitID = resolveCommit(args[0]);
+        if (!commitID) {
+            return;
+        }
+        checkoutFile(getCommit(*commitID), args[2]);
     } else {
         std::cout << "Incorrect Operands" << std::endl;
     }
@@ -305,183 +603,1012 @@ void Repo::checkout(const std::vector<std::string>& args) {
 
 
 void Repo::branch(const std::string& branchName) {
-    fs::path branchPath = workingDir / ".gitlet/branches" / (branchName + ".txt");
-    if (fs::exists(branchPath)) {
+    if (refs.exists(branchName)) {
         std::cout << "A branch with that name already exists." << std::endl;
         return;
     }
 
-    std::string sha1 = Utils::readStringFromFile((workingDir / ".gitlet/branches" / HEAD).string() + ".txt");
-    Utils::writeStringToFile(sha1, branchPath.string(), false);
+    // Expecting no current value makes creation race-free against another
+    // process creating the same branch.
+    if (!refs.update(branchName, refs.resolve(HEAD).value_or(""), std::string())) {
+        std::cout << "A branch with that name already exists." << std::endl;
+    }
 }
 
 void Repo::rmb(const std::string& branchName) {
-    if (branchName == Utils::readStringFromFile(workingDir / ".gitlet/branches/HEAD.txt")) {
+    if (branchName == HEAD) {
         std::cout << "Cannot remove the current branch." << std::endl;
         return;
     }
 
-    fs::path branchPath = workingDir / ".gitlet/branches" / (branchName + ".txt");
-    if (fs::remove(branchPath)) {
+    if (refs.remove(branchName)) {
         std::cout << "Branch " << branchName << " removed." << std::endl;
     } else {
         std::cout << "A branch with that name does not exist." << std::endl;
     }
 }
 
-void Repo::reset(const std::string& commitID) {
-    Commit commitToReset = deserializeCommit(".gitlet/commits/" + commitID + ".txt");
-    if (commitToReset.getOwnHash().empty()) {
-        std::cout << "No commit with that id exists." << std::endl;
+void Repo::packRefs() {
+    size_t packed = refs.pack();
+    std::cout << "Packed " << packed << " branches." << std::endl;
+}
+
+namespace {
+// Links every object file of sourceDir's store into gitletDir's, so both
+// stores share them; objects never change once written. Returns false at the
+// first file that cannot be linked, for example across filesystems.
+bool linkObjects(const fs::path& sourceDir, const fs::path& gitletDir) {
+    std::error_code ec;
+    for (const char* dir : {"blobs", "commits"}) {
+        for (const auto& entry : fs::directory_iterator(sourceDir / dir, ec)) {
+            if (entry.path().extension() != ".txt") {
+                continue;
+            }
+            fs::create_hard_link(entry.path(), gitletDir / dir / entry.path().filename(), ec);
+            if (ec) {
+                return false;
+            }
+            Trace::count("objects linked");
+        }
+    }
+    // The .pack goes before its .idx, as PackWriter publishes them.
+    for (const auto& entry : fs::directory_iterator(sourceDir / "packs", ec)) {
+        if (entry.path().extension() != ".idx" || !fs::exists(fs::path(entry.path()).replace_extension(".pack"))) {
+            continue;
+        }
+        for (const char* extension : {".pack", ".idx"}) {
+            fs::path from = fs::path(entry.path()).replace_extension(extension);
+            fs::create_hard_link(from, gitletDir / "packs" / from.filename(), ec);
+            if (ec) {
+                return false;
+            }
+        }
+        Trace::count("packs linked");
+    }
+    return true;
+}
+
+// A path names a repository by its working directory or its .gitlet.
+std::string normalizeUrl(const std::string& url) {
+    if (url.rfind("ext::", 0) == 0) {
+        return url;
+    }
+    fs::path path = fs::absolute(url).lexically_normal();
+    if (!path.has_filename()) {
+        path = path.parent_path();
+    }
+    if (path.filename() == ".gitlet") {
+        path = path.parent_path();
+    }
+    return path.string();
+}
+}
+
+void Repo::clone(const std::string& source, const fs::path& destination, const CloneOptions& options) {
+    GITLET_TRACE_SCOPE("Repo::clone");
+    std::string url = normalizeUrl(source);
+    bool local = url.rfind("ext::", 0) != 0;
+    if (local && !fs::is_directory(fs::path(url) / ".gitlet")) {
+        std::cout << "Remote directory not found." << std::endl;
+        return;
+    }
+    std::error_code ec;
+    if (fs::exists(destination) && !fs::is_empty(destination, ec)) {
+        std::cout << "Destination path already exists and is not an empty directory." << std::endl;
         return;
     }
 
-    // Checkout files from the commit to reset to
-    for (const auto& [fileName, blobHash] : commitToReset.getBlobs()) {
-        checkoutFile(commitToReset, fileName);
+    fs::path gitletDir = destination / ".gitlet";
+    for (const char* dir : {"blobs", "commits", "branches", "staging", "global-log", "packs"}) {
+        fs::create_directories(gitletDir / dir);
+    }
+    Transaction transaction(gitletDir);
+    Repo repo(destination);
+    repo.config.set("remote.origin.url", url);
+    if (options.blobless) {
+        repo.config.set("remote.origin.promisor", "true");
+    }
+    // A store the source shares is shared by the clone too. The source's
+    // private store is only read from, as the clone's alternate; the clone
+    // copies what it checks out into a store of its own.
+    if (local) {
+        Repo origin(url);
+        if (std::optional<std::string> track = origin.config.get("lfs.track")) {
+            repo.config.set("lfs.track", *track);
+            repo.config.set(origin.config.get("lfs.store") ? "lfs.store" : "lfs.alternate", origin.lfs.location());
+        }
+        repo.lfs = LfsStore(gitletDir, repo.config);
+    }
+
+    // Linked objects keep the invariant that a commit comes with its history
+    // and blobs, so only a complete source is linked, and only into a full
+    // clone; whatever linking missed, fetch then sends.
+    bool full = options.depth == 0 && !options.blobless;
+    if (local && full) {
+        Repo origin(url);
+        full = origin.shallow.empty() && !origin.promisorRemote();
+    }
+    if (local && full && !linkObjects(fs::path(url) / ".gitlet", gitletDir)) {
+        Trace::count("clones copied");
+    }
+    repo.objects.rescanPacks();
+
+    std::optional<Advertisement> advertised = repo.fetchFrom("origin", url, std::nullopt, options.depth);
+    if (!advertised) {
+        fs::remove_all(gitletDir, ec);
+        return;
+    }
+    std::string head = advertised->head;
+    std::optional<std::string> headID = repo.refs.resolve("origin/" + head);
+    if (!headID) {
+        head = "master";
+        headID = repo.refs.resolve("origin/master");
+    }
+    if (headID) {
+        repo.refs.update(head, *headID);
+        repo.refs.setHead(head);
+        repo.HEAD = head;
+        repo.checkoutCommit(repo.getCommit(*headID));
+    }
+    repo.stage = StagingArea();
+    repo.serializeStage();
+    Utils::writeStringToFile("", gitletDir / "global-log" / "gl.txt", true);
+    transaction.commit();
+    std::cout << "Cloned into " << destination.string() << "." << std::endl;
+}
+
+void Repo::addRemote(const std::string& name, const std::string& url) {
+    if (config.get("remote." + name + ".url")) {
+        std::cout << "A remote with that name already exists." << std::endl;
+        return;
+    }
+    config.set("remote." + name + ".url", normalizeUrl(url));
+}
+
+void Repo::rmRemote(const std::string& name) {
+    if (!config.unset("remote." + name + ".url")) {
+        std::cout << "A remote with that name does not exist." << std::endl;
+    }
+}
+
+std::optional<std::string> Repo::remoteUrl(const std::string& remote) const {
+    std::optional<std::string> url = config.get("remote." + remote + ".url");
+    if (!url) {
+        std::cout << "A remote with that name does not exist." << std::endl;
+    }
+    return url;
+}
+
+std::unique_ptr<Connection> Repo::connect(const std::string& url, const std::string& service) {
+    std::unique_ptr<Connection> connection;
+    if (url.rfind("ext::", 0) == 0) {
+        connection = std::make_unique<Connection>(url.substr(5) + " " + service);
+    } else if (fs::is_directory(fs::path(url) / ".gitlet")) {
+        connection = std::make_unique<Connection>([url, service](Channel& channel) {
+            Transaction transaction(fs::path(url) / ".gitlet");
+            Repo remote(url);
+            int status = service == "upload-pack" ? remote.uploadPack(channel) : remote.receivePack(channel);
+            transaction.commit();
+            return status;
+        });
+    }
+    if (!connection || !connection->valid()) {
+        std::cout << "Remote directory not found." << std::endl;
+        return nullptr;
+    }
+    return connection;
+}
+
+// Branches fetched from a remote live here too as <remote>/<branch>, and are
+// not offered on.
+void Repo::advertise(Channel& channel) const {
+    for (const auto& [branchName, commitID] : refs.list()) {
+        size_t slash = branchName.find('/');
+        if (slash != std::string::npos && config.get("remote." + branchName.substr(0, slash) + ".url")) {
+            continue;
+        }
+        channel.write(commitID + " " + branchName + "\n");
+    }
+    channel.write("HEAD " + HEAD + "\n\n");
+    channel.flush();
+}
+
+std::optional<Repo::Advertisement> Repo::readAdvertisement(Channel& channel) {
+    Advertisement advertised;
+    std::string line;
+    while (channel.readLine(line) && !line.empty()) {
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            return std::nullopt;
+        }
+        if (line.compare(0, space, "HEAD") == 0) {
+            advertised.head = line.substr(space + 1);
+        } else {
+            advertised.branches.emplace_back(line.substr(space + 1), line.substr(0, space));
+        }
+    }
+    if (!line.empty() || advertised.head.empty()) {
+        std::cout << "The remote did not answer." << std::endl;
+        return std::nullopt;
+    }
+    return advertised;
+}
+
+void Repo::fetch(const std::string& remote, const std::optional<std::string>& branch) {
+    std::optional<std::string> url = remoteUrl(remote);
+    if (url) {
+        fetchFrom(remote, *url, branch);
+    }
+}
+
+std::optional<Repo::Advertisement> Repo::fetchFrom(const std::string& remote, const std::string& url,
+                                                    const std::optional<std::string>& branch, long depth) {
+    GITLET_TRACE_SCOPE("Repo::fetch");
+    std::unique_ptr<Connection> connection = connect(url, "upload-pack");
+    if (!connection) {
+        return std::nullopt;
+    }
+    Channel& channel = connection->channel();
+    std::optional<Advertisement> advertised = readAdvertisement(channel);
+    if (!advertised) {
+        return std::nullopt;
+    }
+    if (branch) {
+        auto& branches = advertised->branches;
+        branches.erase(std::remove_if(branches.begin(), branches.end(),
+                                      [&](const auto& entry) { return entry.first != *branch; }),
+                       branches.end());
+        if (branches.empty()) {
+            std::cout << "That remote does not have that branch." << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    std::vector<std::string> wants;
+    for (const auto& [branchName, commitID] : advertised->branches) {
+        if (!objects.has(ObjectType::Commit, commitID)
+            && std::find(wants.begin(), wants.end(), commitID) == wants.end()) {
+            wants.push_back(commitID);
+            channel.write("want " + commitID + "\n");
+        }
+    }
+    if (!wants.empty()) {
+        for (const auto& commitID : negotiationHaves()) {
+            channel.write("have " + commitID + "\n");
+        }
+        for (const auto& commitID : shallow.getCommits()) {
+            channel.write("shallow " + commitID + "\n");
+        }
+        if (depth > 0) {
+            channel.write("deepen " + std::to_string(depth) + "\n");
+        }
+        if (promisorRemote() == remote) {
+            channel.write("filter blob:none\n");
+        }
+    }
+    channel.write("done\n");
+    std::unordered_set<std::string> boundary = shallow.getCommits();
+    std::string line;
+    while (channel.readLine(line) && line.rfind("shallow ", 0) == 0) {
+        boundary.insert(line.substr(8));
+    }
+    if (!line.empty() || !PackStream::receive(channel, objects)) {
+        std::cout << "The remote sent a damaged pack." << std::endl;
+        return std::nullopt;
+    }
+    for (const auto& commitID : wants) {
+        if (!objects.has(ObjectType::Commit, commitID)) {
+            std::cout << "The remote sent an incomplete pack." << std::endl;
+            return std::nullopt;
+        }
+    }
+    connection->finish();
+
+    // A boundary commit whose parent has arrived since is no longer one.
+    for (auto it = boundary.begin(); it != boundary.end();) {
+        std::string parent = getCommit(*it).getParentHash();
+        it = parent.empty() || objects.has(ObjectType::Commit, parent) ? boundary.erase(it) : std::next(it);
+    }
+    shallow.set(boundary);
+
+    for (const auto& [branchName, commitID] : advertised->branches) {
+        refs.update(remote + "/" + branchName, commitID);
+    }
+    // A full fetch also drops the branches the remote no longer has.
+    if (!branch) {
+        std::string prefix = remote + "/";
+        for (const auto& [branchName, commitID] : refs.list()) {
+            if (branchName.rfind(prefix, 0) != 0) {
+                continue;
+            }
+            std::string name = branchName.substr(prefix.size());
+            auto& branches = advertised->branches;
+            if (std::none_of(branches.begin(), branches.end(), [&](const auto& entry) { return entry.first == name; })) {
+                refs.remove(branchName);
+            }
+        }
+    }
+    return advertised;
+}
+
+// Distances 0, 1, 2, 4, ... up to 1024 commits back from each tip keep the
+// list short while bounding how far the last common commit can lie behind
+// the nearest have; the server then sends everything after that have.
+std::vector<std::string> Repo::negotiationHaves() const {
+    const size_t maxDepth = 1024;
+    std::vector<std::string> haves;
+    std::unordered_set<std::string> seen;
+    for (const auto& [branchName, tip] : refs.list()) {
+        std::string current = tip;
+        for (size_t depth = 0, next = 0; depth <= maxDepth && !current.empty(); depth++) {
+            if (!seen.insert(current).second) {
+                break;
+            }
+            if (depth == next) {
+                haves.push_back(current);
+                next = next == 0 ? 1 : next * 2;
+            }
+            current = parentOf(getCommit(current));
+        }
+    }
+    return haves;
+}
+
+Repo::PackPlan Repo::missingObjects(const std::vector<std::string>& wants, const std::vector<std::string>& haves,
+                                    const PackFilter& filter) const {
+    GITLET_TRACE_SCOPE("Repo::missingObjects");
+    // Having a commit means having its history back to the shallow boundary,
+    // so everything the haves reach is on the other side already.
+    Reachable common;
+    for (const auto& commitID : haves) {
+        if (objects.has(ObjectType::Commit, commitID)) {
+            extendReachable(common, commitID, &filter.shallow);
+        }
+    }
+
+    PackPlan plan;
+    std::vector<std::pair<ObjectType, ObjectId>> commits;
+    std::unordered_set<std::string> selected;
+    for (const auto& want : wants) {
+        std::string current = want;
+        for (long depth = 1; !current.empty() && !reaches(common, ObjectType::Commit, current)
+                             && selected.insert(current).second; depth++) {
+            Commit commit = getCommit(current);
+            std::optional<ObjectId> id = ObjectId::fromHex(current);
+            if (commit.getOwnHash().empty() || !id) {
+                break;
+            }
+            commits.emplace_back(ObjectType::Commit, *id);
+            for (const auto& [fileName, blobHash] : commit.getBlobs()) {
+                std::optional<ObjectId> blob = ObjectId::fromHex(blobHash);
+                if (filter.blobs && blob && !reaches(common, ObjectType::Blob, blobHash)
+                    && selected.insert(blobHash).second) {
+                    plan.objects.emplace_back(ObjectType::Blob, *blob);
+                }
+            }
+
+            // Cut here at the requested depth or at our own boundary, unless
+            // the other side has the parent anyway.
+            std::string parent = parentOf(commit);
+            bool cut = !commit.getParentHash().empty() && (parent.empty() || depth == filter.depth);
+            if (cut && !reaches(common, ObjectType::Commit, commit.getParentHash())) {
+                plan.shallow.push_back(current);
+                break;
+            }
+            current = parent;
+        }
+    }
+    plan.objects.insert(plan.objects.end(), commits.begin(), commits.end());
+    return plan;
+}
+
+void Repo::sendPack(Channel& channel, const std::vector<std::pair<ObjectType, ObjectId>>& list) {
+    std::vector<std::string> blobIDs;
+    for (const auto& [type, id] : list) {
+        if (type == ObjectType::Blob) {
+            blobIDs.push_back(id.hex());
+        }
+    }
+    prefetchBlobs(blobIDs);
+    PackStream::send(channel, objects, list);
+}
+
+int Repo::uploadPack(Channel& channel) {
+    GITLET_TRACE_SCOPE("Repo::uploadPack");
+    advertise(channel);
+    std::vector<std::string> wants;
+    std::vector<std::string> haves;
+    std::vector<std::string> blobIDs;
+    PackFilter filter;
+    std::string line;
+    while (channel.readLine(line) && line != "done") {
+        size_t space = line.find(' ');
+        std::string keyword = line.substr(0, space);
+        std::string value = space == std::string::npos ? std::string() : line.substr(space + 1);
+        if (keyword == "want" && objects.has(ObjectType::Commit, value)) {
+            wants.push_back(value);
+        } else if (keyword == "have") {
+            haves.push_back(value);
+        } else if (keyword == "shallow") {
+            filter.shallow.insert(value);
+        } else if (keyword == "deepen") {
+            filter.depth = std::max(0L, std::atol(value.c_str()));
+        } else if (keyword == "filter" && value == "blob:none") {
+            filter.blobs = false;
+        } else if (keyword == "blob") {
+            blobIDs.push_back(value);
+        }
+    }
+    if (line != "done") {
+        return 1;
+    }
+
+    PackPlan plan = missingObjects(wants, haves, filter);
+    // Blobs asked for by id come from a blobless clone filling itself in.
+    for (const auto& blobHash : blobIDs) {
+        std::optional<ObjectId> id = ObjectId::fromHex(blobHash);
+        if (id && (objects.has(ObjectType::Blob, blobHash) || promisorRemote())) {
+            plan.objects.emplace_back(ObjectType::Blob, *id);
+        }
+    }
+    for (const auto& commitID : plan.shallow) {
+        channel.write("shallow " + commitID + "\n");
+    }
+    channel.write("\n");
+    sendPack(channel, plan.objects);
+    return 0;
+}
+
+void Repo::push(const std::string& remote, const std::string& branch) {
+    GITLET_TRACE_SCOPE("Repo::push");
+    std::optional<std::string> url = remoteUrl(remote);
+    if (!url) {
+        return;
+    }
+    std::unique_ptr<Connection> connection = connect(*url, "receive-pack");
+    if (!connection) {
+        return;
+    }
+    Channel& channel = connection->channel();
+    std::optional<Advertisement> advertised = readAdvertisement(channel);
+    if (!advertised) {
+        return;
+    }
+
+    std::string localID = refs.resolve(HEAD).value_or("");
+    std::string remoteID;
+    std::vector<std::string> haves;
+    for (const auto& [branchName, commitID] : advertised->branches) {
+        if (branchName == branch) {
+            remoteID = commitID;
+        }
+        if (objects.has(ObjectType::Commit, commitID)) {
+            haves.push_back(commitID);
+        }
+    }
+    // Only a fast-forward is allowed: the remote's commit must be in our history.
+    if (!remoteID.empty() && (!objects.has(ObjectType::Commit, remoteID) || !isAncestor(remoteID, localID))) {
+        std::cout << "Please pull down remote changes before pushing." << std::endl;
+        return;
+    }
+    if (remoteID == localID) {
+        channel.write("done\n");
+        connection->finish();
+        return;
+    }
+
+    PackPlan plan = missingObjects({localID}, haves, PackFilter());
+    if (!plan.shallow.empty()) {
+        std::cout << "The remote lacks history behind this shallow clone's boundary." << std::endl;
+        return;
+    }
+    channel.write("update " + remoteID + " " + localID + " " + branch + "\n");
+    channel.write("done\n");
+    sendPack(channel, plan.objects);
+    std::string reply;
+    if (!channel.readLine(reply) || reply != "ok") {
+        std::cout << "The remote rejected the push" << (reply.rfind("error ", 0) == 0 ? ": " + reply.substr(6) : "")
+                  << "." << std::endl;
+        return;
     }
+    connection->finish();
+    refs.update(remote + "/" + branch, localID);
+}
 
-    // Remove files that are not in the commit to reset to
-    for (const auto& file : fs::directory_iterator(workingDir)) {
-        if (fs::is_regular_file(file) && file.path().filename() != ".gitlet" && file.path().filename() != "Gitlet") {
-            std::string relativePath = fs::relative(file.path(), workingDir).string();
-            if (commitToReset.getBlobs().find(relativePath) == commitToReset.getBlobs().end()) {
-                fs::remove(file);
+// Every update is checked against the value the client saw, so a push that
+// raced with a commit on the remote is refused rather than losing it.
+int Repo::receivePack(Channel& channel) {
+    GITLET_TRACE_SCOPE("Repo::receivePack");
+    advertise(channel);
+    struct Update {
+        std::string oldID;
+        std::string newID;
+        std::string branchName;
+    };
+    std::vector<Update> updates;
+    std::string line;
+    while (channel.readLine(line) && line != "done") {
+        size_t first = line.find(' ', 7);
+        size_t second = first == std::string::npos ? first : line.find(' ', first + 1);
+        if (line.rfind("update ", 0) != 0 || second == std::string::npos) {
+            return 1;
+        }
+        updates.push_back({line.substr(7, first - 7), line.substr(first + 1, second - first - 1), line.substr(second + 1)});
+    }
+    if (line != "done") {
+        return 1;
+    }
+    if (updates.empty()) {
+        return 0;
+    }
+
+    if (!PackStream::receive(channel, objects)) {
+        channel.write("error damaged pack\n");
+        return 1;
+    }
+    // Moving the checked-out branch would leave the working tree and stage
+    // describing a commit the branch no longer points to.
+    bool denyCurrentBranch = config.getBool("receive.denyCurrentBranch", true);
+    for (const auto& update : updates) {
+        if (!objects.has(ObjectType::Commit, update.newID)) {
+            channel.write("error missing commit " + update.newID + "\n");
+            return 1;
+        }
+        if (denyCurrentBranch && update.branchName == refs.head()) {
+            channel.write("error refusing to update checked out branch " + update.branchName + "\n");
+            return 1;
+        }
+    }
+    for (const auto& update : updates) {
+        if (!refs.update(update.branchName, update.newID, update.oldID)) {
+            channel.write("error " + update.branchName + " moved\n");
+            return 1;
+        }
+    }
+    channel.write("ok\n");
+    channel.flush();
+    return 0;
+}
+
+ImportResult Repo::fastImport(Channel& in) {
+    FastImport importer(objects, refs, [this](const std::string& commitID) -> std::optional<Commit> {
+        if (!objects.has(ObjectType::Commit, commitID)) {
+            return std::nullopt;
+        }
+        return getCommit(commitID);
+    });
+    return importer.run(in);
+}
+
+// Every blob goes first, read in batches beside the writing, then the
+// commits oldest first, each with only what changed from its parent.
+bool Repo::fastExport(Channel& out, const std::vector<std::string>& branchNames) {
+    GITLET_TRACE_SCOPE("Repo::fastExport");
+    std::vector<std::pair<std::string, std::string>> branches;
+    if (branchNames.empty()) {
+        branches = refs.list();
+    }
+    for (const auto& branchName : branchNames) {
+        std::optional<std::string> commitID = refs.resolve(branchName);
+        if (!commitID) {
+            return false;
+        }
+        branches.emplace_back(branchName, *commitID);
+    }
+    std::vector<std::string> tips;
+    for (const auto& [branchName, commitID] : branches) {
+        tips.push_back(commitID);
+    }
+    std::vector<Commit> commits = commitWalker().history(tips);
+    std::reverse(commits.begin(), commits.end());
+
+    std::unordered_map<std::string, uint64_t> marks;
+    std::vector<std::string> blobs;
+    for (const Commit& commit : commits) {
+        std::unordered_map<std::string, std::string> files = commit.getBlobs();
+        std::map<std::string, std::string> sorted(files.begin(), files.end());
+        for (const auto& [fileName, blobHash] : sorted) {
+            if (marks.emplace(blobHash, marks.size() + 1).second) {
+                blobs.push_back(blobHash);
+            }
+        }
+    }
+    prefetchBlobs(blobs);
+
+    auto read = [&](size_t begin, size_t end, IoEngine& reader) {
+        return objects.readAll(ObjectType::Blob, {blobs.begin() + begin, blobs.begin() + end}, reader);
+    };
+    auto consume = [&](size_t begin, Contents& contents) {
+        for (size_t i = 0; i < contents.size(); i++) {
+            if (!contents[i]) {
+                contents[i] = readBlob(blobs[begin + i]);
+            }
+            out.write("blob\nmark :" + std::to_string(begin + i + 1) + "\ndata " + std::to_string(contents[i]->size()) + "\n");
+            out.write(contents[i]->data(), contents[i]->size());
+            out.write("\n");
+        }
+        Trace::count("blobs exported", contents.size());
+    };
+    syncWait(pipelineReads(blobs.size(), read, consume));
+
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> exported;
+    for (const Commit& commit : commits) {
+        std::unordered_map<std::string, std::string> files = commit.getBlobs();
+        std::string message = commit.getMessage();
+        std::string text = "commit\nmark :" + std::to_string(marks.size() + 1) + "\ndate " + commit.getDatetime() +
+                           "\ndata " + std::to_string(message.size()) + "\n" + message + "\n";
+        auto parent = exported.find(parentOf(commit));
+        std::map<std::string, std::string> changes;
+        if (parent != exported.end()) {
+            text += "from :" + std::to_string(marks.at(parentOf(commit))) + "\n";
+            for (const auto& [fileName, blobHash] : parent->second) {
+                if (files.find(fileName) == files.end()) {
+                    changes[fileName] = "D " + fileName + "\n";
+                }
+            }
+        }
+        for (const auto& [fileName, blobHash] : files) {
+            if (parent == exported.end() || parent->second.count(fileName) == 0 || parent->second.at(fileName) != blobHash) {
+                changes[fileName] = "M :" + std::to_string(marks.at(blobHash)) + " " + fileName + "\n";
             }
         }
+        for (const auto& [fileName, line] : changes) {
+            text += line;
+        }
+        out.write(text + "\n");
+        marks.emplace(commit.getOwnHash(), marks.size() + 1);
+        exported.emplace(commit.getOwnHash(), std::move(files));
+    }
+    for (const auto& [branchName, commitID] : branches) {
+        out.write("reset " + branchName + "\nfrom :" + std::to_string(marks.at(commitID)) + "\n\n");
+    }
+    out.write("done\n");
+    out.flush();
+    Trace::count("commits exported", commits.size());
+    return true;
+}
+
+void Repo::pull(const std::string& remote, const std::string& branch) {
+    std::optional<std::string> url = remoteUrl(remote);
+    if (url && fetchFrom(remote, *url, branch)) {
+        merge(remote + "/" + branch);
+    }
+}
+
+void Repo::reset(const std::string& name) {
+    std::optional<std::string> resolved = resolveCommit(name);
+    if (!resolved) {
+        return;
+    }
+    const std::string& commitID = *resolved;
+    Commit commitToReset = getCommit(commitID);
+
+    // Checkout files from the commit to reset to
+    if (!checkoutCommit(commitToReset)) {
+        return;
     }
 
     // Update the current branch's commit ID
-    std::string headBranchPath = (workingDir / ".gitlet/branches/HEAD.txt").string();
-    std::string currentBranch = Utils::readStringFromFile(headBranchPath);
-    std::string branchPath = (workingDir / ".gitlet/branches" / currentBranch).string() + ".txt";
-    Utils::writeStringToFile(commitID, branchPath, true);
+    refs.update(HEAD, commitID);
 
     std::cout << "Reset to commit " << commitID << std::endl;
 }
 void Repo::merge(const std::string& branchName) {
-    std::string currentBranch = Utils::readStringFromFile(workingDir / ".gitlet/branches/HEAD.txt");
+    syncWait(mergeBranch(branchName));
+}
+
+Task<void> Repo::mergeBranch(std::string branchName) {
+    std::string currentBranch = HEAD;
     if (currentBranch == branchName) {
         std::cout << "Cannot merge a branch with itself." << std::endl;
-        return;
+        co_return;
     }
 
-    std::string currentCommitHash = Utils::readStringFromFile(workingDir / ".gitlet/branches" / (currentBranch + ".txt"));
-    std::string branchCommitHash = Utils::readStringFromFile(workingDir / ".gitlet/branches" / (branchName + ".txt"));
-    Commit currentCommit = deserializeCommit(workingDir / ".gitlet/commits" / (currentCommitHash + ".txt"));
-    Commit branchCommit = deserializeCommit(workingDir / ".gitlet/commits" / (branchCommitHash + ".txt"));
-
-    Commit splitPoint = findSplitPoint(currentCommit, branchCommit);
+    std::optional<std::string> branchCommitHash = refs.resolve(branchName);
+    if (!branchCommitHash) {
+        std::cout << "A branch with that name does not exist." << std::endl;
+        co_return;
+    }
+    // What the branch reaches is walked on the executor while both commits
+    // are read here.
+    objects.packs();
+    Future<Reachable> branchReach = spawn(executor(), loadReachable(*branchCommitHash));
+    Commit currentCommit = getCurrentCommit();
+    Commit branchCommit = getCommit(*branchCommitHash);
+
+    Commit splitPoint = splitPointWithin(currentCommit, co_await branchReach);
     if (splitPoint.getOwnHash().empty()) {
         std::cout << "Already up-to-date." << std::endl;
-        return;
+        co_return;
     } else if (splitPoint.getOwnHash() == branchCommit.getOwnHash()) {
-        Utils::writeStringToFile(branchName, workingDir / ".gitlet/branches/HEAD.txt", true);
+        refs.setHead(branchName);
         std::cout << "Current branch fast-forwarded." << std::endl;
-        return;
+        co_return;
     }
 
-    std::unordered_set<std::string> currentAncestors = getAllAncestors(currentCommit);
-    std::unordered_set<std::string> branchAncestors = getAllAncestors(branchCommit);
-    std::unordered_set<std::string> splitPointAncestors = getAllAncestors(splitPoint);
-
     // Check for uncommitted changes
+    StageLock lock(*this);
     if (!stage.getAddedFiles().empty() || !stage.getRemovedFiles().empty()) {
         std::cout << "You have uncommitted changes." << std::endl;
-        return;
+        co_return;
     }
 
     // Check for untracked files
-    for (const auto& file : fs::directory_iterator(workingDir)) {
-        if (fs::is_regular_file(file) && file.path().filename() != ".gitlet" && file.path().filename() != "Gitlet") {
-            std::string relativePath = fs::relative(file.path(), workingDir).string();
-            if (currentCommit.getBlobs().find(relativePath) == currentCommit.getBlobs().end() && branchCommit.getBlobs().find(relativePath) == branchCommit.getBlobs().end()) {
-                std::cout << "There is an untracked file in the way; delete it, or add and commit it first." << std::endl;
-                return;
-            }
-        }   
-    }   
+    if (untrackedInTheWay(branchCommit)) {
+        std::cout << "There is an untracked file in the way; delete it, or add and commit it first." << std::endl;
+        co_return;
+    }
+
+    // A file renamed on either side since the split point is compared with
+    // its counterpart under the other names, not as a delete and an add.
+    std::unordered_map<std::string, std::string> currentOrigin;
+    for (const FileChange& change : changesBetween(splitPoint, currentCommit, false)) {
+        if (change.kind == FileChange::Kind::Renamed) {
+            currentOrigin[change.path] = change.from;
+        }
+    }
+    std::unordered_map<std::string, std::string> branchTarget;
+    for (const FileChange& change : changesBetween(splitPoint, branchCommit, false)) {
+        if (change.kind == FileChange::Kind::Renamed) {
+            branchTarget[change.from] = change.path;
+        }
+    }
+    std::unordered_map<std::string, std::string> branchBlobs = branchCommit.getBlobs();
+    std::unordered_map<std::string, std::string> splitPointBlobs = splitPoint.getBlobs();
+    auto blobAt = [](const std::unordered_map<std::string, std::string>& blobs, const std::string& fileName) {
+        auto it = blobs.find(fileName);
+        return it != blobs.end() ? it->second : std::string();
+    };
 
     // Check for conflicts
     for (const auto& [fileName, currentBlobHash] : currentCommit.getBlobs()) {
-        std::string branchBlobHash = branchCommit.getBlobs().find(fileName) != branchCommit.getBlobs().end() ? branchCommit.getBlobs().at(fileName) : "";
-        std::string splitPointBlobHash = splitPoint.getBlobs().find(fileName) != splitPoint.getBlobs().end() ? splitPoint.getBlobs().at(fileName) : "";
+        auto origin = currentOrigin.find(fileName);
+        std::string splitName = origin != currentOrigin.end() ? origin->second : fileName;
+        auto target = branchTarget.find(splitName);
+        std::string branchPath = target != branchTarget.end() ? target->second : splitName;
+        std::string branchBlobHash = blobAt(branchBlobs, branchPath);
+        std::string splitPointBlobHash = blobAt(splitPointBlobs, splitName);
         if (currentBlobHash != branchBlobHash && currentBlobHash != splitPointBlobHash && branchBlobHash != splitPointBlobHash) {
             std::cout << "Encountered a merge conflict." << std::endl;
-            handleConflict(fileName, currentBlobHash, branchBlobHash);
-            return;
+            co_await handleConflict(fileName, currentBlobHash, branchBlobHash);
+            serializeStage();
+            co_return;
         }
     }
 
     // Update the current branch's commit ID
-    std::string headBranchPath = (workingDir / ".gitlet/branches/HEAD.txt").string();
-    Utils::writeStringToFile(currentBranch, headBranchPath, true);
+    refs.setHead(currentBranch);
     std::cout << "Merged " << branchName << " into " << currentBranch << "." << std::endl;
 }
 
-void Repo::handleConflict(const std::string& fileName, const std::string& currentBlobHash, const std::string& branchBlobHash) {
+Task<void> Repo::handleConflict(std::string fileName, std::string currentBlobHash, std::string branchBlobHash) {
     std::string conflictMarkerHead = "<<<<<<< HEAD\n";
     std::string conflictMarkerMid = "=======\n";
     std::string conflictMarkerEnd = ">>>>>>>\n";
 
-    std::string currentContents = currentBlobHash.empty() ? std::string() :
-                                  std::string(Utils::readContents(workingDir / ".gitlet/blobs" / (currentBlobHash + ".txt")).begin(),
-                                              Utils::readContents(workingDir / ".gitlet/blobs" / (currentBlobHash + ".txt")).end());
-    std::string branchContents = branchBlobHash.empty() ? std::string() :
-                                 std::string(Utils::readContents(workingDir / ".gitlet/blobs" / (branchBlobHash + ".txt")).begin(),
-                                             Utils::readContents(workingDir / ".gitlet/blobs" / (branchBlobHash + ".txt")).end());
+    prefetchBlobs({currentBlobHash, branchBlobHash});
+    // Both sides and the file made of them would be held at once.
+    uint64_t sides = objects.sizeOf(ObjectType::Blob, currentBlobHash).value_or(0) +
+                     objects.sizeOf(ObjectType::Blob, branchBlobHash).value_or(0);
+    if (!MemoryBudget::fits(2 * sides)) {
+        Utils::writeAtomic(workingDir / fileName, [&](const Utils::Sink& sink) {
+            sink(conflictMarkerHead.data(), conflictMarkerHead.size());
+            if (!objects.readInPieces(ObjectType::Blob, currentBlobHash, sink)) {
+                throw std::invalid_argument("missing blob " + currentBlobHash);
+            }
+            sink(conflictMarkerMid.data(), conflictMarkerMid.size());
+            if (!objects.readInPieces(ObjectType::Blob, branchBlobHash, sink)) {
+                throw std::invalid_argument("missing blob " + branchBlobHash);
+            }
+            sink(conflictMarkerEnd.data(), conflictMarkerEnd.size());
+        });
+        stage.add(fileName, objects.writeLooseFrom(ObjectType::Blob, workingDir / fileName));
+        co_return;
+    }
+    MemoryBudget::Charge held(2 * sides);
+    Future<std::vector<char>> branchRead = spawn(executor(), loadBlob(branchBlobHash));
+    std::vector<char> currentBlob = co_await loadBlob(currentBlobHash);
+    std::vector<char> branchBlob = co_await branchRead;
+    std::string currentContents(currentBlob.begin(), currentBlob.end());
+    std::string branchContents(branchBlob.begin(), branchBlob.end());
     std::string conflictData = conflictMarkerHead + currentContents + conflictMarkerMid + branchContents + conflictMarkerEnd;
     std::vector<char> conflictDataVec(conflictData.begin(), conflictData.end());
     Utils::writeContents(workingDir / fileName, conflictDataVec);
-    stage.add(fileName, Utils::sha1(conflictDataVec));
+    std::string conflictHash = Utils::sha1(conflictDataVec);
+    objects.writeLoose(ObjectType::Blob, conflictHash, conflictDataVec);
+    stage.add(fileName, conflictHash);
+}
+
+bool Repo::untrackedInTheWay(const Commit& target) const {
+    GITLET_TRACE_SCOPE("check untracked files");
+    std::unordered_map<std::string, std::string> tracked = trackedFiles();
+    UntrackedFiles untracked(workingDir);
+    for (const auto& [fileName, blobHash] : target.getBlobs()) {
+        if (sparse.includes(fileName) && untracked.isUntracked(fileName, tracked)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Repo::checkoutCommit(const Commit& target) {
+    if (untrackedInTheWay(target)) {
+        std::cout << "There is an untracked file in the way; delete it, or add and commit it first." << std::endl;
+        return false;
+    }
+
+    std::unordered_map<std::string, std::string> targetBlobs = target.getBlobs();
+    std::vector<std::pair<std::string, std::string>> files;
+    std::vector<std::string> needed;
+    for (const auto& [fileName, blobHash] : targetBlobs) {
+        if (sparse.includes(fileName)) {
+            files.emplace_back(fileName, blobHash);
+            needed.push_back(blobHash);
+        }
+    }
+    prefetchBlobs(needed);
+    // Blobs the memory budget has no room for skip the batches and are
+    // copied one at a time.
+    auto streamed = std::stable_partition(files.begin(), files.end(), [&](const auto& file) {
+        return !overBudget(file.second);
+    });
+    for (auto it = streamed; it != files.end(); ++it) {
+        fs::create_directories((workingDir / it->first).parent_path());
+        writeWorkingFile(it->first, it->second);
+    }
+    files.erase(streamed, files.end());
+
+    // Each batch's files are written while the next batch's blobs are read;
+    // memory holds two batches.
+    IoEngine& engine = ioEngine();
+    auto read = [&](size_t begin, size_t end, IoEngine& reader) {
+        std::vector<std::string> ids;
+        for (size_t i = begin; i < end; i++) {
+            ids.push_back(files[i].second);
+        }
+        return objects.readAll(ObjectType::Blob, ids, reader);
+    };
+    std::vector<std::pair<fs::path, LfsStore::Pointer>> large;
+    auto consume = [&](size_t begin, Contents& blobs) {
+        std::vector<IoEngine::Write> writes;
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < blobs.size(); i++) {
+            const auto& [fileName, blobHash] = files[begin + i];
+            if (!blobs[i]) {
+                blobs[i] = readBlob(blobHash);
+            }
+            bytes += blobs[i]->size();
+            fs::path path = workingDir / fileName;
+            fs::create_directories(path.parent_path());
+            if (std::optional<LfsStore::Pointer> pointer = LfsStore::parse(*blobs[i])) {
+                large.emplace_back(path, *pointer);
+            } else {
+                writes.push_back({path, blobs[i]->data(), blobs[i]->size()});
+            }
+        }
+        MemoryBudget::Charge held(bytes);
+        engine.writeFiles(writes);
+    };
+    syncWait(pipelineReads(files.size(), read, consume));
+    materializeLarge(large);
+
+    // Remove files tracked by the current commit that target does not have;
+    // outside the sparse set they are not there to remove
+    for (const auto& [fileName, blobHash] : getCurrentCommit().getBlobs()) {
+        if (targetBlobs.find(fileName) == targetBlobs.end() && sparse.includes(fileName)) {
+            removeWorkingFile(fileName);
+        }
+    }
+    return true;
+}
+
+void Repo::removeWorkingFile(const std::string& fileName) {
+    fs::path path = workingDir / fileName;
+    std::error_code ec;
+    fs::remove(path, ec);
+    for (fs::path dir = path.parent_path(); dir != workingDir && dir.string().size() > workingDir.string().size();
+         dir = dir.parent_path()) {
+        if (!fs::is_empty(dir, ec) || ec || !fs::remove(dir, ec)) {
+            break;
+        }
+    }
+}
+
+const SparseCheckout& Repo::getSparseCheckout() const {
+    return sparse;
+}
+
+void Repo::setSparseCheckout(const std::vector<std::string>& patterns) {
+    sparse.set(patterns);
+    applySparseCheckout();
+}
+
+void Repo::disableSparseCheckout() {
+    sparse.disable();
+    applySparseCheckout();
+}
+
+void Repo::applySparseCheckout() {
+    GITLET_TRACE_SCOPE("Repo::applySparseCheckout");
+    std::unordered_map<std::string, std::string> tracked = trackedFiles();
+    std::vector<std::string> needed;
+    for (const auto& [fileName, blobHash] : tracked) {
+        if (sparse.includes(fileName) && !fs::exists(fs::symlink_status(workingDir / fileName))) {
+            needed.push_back(blobHash);
+        }
+    }
+    prefetchBlobs(needed);
+    for (const auto& [fileName, blobHash] : tracked) {
+        fs::path path = workingDir / fileName;
+        bool exists = fs::exists(fs::symlink_status(path));
+        if (sparse.includes(fileName)) {
+            if (!exists) {
+                fs::create_directories(path.parent_path());
+                writeWorkingFile(fileName, blobHash);
+            }
+        } else if (exists) {
+            if (workingBlobHash(fileName) == blobHash) {
+                removeWorkingFile(fileName);
+            } else {
+                std::cout << "Not removing modified file " << fileName << "." << std::endl;
+            }
+        }
+    }
 }
 
 void Repo::checkoutFile(const Commit& commit, const std::string& fileName) {
     std::string blobHash = commit.getBlobs().at(fileName);
-    std::vector<char> blobData = Utils::readContents(workingDir / ".gitlet/blobs" / (blobHash + ".txt"));
-    Utils::writeContents(workingDir / fileName, blobData);
+    writeWorkingFile(fileName, blobHash);
 }
 
+// The split point is the nearest commit on the current chain that the branch
+// also reaches.
 Commit Repo::findSplitPoint(const Commit& currentCommit, const Commit& branchCommit) {
-    std::unordered_set<std::string> currentAncestors = getAllAncestors(currentCommit);
-    std::unordered_set<std::string> branchAncestors = getAllAncestors(branchCommit);
+    return splitPointWithin(currentCommit, reachableFrom(branchCommit.getOwnHash()));
+}
 
-    for (const auto& ancestorHash : currentAncestors) {
-        if (branchAncestors.find(ancestorHash) != branchAncestors.end()) {
-            return deserializeCommit(workingDir / ".gitlet/commits" / (ancestorHash + ".txt"));
+Commit Repo::splitPointWithin(const Commit& currentCommit, const Reachable& branchReach) {
+    for (Commit commit = currentCommit; !commit.getOwnHash().empty(); commit = getCommit(parentOf(commit))) {
+        if (reaches(branchReach, ObjectType::Commit, commit.getOwnHash())) {
+            return commit;
         }
     }
 
     return Commit(); // Return an empty commit if no common ancestor is found
 }
 
-std::unordered_set<std::string> Repo::getAllAncestors(const Commit& commit) {
-    std::unordered_set<std::string> ancestors;
-    std::queue<std::string> toVisit;
-    toVisit.push(commit.getOwnHash());
-
-    while (!toVisit.empty()) {
-        std::string currentHash = toVisit.front();
-        toVisit.pop();
-        ancestors.insert(currentHash);
+std::string Repo::parentOf(const Commit& commit) const {
+    return shallow.contains(commit.getOwnHash()) ? std::string() : commit.getParentHash();
+}
 
-        Commit currentCommit = deserializeCommit(workingDir / ".gitlet/commits" / (currentHash + ".txt"));
-        if (!currentCommit.getParentHash().empty()) {
-            toVisit.push(currentCommit.getParentHash());
-        }
+// Publishes the stage through the stage lock when this Repo holds it.
+void Repo::serializeStage() {
+    GITLET_TRACE_SCOPE("Repo::serializeStage");
+    if (stageLockFile) {
+        stageLockFile->commit(stage.serializeToString());
+        stageLockFile.reset();
+    } else {
+        Utils::writeStringToFile(stage.serializeToString(), workingDir / ".gitlet/staging/stage.txt", true);
     }
+}
 
-    return ancestors;
+// Takes the stage lock and reloads the stage, so changes committed by
+// another process while this one waited are not overwritten.
+Repo::StageLock::StageLock(Repo& repo) : repo(repo) {
+    if (!repo.stageLockFile) {
+        repo.stageLockFile = std::make_unique<LockFile>(repo.workingDir / ".gitlet/staging/stage.txt");
+        repo.deserializeStage();
+    }
 }
 
-void Repo::serializeStage() {
-    std::ofstream ofs(".gitlet/staging/stage.txt");
-    boost::archive::text_oarchive oa(ofs);
-    oa << stage; // Assuming 'stage' is an instance of StagingArea
+Repo::StageLock::~StageLock() {
+    repo.stageLockFile.reset();
 }
 
 void Repo::deserializeStage() {
-    std::ifstream ifs(".gitlet/staging/stage.txt");
+    GITLET_TRACE_SCOPE("Repo::deserializeStage");
+    std::ifstream ifs(workingDir / ".gitlet/staging/stage.txt");
+    stage = StagingArea();
     if(ifs.good()) { // Check if the file exists and is not empty
         boost::archive::text_iarchive ia(ifs);
         ia >> stage; // Assuming 'stage' is an instance of StagingArea
@@ -490,12 +1617,18 @@ void Repo::deserializeStage() {
 
 
 void Repo::serializeCommit(const Commit& commit, const std::string& path) {
-    std::ofstream ofs(path);
-    boost::archive::text_oarchive oa(ofs);
-    oa << commit;
+    GITLET_TRACE_SCOPE("Repo::serializeCommit");
+    std::ostringstream archive_stream;
+    {
+        boost::archive::text_oarchive oa(archive_stream);
+        oa << commit;
+    }
+    Utils::writeStringToFile(archive_stream.str(), path, true);
 }
 
 Commit Repo::deserializeCommit(const std::string& path) const {
+    GITLET_TRACE_SCOPE("Repo::deserializeCommit");
+    Trace::count("commits deserialized");
     Commit commit; 
     std::ifstream ifs(path);
     if(ifs.good()) { 
@@ -503,4 +1636,409 @@ Commit Repo::deserializeCommit(const std::string& path) const {
         ia >> commit;
     }
     return commit;
-}
\ No newline at end of file
+}
+
+// Commits come from the object store, loose or packed. A missing commit
+// yields an empty Commit, as deserializeCommit does for a missing file.
+Commit Repo::getCommit(const std::string& commitID) const {
+    GITLET_TRACE_SCOPE("Repo::deserializeCommit");
+    Commit commit;
+    std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, commitID);
+    if (data) {
+        Trace::count("commits deserialized");
+        commit.deserializeFromString(std::string(data->begin(), data->end()));
+    }
+    return commit;
+}
+
+void Repo::storeCommit(const Commit& commit) {
+    GITLET_TRACE_SCOPE("Repo::serializeCommit");
+    std::string archive = commit.serializeToString();
+    objects.writeLoose(ObjectType::Commit, commit.getOwnHash(), std::vector<char>(archive.begin(), archive.end()));
+}
+
+std::vector<char> Repo::readBlob(const std::string& blobHash) {
+    std::optional<std::vector<char>> data = objects.read(ObjectType::Blob, blobHash);
+    if (!data && promisorRemote()) {
+        prefetchBlobs({blobHash});
+        data = objects.read(ObjectType::Blob, blobHash);
+    }
+    if (!data) {
+        throw std::invalid_argument("missing blob " + blobHash);
+    }
+    return *data;
+}
+
+Task<std::vector<char>> Repo::loadBlob(std::string blobHash) const {
+    if (blobHash.empty()) {
+        co_return std::vector<char>();
+    }
+    std::optional<std::vector<char>> data = objects.read(ObjectType::Blob, blobHash);
+    if (!data) {
+        throw std::invalid_argument("missing blob " + blobHash);
+    }
+    co_return std::move(*data);
+}
+
+void Repo::prefetchBlobs(const std::vector<std::string>& blobIDs) {
+    std::vector<std::string> missing;
+    std::unordered_set<std::string> seen;
+    for (const auto& blobHash : blobIDs) {
+        if (!blobHash.empty() && !objects.has(ObjectType::Blob, blobHash) && seen.insert(blobHash).second) {
+            missing.push_back(blobHash);
+        }
+    }
+    std::optional<std::string> remote = missing.empty() ? std::nullopt : promisorRemote();
+    std::optional<std::string> url = remote ? config.get("remote." + *remote + ".url") : std::nullopt;
+    if (!url) {
+        return;
+    }
+    GITLET_TRACE_SCOPE("Repo::prefetchBlobs");
+    Trace::count("blobs fetched on demand", missing.size());
+    std::unique_ptr<Connection> connection = connect(*url, "upload-pack");
+    if (!connection || !readAdvertisement(connection->channel())) {
+        return;
+    }
+    Channel& channel = connection->channel();
+    for (const auto& blobHash : missing) {
+        channel.write("blob " + blobHash + "\n");
+    }
+    channel.write("done\n");
+    std::string line;
+    if (!channel.readLine(line) || !line.empty() || !PackStream::receive(channel, objects)) {
+        std::cout << "The remote sent a damaged pack." << std::endl;
+        return;
+    }
+    connection->finish();
+}
+
+// A blobless clone marks the remote it came from as remote.<name>.promisor.
+std::optional<std::string> Repo::promisorRemote() const {
+    const std::string prefix = "remote.";
+    const std::string suffix = ".promisor";
+    for (const auto& [key, value] : config.entries()) {
+        if (key.size() > prefix.size() + suffix.size() && key.rfind(prefix, 0) == 0
+            && key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0 && value == "true") {
+            return key.substr(prefix.size(), key.size() - prefix.size() - suffix.size());
+        }
+    }
+    return std::nullopt;
+}
+
+GcResult Repo::gc(GcOptions options) {
+    if (options.pruneExpire < 0) {
+        options.pruneExpire = config.getInt("gc.pruneExpire", 14 * 24 * 60 * 60);
+    }
+    GarbageCollector collector(workingDir / ".gitlet", objects, refs, stage, ioEngine());
+    GcResult result = collector.run(options);
+    result.bitmaps = writeBitmaps();
+    result.changedPaths = writeChangedPaths();
+    return result;
+}
+
+FsckResult Repo::fsck() {
+    Fsck checker(objects, refs, stage, executor(), [this](const std::string& commitID) { return shallow.contains(commitID); },
+                 promisorRemote().has_value());
+    return checker.run();
+}
+
+size_t Repo::writeChangedPaths() {
+    std::vector<std::string> tips;
+    for (const auto& [branchName, commitID] : refs.list()) {
+        tips.push_back(commitID);
+    }
+    std::mutex mutex;
+    std::vector<Commit> commits;
+    commitWalker().walk(tips, [&](const Commit& commit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        commits.push_back(commit);
+    });
+    std::string setting = config.getString("changedPaths.falsePositiveRate", "0.01");
+    double rate = 0.01;
+    size_t used = 0;
+    try {
+        rate = std::stod(setting, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != setting.size() || !(rate > 0 && rate < 1)) {
+        std::cerr << "changedPaths.falsePositiveRate must be a number between 0 and 1, not \"" << setting
+                  << "\"; using 0.01." << std::endl;
+        rate = 0.01;
+    }
+    size_t maxPaths = static_cast<size_t>(std::max(0LL, config.getInt("changedPaths.maxPaths", 512)));
+    size_t written = ChangedPathIndex::write(workingDir / ".gitlet", commits, rate, maxPaths);
+    changedPaths.reset();
+    return written;
+}
+
+size_t Repo::writeBitmaps() {
+    size_t written = BitmapIndex::write(workingDir / ".gitlet", objects, refs, config.getInt("bitmap.interval", 100));
+    bitmaps.reset();
+    return written;
+}
+
+const BitmapIndex& Repo::bitmapIndex() const {
+    if (!bitmaps) {
+        bitmaps = std::make_unique<BitmapIndex>(workingDir / ".gitlet");
+    }
+    return *bitmaps;
+}
+
+const ChangedPathIndex& Repo::changedPathIndex() const {
+    if (!changedPaths) {
+        changedPaths = std::make_unique<ChangedPathIndex>(workingDir / ".gitlet");
+    }
+    return *changedPaths;
+}
+
+std::string Repo::skipUnchanged(const std::string& commitID, const std::string& path) const {
+    const ChangedPathIndex& index = changedPathIndex();
+    std::optional<ObjectId> id = ObjectId::fromHex(commitID);
+    std::optional<size_t> at = id ? index.indexOf(*id) : std::nullopt;
+    if (!at) {
+        return commitID;
+    }
+    std::string current = commitID;
+    while (!index.mayChange(*at, path) && (shallow.empty() || !shallow.contains(current))) {
+        std::optional<size_t> parent = index.parent(*at);
+        if (!parent) {
+            break;
+        }
+        Trace::count("commits skipped by filters");
+        at = parent;
+        current = index.id(*at).hex();
+    }
+    return current;
+}
+
+bool Repo::changes(const Commit& commit, const std::string& path) const {
+    std::unordered_map<std::string, std::string> blobs = commit.getBlobs();
+    auto it = blobs.find(path);
+    std::string parentID = parentOf(commit);
+    std::string before;
+    if (!parentID.empty()) {
+        std::unordered_map<std::string, std::string> parentBlobs = getCommit(parentID).getBlobs();
+        auto found = parentBlobs.find(path);
+        if (found != parentBlobs.end()) {
+            before = found->second;
+        }
+    }
+    return (it == blobs.end() ? std::string() : it->second) != before;
+}
+
+// Walks back from commitID until a commit with a bitmap, which then stands
+// for everything further back. Without an index this walks the whole chain.
+Repo::Reachable Repo::reachableFrom(const std::string& commitID) const {
+    Reachable result;
+    extendReachable(result, commitID);
+    return result;
+}
+
+// A bitmap covers everything behind its commit, so with a boundary to stop
+// at the walk goes without them.
+Task<Repo::Reachable> Repo::loadReachable(std::string commitID) const {
+    co_return reachableFrom(commitID);
+}
+
+void Repo::extendReachable(Reachable& reach, const std::string& commitID,
+                           const std::unordered_set<std::string>* boundary) const {
+    GITLET_TRACE_SCOPE("Repo::reachableFrom");
+    const BitmapIndex& index = bitmapIndex();
+    bool useBitmaps = boundary == nullptr || boundary->empty();
+    std::string current = commitID;
+    while (!current.empty() && !reaches(reach, ObjectType::Commit, current)) {
+        std::optional<ObjectId> id = ObjectId::fromHex(current);
+        std::optional<EwahBitmap> bitmap = id && useBitmaps ? index.bitmap(*id) : std::nullopt;
+        if (bitmap) {
+            reach.bitmap = reach.bitmap ? *reach.bitmap | *bitmap : std::move(*bitmap);
+            break;
+        }
+        Commit commit = getCommit(current);
+        if (commit.getOwnHash().empty() || !id) {
+            break;
+        }
+        reach.commits.insert(*id);
+        for (const auto& [fileName, blobHash] : commit.getBlobs()) {
+            if (std::optional<ObjectId> blob = ObjectId::fromHex(blobHash)) {
+                reach.blobs.insert(*blob);
+            }
+        }
+        current = boundary != nullptr && boundary->count(current) ? std::string() : parentOf(commit);
+    }
+}
+
+bool Repo::reaches(const Reachable& from, ObjectType type, const std::string& id) const {
+    std::optional<ObjectId> raw = ObjectId::fromHex(id);
+    if (!raw) {
+        return false;
+    }
+    if ((type == ObjectType::Commit ? from.commits : from.blobs).contains(*raw)) {
+        return true;
+    }
+    if (!from.bitmap) {
+        return false;
+    }
+    std::optional<size_t> index = bitmapIndex().indexOf(type, *raw);
+    return index && from.bitmap->test(*index);
+}
+
+std::optional<std::string> Repo::resolveRevision(const std::string& name) const {
+    std::optional<std::string> commitID = refs.resolve(name);
+    if (commitID) {
+        return commitID;
+    }
+    if (objects.has(ObjectType::Commit, name)) {
+        return name;
+    }
+    std::vector<std::string> matches = matchCommits(name, 2);
+    if (matches.size() == 1) {
+        return matches[0];
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> Repo::resolveCommit(const std::string& name) const {
+    std::optional<std::string> commitID = resolveRevision(name);
+    if (commitID) {
+        return commitID;
+    }
+    // Enough candidates to tell them apart, not the whole range.
+    std::vector<std::string> candidates = matchCommits(name, 10);
+    if (candidates.size() < 2) {
+        std::cout << "No commit with that id exists." << std::endl;
+        return std::nullopt;
+    }
+    std::cout << "Commit id " << name << " is ambiguous. Candidates:\n";
+    for (const auto& candidate : candidates) {
+        Commit commit = getCommit(candidate);
+        std::cout << "  " << abbreviate(candidate, name.size() + 1) << " " << commit.getDatetime() << " "
+                  << commit.getMessage() << "\n";
+    }
+    std::cout.flush();
+    return std::nullopt;
+}
+
+std::vector<FileChange> Repo::diff(const std::string& fromID, const std::string& toID) {
+    GITLET_TRACE_SCOPE("Repo::diff");
+    return changesBetween(getCommit(fromID), getCommit(toID), true);
+}
+
+std::optional<std::vector<BlameLine>> Repo::blame(const std::string& commitID, const std::string& fileName) {
+    Blame blame(workingDir / ".gitlet", [this](const std::string& id) { return getCommit(id); },
+                [this](const std::string& blobHash) { return readBlob(blobHash); },
+                [this, &fileName](const Commit& commit) {
+                    std::string parentID = parentOf(commit);
+                    return parentID.empty() ? parentID : skipUnchanged(parentID, fileName);
+                });
+    std::optional<std::vector<BlameLine>> lines = blame.run(commitID, fileName);
+    if (!lines) {
+        std::cout << "File does not exist in that commit." << std::endl;
+    }
+    return lines;
+}
+
+std::vector<FileChange> Repo::changesBetween(const Commit& from, const Commit& to, bool findCopies) {
+    std::string renames = config.getString("diff.renames", "true");
+    unsigned threshold = static_cast<unsigned>(std::clamp(config.getInt("diff.renameThreshold", 50), 0LL, 100LL));
+    RenameDetector::Detect detect = renames == "false" ? RenameDetector::Detect::Nothing
+                                  : findCopies && renames == "copies" ? RenameDetector::Detect::Copies
+                                  : RenameDetector::Detect::Renames;
+    bool copies = detect == RenameDetector::Detect::Copies;
+
+    // Everything that may be sketched is fetched first, so the loader never
+    // reaches the promisor remote from a worker.
+    std::unordered_map<std::string, std::string> before = from.getBlobs();
+    std::unordered_map<std::string, std::string> after = to.getBlobs();
+    std::vector<std::string> needed;
+    for (const auto& [fileName, blobHash] : before) {
+        if (copies || after.find(fileName) == after.end()) {
+            needed.push_back(blobHash);
+        }
+    }
+    for (const auto& [fileName, blobHash] : after) {
+        if (before.find(fileName) == before.end()) {
+            needed.push_back(blobHash);
+        }
+    }
+    if (detect != RenameDetector::Detect::Nothing && threshold > 0) {
+        prefetchBlobs(needed);
+        objects.packs();
+    }
+    RenameDetector detector([this](const std::string& blobHash) {
+        std::optional<std::vector<char>> data = objects.read(ObjectType::Blob, blobHash);
+        if (!data) {
+            throw std::invalid_argument("missing blob " + blobHash);
+        }
+        return std::move(*data);
+    }, executor(), detect, threshold);
+    return detector.diff(before, after);
+}
+
+CommitWalker Repo::commitWalker() const {
+    long long threads = std::clamp(config.getInt("core.walkThreads", 0), 0LL, 256LL);
+    return CommitWalker(objects, [this](const Commit& commit) { return parentOf(commit); }, static_cast<unsigned>(threads));
+}
+
+std::vector<std::string> Repo::matchCommits(const std::string& prefix, size_t limit) const {
+    std::optional<ObjectIdPrefix> parsed = ObjectIdPrefix::fromHex(prefix);
+    std::vector<std::string> matches;
+    if (!parsed || parsed->digits < minimumAbbreviation) {
+        return matches;
+    }
+    for (const ObjectId& id : objects.matchPrefix(ObjectType::Commit, *parsed, limit)) {
+        matches.push_back(id.hex());
+    }
+    return matches;
+}
+
+std::string Repo::abbreviate(const std::string& commitID, size_t minLength) const {
+    for (size_t length = std::max(minLength, minimumAbbreviation); length < commitID.size(); length++) {
+        if (matchCommits(commitID.substr(0, length), 2).size() < 2) {
+            return commitID.substr(0, length);
+        }
+    }
+    return commitID;
+}
+
+bool Repo::isAncestor(const std::string& ancestorID, const std::string& commitID) const {
+    return reaches(reachableFrom(commitID), ObjectType::Commit, ancestorID);
+}
+
+ObjectCount Repo::countObjects(const std::string& commitID) const {
+    Reachable reach = reachableFrom(commitID);
+    ObjectCount count;
+    count.commits = reach.commits.size();
+    count.blobs = reach.blobs.size();
+    if (!reach.bitmap) {
+        return count;
+    }
+
+    // Commits are numbered before blobs, so a mask of the first commitCount
+    // bits splits the bitmap's population between the two.
+    const BitmapIndex& index = bitmapIndex();
+    std::vector<uint64_t> mask(index.commitCount() / 64, ~uint64_t(0));
+    if (index.commitCount() % 64 != 0) {
+        mask.push_back((uint64_t(1) << (index.commitCount() % 64)) - 1);
+    }
+    size_t reachable = reach.bitmap->count();
+    size_t commits = (*reach.bitmap & EwahBitmap::fromWords(mask)).count();
+    count.commits += commits;
+    count.blobs += reachable - commits;
+    // A blob kept by a walked commit may be in the bitmap too.
+    reach.blobs.forEach([&](const ObjectId& id) {
+        std::optional<size_t> blob = index.indexOf(ObjectType::Blob, id);
+        if (blob && reach.bitmap->test(*blob)) {
+            count.blobs--;
+        }
+    });
+    return count;
+}
+
+Config& Repo::getConfig() {
+    return config;
+}
+
+const fs::path& Repo::getWorkingDir() const {
+    return workingDir;
+}
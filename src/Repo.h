@@ -7,13 +7,66 @@
 #include "Commit.h"
 #include "StagingArea.h"
 #include "Utils.h"
+#include "RefStore.h"
+#include "LockFile.h"
+#include "ObjectStore.h"
+#include "Config.h"
+#include "GarbageCollector.h"
+#include "IoEngine.h"
+#include "Executor.h"
+#include "Task.h"
+#include "BitmapIndex.h"
+#include "Blame.h"
+#include "ChangedPathIndex.h"
+#include "FastStream.h"
+#include "Fsck.h"
+#include "LfsStore.h"
+#include "MemoryBudget.h"
+#include "ShallowBoundary.h"
+#include "SparseCheckout.h"
+#include "SpillSet.h"
+#include <functional>
+#include <memory>
+#include <optional>
 #include <unordered_set> 
+#include <vector>
+#include "History.h"
+#include "CommitWalker.h"
+#include "RenameDetector.h"
 
 namespace fs = std::filesystem;
 
+class Channel;
+class Connection;
+
+// Snapshot of the repository reported by Repo::status. All lists are sorted.
+struct Status {
+    std::string currentBranch;
+    std::vector<std::string> branches;
+    std::vector<std::string> stagedFiles;
+    std::vector<std::string> removedFiles;
+    std::vector<std::string> modifiedFiles;
+    std::vector<std::string> untrackedFiles;
+};
+
+// Objects reachable from a commit, reported by Repo::countObjects.
+struct ObjectCount {
+    size_t commits = 0;
+    size_t blobs = 0;
+};
+
+// Limits on what clone copies: only the commits within depth of each branch
+// tip (0 for all of them), and no blobs up front when blobless, leaving them
+// to be fetched from the remote when first needed.
+struct CloneOptions {
+    long depth = 0;
+    bool blobless = false;
+};
+
 class Repo {
 public:
     Repo();
+    explicit Repo(const fs::path& dir);
 
     void init();
     std::string getHEAD() const;
@@ -21,27 +74,238 @@ public:
     void add(const std::string& fileName);
     void commitment(const std::string& msg);
     void rm(const std::string& fileName);
-    void log() const;
-    void global() const;
-    void find(const std::string& msg) const;
-    void status() const;
+    History log(const LogOptions& options = LogOptions()) const;
+    // The history of every branch, newest first, within the options.
+    std::vector<Commit> logAll(const LogOptions& options) const;
+    // Every commit in the repository, reachable or not, newest first.
+    std::vector<Commit> global() const;
+    std::vector<std::string> find(const std::string& msg) const;
+    Status status() const;
     void checkout(const std::vector<std::string>& args);
     void branch(const std::string& branchName);
     void rmb(const std::string& branchName);
+    void packRefs();
+    GcResult gc(GcOptions options = GcOptions());
+    // Verifies every object, branch and the stage; changes nothing.
+    FsckResult fsck();
+    Config& getConfig();
+    // Commit id named by a branch, a full commit id or an abbreviation of at
+    // least four hex digits that only one commit starts with.
+    std::optional<std::string> resolveRevision(const std::string& name) const;
+    // resolveRevision, printing why when name names no single commit.
+    std::optional<std::string> resolveCommit(const std::string& name) const;
+    // The shortest prefix of commitID, at least minLength digits long, that
+    // no other commit starts with.
+    std::string abbreviate(const std::string& commitID, size_t minLength) const;
+    bool isAncestor(const std::string& ancestorID, const std::string& commitID) const;
+    ObjectCount countObjects(const std::string& commitID) const;
+    // Changes from one commit to another, with renames and, per diff.renames,
+    // copies detected.
+    std::vector<FileChange> diff(const std::string& fromID, const std::string& toID);
+    // Each line of fileName as commitID has it, with the commit that last
+    // changed it.
+    std::optional<std::vector<BlameLine>> blame(const std::string& commitID, const std::string& fileName);
+    // Rebuilds the changed-path filters for every commit a branch reaches;
+    // returns how many commits got one.
+    size_t writeChangedPaths();
+    // Rebuilds the reachability bitmaps; returns how many were written.
+    size_t writeBitmaps();
+    const SparseCheckout& getSparseCheckout() const;
+    // Changes the sparse patterns and updates the working tree to match.
+    void setSparseCheckout(const std::vector<std::string>& patterns);
+    void disableSparseCheckout();
+    // Copies the repository at source into destination, which must be absent
+    // or empty, and checks out the branch the source has checked out.
+    static void clone(const std::string& source, const fs::path& destination,
+                      const CloneOptions& options = CloneOptions());
+    void addRemote(const std::string& name, const std::string& url);
+    void rmRemote(const std::string& name);
+    // Brings a remote's branches, or one of them, in as <remote>/<branch>.
+    void fetch(const std::string& remote, const std::optional<std::string>& branch = std::nullopt);
+    // Points the remote's branch at the current commit.
+    void push(const std::string& remote, const std::string& branch);
+    void pull(const std::string& remote, const std::string& branch);
+    // Server sides of fetch and push; return an exit status. A push to the
+    // checked-out branch is refused unless receive.denyCurrentBranch is false.
+    int uploadPack(Channel& channel);
+    int receivePack(Channel& channel);
+    // Reads a fast-import stream into one pack and moves its branches; the
+    // working tree is left as it is.
+    ImportResult fastImport(Channel& in);
+    // Writes the history of branchNames, or of every branch, as a
+    // fast-import stream. Returns false, writing nothing, if a branch does
+    // not exist.
+    bool fastExport(Channel& out, const std::vector<std::string>& branchNames);
     void reset(const std::string& commitID);
     void merge(const std::string& bName);
     Commit findSplitPoint(const Commit& currentCommit, const Commit& branchCommit);
     void checkoutFile(const Commit& commit, const std::string& fileName);
-    std::unordered_set<std::string> getAllAncestors(const Commit& commit);
+    // The parent walks follow: none for a commit on the shallow boundary.
+    std::string parentOf(const Commit& commit) const;
+    // The nearest commit from commitID back along parentOf that may have
+    // changed path, going by the changed-path filters without reading any
+    // commit; the oldest commit reached if none may have.
+    std::string skipUnchanged(const std::string& commitID, const std::string& path) const;
+    // Whether commit's blob for path differs from its parent's.
+    bool changes(const Commit& commit, const std::string& path) const;
     void serializeStage();
     Commit deserializeCommit(const std::string& path) const;
+    Commit getCommit(const std::string& commitID) const;
+    const fs::path& getWorkingDir() const;
     void serializeCommit(const Commit& commit, const std::string& path);
     void deserializeStage();
-    void handleConflict(const std::string& fileName, const std::string& currentBlobHash, const std::string& branchBlobHash);
+    Task<void> handleConflict(std::string fileName, std::string currentBlobHash, std::string branchBlobHash);
 private:
     std::string HEAD;
     StagingArea stage;
     fs::path workingDir;
+    RefStore refs;
+    ObjectStore objects;
+    Config config;
+    SparseCheckout sparse;
+    ShallowBoundary shallow;
+    LfsStore lfs;
+    std::unique_ptr<LockFile> stageLockFile;
+    mutable std::unique_ptr<BitmapIndex> bitmaps;
+    mutable std::unique_ptr<ChangedPathIndex> changedPaths;
+    mutable std::unique_ptr<IoEngine> io;
+    // Last, so its workers are joined before anything they may touch goes.
+    mutable std::unique_ptr<Executor> exec;
+
+    // What a commit reaches: the commits walked back to the nearest commit
+    // with a bitmap, their blobs, and that bitmap. The sets spill to disk
+    // under a memory budget.
+    struct Reachable {
+        SpillSet commits;
+        SpillSet blobs;
+        std::optional<EwahBitmap> bitmap;
+    };
+
+    // Holds the stage lock for the duration of a command that changes the
+    // stage; serializeStage() publishes through it.
+    class StageLock {
+    public:
+        explicit StageLock(Repo& repo);
+        ~StageLock();
+    private:
+        Repo& repo;
+    };
+
+    // Branches a remote offers and the branch its HEAD names.
+    struct Advertisement {
+        std::vector<std::pair<std::string, std::string>> branches;
+        std::string head;
+    };
+
+    // What the receiving side asked to leave out of a pack: commits further
+    // than depth from a want, history behind its own shallow boundary, and
+    // blobs unless wanted.
+    struct PackFilter {
+        long depth = 0;
+        bool blobs = true;
+        std::unordered_set<std::string> shallow;
+    };
+
+    // The objects to send, blobs first, and the sent commits whose parents
+    // were left out, which become the receiver's shallow boundary.
+    struct PackPlan {
+        std::vector<std::pair<ObjectType, ObjectId>> objects;
+        std::vector<std::string> shallow;
+    };
+
+    bool stageFile(const std::string& fileName);
+    // The blob a working file is staged as: its contents, or for a file
+    // lfs.track matches, the pointer to them in the large file store.
+    std::vector<char> stagedBlob(const std::string& fileName);
+    // The id of stagedBlob(fileName), without storing anything.
+    std::string workingBlobHash(const std::string& fileName) const;
+    // Writes a blob to the working tree, materializing a large file pointer.
+    // A blob the memory budget has no room for is copied a piece at a time.
+    void writeWorkingFile(const std::string& fileName, const std::string& blobHash);
+    // Whether a blob is too big for the memory budget to read whole.
+    bool overBudget(const std::string& blobHash) const;
+    // Writes large files from their pointers, reporting any whose content
+    // the store lacks.
+    void materializeLarge(const std::vector<std::pair<fs::path, LfsStore::Pointer>>& files);
+    // Stages many files with their reads and blob writes batched.
+    void stageFiles(const std::vector<std::string>& fileNames);
+    // The engine chosen by core.ioEngine, with core.ioQueueDepth.
+    IoEngine& ioEngine() const;
+    // Another such engine, for a stage that runs beside the first.
+    std::unique_ptr<IoEngine> makeIoEngine() const;
+    // The executor chosen by core.executor, "threads" or "inline", with
+    // core.executorThreads workers.
+    Executor& executor() const;
+
+    using Contents = std::vector<std::optional<std::vector<char>>>;
+    // Reads count items a batch at a time with read(begin, end, engine) and
+    // hands each batch to consume(begin, contents). The next batch is read
+    // on the executor, through an engine of its own, while consume works.
+    Task<void> pipelineReads(size_t count, std::function<Contents(size_t, size_t, IoEngine&)> read,
+                             std::function<void(size_t, Contents&)> consume) const;
+    Task<void> mergeBranch(std::string branchName);
+    Task<Reachable> loadReachable(std::string commitID) const;
+    // Reads a blob the store has; an empty ID reads as empty.
+    Task<std::vector<char>> loadBlob(std::string blobHash) const;
+    void storeCommit(const Commit& commit);
+    // Fetches a blob from the promisor remote when a blobless clone lacks it.
+    std::vector<char> readBlob(const std::string& blobHash);
+    // Fetches whichever of blobIDs are missing in one request to the promisor.
+    void prefetchBlobs(const std::vector<std::string>& blobIDs);
+    std::optional<std::string> promisorRemote() const;
+
+    // Tracked files whose working copy differs, each list sorted.
+    struct WorkingTreeChanges {
+        std::vector<std::string> modified;
+        std::vector<std::string> deleted;
+    };
+    // The current commit's files with the stage applied.
+    std::unordered_map<std::string, std::string> trackedFiles() const;
+    WorkingTreeChanges workingTreeChanges(const std::unordered_map<std::string, std::string>& tracked) const;
+    // Whether an untracked, unignored file would be overwritten by target.
+    bool untrackedInTheWay(const Commit& target) const;
+    // Writes target's files and removes the files the current commit tracks
+    // and target does not. Returns false, changing nothing, if an untracked
+    // file is in the way.
+    bool checkoutCommit(const Commit& target);
+    // Writes missing tracked files inside the sparse set and removes
+    // unmodified ones outside it.
+    void applySparseCheckout();
+    // Removes a working file and any directories it leaves empty.
+    void removeWorkingFile(const std::string& fileName);
+    const BitmapIndex& bitmapIndex() const;
+    const ChangedPathIndex& changedPathIndex() const;
+    Reachable reachableFrom(const std::string& commitID) const;
+    // A walker following parentOf on core.walkThreads threads.
+    CommitWalker commitWalker() const;
+    // Changes between two commits as diff.renames and diff.renameThreshold
+    // ask: "true" detects renames, "copies" copies too, "false" neither.
+    std::vector<FileChange> changesBetween(const Commit& from, const Commit& to, bool findCopies);
+    // Commit ids starting with prefix, sorted, at most limit of them.
+    std::vector<std::string> matchCommits(const std::string& prefix, size_t limit) const;
+    // The nearest commit on currentCommit's chain within branchReach.
+    Commit splitPointWithin(const Commit& currentCommit, const Reachable& branchReach);
+    // Adds what commitID reaches to reach, stopping where reach already covers
+    // and, if given, after any commit of boundary.
+    void extendReachable(Reachable& reach, const std::string& commitID,
+                         const std::unordered_set<std::string>* boundary = nullptr) const;
+    bool reaches(const Reachable& from, ObjectType type, const std::string& id) const;
+    std::optional<std::string> remoteUrl(const std::string& remote) const;
+    // Starts upload-pack or receive-pack for a URL; nullptr if there is no
+    // repository there.
+    static std::unique_ptr<Connection> connect(const std::string& url, const std::string& service);
+    void advertise(Channel& channel) const;
+    static std::optional<Advertisement> readAdvertisement(Channel& channel);
+    std::optional<Advertisement> fetchFrom(const std::string& remote, const std::string& url,
+                                           const std::optional<std::string>& branch, long depth = 0);
+    // Commits offered as haves: every branch tip and ancestors of it at
+    // exponentially growing distances.
+    std::vector<std::string> negotiationHaves() const;
+    // Commits and blobs reachable from wants that the haves do not reach.
+    PackPlan missingObjects(const std::vector<std::string>& wants, const std::vector<std::string>& haves,
+                            const PackFilter& filter) const;
+    // Sends a pack, first fetching any blobs a blobless clone is missing.
+    void sendPack(Channel& channel, const std::vector<std::pair<ObjectType, ObjectId>>& objects);
 
     Commit getCurrentCommit() const;
     fs::path findFile(const std::string& fileName, const fs::path& dir) const;
@@ -0,0 +1,47 @@
+#include "ShallowBoundary.h"
+#include "LockFile.h"
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+ShallowBoundary::ShallowBoundary(const fs::path& gitletDir) : file(gitletDir / "shallow") {
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) {
+            commits.insert(line);
+        }
+    }
+}
+
+bool ShallowBoundary::empty() const {
+    return commits.empty();
+}
+
+bool ShallowBoundary::contains(const std::string& commitID) const {
+    return !commits.empty() && commits.count(commitID) != 0;
+}
+
+const std::unordered_set<std::string>& ShallowBoundary::getCommits() const {
+    return commits;
+}
+
+void ShallowBoundary::set(const std::unordered_set<std::string>& newCommits) {
+    if (newCommits == commits) {
+        return;
+    }
+    LockFile lock(file);
+    if (newCommits.empty()) {
+        fs::remove(file);
+        lock.release();
+    } else {
+        std::vector<std::string> sorted(newCommits.begin(), newCommits.end());
+        std::sort(sorted.begin(), sorted.end());
+        std::string contents;
+        for (const auto& commitID : sorted) {
+            contents += commitID + "\n";
+        }
+        lock.commit(contents);
+    }
+    commits = newCommits;
+}
@@ -0,0 +1,30 @@
+#ifndef SHALLOWBOUNDARY_H
+#define SHALLOWBOUNDARY_H
+
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+// The commits of a shallow clone whose parents were not fetched, one id per
+// line in .gitlet/shallow. Every walk over history treats them as root
+// commits, so log, ancestry and split points stop there instead of at a
+// missing object. Without the file the repository has full history.
+class ShallowBoundary {
+public:
+    explicit ShallowBoundary(const fs::path& gitletDir);
+
+    bool empty() const;
+    bool contains(const std::string& commitID) const;
+    const std::unordered_set<std::string>& getCommits() const;
+
+    // Replaces the boundary; an empty one removes the file.
+    void set(const std::unordered_set<std::string>& commits);
+
+private:
+    fs::path file;
+    std::unordered_set<std::string> commits;
+};
+
+#endif // SHALLOWBOUNDARY_H
@@ -0,0 +1,56 @@
+#include "SparseCheckout.h"
+#include "LockFile.h"
+#include <fstream>
+
+SparseCheckout::SparseCheckout(const fs::path& gitletDir) : file(path(gitletDir)), isEnabled(false) {
+    load();
+}
+
+fs::path SparseCheckout::path(const fs::path& gitletDir) {
+    return gitletDir / "info" / "sparse-checkout";
+}
+
+void SparseCheckout::load() {
+    std::ifstream in(file);
+    isEnabled = in.good();
+    patterns.clear();
+    rules = IgnoreRules();
+    std::string line;
+    while (std::getline(in, line)) {
+        patterns.push_back(line);
+        rules.add(line);
+    }
+}
+
+bool SparseCheckout::enabled() const {
+    return isEnabled;
+}
+
+bool SparseCheckout::includes(const std::string& path) const {
+    return !isEnabled || path.find('/') == std::string::npos || rules.ignoredPath(path);
+}
+
+const std::vector<std::string>& SparseCheckout::getPatterns() const {
+    return patterns;
+}
+
+void SparseCheckout::set(const std::vector<std::string>& newPatterns) {
+    fs::create_directories(file.parent_path());
+    LockFile lock(file);
+    std::string contents;
+    for (const auto& pattern : newPatterns) {
+        contents += pattern + "\n";
+    }
+    lock.commit(contents);
+    load();
+}
+
+void SparseCheckout::disable() {
+    if (!fs::exists(file)) {
+        return;
+    }
+    LockFile lock(file);
+    fs::remove(file);
+    lock.release();
+    load();
+}
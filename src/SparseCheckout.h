@@ -0,0 +1,39 @@
+#ifndef SPARSECHECKOUT_H
+#define SPARSECHECKOUT_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "IgnoreRules.h"
+
+namespace fs = std::filesystem;
+
+// The part of the tree that is checked out, from the patterns in
+// .gitlet/info/sparse-checkout. Patterns use the .gitletignore syntax, but
+// here a match includes the path, and everything under a matched directory
+// is included. Files directly in the working directory are always included,
+// so `sparse-checkout set src/app/` keeps the top-level build files too.
+// Without the file every path is included.
+class SparseCheckout {
+public:
+    explicit SparseCheckout(const fs::path& gitletDir);
+
+    static fs::path path(const fs::path& gitletDir);
+
+    bool enabled() const;
+    bool includes(const std::string& path) const;
+    const std::vector<std::string>& getPatterns() const;
+
+    void set(const std::vector<std::string>& patterns);
+    void disable();
+
+private:
+    fs::path file;
+    bool isEnabled;
+    std::vector<std::string> patterns;
+    IgnoreRules rules;
+
+    void load();
+};
+
+#endif // SPARSECHECKOUT_H
@@ -0,0 +1,194 @@
+#include "SpillSet.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// What an id costs in the hash set: the id, its node and its bucket.
+const uint64_t entryBytes = 64;
+}
+
+// A file of sorted ids, mapped for as long as the set lives.
+class SpillSet::Run {
+public:
+    explicit Run(fs::path file) : path(std::move(file)), data(nullptr), bytes(0) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::invalid_argument("could not open spilled ids");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const unsigned char*>(mapped);
+                bytes = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~Run() {
+        if (data != nullptr) {
+            ::munmap(const_cast<unsigned char*>(data), bytes);
+        }
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+
+    Run(const Run&) = delete;
+    Run& operator=(const Run&) = delete;
+
+    // A name no other run of this process has.
+    static fs::path newPath() {
+        static std::atomic<unsigned> sequence{0};
+        fs::path dir = MemoryBudget::spillDirectory();
+        fs::create_directories(dir);
+        return dir / ("spill-" + std::to_string(getpid()) + "-" + std::to_string(sequence++));
+    }
+
+    size_t count() const {
+        return bytes / ObjectId::size;
+    }
+
+    ObjectId at(size_t index) const {
+        ObjectId id;
+        std::memcpy(id.bytes.data(), data + index * ObjectId::size, ObjectId::size);
+        return id;
+    }
+
+    bool contains(const ObjectId& id) const {
+        size_t lo = 0;
+        size_t hi = count();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(id.bytes.data(), data + mid * ObjectId::size, ObjectId::size);
+            if (cmp == 0) {
+                return true;
+            } else if (cmp < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return false;
+    }
+
+private:
+    fs::path path;
+    const unsigned char* data;
+    size_t bytes;
+};
+
+SpillSet::SpillSet() : total(0) {}
+
+SpillSet::~SpillSet() = default;
+SpillSet::SpillSet(SpillSet&&) noexcept = default;
+SpillSet& SpillSet::operator=(SpillSet&&) noexcept = default;
+
+bool SpillSet::insert(const ObjectId& id) {
+    for (const auto& run : runs) {
+        if (run->contains(id)) {
+            return false;
+        }
+    }
+    if (!memory.insert(id).second) {
+        return false;
+    }
+    total++;
+    if (MemoryBudget::limited()) {
+        charge.resize(memory.size() * entryBytes);
+        if (memory.size() * entryBytes > MemoryBudget::limit() / 4) {
+            spill();
+        }
+    }
+    return true;
+}
+
+bool SpillSet::contains(const ObjectId& id) const {
+    if (memory.count(id)) {
+        return true;
+    }
+    for (const auto& run : runs) {
+        if (run->contains(id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SpillSet::size() const {
+    return total;
+}
+
+void SpillSet::forEach(const std::function<void(const ObjectId&)>& visit) const {
+    for (const ObjectId& id : memory) {
+        visit(id);
+    }
+    for (const auto& run : runs) {
+        for (size_t i = 0; i < run->count(); i++) {
+            visit(run->at(i));
+        }
+    }
+}
+
+void SpillSet::spill() {
+    GITLET_TRACE_SCOPE("SpillSet::spill");
+    std::vector<ObjectId> sorted(memory.begin(), memory.end());
+    std::sort(sorted.begin(), sorted.end());
+    fs::path path = Run::newPath();
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        for (const ObjectId& id : sorted) {
+            out.write(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+        }
+        if (!out) {
+            throw std::invalid_argument("could not spill ids to " + path.string());
+        }
+    }
+    runs.push_back(std::make_unique<Run>(path));
+    Trace::count("ids spilled", sorted.size());
+    // Clearing keeps the buckets; a fresh set gives them back.
+    memory = std::unordered_set<ObjectId, ObjectIdHash>();
+    charge.resize(0);
+    if (runs.size() > maxRuns) {
+        mergeRuns();
+    }
+}
+
+void SpillSet::mergeRuns() {
+    GITLET_TRACE_SCOPE("SpillSet::mergeRuns");
+    using Head = std::pair<ObjectId, std::pair<size_t, size_t>>;   // id, run, position
+    auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i]->count() > 0) {
+            heads.push({runs[i]->at(0), {i, 0}});
+        }
+    }
+    fs::path path = Run::newPath();
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        while (!heads.empty()) {
+            auto [id, where] = heads.top();
+            heads.pop();
+            out.write(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+            if (where.second + 1 < runs[where.first]->count()) {
+                heads.push({runs[where.first]->at(where.second + 1), {where.first, where.second + 1}});
+            }
+        }
+        if (!out) {
+            throw std::invalid_argument("could not spill ids to " + path.string());
+        }
+    }
+    runs.clear();
+    runs.push_back(std::make_unique<Run>(path));
+}
@@ -0,0 +1,52 @@
+#ifndef SPILLSET_H
+#define SPILLSET_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include "MemoryBudget.h"
+#include "ObjectId.h"
+
+namespace fs = std::filesystem;
+
+// A set of object ids that keeps no more than a quarter of the memory
+// budget in memory. When the ids held would go over, they are sorted and
+// written out as a run, a file of raw 20-byte ids in the budget's spill
+// directory, which from then on is memory-mapped and binary searched. Runs
+// never share an id, since an id is only added after every run was
+// searched for it, and past maxRuns they are merged into one, so a lookup
+// searches at most that many files. Without a budget it is a plain hash
+// set. The runs are deleted with the set.
+class SpillSet {
+public:
+    static constexpr size_t maxRuns = 8;
+
+    SpillSet();
+    ~SpillSet();
+
+    SpillSet(SpillSet&&) noexcept;
+    SpillSet& operator=(SpillSet&&) noexcept;
+
+    // Returns whether id was not in the set before.
+    bool insert(const ObjectId& id);
+    bool contains(const ObjectId& id) const;
+    size_t size() const;
+    // Calls visit for every id once, in no particular order.
+    void forEach(const std::function<void(const ObjectId&)>& visit) const;
+
+private:
+    class Run;
+
+    std::unordered_set<ObjectId, ObjectIdHash> memory;
+    std::vector<std::unique_ptr<Run>> runs;
+    size_t total;
+    MemoryBudget::Charge charge;
+
+    void spill();
+    void mergeRuns();
+};
+
+#endif // SPILLSET_H
@@ -0,0 +1,248 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "Executor.h"
+
+// C++20 coroutine building blocks for overlapping I/O with work.
+//
+//   Task<T>    a lazy coroutine: nothing runs until it is awaited, and it
+//              resumes its awaiter when it finishes
+//   spawn()    starts a Task on an Executor now and returns a Future
+//   Future<T>  awaits a spawned Task's result, once
+//   whenAll()  awaits every Future of a list
+//   syncWait() runs a Task from ordinary code and blocks for its result
+//
+// Exceptions travel with results: awaiting a Task or Future that threw
+// rethrows in the awaiter.
+
+template <typename T>
+class Task;
+
+namespace detail {
+template <typename T>
+struct TaskResult {
+    std::optional<T> value;
+    void return_value(T result) { value = std::move(result); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskResult<void> {
+    void return_void() {}
+    void take() {}
+};
+
+// A coroutine nobody awaits; its frame is freed when it finishes.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+}
+
+template <typename T = void>
+class Task {
+public:
+    struct promise_type : detail::TaskResult<T> {
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                std::coroutine_handle<> next = handle.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() {
+        if (handle.promise().error) {
+            std::rethrow_exception(handle.promise().error);
+        }
+        return handle.promise().take();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+};
+
+template <typename T = void>
+class Future {
+public:
+    struct State {
+        std::mutex mutex;
+        bool done = false;
+        std::coroutine_handle<> waiter;
+        std::exception_ptr error;
+        detail::TaskResult<T> result;
+    };
+
+    Future() = default;
+    explicit Future(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+    bool valid() const { return state != nullptr; }
+
+    bool await_ready() {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->done;
+    }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->done) {
+            return false;
+        }
+        state->waiter = awaiting;
+        return true;
+    }
+    T await_resume() {
+        std::shared_ptr<State> finished = std::move(state);
+        if (finished->error) {
+            std::rethrow_exception(finished->error);
+        }
+        return finished->result.take();
+    }
+
+    // Waits for the spawned task without taking its result or exception,
+    // for unwinding while it may still use what the awaiter owns.
+    struct Settled {
+        Future& future;
+        bool await_ready() { return !future.valid() || future.await_ready(); }
+        bool await_suspend(std::coroutine_handle<> awaiting) { return future.await_suspend(awaiting); }
+        void await_resume() { future.state.reset(); }
+    };
+    Settled settled() { return Settled{*this}; }
+
+private:
+    std::shared_ptr<State> state;
+};
+
+namespace detail {
+template <typename T>
+Detached runSpawned(Executor& executor, Task<T> task, std::shared_ptr<typename Future<T>::State> state) {
+    co_await executor.schedule();
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+        } else {
+            state->result.return_value(co_await task);
+        }
+    } catch (...) {
+        state->error = std::current_exception();
+    }
+    std::coroutine_handle<> waiter;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done = true;
+        waiter = state->waiter;
+    }
+    if (waiter) {
+        waiter.resume();
+    }
+}
+
+struct Signal {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done = false;
+};
+
+template <typename T>
+Detached runBlocking(Task<T>& task, detail::TaskResult<T>& result, std::exception_ptr& error, Signal& signal) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await task;
+        } else {
+            result.return_value(co_await task);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(signal.mutex);
+    signal.done = true;
+    signal.changed.notify_all();
+}
+}
+
+// Starts task on executor. An inline executor runs it to completion first.
+template <typename T>
+Future<T> spawn(Executor& executor, Task<T> task) {
+    auto state = std::make_shared<typename Future<T>::State>();
+    detail::runSpawned<T>(executor, std::move(task), state);
+    return Future<T>(state);
+}
+
+// Awaits every future, even after one failed, then rethrows the first
+// failure.
+inline Task<void> whenAll(std::vector<Future<void>> futures) {
+    std::exception_ptr failure;
+    for (auto& future : futures) {
+        try {
+            co_await future;
+        } catch (...) {
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+template <typename T>
+T syncWait(Task<T> task) {
+    detail::TaskResult<T> result;
+    std::exception_ptr error;
+    detail::Signal signal;
+    detail::runBlocking<T>(task, result, error, signal);
+    std::unique_lock<std::mutex> lock(signal.mutex);
+    signal.changed.wait(lock, [&]() { return signal.done; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return result.take();
+}
+
+#endif // TASK_H
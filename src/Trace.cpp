@@ -0,0 +1,181 @@
+#include "Trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+struct Event {
+    std::string name;
+    int64_t startUs;
+    int64_t durationUs;
+    size_t thread;
+};
+
+struct Summary {
+    uint64_t calls = 0;
+    int64_t totalUs = 0;
+    int64_t maxUs = 0;
+};
+
+// Collects everything recorded during the process and reports it on exit.
+class Collector {
+public:
+    Collector() : origin(std::chrono::steady_clock::now()) {}
+
+    ~Collector() {
+        struct rusage usage;
+        if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+            counters["peak resident bytes"] = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+        }
+        writeTrace();
+        writeSummary();
+    }
+
+    void add(const std::string& name, std::chrono::steady_clock::time_point start,
+             std::chrono::steady_clock::time_point end) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        Event event{name, duration_cast<microseconds>(start - origin).count(),
+                    duration_cast<microseconds>(end - start).count(),
+                    std::hash<std::thread::id>()(std::this_thread::get_id())};
+        std::lock_guard<std::mutex> lock(mutex);
+        Summary& summary = summaries[name];
+        summary.calls++;
+        summary.totalUs += event.durationUs;
+        summary.maxUs = std::max(summary.maxUs, event.durationUs);
+        events.push_back(std::move(event));
+    }
+
+    void count(const char* name, uint64_t amount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters[name] += amount;
+    }
+
+    void peak(const char* name, uint64_t value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t& current = counters[name];
+        current = std::max(current, value);
+    }
+
+private:
+    std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;
+    std::vector<Event> events;
+    std::map<std::string, Summary> summaries;
+    std::map<std::string, uint64_t> counters;
+
+    static std::string escape(const std::string& str) {
+        std::string out;
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    void writeTrace() const {
+        std::string target = std::getenv("GITLET_TRACE");
+        if (target == "1" || target == "true") {
+            target = "gitlet-trace-" + std::to_string(getpid()) + ".json";
+        }
+        std::ofstream out(target);
+        if (!out) {
+            std::fprintf(stderr, "gitlet: could not write trace to %s\n", target.c_str());
+            return;
+        }
+
+        // Thread ids are remapped to small integers for the viewer.
+        std::map<size_t, int> threadIds;
+        int pid = getpid();
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (const Event& event : events) {
+            auto tid = threadIds.emplace(event.thread, static_cast<int>(threadIds.size())).first->second;
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"" << escape(event.name) << "\",\"cat\":\"gitlet\",\"ph\":\"X\""
+                << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+                << ",\"pid\":" << pid << ",\"tid\":" << tid << "}";
+            first = false;
+        }
+        int64_t endUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - origin).count();
+        for (const auto& [name, value] : counters) {
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"" << escape(name) << "\",\"cat\":\"gitlet\",\"ph\":\"C\""
+                << ",\"ts\":" << endUs << ",\"pid\":" << pid << ",\"tid\":0"
+                << ",\"args\":{\"value\":" << value << "}}";
+            first = false;
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    void writeSummary() const {
+        std::vector<std::pair<std::string, Summary>> rows(summaries.begin(), summaries.end());
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return a.second.totalUs > b.second.totalUs;
+        });
+
+        std::ostringstream table;
+        table << std::left << std::setw(32) << "scope" << std::right
+              << std::setw(10) << "calls" << std::setw(14) << "total ms"
+              << std::setw(12) << "avg us" << std::setw(12) << "max us" << "\n";
+        for (const auto& [name, summary] : rows) {
+            table << std::left << std::setw(32) << name << std::right
+                  << std::setw(10) << summary.calls
+                  << std::setw(14) << std::fixed << std::setprecision(3) << summary.totalUs / 1000.0
+                  << std::setw(12) << summary.totalUs / static_cast<int64_t>(summary.calls)
+                  << std::setw(12) << summary.maxUs << "\n";
+        }
+        if (!counters.empty()) {
+            table << "\n" << std::left << std::setw(32) << "counter" << std::right << std::setw(20) << "value" << "\n";
+            for (const auto& [name, value] : counters) {
+                table << std::left << std::setw(32) << name << std::right << std::setw(20) << value << "\n";
+            }
+        }
+        std::fputs(table.str().c_str(), stderr);
+    }
+};
+
+Collector& collector() {
+    static Collector instance;
+    return instance;
+}
+
+bool traceRequested() {
+    const char* value = std::getenv("GITLET_TRACE");
+    if (value == nullptr || *value == '\0' || std::string(value) == "0") {
+        return false;
+    }
+    // Construct the collector now so it outlives every scope recorded later.
+    collector();
+    return true;
+}
+
+} // namespace
+
+const bool Trace::active = traceRequested();
+
+void Trace::addCount(const char* name, uint64_t amount) {
+    collector().count(name, amount);
+}
+
+void Trace::addPeak(const char* name, uint64_t value) {
+    collector().peak(name, value);
+}
+
+void Trace::record(const std::string& name, std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::time_point end) {
+    collector().add(name, start, end);
+}
@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// Hot-path instrumentation, switched on by the GITLET_TRACE environment
+// variable. Set it to a file path to choose where the Chrome trace-event JSON
+// goes, or to "1" for gitlet-trace-<pid>.json in the current directory. When
+// the process exits the trace is written and a per-scope summary table is
+// printed to stderr. With tracing off a scope costs one predictable branch.
+class Trace {
+public:
+    static bool enabled() { return active; }
+
+    // Adds `amount` to a named counter, e.g. bytes read.
+    static void count(const char* name, uint64_t amount = 1) {
+        if (active) {
+            addCount(name, amount);
+        }
+    }
+
+    // Raises a named counter to `value` if it is below, e.g. peak memory.
+    static void peak(const char* name, uint64_t value) {
+        if (active) {
+            addPeak(name, value);
+        }
+    }
+
+    // Times the enclosing block as one complete ("X") trace event.
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name(name) {
+            if (active) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+        explicit Scope(const std::string& label) : name(nullptr) {
+            if (active) {
+                owned = label;
+                start = std::chrono::steady_clock::now();
+            }
+        }
+        ~Scope() {
+            if (active) {
+                record(name ? std::string(name) : owned, start, std::chrono::steady_clock::now());
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        std::string owned;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    static const bool active;
+
+    static void addCount(const char* name, uint64_t amount);
+    static void addPeak(const char* name, uint64_t value);
+    static void record(const std::string& name, std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end);
+};
+
+#define GITLET_TRACE_CONCAT_(a, b) a##b
+#define GITLET_TRACE_CONCAT(a, b) GITLET_TRACE_CONCAT_(a, b)
+#define GITLET_TRACE_SCOPE(name) Trace::Scope GITLET_TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif // TRACE_H
@@ -0,0 +1,73 @@
+#include "Transaction.h"
+#include "Trace.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+Transaction* openTransaction = nullptr;
+
+void syncPath(const fs::path& path, bool dataOnly) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (dataOnly) {
+        ::fdatasync(fd);
+    } else {
+        ::fsync(fd);
+    }
+    ::close(fd);
+}
+}
+
+Transaction::Transaction(const fs::path& repoDir) : repoDir(repoDir), outer(openTransaction), committed(false) {
+    openTransaction = this;
+}
+
+// A transaction that was never committed still flushes what it wrote, so an
+// early return from a command does not lose durability.
+Transaction::~Transaction() {
+    if (!committed) {
+        commit();
+    }
+    openTransaction = outer;
+}
+
+Transaction* Transaction::current() {
+    return openTransaction;
+}
+
+void Transaction::track(const fs::path& file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    files.insert(file);
+    directories.insert(file.parent_path());
+}
+
+void Transaction::commit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    committed = true;
+    if (files.empty()) {
+        return;
+    }
+    GITLET_TRACE_SCOPE("Transaction::commit");
+
+    bool synced = false;
+#ifdef __linux__
+    int fd = ::open(repoDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        synced = ::syncfs(fd) == 0;
+        ::close(fd);
+    }
+#endif
+    if (!synced) {
+        for (const auto& file : files) {
+            syncPath(file, true);
+        }
+        for (const auto& dir : directories) {
+            syncPath(dir, false);
+        }
+    }
+    Trace::count("durability barriers");
+    files.clear();
+    directories.clear();
+}
@@ -0,0 +1,44 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Groups every file written by one command so they are made durable with a
+// single barrier instead of one fsync per file.
+//
+// Utils::writeContents and friends always write a temporary file and rename
+// it over the target, so readers never see a torn file. While a Transaction
+// is open those writes skip their own fsync and are only recorded here;
+// commit() then issues one syncfs(2) on the repository's filesystem, falling
+// back to fdatasync of each recorded file and fsync of each touched directory
+// where syncfs is unavailable. Writes made with no open Transaction are synced
+// individually.
+class Transaction {
+public:
+    explicit Transaction(const fs::path& repoDir);
+    ~Transaction();
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    // The innermost open transaction, or nullptr.
+    static Transaction* current();
+
+    void track(const fs::path& file);
+    void commit();
+
+private:
+    fs::path repoDir;
+    Transaction* outer;
+    std::mutex mutex;
+    std::set<fs::path> files;
+    std::set<fs::path> directories;
+    bool committed;
+};
+
+#endif // TRANSACTION_H
@@ -0,0 +1,235 @@
+#include "Transport.h"
+#include "Commit.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+const char packMagic[4] = {'G', 'P', 'A', 'K'};
+const uint32_t formatVersion = 1;
+const size_t headerSize = 16;
+const size_t entryHeaderSize = 1 + ObjectId::size + 8;
+const uint64_t maxObjectSize = uint64_t(1) << 40;
+}
+
+Channel::Channel(int in, int out) : in(in), out(out), buffer(BufferedWriter::defaultCapacity), begin(0), end(0) {}
+
+bool Channel::fill() {
+    out.flush();
+    while (true) {
+        ssize_t n = ::read(in, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        begin = 0;
+        end = static_cast<size_t>(n);
+        return true;
+    }
+}
+
+bool Channel::readLine(std::string& line) {
+    line.clear();
+    while (true) {
+        if (begin == end && !fill()) {
+            return false;
+        }
+        const char* start = buffer.data() + begin;
+        const char* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+        if (newline != nullptr) {
+            line.append(start, newline);
+            begin += newline - start + 1;
+            return true;
+        }
+        line.append(start, end - begin);
+        begin = end;
+    }
+}
+
+bool Channel::read(char* data, size_t size) {
+    while (size > 0) {
+        if (begin == end && !fill()) {
+            return false;
+        }
+        size_t chunk = std::min(size, end - begin);
+        std::memcpy(data, buffer.data() + begin, chunk);
+        begin += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+void Channel::write(const std::string& data) {
+    out << data;
+}
+
+void Channel::write(const char* data, size_t size) {
+    out << std::string(data, size);
+}
+
+void Channel::flush() {
+    out.flush();
+}
+
+bool Channel::good() const {
+    return out.good();
+}
+
+Connection::Connection(const std::function<int(Channel&)>& serve) : pid(-1), fd(-1) {
+    start([&serve](int end) {
+        int status = 1;
+        try {
+            Channel child(end, end);
+            status = serve(child);
+            child.flush();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+        return status;
+    });
+}
+
+Connection::Connection(const std::string& command) : pid(-1), fd(-1) {
+    start([&command](int end) {
+        if (::dup2(end, 0) < 0 || ::dup2(end, 1) < 0) {
+            return 1;
+        }
+        ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+        return 127;
+    });
+}
+
+void Connection::start(const std::function<int(int)>& child) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    pid = ::fork();
+    if (pid == 0) {
+        ::close(fds[0]);
+        int status = child(fds[1]);
+        std::cout.flush();
+        std::cerr.flush();
+        ::_exit(status);
+    }
+    ::close(fds[1]);
+    if (pid < 0) {
+        ::close(fds[0]);
+        return;
+    }
+    fd = fds[0];
+    stream = std::make_unique<Channel>(fd, fd);
+}
+
+Connection::~Connection() {
+    finish();
+}
+
+bool Connection::valid() const {
+    return pid > 0;
+}
+
+Channel& Connection::channel() {
+    return *stream;
+}
+
+bool Connection::finish() {
+    if (pid <= 0) {
+        return false;
+    }
+    stream->flush();
+    stream.reset();
+    ::close(fd);
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    pid = -1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void PackStream::send(Channel& channel, const ObjectStore& objects, const std::vector<Object>& list) {
+    GITLET_TRACE_SCOPE("PackStream::send");
+    std::string header(packMagic, 4);
+    Utils::put32(header, formatVersion);
+    Utils::put64(header, list.size());
+    channel.write(header);
+    for (const auto& [type, id] : list) {
+        std::optional<std::vector<char>> data = objects.read(type, id.hex());
+        if (!data) {
+            throw std::invalid_argument("missing object " + id.hex());
+        }
+        std::string entry(1, static_cast<char>(type));
+        entry.append(reinterpret_cast<const char*>(id.bytes.data()), ObjectId::size);
+        Utils::put64(entry, data->size());
+        channel.write(entry);
+        channel.write(data->data(), data->size());
+        Trace::count("objects sent");
+    }
+    channel.flush();
+}
+
+std::optional<size_t> PackStream::receive(Channel& channel, ObjectStore& objects) {
+    GITLET_TRACE_SCOPE("PackStream::receive");
+    char header[headerSize];
+    if (!channel.read(header, headerSize) || std::memcmp(header, packMagic, 4) != 0) {
+        return std::nullopt;
+    }
+    uint64_t count = Utils::get64(header + 8);
+
+    ObjectStore::PackWriter writer(objects.packsDir());
+    std::vector<char> data;
+    for (uint64_t i = 0; i < count; i++) {
+        char entry[entryHeaderSize];
+        if (!channel.read(entry, entryHeaderSize)) {
+            return std::nullopt;
+        }
+        ObjectType type = static_cast<ObjectType>(entry[0]);
+        ObjectId id;
+        std::memcpy(id.bytes.data(), entry + 1, ObjectId::size);
+        uint64_t size = Utils::get64(entry + 1 + ObjectId::size);
+        if ((type != ObjectType::Blob && type != ObjectType::Commit) || size > maxObjectSize) {
+            return std::nullopt;
+        }
+        data.resize(size);
+        if (!channel.read(data.data(), size)) {
+            return std::nullopt;
+        }
+
+        // Objects are named by their contents, so a wrong name means damage.
+        std::string hex = id.hex();
+        if (type == ObjectType::Blob && Utils::sha1(data) != hex) {
+            return std::nullopt;
+        }
+        if (type == ObjectType::Commit) {
+            // The id a commit names for itself proves nothing; its contents must hash to it.
+            std::string archive(data.begin(), data.end());
+            Commit commit;
+            try {
+                commit.deserializeFromString(archive);
+            } catch (const std::exception&) {
+                return std::nullopt;
+            }
+            if (commit.getOwnHash() != hex || Commit::contentHash(archive, hex) != hex) {
+                return std::nullopt;
+            }
+        }
+        if (!objects.has(type, hex)) {
+            writer.add(type, id, data.data(), data.size());
+        }
+        Trace::count("objects received");
+    }
+    size_t received = writer.count();
+    writer.finish();
+    objects.rescanPacks();
+    return received;
+}
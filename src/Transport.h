@@ -0,0 +1,99 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+#include "BufferedWriter.h"
+#include "ObjectId.h"
+#include "ObjectStore.h"
+
+// Moving history between repositories. A fetch or push talks to a server
+// side, upload-pack or receive-pack, over one byte stream:
+//
+//   server  "<commit id> <branch>" per branch, "HEAD <branch>", blank line
+//   fetch   "want <id>" per missing tip, "have <id>" per local commit
+//           offered, "shallow <id>" per commit of the client's shallow
+//           boundary, optionally "deepen <n>", "filter blob:none" and
+//           "blob <id>" per blob wanted by id, then "done"; the server
+//           answers "shallow <id>" per sent commit whose parent it left
+//           out, a blank line and a pack stream
+//   push    "update <old id or empty> <new id> <branch>" per branch, "done",
+//           then a pack stream; the server answers "ok" or "error <reason>"
+//
+// A pack stream has the layout of a .pack file, so the receiver indexes it
+// with a PackWriter as it arrives. For a local path the server runs in a
+// forked child connected by a socket pair. A remote "ext::<command>" runs
+// `<command> upload-pack` or `<command> receive-pack` through the shell
+// instead, talking on its stdin and stdout; `gitlet upload-pack [<dir>]` and
+// `gitlet receive-pack [<dir>]` are such servers.
+
+// Buffered reads and writes on one file descriptor.
+class Channel {
+public:
+    Channel(int in, int out);
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    // A line without its '\n'; false at the end of the stream.
+    bool readLine(std::string& line);
+    bool read(char* data, size_t size);
+    void write(const std::string& data);
+    void write(const char* data, size_t size);
+    void flush();
+    bool good() const;
+
+private:
+    int in;
+    BufferedWriter out;
+    std::vector<char> buffer;
+    size_t begin;
+    size_t end;
+
+    bool fill();
+};
+
+// The server side of a transfer, run in a forked child process. A server
+// that dies mid-transfer shows up as a failed write only if the caller
+// ignores SIGPIPE, as the gitlet command does; otherwise it ends the process.
+class Connection {
+public:
+    // serve gets the child's end of the stream and returns its exit status.
+    explicit Connection(const std::function<int(Channel&)>& serve);
+    // Runs a shell command with the child's end as its stdin and stdout.
+    explicit Connection(const std::string& command);
+    ~Connection();
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    bool valid() const;
+    Channel& channel();
+    // Closes the stream and waits for the child; returns whether it succeeded.
+    bool finish();
+
+private:
+    pid_t pid;
+    int fd;
+    std::unique_ptr<Channel> stream;
+
+    void start(const std::function<int(int)>& child);
+};
+
+class PackStream {
+public:
+    using Object = std::pair<ObjectType, ObjectId>;
+
+    static void send(Channel& channel, const ObjectStore& objects, const std::vector<Object>& list);
+    // Writes the objects from the stream into one new pack, skipping any the
+    // store has. Blob and commit contents are checked against their ids.
+    // Returns how many objects were new, or nothing if the stream is damaged.
+    static std::optional<size_t> receive(Channel& channel, ObjectStore& objects);
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,158 @@
+#include "UntrackedFiles.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const std::string cacheHeader = "# gitlet untracked cache";
+const int64_t racyNanoseconds = 2'000'000'000;
+
+int64_t nanoseconds(const struct timespec& time) {
+    return static_cast<int64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec;
+}
+}
+
+UntrackedFiles::UntrackedFiles(const fs::path& workingDir)
+    : workingDir(workingDir), cachePath(workingDir / ".gitlet" / "untracked-cache"),
+      rules(IgnoreRules::load(workingDir)), dirty(false) {
+    loadCache();
+}
+
+const IgnoreRules& UntrackedFiles::getRules() const {
+    return rules;
+}
+
+std::vector<std::string> UntrackedFiles::list(const std::unordered_map<std::string, std::string>& tracked) {
+    GITLET_TRACE_SCOPE("UntrackedFiles::list");
+    std::unordered_map<std::string, Listing> seen;
+    std::vector<std::string> out;
+    scan("", tracked, seen, out);
+    dirty = dirty || seen.size() != cache.size();
+    cache = std::move(seen);
+    if (dirty) {
+        saveCache();
+        dirty = false;
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+bool UntrackedFiles::isUntracked(const std::string& path, const std::unordered_map<std::string, std::string>& tracked) const {
+    struct stat st;
+    return tracked.find(path) == tracked.end()
+        && ::lstat((workingDir / path).c_str(), &st) == 0 && !S_ISDIR(st.st_mode)
+        && !rules.ignoredPath(path);
+}
+
+void UntrackedFiles::scan(const std::string& directory, const std::unordered_map<std::string, std::string>& tracked,
+                          std::unordered_map<std::string, Listing>& seen, std::vector<std::string>& out) {
+    struct stat st;
+    fs::path dirPath = workingDir / directory;
+    if (::lstat(dirPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return;
+    }
+    int64_t mtime = nanoseconds(st.st_mtim);
+
+    auto cached = cache.find(directory);
+    Listing& listing = seen[directory];
+    if (cached != cache.end() && cached->second.mtime != 0 && cached->second.mtime == mtime) {
+        Trace::count("directories cached");
+        listing = std::move(cached->second);
+    } else {
+        Trace::count("directories read");
+        dirty = true;
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        int64_t nowNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+        listing.mtime = mtime > nowNanoseconds - racyNanoseconds ? 0 : mtime;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dirPath, ec)) {
+            std::string name = entry.path().filename().string();
+            if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+                listing.directories.push_back(name);
+            } else {
+                listing.files.push_back(name);
+            }
+        }
+    }
+
+    for (const std::string& name : listing.files) {
+        std::string path = directory + name;
+        if (tracked.find(path) == tracked.end() && !rules.ignored(path, false)) {
+            out.push_back(path);
+        }
+    }
+    std::vector<std::string> directories = listing.directories;
+    for (const std::string& name : directories) {
+        std::string path = directory + name;
+        if (!rules.ignored(path, true)) {
+            scan(path + "/", tracked, seen, out);
+        }
+    }
+}
+
+// A torn cache is dropped whole, so it only costs a full read of the tree.
+void UntrackedFiles::loadCache() {
+    std::ifstream in(cachePath);
+    std::string line;
+    if (!std::getline(in, line) || line != cacheHeader) {
+        return;
+    }
+    std::unordered_map<std::string, Listing> loaded;
+    Listing* current = nullptr;
+    while (std::getline(in, line)) {
+        if (line == "end") {
+            cache = std::move(loaded);
+            return;
+        } else if (line.rfind("dir ", 0) == 0) {
+            size_t space = line.find(' ', 4);
+            if (space == std::string::npos) {
+                return;
+            }
+            current = &loaded[line.substr(space + 1)];
+            current->mtime = std::stoll(line.substr(4, space - 4));
+        } else if (current != nullptr && line.rfind("f ", 0) == 0) {
+            current->files.push_back(line.substr(2));
+        } else if (current != nullptr && line.rfind("d ", 0) == 0) {
+            current->directories.push_back(line.substr(2));
+        }
+    }
+}
+
+// The cache is replaced by a rename but not synced; losing it in a crash
+// only costs one full read of the tree.
+void UntrackedFiles::saveCache() const {
+    if (!fs::exists(cachePath.parent_path())) {
+        return;
+    }
+    std::string out = cacheHeader + "\n";
+    auto fits = [](const std::string& name) { return name.find('\n') == std::string::npos; };
+    for (const auto& [directory, listing] : cache) {
+        if (!fits(directory) || !std::all_of(listing.files.begin(), listing.files.end(), fits)
+            || !std::all_of(listing.directories.begin(), listing.directories.end(), fits)) {
+            return;
+        }
+        out += "dir " + std::to_string(listing.mtime) + " " + directory + "\n";
+        for (const auto& name : listing.files) {
+            out += "f " + name + "\n";
+        }
+        for (const auto& name : listing.directories) {
+            out += "d " + name + "\n";
+        }
+    }
+    out += "end\n";
+
+    fs::path tmp = cachePath;
+    tmp += ".tmp-" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), out.size());
+        if (!file) {
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, cachePath, ec);
+}
@@ -0,0 +1,53 @@
+#ifndef UNTRACKEDFILES_H
+#define UNTRACKEDFILES_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "IgnoreRules.h"
+
+namespace fs = std::filesystem;
+
+// Finds files that are neither tracked nor ignored.
+//
+// Adding, removing or renaming an entry changes its directory's mtime, and
+// editing a file does not, so a directory whose mtime is unchanged still
+// holds the same names. The listing of every directory is cached in
+// .gitlet/untracked-cache with that mtime; a scan stats each directory and
+// reads only those that changed. Directories changed within the last two
+// seconds are not cached, since a later change in the same clock tick would
+// leave the mtime as it was. Ignored directories are never entered.
+class UntrackedFiles {
+public:
+    explicit UntrackedFiles(const fs::path& workingDir);
+
+    const IgnoreRules& getRules() const;
+
+    // Every untracked, unignored file, relative and sorted. Symlinks count as
+    // files and are not followed.
+    std::vector<std::string> list(const std::unordered_map<std::string, std::string>& tracked);
+    // Whether one path is an untracked, unignored file.
+    bool isUntracked(const std::string& path, const std::unordered_map<std::string, std::string>& tracked) const;
+
+private:
+    struct Listing {
+        int64_t mtime = 0;
+        std::vector<std::string> files;
+        std::vector<std::string> directories;
+    };
+
+    fs::path workingDir;
+    fs::path cachePath;
+    IgnoreRules rules;
+    std::unordered_map<std::string, Listing> cache;    // directory, "" or "dir/", to listing
+    bool dirty;
+
+    void loadCache();
+    void saveCache() const;
+    void scan(const std::string& directory, const std::unordered_map<std::string, std::string>& tracked,
+              std::unordered_map<std::string, Listing>& seen, std::vector<std::string>& out);
+};
+
+#endif // UNTRACKEDFILES_H
@@ -1,6 +1,72 @@
 #include "Utils.h"
+#include "Trace.h"
+#include "Transaction.h"
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const size_t pieceSize = 64 * 1024;
+}
+
+Sha1Stream::Sha1Stream() : context(EVP_MD_CTX_new()) {
+    if (context == nullptr || EVP_DigestInit_ex(context, EVP_sha1(), nullptr) != 1) {
+        EVP_MD_CTX_free(context);
+        throw std::runtime_error("could not start a SHA-1");
+    }
+}
+
+Sha1Stream::~Sha1Stream() {
+    EVP_MD_CTX_free(context);
+}
+
+void Sha1Stream::update(const char* data, size_t size) {
+    Trace::count("bytes hashed", size);
+    EVP_DigestUpdate(context, data, size);
+}
+
+std::string Sha1Stream::hex() {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(context, hash, &length);
+    std::stringstream ss;
+    for (unsigned int i = 0; i < length; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    }
+    return ss.str();
+}
+
+std::string Utils::sha1(const fs::path& path) {
+    GITLET_TRACE_SCOPE("Utils::sha1");
+    Sha1Stream hash;
+    readInPieces(path, [&](const char* data, size_t size) { hash.update(data, size); });
+    return hash.hex();
+}
+
+void Utils::readInPieces(const fs::path& path, const Sink& sink) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        throw std::invalid_argument("must be a normal file");
+    }
+    std::vector<char> piece(pieceSize);
+    while (ifs) {
+        ifs.read(piece.data(), piece.size());
+        if (ifs.gcount() > 0) {
+            Trace::count("bytes read", ifs.gcount());
+            sink(piece.data(), static_cast<size_t>(ifs.gcount()));
+        }
+    }
+    if (ifs.bad()) {
+        throw std::invalid_argument("could not read file");
+    }
+}
 
 std::string Utils::sha1(const std::vector<char>& vals) {
+    GITLET_TRACE_SCOPE("Utils::sha1");
+    Trace::count("bytes hashed", vals.size());
     unsigned char hash[SHA_DIGEST_LENGTH];
     SHA1(reinterpret_cast<const unsigned char*>(vals.data()), vals.size(), hash);
 
@@ -12,6 +78,7 @@ std::string Utils::sha1(const std::vector<char>& vals) {
 }
 
 std::vector<char> Utils::readContents(const std::string& file) {
+    GITLET_TRACE_SCOPE("Utils::readContents");
     std::ifstream ifs(file, std::ios::binary | std::ios::ate);
     if (!ifs) {
         throw std::invalid_argument("must be a normal file");
@@ -26,17 +93,77 @@ std::vector<char> Utils::readContents(const std::string& file) {
         throw std::invalid_argument("could not read file");
     }
 
+    Trace::count("bytes read", bytes.size());
     return bytes;
 }
 
 void Utils::writeContents(const std::string& file, const std::vector<char>& bytes) {
-    std::ofstream ofs(file, std::ios::binary);
-    if (!ofs) {
+    GITLET_TRACE_SCOPE("Utils::writeContents");
+    Trace::count("bytes written", bytes.size());
+    writeAtomic(file, bytes.data(), bytes.size());
+}
+
+void Utils::writeAtomic(const fs::path& file, const char* data, size_t size) {
+    writeAtomic(file, [&](const Sink& sink) { sink(data, size); });
+}
+
+void Utils::writeAtomic(const fs::path& file, const std::function<void(const Sink&)>& fill) {
+    static std::atomic<unsigned> sequence{0};
+    fs::path tmp = file;
+    tmp += ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(sequence++);
+
+    // Keep the permissions of a file being replaced, e.g. in the working tree.
+    struct stat existing;
+    mode_t mode = ::stat(file.c_str(), &existing) == 0 ? existing.st_mode & 07777 : 0666;
+
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (fd < 0) {
         throw std::invalid_argument("could not open file for writing");
     }
+    auto sink = [&](const char* data, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = ::write(fd, data + written, size - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::invalid_argument("could not write to file");
+            }
+            written += static_cast<size_t>(n);
+        }
+    };
+    try {
+        fill(sink);
+    } catch (...) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+
+    Transaction* transaction = Transaction::current();
+    if (transaction == nullptr) {
+        ::fdatasync(fd);
+    }
+    ::close(fd);
+
+    if (::rename(tmp.c_str(), file.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        throw std::invalid_argument("could not replace file");
+    }
+
+    if (transaction != nullptr) {
+        transaction->track(file);
+    } else {
+        syncParentDirectory(file);
+    }
+}
 
-    if (!ofs.write(bytes.data(), bytes.size())) {
-        throw std::invalid_argument("could not write to file");
+void Utils::syncParentDirectory(const fs::path& file) {
+    int dirFd = ::open(file.has_parent_path() ? file.parent_path().c_str() : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
     }
 }
 
@@ -50,11 +177,44 @@ fs::path Utils::join(const std::string& first, const std::vector<std::string>& o
 
 
 std::string Utils::readStringFromFile(const std::string& filepath) {
+    GITLET_TRACE_SCOPE("Utils::readStringFromFile");
     std::ifstream file(filepath);
     return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
 }
 
 void Utils::writeStringToFile(const std::string& text, const std::string& filepath, bool overwrite) {
-    std::ofstream file(filepath, overwrite ? std::ofstream::out : std::ofstream::app);
-    file << text;
-}
\ No newline at end of file
+    GITLET_TRACE_SCOPE("Utils::writeStringToFile");
+    Trace::count("bytes written", text.size());
+    if (overwrite || !fs::exists(filepath)) {
+        writeAtomic(filepath, text.data(), text.size());
+    } else {
+        std::string appended = readStringFromFile(filepath) + text;
+        writeAtomic(filepath, appended.data(), appended.size());
+    }
+}
+
+void Utils::put32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+void Utils::put64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+uint32_t Utils::get32(const void* in) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(in);
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+uint64_t Utils::get64(const void* in) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(in);
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
@@ -1,6 +1,8 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -13,14 +15,38 @@
 namespace fs = std::filesystem;
 
 
+// SHA-1 of contents handed over in pieces, for contents too large to hold
+// at once.
+class Sha1Stream {
+public:
+    Sha1Stream();
+    ~Sha1Stream();
+
+    Sha1Stream(const Sha1Stream&) = delete;
+    Sha1Stream& operator=(const Sha1Stream&) = delete;
+
+    void update(const char* data, size_t size);
+    // The hex digest of everything so far; call once, at the end.
+    std::string hex();
+
+private:
+    struct evp_md_ctx_st* context;
+};
+
 class Utils {
 public:
+    // Receives a file's contents one piece at a time.
+    using Sink = std::function<void(const char* data, size_t size)>;
+
     static std::string sha1(const std::vector<char>& vals);
 
     
     static std::string sha1(const std::string& str);
 
+    // Reads the file a piece at a time rather than all at once.
     static std::string sha1(const fs::path& path);
+    // Hands the file to sink a piece at a time.
+    static void readInPieces(const fs::path& path, const Sink& sink);
 
     static bool restrictedDelete(const std::string& file);
 
@@ -32,7 +58,25 @@ public:
 
     static std::string readStringFromFile(const std::string& file);
 
-    static void writeStringToFile(const std::string& file, const std::string& str, bool overwrite);
+    static void writeStringToFile(const std::string& str, const std::string& file, bool overwrite);
+
+    // Replaces file through a temporary file and a rename, so readers see the
+    // old or the new contents and never a partial write. Durability is left to
+    // the open Transaction if there is one, otherwise the write is synced here.
+    static void writeAtomic(const fs::path& file, const char* data, size_t size);
+    // The same for contents made a piece at a time: fill hands each piece to
+    // the sink it is given. If fill throws, the file is left as it was.
+    static void writeAtomic(const fs::path& file, const std::function<void(const Sink&)>& fill);
+
+    // fsyncs the directory holding file so a rename into it is durable.
+    static void syncParentDirectory(const fs::path& file);
+
+    // Little-endian integers, as every binary file and stream gitlet writes
+    // lays them out: put appends value to out, get reads one at in.
+    static void put32(std::string& out, uint32_t value);
+    static void put64(std::string& out, uint64_t value);
+    static uint32_t get32(const void* in);
+    static uint64_t get64(const void* in);
 
 };
 
@@ -0,0 +1,437 @@
+#include "Watcher.h"
+#include "Trace.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+const std::string journalHeader = "# gitlet watch ";
+const std::string checkpointHeader = "# gitlet watch checkpoint";
+const uint32_t directoryMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB
+                             | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+const uint64_t rotateSize = 16 << 20;   // a longer journal starts a new generation
+const auto syncTimeout = std::chrono::seconds(2);
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+std::string readFrom(int fd, uint64_t offset) {
+    std::string out;
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = ::pread(fd, buffer, sizeof(buffer), offset + out.size())) > 0) {
+        out.append(buffer, n);
+    }
+    return out;
+}
+}
+
+bool WatchQuery::touches(const std::string& path) const {
+    if (files.count(path)) {
+        return true;
+    }
+    for (const std::string& directory : directories) {
+        if (path.compare(0, directory.size(), directory) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+WatchJournal::WatchJournal(const fs::path& gitletDir) : gitletDir(gitletDir) {}
+
+WatchQuery WatchJournal::query() const {
+    GITLET_TRACE_SCOPE("WatchJournal::query");
+    WatchQuery query;
+    if (!Watcher::running(gitletDir)) {
+        return query;
+    }
+
+    // A checkpoint only counts if it is whole, so a torn one means a full scan.
+    std::ifstream in(Watcher::directory(gitletDir) / "checkpoint");
+    std::string line;
+    std::string generation;
+    uint64_t offset = 0;
+    bool whole = false;
+    if (std::getline(in, line) && line == checkpointHeader) {
+        while (std::getline(in, line)) {
+            if (line.rfind("generation ", 0) == 0) {
+                generation = line.substr(11);
+            } else if (line.rfind("offset ", 0) == 0) {
+                offset = std::stoull(line.substr(7));
+            } else if (line.rfind("tracked ", 0) == 0 && line.size() > 49) {
+                query.tracked[line.substr(49)] = line.substr(8, 40);
+            } else if (line.rfind("pending ", 0) == 0) {
+                query.pending.push_back(line.substr(8));
+            } else if (line == "end") {
+                whole = true;
+            }
+        }
+    }
+    if (!whole) {
+        generation.clear();
+        query.tracked.clear();
+        query.pending.clear();
+    }
+
+    std::string text;
+    if (!sync(query, generation, offset, text)) {
+        query.generation.clear();
+        return query;
+    }
+    query.complete = whole && query.generation == generation;
+    for (size_t pos = 0; pos < text.size();) {
+        size_t end = text.find('\n', pos);
+        std::string entry = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (entry == "!overflow") {
+            query.complete = false;
+        } else if (entry.empty() || entry[0] == '!' || entry[0] == '#') {
+            continue;
+        } else if (entry.back() == '/') {
+            query.directories.push_back(entry);
+        } else {
+            query.files.insert(entry);
+        }
+    }
+    Trace::count("paths touched", query.files.size() + query.directories.size());
+    return query;
+}
+
+// Drops a cookie and waits for the watcher to journal it, which proves every
+// earlier change is journaled too. `text` gets the journal from the checkpoint
+// (or from the header, in a new generation) through the cookie line.
+bool WatchJournal::sync(WatchQuery& query, const std::string& fromGeneration, uint64_t from, std::string& text) const {
+    static std::atomic<unsigned> sequence{0};
+    fs::path watchDir = Watcher::directory(gitletDir);
+    int fd = ::open((watchDir / "journal").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    std::string head = readFrom(fd, 0).substr(0, 256);
+    size_t headerEnd = head.find('\n');
+    if (head.rfind(journalHeader, 0) != 0 || headerEnd == std::string::npos) {
+        ::close(fd);
+        return false;
+    }
+    query.generation = head.substr(journalHeader.size(), headerEnd - journalHeader.size());
+    uint64_t start = headerEnd + 1;
+    if (query.generation == fromGeneration && from >= start) {
+        start = from;
+    }
+
+    std::string cookie = std::to_string(::getpid()) + "-" + std::to_string(sequence++);
+    fs::path cookiePath = watchDir / "cookies" / cookie;
+    int cookieFd = ::open(cookiePath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (cookieFd < 0) {
+        ::close(fd);
+        return false;
+    }
+    ::close(cookieFd);
+
+    std::string needle = "!cookie " + cookie + "\n";
+    bool found = false;
+    auto deadline = std::chrono::steady_clock::now() + syncTimeout;
+    while (true) {
+        text += readFrom(fd, start + text.size());
+        size_t at = text.find(needle);
+        while (at != std::string::npos && at != 0 && text[at - 1] != '\n') {
+            at = text.find(needle, at + 1);
+        }
+        if (at != std::string::npos) {
+            text.resize(at + needle.size());
+            found = true;
+            break;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ::close(fd);
+    std::error_code ec;
+    fs::remove(cookiePath, ec);
+    query.offset = start + text.size();
+    return found;
+}
+
+// The checkpoint is a cache, so it is replaced by a rename but not synced; a
+// checkpoint lost in a crash only costs one full scan.
+void WatchJournal::checkpoint(const WatchQuery& query, const std::unordered_map<std::string, std::string>& tracked,
+                              const std::vector<std::string>& pending) const {
+    if (query.generation.empty()) {
+        return;
+    }
+    std::string out = checkpointHeader + "\ngeneration " + query.generation + "\noffset " + std::to_string(query.offset) + "\n";
+    for (const auto& [fileName, blobHash] : tracked) {
+        if (fileName.find('\n') == std::string::npos && blobHash.size() == 40) {
+            out += "tracked " + blobHash + " " + fileName + "\n";
+        }
+    }
+    for (const std::string& path : pending) {
+        if (path.find('\n') != std::string::npos) {
+            return;
+        }
+        out += "pending " + path + "\n";
+    }
+    out += "end\n";
+
+    fs::path target = Watcher::directory(gitletDir) / "checkpoint";
+    fs::path tmp = target;
+    tmp += ".tmp-" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), out.size());
+        if (!file) {
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, target, ec);
+}
+
+Watcher::Watcher(const fs::path& workingDir)
+    : workingDir(workingDir), gitletDir(workingDir / ".gitlet"), inotifyFd(-1), journalFd(-1), lockFd(-1),
+      cookieWatch(-1), journalSize(0) {}
+
+Watcher::~Watcher() {
+    for (int fd : {inotifyFd, journalFd, lockFd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+fs::path Watcher::directory(const fs::path& gitletDir) {
+    return gitletDir / "watch";
+}
+
+// The watcher holds an exclusive flock on watch/lock for as long as it runs.
+bool Watcher::running(const fs::path& gitletDir) {
+    int fd = ::open((directory(gitletDir) / "lock").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool held = ::flock(fd, LOCK_SH | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+    ::close(fd);
+    return held;
+}
+
+bool Watcher::stop(const fs::path& gitletDir) {
+    if (!running(gitletDir)) {
+        return false;
+    }
+    std::ifstream in(directory(gitletDir) / "lock");
+    pid_t pid = 0;
+    if (!(in >> pid) || pid <= 0) {
+        return false;
+    }
+    return ::kill(pid, SIGTERM) == 0;
+}
+
+bool Watcher::run() {
+    fs::path watchDir = directory(gitletDir);
+    if (!fs::exists(gitletDir)) {
+        std::cout << "Not in an initialized Gitlet directory." << std::endl;
+        return false;
+    }
+    fs::create_directories(watchDir / "cookies");
+
+    lockFd = ::open((watchDir / "lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd < 0 || ::flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+        std::cout << "A watcher is already running." << std::endl;
+        return false;
+    }
+    std::string pid = std::to_string(::getpid()) + "\n";
+    if (::ftruncate(lockFd, 0) != 0 || ::pwrite(lockFd, pid.data(), pid.size(), 0) != static_cast<ssize_t>(pid.size())) {
+        return false;
+    }
+
+    struct sigaction action {};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    // Watches go in before the journal starts, so nothing a reader could see
+    // as covered by the journal happens unwatched.
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0 || !addWatches("")) {
+        std::cerr << "Could not watch the working directory: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    cookieWatch = ::inotify_add_watch(inotifyFd, (watchDir / "cookies").c_str(), IN_CREATE | IN_ONLYDIR);
+    if (cookieWatch < 0 || !startJournal()) {
+        std::cerr << "Could not start the watch journal: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    alignas(struct inotify_event) char buffer[1 << 16];
+    while (!stopRequested) {
+        struct pollfd pfd = {inotifyFd, POLLIN, 0};
+        if (::poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+        ssize_t n = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            continue;
+        }
+
+        std::string lines;
+        std::unordered_set<std::string> seen;
+        auto emit = [&](const std::string& line) {
+            if (seen.insert(line).second) {
+                lines += line + "\n";
+            }
+        };
+        for (char* p = buffer; p < buffer + n;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            std::string name = event->len > 0 ? std::string(event->name) : std::string();
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                emit("!overflow");
+                continue;
+            }
+            if (event->wd == cookieWatch) {
+                if (event->mask & IN_CREATE) {
+                    emit("!cookie " + name);
+                }
+                continue;
+            }
+            auto it = watches.find(event->wd);
+            if (it == watches.end()) {
+                continue;
+            }
+            std::string dir = it->second;
+            if (event->mask & IN_IGNORED) {
+                watches.erase(it);
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                if (dir.empty()) {
+                    emit("!overflow");      // the working directory itself went away
+                }
+                continue;
+            }
+            if (name.empty() || (dir.empty() && name == ".gitlet")) {
+                continue;
+            }
+            if (name.find('\n') != std::string::npos) {
+                emit("!overflow");
+                continue;
+            }
+
+            std::string path = dir + name;
+            if (event->mask & IN_ISDIR) {
+                // A directory moves with its watches, which would then report
+                // the old path, so they are dropped and added again.
+                if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+                    removeWatches(path + "/");
+                }
+                if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && !addWatches(path + "/")) {
+                    std::cerr << "Could not watch " << path << ": " << std::strerror(errno) << std::endl;
+                    return false;
+                }
+                emit(path + "/");
+            } else {
+                emit(path);
+            }
+        }
+        if (!lines.empty() && !append(lines)) {
+            std::cerr << "Could not write the watch journal: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Starts a new generation: readers holding a checkpoint of the old one fall
+// back to a full scan once.
+bool Watcher::startJournal() {
+    fs::path watchDir = directory(gitletDir);
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    std::string header = journalHeader + std::to_string(::getpid()) + "-"
+                       + std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()) + "\n";
+    fs::path tmp = watchDir / ("journal.tmp-" + std::to_string(::getpid()));
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (::write(fd, header.data(), header.size()) != static_cast<ssize_t>(header.size())
+        || ::rename(tmp.c_str(), (watchDir / "journal").c_str()) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (journalFd >= 0) {
+        ::close(journalFd);
+    }
+    journalFd = fd;
+    journalSize = header.size();
+    return true;
+}
+
+// Lines go out in one write, so readers never see half of one.
+bool Watcher::append(const std::string& lines) {
+    if (journalSize + lines.size() > rotateSize && !startJournal()) {
+        return false;
+    }
+    if (::write(journalFd, lines.data(), lines.size()) != static_cast<ssize_t>(lines.size())) {
+        return false;
+    }
+    journalSize += lines.size();
+    return true;
+}
+
+bool Watcher::addWatches(const std::string& directory) {
+    fs::path root = workingDir / directory;
+    int wd = ::inotify_add_watch(inotifyFd, root.c_str(), directoryMask);
+    if (wd < 0) {
+        return errno == ENOENT || errno == ENOTDIR;     // already gone again
+    }
+    watches[wd] = directory;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_directory() || it->is_symlink()) {
+            continue;
+        }
+        std::string relative = fs::relative(it->path(), workingDir).string() + "/";
+        if (relative == ".gitlet/") {
+            it.disable_recursion_pending();
+            continue;
+        }
+        wd = ::inotify_add_watch(inotifyFd, it->path().c_str(), directoryMask);
+        if (wd < 0) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                continue;
+            }
+            return false;
+        }
+        watches[wd] = relative;
+    }
+    return true;
+}
+
+void Watcher::removeWatches(const std::string& directory) {
+    for (auto it = watches.begin(); it != watches.end();) {
+        if (it->second.compare(0, directory.size(), directory) == 0) {
+            ::inotify_rm_watch(inotifyFd, it->first);
+            it = watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
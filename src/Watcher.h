@@ -0,0 +1,94 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Tracks which working-tree paths change, so status and add . can skip the
+// rest. `gitlet watch` runs a Watcher in the foreground. It puts an inotify
+// watch on every directory of the working tree and appends each touched path
+// to .gitlet/watch/journal:
+//
+//   # gitlet watch <generation>
+//   <path>             a file was created, changed, moved or deleted
+//   <path>/            a directory was, so anything under it may have changed
+//   !overflow          events were lost
+//   !cookie <name>     the watcher has seen everything before this point
+//
+// A reader drops a cookie file into .gitlet/watch/cookies and waits for its
+// line, so every change made before it asked is in the journal. It then keeps
+// a checkpoint: the journal position it consumed, the tracked files at that
+// point, and the paths that still differed from them. Next time only those
+// paths, the ones touched since, and the ones whose tracked version changed
+// need looking at. No watcher, a new generation, an overflow or a cookie that
+// never shows up all mean a full scan.
+struct WatchQuery {
+    bool complete = false;  // whether the paths below cover every change since the checkpoint
+    std::unordered_set<std::string> files;
+    std::vector<std::string> directories;                   // with a trailing '/'
+    std::unordered_map<std::string, std::string> tracked;   // file to blob at the checkpoint
+    std::vector<std::string> pending;                       // paths that differed at the checkpoint
+    std::string generation;                                 // empty when no watcher answered
+    uint64_t offset = 0;
+
+    // Whether path was touched, itself or through a directory above it.
+    bool touches(const std::string& path) const;
+};
+
+// The reading side of the journal.
+class WatchJournal {
+public:
+    explicit WatchJournal(const fs::path& gitletDir);
+
+    WatchQuery query() const;
+    // Records that everything up to query was examined, with `pending` still
+    // differing from `tracked`. Does nothing when no watcher answered.
+    void checkpoint(const WatchQuery& query, const std::unordered_map<std::string, std::string>& tracked,
+                    const std::vector<std::string>& pending) const;
+
+private:
+    fs::path gitletDir;
+
+    bool sync(WatchQuery& query, const std::string& fromGeneration, uint64_t from, std::string& text) const;
+};
+
+class Watcher {
+public:
+    explicit Watcher(const fs::path& workingDir);
+    ~Watcher();
+
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    // Watches until SIGINT or SIGTERM. Returns false if it could not start or
+    // lost track of the tree.
+    bool run();
+
+    static fs::path directory(const fs::path& gitletDir);
+    static bool running(const fs::path& gitletDir);
+    // Asks the running watcher to exit; returns whether there was one.
+    static bool stop(const fs::path& gitletDir);
+
+private:
+    fs::path workingDir;
+    fs::path gitletDir;
+    int inotifyFd;
+    int journalFd;
+    int lockFd;
+    int cookieWatch;
+    uint64_t journalSize;
+    std::unordered_map<int, std::string> watches;   // watch descriptor to directory, "" or "dir/"
+
+    bool startJournal();
+    bool append(const std::string& lines);
+    bool addWatches(const std::string& directory);
+    void removeWatches(const std::string& directory);
+};
+
+#endif // WATCHER_H
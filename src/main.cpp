@@ -1,7 +1,18 @@
 #include "Repo.h"
+#include "BufferedWriter.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include "Transaction.h"
+#include "Transport.h"
+#include "Watcher.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <csignal>
 
 bool inputChecker(int expectedLength, const std::vector<std::string>& args) {
     if (args.size() == expectedLength) {
@@ -11,78 +22,551 @@ bool inputChecker(int expectedLength, const std::vector<std::string>& args) {
     return false;
 }
 
-int main(int argc, char* argv[]) {
-    Repo r;
-    std::vector<std::string> args(argv + 1, argv + argc);
-    
-    if (args.empty()) {
-        std::cout << "Please enter a command." << std::endl;
-    } else {
-        std::string command = args[0];
+// Accepts "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS" and returns the full commit
+// datetime form, or an empty string if the date cannot be parsed. A bare day
+// means its first second, or its last one when endOfDay is set.
+std::string normalizeDate(const std::string& date, bool endOfDay) {
+    std::tm tm = {};
+    std::istringstream in(date);
+    if (date.size() == 10) {
+        in >> std::get_time(&tm, "%Y-%m-%d");
+        return in.fail() ? std::string() : date + (endOfDay ? " 23:59:59" : " 00:00:00");
+    }
+    in >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    return in.fail() || date.size() != 19 ? std::string() : date;
+}
 
-        if (command == "init") {
-            if (inputChecker(1, args)) {
-                r.init();
+// log [-n <count>] [--skip <count>] [--since <date>] [--until <date>] [--abbrev[=<digits>]] [--all]
+// Every option also accepts the --option=value form.
+bool parseLogOptions(const std::vector<std::string>& args, LogOptions& options) {
+    for (size_t i = 1; i < args.size(); i++) {
+        std::string flag = args[i];
+        if (flag == "--abbrev") {
+            options.abbrev = 7;
+            continue;
+        } else if (flag == "--all") {
+            options.all = true;
+            continue;
+        } else if (flag == "--") {
+            if (i + 2 != args.size()) {
+                return false;
             }
-        } else if (command == "add") {
-            if (inputChecker(2, args)) {
-                r.add(args[1]);
-            }
-        } else if (command == "commit") {
-            if (inputChecker(2, args)) {
-                r.commitment(args[1]);
-            }
-        } else if (command == "rm") {
-            if (inputChecker(2, args)) {
-                r.rm(args[1]);
+            options.path = args[++i];
+            continue;
+        }
+        std::string value;
+        size_t eq = flag.find('=');
+        if (flag.rfind("--", 0) == 0 && eq != std::string::npos) {
+            value = flag.substr(eq + 1);
+            flag = flag.substr(0, eq);
+        } else if (i + 1 < args.size()) {
+            value = args[++i];
+        } else {
+            return false;
+        }
+
+        try {
+            if (flag == "-n" || flag == "--max-count") {
+                options.maxCount = std::stol(value);
+            } else if (flag == "--skip") {
+                options.skip = std::stol(value);
+            } else if (flag == "--since") {
+                options.since = normalizeDate(value, false);
+                if (options.since.empty()) return false;
+            } else if (flag == "--until") {
+                options.until = normalizeDate(value, true);
+                if (options.until.empty()) return false;
+            } else if (flag == "--abbrev") {
+                options.abbrev = std::stoul(value);
+                if (options.abbrev < 4 || options.abbrev > 40) return false;
+            } else {
+                return false;
             }
-        } else if (command == "log") {
-            if (inputChecker(1, args)) {
-                r.log();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Commits>
+void printCommits(const Repo& r, const Commits& commits, size_t abbrev) {
+    BufferedWriter out;
+    for (const Commit& commit : commits) {
+        out << (abbrev ? commit.globalLog(r.abbreviate(commit.getOwnHash(), abbrev)) : commit.globalLog());
+        if (!out.good()) {
+            break;
+        }
+    }
+}
+
+void printLog(const Repo& r, const LogOptions& options) {
+    if (options.all) {
+        printCommits(r, r.logAll(options), options.abbrev);
+    } else {
+        printCommits(r, r.log(options), options.abbrev);
+    }
+}
+
+void printFind(const Repo& r, const std::string& msg) {
+    std::vector<std::string> found = r.find(msg);
+    for (const auto& commitID : found) {
+        std::cout << commitID << "\n";
+    }
+    if (found.empty()) {
+        std::cout << "Found no commit with that message." << std::endl;
+    }
+}
+
+void printStatus(const Repo& r) {
+    Status status = r.status();
+    std::cout << "=== Branches ===\n";
+    for (const auto& branch : status.branches) {
+        if (branch == status.currentBranch) {
+            std::cout << "*";
+        }
+        std::cout << branch << "\n";
+    }
+    std::cout << "\n=== Staged Files ===\n";
+    for (const auto& file : status.stagedFiles) {
+        std::cout << file << "\n";
+    }
+    std::cout << "\n=== Removed Files ===\n";
+    for (const auto& file : status.removedFiles) {
+        std::cout << file << "\n";
+    }
+    std::cout << "\n=== Modifications Not Staged For Commit ===\n";
+    for (const auto& file : status.modifiedFiles) {
+        std::cout << file << "\n";
+    }
+    std::cout << "\n=== Untracked Files ===\n";
+    for (const auto& file : status.untrackedFiles) {
+        std::cout << file << "\n";
+    }
+}
+
+// gc [--prune=<seconds>|--prune=now]
+bool parseGcOptions(const std::vector<std::string>& args, GcOptions& options) {
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--prune=now") {
+            options.pruneExpire = 0;
+        } else if (args[i].rfind("--prune=", 0) == 0) {
+            std::optional<long long> seconds = Config::parseInt(args[i].substr(8));
+            if (!seconds || *seconds < 0) {
+                return false;
             }
-        } else if (command == "global-log") {
-        if (inputChecker(1, args)) {
-            r.global();
+            options.pruneExpire = *seconds;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// fsck: problems first, then dangling objects; fails if there were problems
+int printFsck(Repo& r) {
+    FsckResult result = r.fsck();
+    for (const auto& error : result.errors) {
+        std::cout << "error: " << error << "\n";
+    }
+    for (const auto& line : result.dangling) {
+        std::cout << line << "\n";
+    }
+    std::cout << "Checked " << result.commits << " commits and " << result.blobs << " blobs, " << result.bytes
+              << " bytes; " << result.errors.size() << " problems." << std::endl;
+    return result.errors.empty() ? 0 : 1;
+}
+
+void printGc(Repo& r, const GcOptions& options) {
+    GcResult result = r.gc(options);
+    std::cout << "Counted " << result.commits << " commits and " << result.blobs << " blobs, "
+              << result.reachable << " reachable.\n"
+              << "Packed " << result.packed << " objects, replacing " << result.packsRemoved << " old packs.\n"
+              << "Pruned " << result.pruned << " unreachable objects, kept " << result.kept
+              << " within the grace period.\n"
+              << "Packed " << result.refsPacked << " branches.\n"
+              << "Wrote " << result.bitmaps << " reachability bitmaps.\n"
+              << "Wrote changed-path filters for " << result.changedPaths << " commits." << std::endl;
+}
+
+// is-ancestor <commit> <commit>, each a branch, a commit id or an abbreviation
+void printIsAncestor(const Repo& r, const std::string& ancestor, const std::string& descendant) {
+    std::optional<std::string> ancestorID = r.resolveCommit(ancestor);
+    std::optional<std::string> descendantID = ancestorID ? r.resolveCommit(descendant) : std::nullopt;
+    if (!ancestorID || !descendantID) {
+        return;
+    } else if (r.isAncestor(*ancestorID, *descendantID)) {
+        std::cout << ancestor << " is an ancestor of " << descendant << "." << std::endl;
+    } else {
+        std::cout << ancestor << " is not an ancestor of " << descendant << "." << std::endl;
+    }
+}
+
+// count-objects [<commit>], counting from the current branch by default
+void printCountObjects(const Repo& r, const std::vector<std::string>& args) {
+    std::optional<std::string> commitID = r.resolveCommit(args.size() == 2 ? args[1] : r.getHEAD());
+    if (!commitID) {
+        return;
+    }
+    ObjectCount count = r.countObjects(*commitID);
+    std::cout << "commits: " << count.commits << "\n"
+              << "blobs: " << count.blobs << std::endl;
+}
+
+// diff <commit> [<commit>], to the current branch by default; one line per
+// changed path, "R<score>" and "C<score>" naming the source first.
+void printDiff(Repo& r, const std::vector<std::string>& args) {
+    std::optional<std::string> fromID = r.resolveCommit(args[1]);
+    std::optional<std::string> toID = fromID ? r.resolveCommit(args.size() == 3 ? args[2] : r.getHEAD()) : std::nullopt;
+    if (!fromID || !toID) {
+        return;
+    }
+    for (const FileChange& change : r.diff(*fromID, *toID)) {
+        switch (change.kind) {
+        case FileChange::Kind::Added:
+            std::cout << "A\t" << change.path << "\n";
+            break;
+        case FileChange::Kind::Deleted:
+            std::cout << "D\t" << change.path << "\n";
+            break;
+        case FileChange::Kind::Modified:
+            std::cout << "M\t" << change.path << "\n";
+            break;
+        case FileChange::Kind::Renamed:
+        case FileChange::Kind::Copied:
+            std::cout << (change.kind == FileChange::Kind::Renamed ? "R" : "C") << std::setw(3) << std::setfill('0')
+                      << change.score << "\t" << change.from << "\t" << change.path << "\n";
+            break;
         }
-    } else if (command == "find") {
-        if (inputChecker(2, args)) {
-            r.find(args[1]);
+    }
+    std::cout << std::flush;
+}
+
+// blame [<commit>] <file>: each line with the commit that last changed it,
+// as of the current branch by default
+void printBlame(Repo& r, const std::vector<std::string>& args) {
+    std::optional<std::string> commitID = r.resolveCommit(args.size() == 3 ? args[1] : r.getHEAD());
+    if (!commitID) {
+        return;
+    }
+    std::optional<std::vector<BlameLine>> lines = r.blame(*commitID, args.back());
+    if (!lines) {
+        return;
+    }
+    std::unordered_map<std::string, std::string> shown;
+    for (const BlameLine& line : *lines) {
+        if (shown.find(line.commitID) == shown.end()) {
+            shown[line.commitID] = r.abbreviate(line.commitID, 8) + " (" + r.getCommit(line.commitID).getDatetime();
         }
-    } else if (command == "status") {
-        if (inputChecker(1, args)) {
-            r.status();
+    }
+    size_t width = std::to_string(lines->size()).size();
+    for (size_t i = 0; i < lines->size(); i++) {
+        const BlameLine& line = (*lines)[i];
+        std::cout << shown[line.commitID] << " " << std::setw(static_cast<int>(width)) << i + 1 << ") " << line.text << "\n";
+    }
+    std::cout << std::flush;
+}
+
+// sparse-checkout set <pattern>... | sparse-checkout list | sparse-checkout disable
+void runSparseCheckout(Repo& r, const std::vector<std::string>& args) {
+    if (args.size() >= 3 && args[1] == "set") {
+        r.setSparseCheckout({args.begin() + 2, args.end()});
+    } else if (args.size() == 2 && args[1] == "list") {
+        for (const auto& pattern : r.getSparseCheckout().getPatterns()) {
+            std::cout << pattern << "\n";
         }
-    } else if (command == "checkout") {
-        if (args.size() == 2) {
-            r.checkout({args.begin() + 1, args.end()});
-        } else if (args.size() == 3 && args[1] == "--") {
-            std::vector<std::string> checkoutArgs = {args[1], args[2]};
-            r.checkout(checkoutArgs);
-        } else if (args.size() == 4 && args[2] == "--") {
-            std::vector<std::string> checkoutArgs = {args[1], args[2], args[3]};
-            r.checkout(checkoutArgs);
+    } else if (args.size() == 2 && args[1] == "disable") {
+        r.disableSparseCheckout();
+    } else {
+        std::cout << "Incorrect Operands" << std::endl;
+    }
+}
+
+// clone [--depth <count>] [--filter=blob:none] <source> [<directory>]
+bool parseCloneOptions(const std::vector<std::string>& args, CloneOptions& options, std::vector<std::string>& operands) {
+    for (size_t i = 1; i < args.size(); i++) {
+        std::string depth;
+        if (args[i] == "--depth" && i + 1 < args.size()) {
+            depth = args[++i];
+        } else if (args[i].rfind("--depth=", 0) == 0) {
+            depth = args[i].substr(8);
+        } else if (args[i] == "--filter=blob:none") {
+            options.blobless = true;
+            continue;
         } else {
-            std::cout << "Incorrect Operands" << std::endl;
+            operands.push_back(args[i]);
+            continue;
         }
-    } else if (command == "branch") {
-        if (inputChecker(2, args)) {
-            r.branch(args[1]);
+        std::optional<long long> count = Config::parseInt(depth);
+        if (!count || *count <= 0) {
+            return false;
         }
-    } else if (command == "rm-branch") {
-        if (inputChecker(2, args)) {
-            r.rmb(args[1]);
+        options.depth = *count;
+    }
+    return operands.size() == 1 || operands.size() == 2;
+}
+
+// config <key> | config <key> <value> | config --unset <key> | config --list
+void runConfig(Repo& r, const std::vector<std::string>& args) {
+    Config& config = r.getConfig();
+    if (args.size() == 2 && args[1] == "--list") {
+        for (const auto& [key, value] : config.entries()) {
+            std::cout << key << " = " << value << "\n";
         }
-    } else if (command == "reset") {
-        if (inputChecker(2, args)) {
-            r.reset(args[1]);
+    } else if (args.size() == 3 && args[1] == "--unset") {
+        if (!config.unset(args[2])) {
+            std::cout << "No such config key." << std::endl;
         }
-    } else if (command == "merge") {
-        if (inputChecker(2, args)) {
-            r.merge(args[1]);
+    } else if (args.size() == 2) {
+        std::optional<std::string> value = config.get(args[1]);
+        if (value) {
+            std::cout << *value << std::endl;
         }
+    } else if (args.size() == 3) {
+        config.set(args[1], args[2]);
     } else {
-        std::cout << "No command with that name exists." << std::endl;
+        std::cout << "Incorrect Operands" << std::endl;
     }
 }
-return 0;
+
+// Sets the process's memory budget from core.memoryBudget of the repository
+// in dir, once, before any command runs.
+void configureMemoryBudget(Repo& repo, const fs::path& dir) {
+    long long limit = repo.getConfig().getInt("core.memoryBudget", 0);
+    MemoryBudget::configure(static_cast<uint64_t>(std::max(0LL, limit)), dir / ".gitlet" / "tmp");
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    GITLET_TRACE_SCOPE("gitlet " + (args.empty() ? std::string() : args[0]));
+    // A remote that goes away mid-transfer must show up as a failed write.
+    std::signal(SIGPIPE, SIG_IGN);
+    try {
+        // Everything the command writes is flushed by one barrier when it ends.
+        Transaction transaction(fs::current_path() / ".gitlet");
+        Repo r;
+        configureMemoryBudget(r, fs::current_path());
+        if (args.empty()) {
+            std::cout << "Please enter a command." << std::endl;
+        } else {
+            std::string command = args[0];
+
+            if (command == "init") {
+                if (inputChecker(1, args)) {
+                    r.init();
+                }
+            } else if (command == "add") {
+                if (inputChecker(2, args)) {
+                    r.add(args[1]);
+                }
+            } else if (command == "commit") {
+                if (inputChecker(2, args)) {
+                    r.commitment(args[1]);
+                }
+            } else if (command == "rm") {
+                if (inputChecker(2, args)) {
+                    r.rm(args[1]);
+                }
+            } else if (command == "log") {
+                LogOptions options;
+                if (parseLogOptions(args, options)) {
+                    printLog(r, options);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "global-log") {
+                if (inputChecker(1, args)) {
+                    printCommits(r, r.global(), 0);
+                }
+            } else if (command == "find") {
+                if (inputChecker(2, args)) {
+                    printFind(r, args[1]);
+                }
+            } else if (command == "status") {
+                if (inputChecker(1, args)) {
+                    printStatus(r);
+                }
+            } else if (command == "checkout") {
+                if (args.size() == 2) {
+                    r.checkout({args.begin() + 1, args.end()});
+                } else if (args.size() == 3 && args[1] == "--") {
+                    std::vector<std::string> checkoutArgs = {args[1], args[2]};
+                    r.checkout(checkoutArgs);
+                } else if (args.size() == 4 && args[2] == "--") {
+                    std::vector<std::string> checkoutArgs = {args[1], args[2], args[3]};
+                    r.checkout(checkoutArgs);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "branch") {
+                if (inputChecker(2, args)) {
+                    r.branch(args[1]);
+                }
+            } else if (command == "rm-branch") {
+                if (inputChecker(2, args)) {
+                    r.rmb(args[1]);
+                }
+            } else if (command == "pack-refs") {
+                if (inputChecker(1, args)) {
+                    r.packRefs();
+                }
+            } else if (command == "gc") {
+                GcOptions options;
+                if (parseGcOptions(args, options)) {
+                    printGc(r, options);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "fsck") {
+                if (inputChecker(1, args) && printFsck(r) != 0) {
+                    return 1;
+                }
+            } else if (command == "watch") {
+                if (args.size() == 2 && args[1] == "--stop") {
+                    if (!Watcher::stop(fs::current_path() / ".gitlet")) {
+                        std::cout << "No watcher is running." << std::endl;
+                    }
+                } else if (inputChecker(1, args)) {
+                    Watcher watcher(fs::current_path());
+                    if (!watcher.run()) {
+                        return 1;
+                    }
+                }
+            } else if (command == "write-bitmaps") {
+                if (inputChecker(1, args)) {
+                    std::cout << "Wrote " << r.writeBitmaps() << " reachability bitmaps." << std::endl;
+                }
+            } else if (command == "write-changed-paths") {
+                if (inputChecker(1, args)) {
+                    size_t written = r.writeChangedPaths();
+                    std::cout << "Wrote changed-path filters for " << written << " commits." << std::endl;
+                }
+            } else if (command == "is-ancestor") {
+                if (inputChecker(3, args)) {
+                    printIsAncestor(r, args[1], args[2]);
+                }
+            } else if (command == "count-objects") {
+                if (args.size() == 1 || args.size() == 2) {
+                    printCountObjects(r, args);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "diff") {
+                if (args.size() == 2 || args.size() == 3) {
+                    printDiff(r, args);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "blame") {
+                if (args.size() == 2 || args.size() == 3) {
+                    printBlame(r, args);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "fast-import") {
+                if (inputChecker(1, args)) {
+                    Channel channel(0, 1);
+                    ImportResult result = r.fastImport(channel);
+                    if (!result.error.empty()) {
+                        std::cout << "fast-import: " << result.error << std::endl;
+                        return 1;
+                    }
+                    std::cout << "Imported " << result.blobs << " blobs and " << result.commits << " commits, moved "
+                              << result.branches << " branches." << std::endl;
+                }
+            } else if (command == "fast-export") {
+                Channel channel(0, 1);
+                if (!r.fastExport(channel, std::vector<std::string>(args.begin() + 1, args.end()))) {
+                    std::cout << "A branch with that name does not exist." << std::endl;
+                }
+            } else if (command == "sparse-checkout") {
+                runSparseCheckout(r, args);
+            } else if (command == "clone") {
+                std::vector<std::string> operands;
+                CloneOptions options;
+                if (parseCloneOptions(args, options, operands)) {
+                    fs::path source = fs::path(operands[0]).lexically_normal();
+                    if (!source.has_filename()) {
+                        source = source.parent_path();
+                    }
+                    if (source.filename() == ".gitlet") {
+                        source = source.parent_path();
+                    }
+                    Repo::clone(operands[0], operands.size() == 2 ? fs::path(operands[1]) : source.filename(), options);
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "add-remote") {
+                if (inputChecker(3, args)) {
+                    r.addRemote(args[1], args[2]);
+                }
+            } else if (command == "rm-remote") {
+                if (inputChecker(2, args)) {
+                    r.rmRemote(args[1]);
+                }
+            } else if (command == "fetch") {
+                if (args.size() == 2) {
+                    r.fetch(args[1]);
+                } else if (inputChecker(3, args)) {
+                    r.fetch(args[1], args[2]);
+                }
+            } else if (command == "push") {
+                if (inputChecker(3, args)) {
+                    r.push(args[1], args[2]);
+                }
+            } else if (command == "pull") {
+                if (inputChecker(3, args)) {
+                    r.pull(args[1], args[2]);
+                }
+            } else if (command == "upload-pack" || command == "receive-pack") {
+                // Serves a fetch or push on stdin and stdout, for "ext::" remotes.
+                if (args.size() == 1 || args.size() == 2) {
+                    fs::path dir = args.size() == 2 ? fs::path(args[1]) : fs::current_path();
+                    Transaction serverTransaction(dir / ".gitlet");
+                    Repo server(dir);
+                    configureMemoryBudget(server, dir);
+                    Channel channel(0, 1);
+                    int status = command == "upload-pack" ? server.uploadPack(channel) : server.receivePack(channel);
+                    channel.flush();
+                    serverTransaction.commit();
+                    if (status != 0) {
+                        return status;
+                    }
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "lfs-serve") {
+                // Serves a large file store on stdin and stdout, for an "ext::"
+                // lfs.store; by default the current repository's own store.
+                if (args.size() == 1 || args.size() == 2) {
+                    fs::path dir = args.size() == 2 ? fs::path(args[1]) : fs::current_path() / ".gitlet" / "lfs" / "objects";
+                    Channel channel(0, 1);
+                    int status = LfsStore::serve(dir, channel);
+                    channel.flush();
+                    if (status != 0) {
+                        return status;
+                    }
+                } else {
+                    std::cout << "Incorrect Operands" << std::endl;
+                }
+            } else if (command == "config") {
+                runConfig(r, args);
+            } else if (command == "reset") {
+                if (inputChecker(2, args)) {
+                    r.reset(args[1]);
+                }
+            } else if (command == "merge") {
+                if (inputChecker(2, args)) {
+                    r.merge(args[1]);
+                }
+            } else {
+                std::cout << "No command with that name exists." << std::endl;
+            }
+        }
+        transaction.commit();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
 }
\ No newline at end of file
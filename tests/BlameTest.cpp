@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <fstream>
+
+#include "Blame.h"
+#include "ObjectStore.h"
+#include "RefStore.h"
+#include "Repo.h"
+#include "SyntheticRepo.h"
+
+namespace {
+// Counts what a Blame reads, so a cached answer shows as reading nothing
+// but the file asked about.
+struct CountingReads {
+    explicit CountingReads(const fs::path& gitletDir) : objects(gitletDir) {}
+
+    Blame blame(const fs::path& gitletDir) {
+        return Blame(
+            gitletDir,
+            [this](const std::string& id) {
+                commits++;
+                Commit commit;
+                std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, id);
+                commit.deserializeFromString(std::string(data->begin(), data->end()));
+                return commit;
+            },
+            [this](const std::string& id) {
+                blobs++;
+                return *objects.read(ObjectType::Blob, id);
+            },
+            [](const Commit& commit) { return commit.getParentHash(); });
+    }
+
+    ObjectStore objects;
+    size_t commits = 0;
+    size_t blobs = 0;
+};
+
+void writeFile(const std::string& name, const std::string& contents) {
+    std::ofstream(name, std::ios::binary) << contents;
+}
+
+std::string commitFile(const std::string& name, const std::string& contents, const std::string& message) {
+    writeFile(name, contents);
+    Repo().add(name);
+    Repo().commitment(message);
+    return *RefStore(fs::path(".gitlet")).resolve("master");
+}
+
+std::vector<std::string> owners(const std::vector<BlameLine>& lines) {
+    std::vector<std::string> out;
+    for (const BlameLine& line : lines) {
+        out.push_back(line.commitID);
+    }
+    return out;
+}
+}
+
+TEST(BlameTest, GivesEachLineTheCommitThatLastChangedIt) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    std::string first = commitFile("poem.txt", "one\ntwo\nthree\n", "first");
+    std::string second = commitFile("poem.txt", "one\nTWO\nthree\nfour\n", "second");
+
+    CountingReads reads(gitletDir);
+    std::optional<std::vector<BlameLine>> lines = reads.blame(gitletDir).run(second, "poem.txt");
+    ASSERT_TRUE(lines);
+    EXPECT_EQ(owners(*lines), (std::vector<std::string>{first, second, first, second}));
+    EXPECT_EQ((*lines)[1].text, "TWO");
+    EXPECT_FALSE(reads.blame(gitletDir).run(second, "absent.txt"));
+
+    // A second run takes every owner from the cache: the file itself is the
+    // only blob read and no parent is.
+    CountingReads again(gitletDir);
+    std::optional<std::vector<BlameLine>> cached = again.blame(gitletDir).run(second, "poem.txt");
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(owners(*cached), owners(*lines));
+    EXPECT_EQ(again.commits, 1u);
+    EXPECT_EQ(again.blobs, 1u);
+}
+
+TEST(BlameTest, RejectsATruncatedCacheFile) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    std::string first = commitFile("poem.txt", "one\ntwo\n", "first");
+    std::string second = commitFile("poem.txt", "one\n2\n", "second");
+    CountingReads reads(gitletDir);
+    std::vector<BlameLine> lines = *reads.blame(gitletDir).run(second, "poem.txt");
+
+    std::vector<fs::path> cacheFiles;
+    for (const auto& entry : fs::directory_iterator(gitletDir / "blame")) {
+        cacheFiles.push_back(entry.path());
+    }
+    ASSERT_EQ(cacheFiles.size(), 1u);
+    for (uintmax_t size : {uintmax_t(3), uintmax_t(16), fs::file_size(cacheFiles[0]) - 1}) {
+        fs::resize_file(cacheFiles[0], size);
+        CountingReads again(gitletDir);
+        std::optional<std::vector<BlameLine>> redone = again.blame(gitletDir).run(second, "poem.txt");
+        ASSERT_TRUE(redone);
+        EXPECT_EQ(owners(*redone), (std::vector<std::string>{first, second}));
+        // Rejected, so the walk read the parent again and rewrote the file.
+        EXPECT_GT(again.commits, 1u);
+    }
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+#include "ChangedPathIndex.h"
+#include "Commit.h"
+#include "SyntheticRepo.h"
+
+namespace {
+using Blobs = std::unordered_map<std::string, std::string>;
+
+std::string blobId(int n) {
+    std::string hex = std::to_string(n);
+    return std::string(40 - hex.size(), '0') + hex;
+}
+
+// Paths whose blob differs between the two maps, or that only one has.
+std::set<std::string> changedBetween(const Blobs& before, const Blobs& after) {
+    std::set<std::string> changed;
+    for (const auto& [path, blobHash] : after) {
+        auto it = before.find(path);
+        if (it == before.end() || it->second != blobHash) {
+            changed.insert(path);
+        }
+    }
+    for (const auto& [path, blobHash] : before) {
+        if (after.find(path) == after.end()) {
+            changed.insert(path);
+        }
+    }
+    return changed;
+}
+
+// A chain of commits over 100 paths, each adding, editing or deleting a few.
+std::vector<Commit> randomHistory(int length, int maxChanges, std::mt19937& random) {
+    std::vector<Commit> commits;
+    Blobs blobs;
+    int nextBlob = 0;
+    for (int i = 0; i < 100; i++) {
+        blobs["dir" + std::to_string(i % 7) + "/file" + std::to_string(i)] = blobId(nextBlob++);
+    }
+    std::string parent;
+    for (int i = 0; i < length; i++) {
+        int changes = std::uniform_int_distribution<int>(0, maxChanges)(random);
+        for (int c = 0; c < changes; c++) {
+            std::string path = "dir" + std::to_string(random() % 7) + "/file" + std::to_string(random() % 120);
+            if (blobs.count(path) && random() % 4 == 0) {
+                blobs.erase(path);
+            } else {
+                blobs[path] = blobId(nextBlob++);
+            }
+        }
+        commits.emplace_back("commit " + std::to_string(i), blobs, parent, "2024-01-02 03:04:05");
+        parent = commits.back().getOwnHash();
+    }
+    return commits;
+}
+
+const Commit& commitAt(const std::vector<Commit>& commits, const ChangedPathIndex& index, size_t at) {
+    for (const Commit& commit : commits) {
+        if (ObjectId::fromHex(commit.getOwnHash()) == index.id(at)) {
+            return commit;
+        }
+    }
+    throw std::invalid_argument("commit not written");
+}
+}
+
+// Every path a commit changed is in its filter, and the paths it left alone
+// are mostly not, near the configured false positive rate.
+TEST(ChangedPathIndexTest, NeverReportsAChangedPathAsUnchanged) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    std::mt19937 random(11);
+    std::vector<Commit> commits = randomHistory(300, 12, random);
+    EXPECT_EQ(ChangedPathIndex::write(gitletDir, commits, 0.01, 512), commits.size());
+    ChangedPathIndex index(gitletDir);
+    ASSERT_TRUE(index.valid());
+    ASSERT_EQ(index.commitCount(), commits.size());
+
+    size_t unchangedChecks = 0;
+    size_t falsePositives = 0;
+    for (size_t i = 0; i < index.commitCount(); i++) {
+        const Commit& commit = commitAt(commits, index, i);
+        EXPECT_EQ(index.indexOf(index.id(i)), i);
+        Blobs before;
+        if (std::optional<size_t> parent = index.parent(i)) {
+            EXPECT_EQ(index.id(*parent), ObjectId::fromHex(commit.getParentHash()));
+            before = commitAt(commits, index, *parent).getBlobs();
+        } else {
+            EXPECT_TRUE(commit.getParentHash().empty());
+        }
+        std::set<std::string> changed = changedBetween(before, commit.getBlobs());
+        for (const std::string& path : changed) {
+            EXPECT_TRUE(index.mayChange(i, path)) << path << " in commit " << i;
+        }
+        for (int p = 0; p < 120; p++) {
+            std::string path = "dir" + std::to_string(p % 7) + "/file" + std::to_string(p);
+            if (!changed.count(path)) {
+                unchangedChecks++;
+                falsePositives += index.mayChange(i, path);
+            }
+        }
+    }
+    EXPECT_LT(falsePositives * 100, unchangedChecks * 3) << falsePositives << " of " << unchangedChecks;
+}
+
+// A commit over changedPaths.maxPaths, or whose parent the index does not
+// hold, gets no filter and may have changed anything.
+TEST(ChangedPathIndexTest, CommitsWithoutAFilterMayChangeAnything) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    Commit root("root", {{"a", blobId(1)}, {"b", blobId(2)}, {"c", blobId(3)}}, "", "2024-01-02 03:04:05");
+    Commit small("small", {{"a", blobId(4)}, {"b", blobId(2)}, {"c", blobId(3)}}, root.getOwnHash(), "2024-01-02 03:04:05");
+    Commit orphan("orphan", {{"a", blobId(4)}}, blobId(99), "2024-01-02 03:04:05");
+    EXPECT_EQ(ChangedPathIndex::write(gitletDir, {root, small, orphan}, 0.01, 2), 1u);
+    ChangedPathIndex index(gitletDir);
+    ASSERT_TRUE(index.valid());
+    std::optional<size_t> rootAt = index.indexOf(*ObjectId::fromHex(root.getOwnHash()));
+    std::optional<size_t> smallAt = index.indexOf(*ObjectId::fromHex(small.getOwnHash()));
+    std::optional<size_t> orphanAt = index.indexOf(*ObjectId::fromHex(orphan.getOwnHash()));
+    ASSERT_TRUE(rootAt && smallAt && orphanAt);
+    EXPECT_EQ(index.parent(*smallAt), rootAt);
+    EXPECT_FALSE(index.parent(*orphanAt));
+    EXPECT_TRUE(index.mayChange(*smallAt, "a"));
+    EXPECT_FALSE(index.mayChange(*smallAt, "b") && index.mayChange(*smallAt, "c"));
+    for (const char* path : {"a", "b", "c", "elsewhere"}) {
+        EXPECT_TRUE(index.mayChange(*rootAt, path));
+        EXPECT_TRUE(index.mayChange(*orphanAt, path));
+    }
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include "Commit.h"
+#include "ObjectStore.h"
+#include "Repo.h"
+#include "SyntheticRepo.h"
+#include "Utils.h"
+
+namespace {
+std::string archiveOf(const std::vector<char>& data) {
+    return std::string(data.begin(), data.end());
+}
+
+// Every commit in the store hashes back to its own id from its stored text.
+void expectEveryCommitHashesToItsId(const ObjectStore& objects) {
+    for (const ObjectId& id : objects.list(ObjectType::Commit)) {
+        std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, id.hex());
+        ASSERT_TRUE(data);
+        EXPECT_EQ(Commit::contentHash(archiveOf(*data), id.hex()), id.hex());
+    }
+}
+}
+
+TEST(CommitTest, ContentHashOfAConstructedCommit) {
+    Commit commit("message", {{"a.txt", std::string(40, 'a')}, {"b.txt", std::string(40, 'b')}},
+                  std::string(40, 'c'), "2024-01-02 03:04:05");
+    EXPECT_EQ(Commit::contentHash(commit.serializeToString(), commit.getOwnHash()), commit.getOwnHash());
+}
+
+TEST(CommitTest, WithArchiveMatchesTheConstructor) {
+    std::unordered_map<std::string, std::string> files;
+    for (int i = 0; i < 50; i++) {
+        files["f" + std::to_string(i) + ".txt"] = std::string(40, static_cast<char>('a' + i % 6));
+    }
+    Commit made("message", files, std::string(40, 'c'), "2024-01-02 03:04:05");
+    std::string archive;
+    Commit commit = Commit::withArchive("message", files, std::string(40, 'c'), "2024-01-02 03:04:05", archive);
+    EXPECT_EQ(commit.getOwnHash(), made.getOwnHash());
+    EXPECT_EQ(archive, commit.serializeToString());
+    EXPECT_EQ(Commit::contentHash(archive, commit.getOwnHash()), commit.getOwnHash());
+}
+
+TEST(CommitTest, ContentHashOfLooseAndPackedCommits) {
+    SyntheticRepo repo({5, 32, 6, 2});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    {
+        ObjectStore objects(gitletDir);
+        ASSERT_FALSE(objects.listLoose(ObjectType::Commit).empty());
+        expectEveryCommitHashesToItsId(objects);
+    }
+    Repo().gc();
+    ObjectStore objects(gitletDir);
+    EXPECT_TRUE(objects.listLoose(ObjectType::Commit).empty());
+    expectEveryCommitHashesToItsId(objects);
+}
+
+// Text that looks like a stored id anywhere but right after the header is
+// left alone, so it cannot stand in for the ownHash field.
+TEST(CommitTest, ContentHashOnlyTakesTheFieldAfterTheHeader) {
+    std::string parent(40, 'd');
+    Commit commit(" 40 " + parent + " ", {}, parent, "2024-01-02 03:04:05");
+    std::string archive = commit.serializeToString();
+    std::string text = archive.substr(0, archive.size() - 1);
+    EXPECT_EQ(Commit::contentHash(archive, parent), Utils::sha1(std::vector<char>(text.begin(), text.end())));
+    EXPECT_NE(Commit::contentHash(archive, parent), parent);
+
+    std::string damaged = archive;
+    damaged.replace(damaged.find("serialization::archive"), 5, "XXXXX");
+    EXPECT_NE(Commit::contentHash(damaged, commit.getOwnHash()), commit.getOwnHash());
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <mutex>
+
+#include "CommitWalker.h"
+#include "ObjectStore.h"
+#include "RefStore.h"
+#include "SyntheticRepo.h"
+#include "Utils.h"
+
+namespace {
+std::vector<std::string> tips(const fs::path& gitletDir) {
+    std::vector<std::string> out;
+    for (const auto& [branchName, commitID] : RefStore(gitletDir).list()) {
+        out.push_back(commitID);
+    }
+    return out;
+}
+}
+
+TEST(CommitWalkerTest, VisitsEveryCommitOnce) {
+    SyntheticRepo repo({4, 16, 20, 3});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    ObjectStore objects(gitletDir);
+    CommitWalker walker(objects, [](const Commit& commit) { return commit.getParentHash(); }, 4);
+    std::mutex mutex;
+    std::vector<std::string> seen;
+    walker.walk(tips(gitletDir), [&](const Commit& commit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.push_back(commit.getOwnHash());
+    });
+    std::sort(seen.begin(), seen.end());
+    EXPECT_EQ(std::adjacent_find(seen.begin(), seen.end()), seen.end());
+    EXPECT_EQ(seen.size(), objects.list(ObjectType::Commit).size());
+}
+
+// Commits made within one second share a date, so only parent links order
+// them; the lazy walk must agree with the merged one anyway.
+TEST(CommitWalkerTest, NewestFirstMatchesHistory) {
+    SyntheticRepo repo({4, 16, 20, 3});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    ObjectStore objects(gitletDir);
+    CommitWalker walker(objects, [](const Commit& commit) { return commit.getParentHash(); }, 4);
+    std::vector<std::string> expected;
+    for (const Commit& commit : walker.history(tips(gitletDir))) {
+        expected.push_back(commit.getOwnHash());
+    }
+    std::vector<std::string> lazy;
+    walker.newestFirst(tips(gitletDir), [&](const Commit& commit) {
+        lazy.push_back(commit.getOwnHash());
+        return true;
+    });
+    EXPECT_EQ(lazy, expected);
+
+    std::vector<std::string> firstFive;
+    walker.newestFirst(tips(gitletDir), [&](const Commit& commit) {
+        firstFive.push_back(commit.getOwnHash());
+        return firstFive.size() < 5;
+    });
+    EXPECT_EQ(firstFive, std::vector<std::string>(expected.begin(), expected.begin() + 5));
+}
+
+// A commit that does not load fails the walk on the calling thread instead
+// of ending the process from a worker.
+TEST(CommitWalkerTest, RethrowsWhatAWorkerThrew) {
+    SyntheticRepo repo({4, 16, 20, 3});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    ObjectStore objects(gitletDir);
+    std::vector<std::string> starts = tips(gitletDir);
+    for (const ObjectId& id : objects.listLoose(ObjectType::Commit)) {
+        if (std::find(starts.begin(), starts.end(), id.hex()) == starts.end()) {
+            Utils::writeContents(objects.loosePath(ObjectType::Commit, id.hex()).string(), std::vector<char>{'x'});
+        }
+    }
+    CommitWalker walker(objects, [](const Commit& commit) { return commit.getParentHash(); }, 4);
+    EXPECT_THROW(walker.walk(starts, [](const Commit&) {}), std::exception);
+}
+
+// One start leaves the other threads to read ahead from every commit; what
+// they read that the start does not reach must not be visited, and the
+// order must be the one a single thread gives.
+TEST(CommitWalkerTest, OneStartOnManyThreadsMatchesOneThread) {
+    SyntheticRepo repo({4, 16, 40, 3});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    ObjectStore objects(gitletDir);
+    auto parentOf = [](const Commit& commit) { return commit.getParentHash(); };
+    for (const std::string& tip : tips(gitletDir)) {
+        std::vector<std::string> expected;
+        for (const Commit& commit : CommitWalker(objects, parentOf, 1).history({tip})) {
+            expected.push_back(commit.getOwnHash());
+        }
+        std::vector<std::string> spread;
+        for (const Commit& commit : CommitWalker(objects, parentOf, 4).history({tip})) {
+            spread.push_back(commit.getOwnHash());
+        }
+        EXPECT_EQ(spread, expected);
+        EXPECT_LT(expected.size(), objects.list(ObjectType::Commit).size());
+    }
+}
+
+// A damaged commit that only the reading ahead meets is no error, while one
+// the start reaches still fails the walk.
+TEST(CommitWalkerTest, ReadingAheadOnlyFailsOnReachableDamage) {
+    SyntheticRepo repo({4, 16, 20, 1});
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    ObjectStore objects(gitletDir);
+    auto parentOf = [](const Commit& commit) { return commit.getParentHash(); };
+    RefStore refs(gitletDir);
+    std::string master = *refs.resolve("master");
+    std::string other;
+    for (const auto& [branchName, commitID] : refs.list()) {
+        if (commitID != master) {
+            other = commitID;
+        }
+    }
+    ASSERT_FALSE(other.empty());
+    std::vector<char> damaged{'x'};
+    Utils::writeContents(objects.loosePath(ObjectType::Commit, other).string(), damaged);
+
+    CommitWalker walker(objects, parentOf, 4);
+    size_t visited = 0;
+    std::mutex mutex;
+    EXPECT_NO_THROW(walker.walk({master}, [&](const Commit&) {
+        std::lock_guard<std::mutex> lock(mutex);
+        visited++;
+    }));
+    EXPECT_EQ(visited, CommitWalker(objects, parentOf, 1).history({master}).size());
+
+    std::string parent = CommitWalker(objects, parentOf, 1).history({master}).at(5).getOwnHash();
+    Utils::writeContents(objects.loosePath(ObjectType::Commit, parent).string(), damaged);
+    EXPECT_THROW(walker.walk({master}, [](const Commit&) {}), std::exception);
+}
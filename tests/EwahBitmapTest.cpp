@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "EwahBitmap.h"
+
+namespace {
+// Words with long clean runs of zeros and ones between literals, so the
+// compressed form has markers with both runs and literals.
+std::vector<uint64_t> randomWords(std::mt19937_64& rng, size_t count) {
+    std::vector<uint64_t> words(count);
+    std::uniform_int_distribution<int> kind(0, 3);
+    for (auto& word : words) {
+        switch (kind(rng)) {
+            case 0: word = 0; break;
+            case 1: word = ~uint64_t(0); break;
+            default: word = rng(); break;
+        }
+    }
+    return words;
+}
+
+bool plainTest(const std::vector<uint64_t>& words, size_t bit) {
+    return bit / 64 < words.size() && (words[bit / 64] >> (bit % 64) & 1);
+}
+
+// Pads the shorter operand with zero words, as the compressed operators do.
+std::vector<uint64_t> plain(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                            uint64_t (*op)(uint64_t, uint64_t)) {
+    std::vector<uint64_t> out(std::max(a.size(), b.size()));
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = op(i < a.size() ? a[i] : 0, i < b.size() ? b[i] : 0);
+    }
+    return out;
+}
+
+void expectBits(const EwahBitmap& bitmap, const std::vector<uint64_t>& words) {
+    for (size_t bit = 0; bit < (words.size() + 1) * 64; bit++) {
+        ASSERT_EQ(bitmap.test(bit), plainTest(words, bit)) << "bit " << bit;
+    }
+}
+}
+
+TEST(EwahBitmapTest, TestsTheBitsItWasBuiltFrom) {
+    std::mt19937_64 rng(7);
+    for (size_t count : {0, 1, 2, 65, 300}) {
+        std::vector<uint64_t> words = randomWords(rng, count);
+        EwahBitmap bitmap = EwahBitmap::fromWords(words);
+        expectBits(bitmap, words);
+        size_t ones = 0;
+        for (uint64_t word : words) {
+            ones += __builtin_popcountll(word);
+        }
+        EXPECT_EQ(bitmap.count(), ones);
+        std::string bytes = bitmap.serialize();
+        expectBits(EwahBitmap::deserialize(bytes.data(), bytes.size()), words);
+    }
+}
+
+TEST(EwahBitmapTest, OrAndAndAgreeWithPlainWords) {
+    std::mt19937_64 rng(11);
+    std::uniform_int_distribution<size_t> length(0, 200);
+    for (int round = 0; round < 50; round++) {
+        std::vector<uint64_t> a = randomWords(rng, length(rng));
+        std::vector<uint64_t> b = randomWords(rng, length(rng));
+        EwahBitmap x = EwahBitmap::fromWords(a);
+        EwahBitmap y = EwahBitmap::fromWords(b);
+        expectBits(x | y, plain(a, b, [](uint64_t p, uint64_t q) { return p | q; }));
+        expectBits(x & y, plain(a, b, [](uint64_t p, uint64_t q) { return p & q; }));
+        expectBits(x.andNot(y), plain(a, b, [](uint64_t p, uint64_t q) { return p & ~q; }));
+    }
+}
+
+// A long clean run ending in a literal, against a run of the other value.
+TEST(EwahBitmapTest, HandlesLongRuns) {
+    std::vector<uint64_t> zeros(100000, 0);
+    zeros.back() = 1;
+    std::vector<uint64_t> ones(70000, ~uint64_t(0));
+    EwahBitmap x = EwahBitmap::fromWords(zeros);
+    EwahBitmap y = EwahBitmap::fromWords(ones);
+    EXPECT_TRUE(x.test((zeros.size() - 1) * 64));
+    EXPECT_FALSE(x.test(64));
+    EXPECT_EQ((x | y).count(), ones.size() * 64 + 1);
+    EXPECT_EQ((x & y).count(), 0u);
+    EXPECT_EQ((x | y).toWords(), plain(zeros, ones, [](uint64_t p, uint64_t q) { return p | q; }));
+}
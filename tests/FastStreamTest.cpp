@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <map>
+#include <tuple>
+#include <unistd.h>
+
+#include "Commit.h"
+#include "FastStream.h"
+#include "ObjectStore.h"
+#include "RefStore.h"
+#include "Repo.h"
+#include "SyntheticRepo.h"
+#include "Transport.h"
+#include "Utils.h"
+
+namespace {
+// The fast-export stream of every branch of the repository in dir.
+std::string exportOf(const fs::path& dir, const fs::path& streamFile) {
+    int fd = ::open(streamFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    EXPECT_GE(fd, 0);
+    {
+        Channel out(-1, fd);
+        EXPECT_TRUE(Repo(dir).fastExport(out, {}));
+    }
+    ::close(fd);
+    return Utils::readStringFromFile(streamFile.string());
+}
+
+ImportResult importInto(const fs::path& dir, const std::string& stream, const fs::path& streamFile) {
+    Utils::writeStringToFile(stream, streamFile.string(), true);
+    int fd = ::open(streamFile.c_str(), O_RDONLY);
+    EXPECT_GE(fd, 0);
+    ImportResult result;
+    {
+        Channel in(fd, -1);
+        result = Repo(dir).fastImport(in);
+    }
+    ::close(fd);
+    return result;
+}
+
+// Each commit from tip back to the root, by message, date and files.
+std::vector<std::tuple<std::string, std::string, std::map<std::string, std::string>>> chainOf(const fs::path& dir,
+                                                                                               const std::string& tip) {
+    ObjectStore objects(dir / ".gitlet");
+    std::vector<std::tuple<std::string, std::string, std::map<std::string, std::string>>> chain;
+    for (std::string id = tip; !id.empty();) {
+        std::optional<std::vector<char>> data = objects.read(ObjectType::Commit, id);
+        EXPECT_TRUE(data) << id;
+        if (!data) {
+            break;
+        }
+        Commit commit;
+        commit.deserializeFromString(std::string(data->begin(), data->end()));
+        std::unordered_map<std::string, std::string> files = commit.getBlobs();
+        chain.emplace_back(commit.getMessage(), commit.getDatetime(), std::map<std::string, std::string>(files.begin(), files.end()));
+        id = commit.getParentHash();
+    }
+    return chain;
+}
+}
+
+// Exporting a history and importing it elsewhere keeps every branch's
+// commits with their messages, dates and files, and every blob. Commit ids
+// are not kept: they hash the file map in the order it was built.
+TEST(FastStreamTest, ExportThenImportKeepsTheHistory) {
+    SyntheticRepo source({8, 64, 10, 3});
+    QuietStdout quiet;
+    std::string stream = exportOf(source.getRoot(), source.getRoot() / "stream");
+    ASSERT_NE(stream.find("done\n"), std::string::npos);
+
+    SyntheticRepo target({0, 16, 1, 0});
+    ImportResult result = importInto(target.getRoot(), stream, target.getRoot() / "stream");
+    EXPECT_EQ(result.error, "");
+    EXPECT_GT(result.blobs, 0u);
+    EXPECT_GT(result.commits, 0u);
+
+    std::vector<std::pair<std::string, std::string>> sourceBranches = RefStore(source.getRoot() / ".gitlet").list();
+    std::vector<std::pair<std::string, std::string>> targetBranches = RefStore(target.getRoot() / ".gitlet").list();
+    ASSERT_EQ(targetBranches.size(), sourceBranches.size());
+    for (size_t i = 0; i < sourceBranches.size(); i++) {
+        EXPECT_EQ(targetBranches[i].first, sourceBranches[i].first);
+        EXPECT_EQ(chainOf(target.getRoot(), targetBranches[i].second), chainOf(source.getRoot(), sourceBranches[i].second))
+            << sourceBranches[i].first;
+    }
+    ObjectStore sourceObjects(source.getRoot() / ".gitlet");
+    ObjectStore targetObjects(target.getRoot() / ".gitlet");
+    for (const ObjectId& id : sourceObjects.list(ObjectType::Blob)) {
+        EXPECT_EQ(targetObjects.read(ObjectType::Blob, id.hex()), sourceObjects.read(ObjectType::Blob, id.hex()));
+    }
+}
+
+// A stream that fails part way moves no branch and leaves no pack.
+TEST(FastStreamTest, ARejectedStreamChangesNothing) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    std::vector<std::pair<std::string, std::string>> before = RefStore(gitletDir).list();
+    ImportResult result = importInto(repo.getRoot(),
+                                     "blob\nmark :1\ndata 3\nabc\n"
+                                     "commit topic\nmark :2\ndata 2\nhi\nM :1 a.txt\n\n"
+                                     "commit master\ndata 2\nho\nfrom :9\n\n",
+                                     repo.getRoot() / "stream");
+    EXPECT_NE(result.error, "");
+    EXPECT_EQ(RefStore(gitletDir).list(), before);
+    EXPECT_TRUE(ObjectStore(gitletDir).packs().empty());
+}
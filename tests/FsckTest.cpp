@@ -0,0 +1,29 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+
+#include "ObjectStore.h"
+#include "RefStore.h"
+#include "Repo.h"
+#include "SyntheticRepo.h"
+#include "Utils.h"
+
+// A damaged commit is reported once, and what it refers to is not taken
+// for dangling.
+TEST(FsckTest, DamagedCommitStillReferencesItsParentAndBlobs) {
+    SyntheticRepo repo({3, 32, 4, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    EXPECT_TRUE(Repo().fsck().errors.empty());
+
+    std::string tip = *RefStore(gitletDir).resolve("master");
+    fs::path path = ObjectStore(gitletDir).loosePath(ObjectType::Commit, tip);
+    std::vector<char> data = Utils::readContents(path);
+    std::string text(data.begin(), data.end());
+    text.replace(text.find("commit 3"), 8, "commit 9");
+    Utils::writeContents(path.string(), std::vector<char>(text.begin(), text.end()));
+
+    FsckResult result = Repo().fsck();
+    EXPECT_NE(std::find(result.errors.begin(), result.errors.end(), "hash mismatch in commit " + tip),
+              result.errors.end());
+    EXPECT_TRUE(result.dangling.empty());
+}
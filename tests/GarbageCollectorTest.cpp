@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <sys/stat.h>
+
+#include "ObjectStore.h"
+#include "Repo.h"
+#include "SyntheticRepo.h"
+#include "Utils.h"
+
+namespace {
+std::set<fs::path> packFiles(const fs::path& gitletDir) {
+    std::set<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(gitletDir / "packs")) {
+        files.insert(entry.path());
+    }
+    return files;
+}
+}
+
+// A reachable object gc cannot read must keep its loose copy, and the packs
+// that were there must stay, since nothing new holds what they hold.
+TEST(GarbageCollectorTest, KeepsEverythingWhenAReachableObjectCannotBeRead) {
+    SyntheticRepo repo({3, 64, 2, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    Repo().gc();
+
+    repo.touchFile(0, 5);
+    Repo().add(SyntheticRepo::fileName(0));
+    Repo().commitment("unpacked");
+    std::string blobHash = Utils::sha1(repo.getRoot() / SyntheticRepo::fileName(0));
+    fs::path loose = gitletDir / "blobs" / (blobHash + ".txt");
+    ASSERT_TRUE(fs::is_regular_file(loose));
+    // A directory in its place reads as an I/O error.
+    fs::remove(loose);
+    fs::create_directory(loose);
+
+    std::set<fs::path> packs = packFiles(gitletDir);
+    EXPECT_THROW(Repo().gc(), std::invalid_argument);
+    EXPECT_TRUE(fs::exists(loose));
+    EXPECT_EQ(packFiles(gitletDir), packs);
+
+    ObjectStore objects(gitletDir);
+    for (ObjectType type : {ObjectType::Commit, ObjectType::Blob}) {
+        for (const ObjectId& id : objects.list(type)) {
+            if (id.hex() != blobHash) {
+                EXPECT_TRUE(objects.read(type, id.hex())) << id.hex();
+            }
+        }
+    }
+}
+
+// Without a damaged object gc packs everything and leaves nothing loose.
+TEST(GarbageCollectorTest, PacksEveryReachableObject) {
+    SyntheticRepo repo({3, 64, 3, 1});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    ObjectStore before(gitletDir);
+    size_t objectCount = before.list(ObjectType::Commit).size() + before.list(ObjectType::Blob).size();
+
+    GcResult result = Repo().gc();
+    EXPECT_EQ(result.packed, objectCount);
+
+    ObjectStore after(gitletDir);
+    EXPECT_TRUE(after.listLoose(ObjectType::Commit).empty());
+    EXPECT_TRUE(after.listLoose(ObjectType::Blob).empty());
+    EXPECT_EQ(after.list(ObjectType::Commit).size() + after.list(ObjectType::Blob).size(), objectCount);
+}
+
+// A second gc packs the same objects under the same name; the pack already
+// there stays, rather than being replaced under its old index.
+TEST(GarbageCollectorTest, KeepsAPackOfTheSameName) {
+    SyntheticRepo repo({3, 64, 2, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    Repo().gc();
+    std::set<fs::path> packs = packFiles(gitletDir);
+    ASSERT_EQ(packs.size(), 2u);
+    fs::path pack = *packs.rbegin();
+    ASSERT_EQ(pack.extension(), ".pack");
+    auto inode = [](const fs::path& path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0 ? st.st_ino : 0;
+    };
+    ino_t before = inode(pack);
+
+    Repo().gc();
+    EXPECT_EQ(packFiles(gitletDir), packs);
+    EXPECT_EQ(inode(pack), before);
+}
+
+// An index entry past the end of its pack reads as missing, not out of
+// bounds.
+TEST(GarbageCollectorTest, IgnoresEntriesOutsideTheirPack) {
+    SyntheticRepo repo({3, 64, 2, 0});
+    QuietStdout quiet;
+    fs::path gitletDir = repo.getRoot() / ".gitlet";
+    Repo().gc();
+    fs::path pack = *packFiles(gitletDir).rbegin();
+    fs::resize_file(pack, 64);
+
+    ObjectStore objects(gitletDir);
+    for (const ObjectId& id : objects.list(ObjectType::Blob)) {
+        EXPECT_FALSE(objects.read(ObjectType::Blob, id.hex())) << id.hex();
+        EXPECT_FALSE(objects.readInPieces(ObjectType::Blob, id.hex(), [](const char*, size_t) {}));
+    }
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "IgnoreRules.h"
+
+namespace {
+IgnoreRules rulesOf(const std::vector<std::string>& lines) {
+    IgnoreRules rules;
+    for (const std::string& line : lines) {
+        rules.add(line);
+    }
+    return rules;
+}
+}
+
+TEST(IgnoreRulesTest, MatchesNamesAtAnyDepthUnlessAnchored) {
+    IgnoreRules rules = rulesOf({"# a comment", "", "*.o", "core", "tmp*", "/notes.txt", "docs/draft.md"});
+    EXPECT_TRUE(rules.ignoredPath("main.o"));
+    EXPECT_TRUE(rules.ignoredPath("src/deep/main.o"));
+    EXPECT_FALSE(rules.ignoredPath("main.oo"));
+    EXPECT_FALSE(rules.ignoredPath("o"));
+    EXPECT_TRUE(rules.ignoredPath("lib/core"));
+    EXPECT_FALSE(rules.ignoredPath("lib/core2"));
+    EXPECT_TRUE(rules.ignoredPath("tmp"));
+    EXPECT_TRUE(rules.ignoredPath("a/tmp.log"));
+    EXPECT_FALSE(rules.ignoredPath("a/xtmp"));
+    EXPECT_TRUE(rules.ignoredPath("notes.txt"));
+    EXPECT_FALSE(rules.ignoredPath("sub/notes.txt"));
+    EXPECT_TRUE(rules.ignoredPath("docs/draft.md"));
+    EXPECT_FALSE(rules.ignoredPath("src/docs/draft.md"));
+    EXPECT_FALSE(rules.ignoredPath("# a comment"));
+}
+
+TEST(IgnoreRulesTest, TrailingSlashMatchesOnlyDirectories) {
+    IgnoreRules rules = rulesOf({"build/"});
+    EXPECT_TRUE(rules.ignored("build", true));
+    EXPECT_FALSE(rules.ignored("build", false));
+    EXPECT_TRUE(rules.ignoredPath("build/out.bin"));
+    EXPECT_TRUE(rules.ignoredPath("src/build/out.bin"));
+    EXPECT_FALSE(rules.ignoredPath("build"));
+}
+
+TEST(IgnoreRulesTest, DoubleStarMatchesAnyNumberOfDirectories) {
+    IgnoreRules rules = rulesOf({"docs/**/*.tmp", "**/cache", "logs/**"});
+    EXPECT_TRUE(rules.ignoredPath("docs/a.tmp"));
+    EXPECT_TRUE(rules.ignoredPath("docs/x/y/a.tmp"));
+    EXPECT_FALSE(rules.ignoredPath("docs/x/a.tmpl"));
+    EXPECT_FALSE(rules.ignoredPath("other/docs/a.tmp"));
+    EXPECT_TRUE(rules.ignoredPath("cache"));
+    EXPECT_TRUE(rules.ignoredPath("a/b/cache"));
+    EXPECT_FALSE(rules.ignoredPath("a/bcache"));
+    EXPECT_TRUE(rules.ignoredPath("logs/today/1.log"));
+    EXPECT_FALSE(rules.ignoredPath("logsx/1.log"));
+}
+
+TEST(IgnoreRulesTest, StarsQuestionMarksAndClassesStayWithinANameSegment) {
+    IgnoreRules rules = rulesOf({"src/*.gen", "img?.png", "[abc]*.bak", "[!x]y.c", "file[0-9].txt", "\\#hash", "\\!bang"});
+    EXPECT_TRUE(rules.ignoredPath("src/a.gen"));
+    EXPECT_FALSE(rules.ignoredPath("src/sub/a.gen"));
+    EXPECT_TRUE(rules.ignoredPath("img1.png"));
+    EXPECT_FALSE(rules.ignoredPath("img12.png"));
+    EXPECT_TRUE(rules.ignoredPath("b1.bak"));
+    EXPECT_FALSE(rules.ignoredPath("d1.bak"));
+    EXPECT_TRUE(rules.ignoredPath("ay.c"));
+    EXPECT_FALSE(rules.ignoredPath("xy.c"));
+    EXPECT_TRUE(rules.ignoredPath("file7.txt"));
+    EXPECT_FALSE(rules.ignoredPath("filex.txt"));
+    EXPECT_TRUE(rules.ignoredPath("#hash"));
+    EXPECT_TRUE(rules.ignoredPath("!bang"));
+}
+
+// The last matching pattern decides, but nothing inside an ignored
+// directory comes back.
+TEST(IgnoreRulesTest, NegationReincludesUnlessTheDirectoryIsIgnored) {
+    IgnoreRules rules = rulesOf({"*.log", "!keep.log", "out/", "!out/keep.txt"});
+    EXPECT_TRUE(rules.ignoredPath("a.log"));
+    EXPECT_FALSE(rules.ignoredPath("keep.log"));
+    EXPECT_FALSE(rules.ignoredPath("sub/keep.log"));
+    EXPECT_TRUE(rules.ignoredPath("out/keep.txt"));
+    EXPECT_TRUE(rulesOf({"!keep.log", "*.log"}).ignoredPath("keep.log"));
+}
+
+TEST(IgnoreRulesTest, AlwaysIgnoresTheRepositoryItself) {
+    IgnoreRules rules;
+    EXPECT_TRUE(rules.ignored(".gitlet", true));
+    EXPECT_TRUE(rules.ignoredPath(".gitlet/HEAD"));
+    EXPECT_TRUE(rules.ignoredPath("Gitlet"));
+    EXPECT_FALSE(rules.ignoredPath("src/Gitlet.cpp"));
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "LineDiff.h"
+
+namespace {
+std::vector<std::string_view> linesOf(const std::vector<std::string>& texts) {
+    return std::vector<std::string_view>(texts.begin(), texts.end());
+}
+
+// The length of a longest common subsequence, by the quadratic table.
+size_t commonLength(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b) {
+    std::vector<std::vector<size_t>> table(a.size() + 1, std::vector<size_t>(b.size() + 1, 0));
+    for (size_t i = a.size(); i-- > 0;) {
+        for (size_t j = b.size(); j-- > 0;) {
+            table[i][j] = a[i] == b[j] ? table[i + 1][j + 1] + 1 : std::max(table[i + 1][j], table[i][j + 1]);
+        }
+    }
+    return table[0][0];
+}
+
+// A matching pairs equal lines, increasing in both, and is as long as any.
+void expectShortest(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b) {
+    std::vector<std::pair<size_t, size_t>> pairs = LineDiff::matching(a, b);
+    for (size_t k = 0; k < pairs.size(); k++) {
+        ASSERT_LT(pairs[k].first, a.size());
+        ASSERT_LT(pairs[k].second, b.size());
+        EXPECT_EQ(a[pairs[k].first], b[pairs[k].second]);
+        if (k > 0) {
+            EXPECT_LT(pairs[k - 1].first, pairs[k].first);
+            EXPECT_LT(pairs[k - 1].second, pairs[k].second);
+        }
+    }
+    EXPECT_EQ(pairs.size(), commonLength(a, b));
+}
+}
+
+TEST(LineDiffTest, SplitsLinesKeepingTheLastWithoutANewline) {
+    std::vector<std::string_view> lines = LineDiff::lines("a\nb\n\nc");
+    EXPECT_EQ(lines, (std::vector<std::string_view>{"a\n", "b\n", "\n", "c"}));
+    EXPECT_TRUE(LineDiff::lines("").empty());
+}
+
+TEST(LineDiffTest, MatchesEmptyAndIdenticalInputs) {
+    std::vector<std::string> some = {"x", "y", "z"};
+    EXPECT_TRUE(LineDiff::matching({}, {}).empty());
+    EXPECT_TRUE(LineDiff::matching({}, linesOf(some)).empty());
+    EXPECT_TRUE(LineDiff::matching(linesOf(some), {}).empty());
+    std::vector<std::pair<size_t, size_t>> same = LineDiff::matching(linesOf(some), linesOf(some));
+    EXPECT_EQ(same, (std::vector<std::pair<size_t, size_t>>{{0, 0}, {1, 1}, {2, 2}}));
+}
+
+TEST(LineDiffTest, MatchesNothingWhenNothingIsShared) {
+    std::vector<std::string> a = {"a", "b", "c"};
+    std::vector<std::string> b = {"d", "e"};
+    EXPECT_TRUE(LineDiff::matching(linesOf(a), linesOf(b)).empty());
+}
+
+// The middle snake is found where the forward and backward searches
+// overlap, checked on forward steps for an odd edit distance and on
+// backward steps for an even one.
+TEST(LineDiffTest, FindsAShortestScriptForOddAndEvenDistances) {
+    std::vector<std::string> a = {"a", "b", "c", "d", "e", "f"};
+    std::vector<std::string> odd = {"a", "c", "d", "e", "f"};        // one deletion
+    std::vector<std::string> even = {"a", "x", "c", "d", "y", "f"};  // two replaced, four edits
+    std::vector<std::string> moved = {"f", "a", "b", "c", "d", "e"};  // two edits
+    std::vector<std::string> grown = {"a", "b", "q", "c", "d", "r", "s", "e", "f"};
+    for (const auto* b : {&odd, &even, &moved, &grown}) {
+        expectShortest(linesOf(a), linesOf(*b));
+        expectShortest(linesOf(*b), linesOf(a));
+    }
+    EXPECT_EQ(LineDiff::matching(linesOf(a), linesOf(odd)).size(), 5u);
+    EXPECT_EQ(LineDiff::matching(linesOf(a), linesOf(even)).size(), 4u);
+}
+
+// Small alphabets make many equal lines, so the searches meet in every
+// kind of place; each answer is checked against the quadratic table.
+TEST(LineDiffTest, MatchesAsManyLinesAsTheQuadraticTable) {
+    std::mt19937 rng(42);
+    const std::vector<std::string> alphabet = {"a", "b", "c", "d"};
+    for (int round = 0; round < 500; round++) {
+        std::uniform_int_distribution<int> length(0, 12);
+        std::uniform_int_distribution<int> letter(0, round % 2 ? 1 : 3);
+        std::vector<std::string> a(length(rng));
+        std::vector<std::string> b(length(rng));
+        for (auto& line : a) {
+            line = alphabet[letter(rng)];
+        }
+        for (auto& line : b) {
+            line = alphabet[letter(rng)];
+        }
+        expectShortest(linesOf(a), linesOf(b));
+    }
+}
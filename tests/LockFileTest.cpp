@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "LockFile.h"
+#include "SyntheticRepo.h"
+#include "Utils.h"
+
+using namespace std::chrono_literals;
+
+// A held lock turns a second taker away once its timeout passes, and lets
+// one in as soon as it is released.
+TEST(LockFileTest, SecondTakerWaitsForTheFirst) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    fs::path target = repo.getRoot() / "counter";
+    Utils::writeStringToFile("before", target.string(), true);
+    {
+        LockFile held(target);
+        EXPECT_THROW(LockFile(target, 20ms), LockError);
+        std::thread releaser([&] {
+            std::this_thread::sleep_for(20ms);
+            held.release();
+        });
+        LockFile waited(target, 5000ms);
+        releaser.join();
+        waited.commit("after");
+    }
+    EXPECT_EQ(Utils::readStringFromFile(target.string()), "after");
+    EXPECT_FALSE(fs::exists(fs::path(target) += ".lock"));
+}
+
+// Dropping a lock without committing leaves the target as it was.
+TEST(LockFileTest, ReleasingLeavesTheTarget) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    fs::path target = repo.getRoot() / "counter";
+    Utils::writeStringToFile("kept", target.string(), true);
+    {
+        LockFile lock(target);
+    }
+    EXPECT_EQ(Utils::readStringFromFile(target.string()), "kept");
+    EXPECT_FALSE(fs::exists(fs::path(target) += ".lock"));
+}
+
+// Read-modify-write under the lock from many threads loses no update.
+TEST(LockFileTest, SerializesConcurrentUpdates) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    fs::path target = repo.getRoot() / "counter";
+    Utils::writeStringToFile("0", target.string(), true);
+    const int threads = 8;
+    const int rounds = 25;
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.emplace_back([&] {
+            for (int i = 0; i < rounds; i++) {
+                LockFile lock(target);
+                int value = std::stoi(Utils::readStringFromFile(target.string()));
+                lock.commit(std::to_string(value + 1));
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    EXPECT_EQ(Utils::readStringFromFile(target.string()), std::to_string(threads * rounds));
+}
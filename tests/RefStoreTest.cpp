@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "RefStore.h"
+#include "SyntheticRepo.h"
+
+namespace {
+std::string idFor(int n) {
+    std::string hex = std::to_string(n);
+    return std::string(40 - hex.size(), '0') + hex;
+}
+}
+
+// Names that sort next to each other, share prefixes or nest are all found
+// by the binary search over packed-refs, and names between them are not.
+TEST(RefStoreTest, ResolvesPackedBranches) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    RefStore refs(repo.getRoot() / ".gitlet");
+    std::vector<std::string> names = {"a", "ab", "abc", "b", "feature/x", "feature/x-2", "feature/y", "z"};
+    for (int i = 0; i < 200; i++) {
+        names.push_back("topic" + std::to_string(i));
+    }
+    for (size_t i = 0; i < names.size(); i++) {
+        ASSERT_TRUE(refs.update(names[i], idFor(static_cast<int>(i))));
+    }
+    std::string master = *refs.resolve("master");
+    EXPECT_EQ(refs.pack(), names.size() + 1);
+    EXPECT_FALSE(fs::exists(refs.loosePath("feature/x")));
+    EXPECT_FALSE(fs::exists(repo.getRoot() / ".gitlet" / "branches" / "feature"));
+
+    RefStore fresh(repo.getRoot() / ".gitlet");
+    for (size_t i = 0; i < names.size(); i++) {
+        EXPECT_EQ(fresh.resolve(names[i]), idFor(static_cast<int>(i))) << names[i];
+    }
+    EXPECT_EQ(fresh.resolve("master"), master);
+    for (const std::string& missing : {"", "0", "aa", "abcd", "feature", "feature/", "topic", "zz", "HEAD"}) {
+        EXPECT_FALSE(fresh.resolve(missing)) << missing;
+    }
+    std::vector<std::pair<std::string, std::string>> listed = fresh.list();
+    EXPECT_EQ(listed.size(), names.size() + 1);
+    EXPECT_TRUE(std::is_sorted(listed.begin(), listed.end()));
+}
+
+// A loose branch overrides its packed entry, and removing the branch
+// removes both.
+TEST(RefStoreTest, LooseBranchesOverridePackedOnes) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    RefStore refs(repo.getRoot() / ".gitlet");
+    refs.update("topic", idFor(1));
+    refs.pack();
+    ASSERT_TRUE(refs.update("topic", idFor(2), idFor(1)));
+    EXPECT_FALSE(refs.update("topic", idFor(3), idFor(1)));
+    EXPECT_EQ(refs.resolve("topic"), idFor(2));
+    EXPECT_EQ(refs.list().size(), 2u);
+    EXPECT_TRUE(refs.remove("topic"));
+    EXPECT_FALSE(refs.resolve("topic"));
+    EXPECT_FALSE(refs.remove("topic"));
+}
+
+// Moves made together either all happen or, when one branch is not where
+// the caller expects, none does.
+TEST(RefStoreTest, UpdateAllMovesEveryBranchOrNone) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    RefStore refs(repo.getRoot() / ".gitlet");
+    ASSERT_TRUE(refs.update("a", idFor(1)));
+    ASSERT_TRUE(refs.update("nested/b", idFor(2)));
+    refs.pack();
+
+    EXPECT_FALSE(refs.updateAll({{"a", {idFor(10), idFor(1)}}, {"nested/b", {idFor(20), idFor(3)}}, {"new", {idFor(30), ""}}}));
+    EXPECT_EQ(refs.resolve("a"), idFor(1));
+    EXPECT_EQ(refs.resolve("nested/b"), idFor(2));
+    EXPECT_FALSE(refs.resolve("new"));
+    EXPECT_FALSE(fs::exists(refs.loosePath("a")));
+
+    EXPECT_TRUE(refs.updateAll({{"a", {idFor(10), idFor(1)}}, {"nested/b", {idFor(20), idFor(2)}}, {"new", {idFor(30), ""}}}));
+    EXPECT_EQ(refs.resolve("a"), idFor(10));
+    EXPECT_EQ(refs.resolve("nested/b"), idFor(20));
+    EXPECT_EQ(refs.resolve("new"), idFor(30));
+    EXPECT_EQ(RefStore(repo.getRoot() / ".gitlet").resolve("nested/b"), idFor(20));
+}
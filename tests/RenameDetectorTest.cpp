@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+#include "Executor.h"
+#include "RenameDetector.h"
+
+namespace {
+std::string linesOf(int first, int count, const std::string& tag = "") {
+    std::string text;
+    for (int i = first; i < first + count; i++) {
+        text += "line " + std::to_string(i) + tag + "\n";
+    }
+    return text;
+}
+
+// Blob contents by id, with ids handed out as contents are added.
+class Contents {
+public:
+    std::string add(const std::string& text) {
+        std::string id = "blob" + std::to_string(byId.size());
+        byId[id] = text;
+        return id;
+    }
+    RenameDetector::Loader loader() const {
+        return [this](const std::string& blobHash) {
+            const std::string& text = byId.at(blobHash);
+            return std::vector<char>(text.begin(), text.end());
+        };
+    }
+
+private:
+    std::map<std::string, std::string> byId;
+};
+
+const FileChange* changeAt(const std::vector<FileChange>& changes, const std::string& path) {
+    for (const FileChange& change : changes) {
+        if (change.path == path) {
+            return &change;
+        }
+    }
+    return nullptr;
+}
+}
+
+// An edited, moved file pairs with its old path and scores near the share
+// of lines the two versions have in common.
+TEST(RenameDetectorTest, PairsAnEditedMoveByContent) {
+    Contents contents;
+    InlineExecutor executor;
+    std::string kept = contents.add(linesOf(0, 20, "k"));
+    std::string before = contents.add(linesOf(0, 100));
+    std::string after = contents.add(linesOf(0, 90) + linesOf(1000, 10));
+    std::string unrelated = contents.add(linesOf(5000, 100));
+    RenameDetector detector(contents.loader(), executor);
+    std::vector<FileChange> changes = detector.diff({{"keep.txt", kept}, {"old.txt", before}, {"gone.txt", unrelated}},
+                                                    {{"keep.txt", kept}, {"dir/new.txt", after}, {"fresh.txt", contents.add(linesOf(9000, 50))}});
+    ASSERT_EQ(changes.size(), 3u);
+    const FileChange* rename = changeAt(changes, "dir/new.txt");
+    ASSERT_TRUE(rename);
+    EXPECT_EQ(rename->kind, FileChange::Kind::Renamed);
+    EXPECT_EQ(rename->from, "old.txt");
+    // 90 shared lines out of 110 distinct ones.
+    EXPECT_GE(rename->score, 65u);
+    EXPECT_LE(rename->score, 99u);
+    EXPECT_EQ(changeAt(changes, "fresh.txt")->kind, FileChange::Kind::Added);
+    EXPECT_EQ(changeAt(changes, "gone.txt")->kind, FileChange::Kind::Deleted);
+    EXPECT_EQ(changes.front().path, "dir/new.txt");
+}
+
+// Identical blobs pair first and score 100; each deleted file is renamed
+// once, so a second identical file added is only a copy.
+TEST(RenameDetectorTest, IdenticalBlobsPairFirst) {
+    Contents contents;
+    InlineExecutor executor;
+    std::string same = contents.add(linesOf(0, 30));
+    std::string similar = contents.add(linesOf(0, 29) + "changed\n");
+    RenameDetector renames(contents.loader(), executor);
+    std::vector<FileChange> changes = renames.diff({{"a.txt", same}}, {{"b.txt", similar}, {"c.txt", same}});
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changeAt(changes, "c.txt")->kind, FileChange::Kind::Renamed);
+    EXPECT_EQ(changeAt(changes, "c.txt")->score, 100u);
+    EXPECT_EQ(changeAt(changes, "b.txt")->kind, FileChange::Kind::Added);
+
+    RenameDetector copies(contents.loader(), executor, RenameDetector::Detect::Copies);
+    changes = copies.diff({{"a.txt", same}, {"kept.txt", same}}, {{"kept.txt", same}, {"b.txt", similar}, {"c.txt", same}, {"d.txt", same}});
+    ASSERT_EQ(changes.size(), 3u);
+    EXPECT_EQ(changeAt(changes, "c.txt")->kind, FileChange::Kind::Renamed);
+    EXPECT_EQ(changeAt(changes, "c.txt")->from, "a.txt");
+    EXPECT_EQ(changeAt(changes, "d.txt")->kind, FileChange::Kind::Copied);
+    EXPECT_EQ(changeAt(changes, "d.txt")->score, 100u);
+    EXPECT_EQ(changeAt(changes, "b.txt")->kind, FileChange::Kind::Copied);
+    EXPECT_LT(changeAt(changes, "b.txt")->score, 100u);
+}
+
+// Pairs below the threshold, and every pair when detection is off, are
+// reported as an add and a delete.
+TEST(RenameDetectorTest, ThresholdAndDetectionOff) {
+    Contents contents;
+    InlineExecutor executor;
+    RenameDetector::Blobs before{{"old.txt", contents.add(linesOf(0, 100))}};
+    RenameDetector::Blobs after{{"new.txt", contents.add(linesOf(0, 60) + linesOf(1000, 40))}};
+    EXPECT_EQ(RenameDetector(contents.loader(), executor, RenameDetector::Detect::Renames, 30).diff(before, after).size(), 1u);
+    for (RenameDetector detector : {RenameDetector(contents.loader(), executor, RenameDetector::Detect::Renames, 90),
+                                    RenameDetector(contents.loader(), executor, RenameDetector::Detect::Nothing)}) {
+        std::vector<FileChange> changes = detector.diff(before, after);
+        ASSERT_EQ(changes.size(), 2u);
+        EXPECT_EQ(changeAt(changes, "new.txt")->kind, FileChange::Kind::Added);
+        EXPECT_EQ(changeAt(changes, "old.txt")->kind, FileChange::Kind::Deleted);
+    }
+}
+
+// The sketch estimate stays close to the exact Jaccard similarity of the
+// line sets, and empty content has no sketch.
+TEST(RenameDetectorTest, SimilarityEstimatesJaccard) {
+    std::mt19937 random(7);
+    double totalError = 0;
+    const int trials = 40;
+    for (int trial = 0; trial < trials; trial++) {
+        int shared = std::uniform_int_distribution<int>(20, 200)(random);
+        int onlyA = std::uniform_int_distribution<int>(0, 100)(random);
+        int onlyB = std::uniform_int_distribution<int>(0, 100)(random);
+        std::string a = linesOf(0, shared) + linesOf(100000, onlyA);
+        std::string b = linesOf(0, shared) + linesOf(200000, onlyB);
+        RenameDetector::Sketch sa;
+        RenameDetector::Sketch sb;
+        ASSERT_TRUE(RenameDetector::sketch(std::vector<char>(a.begin(), a.end()), sa));
+        ASSERT_TRUE(RenameDetector::sketch(std::vector<char>(b.begin(), b.end()), sb));
+        double exact = 100.0 * shared / (shared + onlyA + onlyB);
+        double error = std::abs(RenameDetector::similarity(sa, sb) - exact);
+        EXPECT_LT(error, 30) << "shared " << shared << " onlyA " << onlyA << " onlyB " << onlyB;
+        totalError += error;
+    }
+    EXPECT_LT(totalError / trials, 8);
+
+    RenameDetector::Sketch empty;
+    EXPECT_FALSE(RenameDetector::sketch({}, empty));
+}
+
+// Repeated lines count once per occurrence, so doubling a file's lines
+// halves its similarity to the original.
+TEST(RenameDetectorTest, RepeatedLinesCountEachTime) {
+    std::string once = linesOf(0, 100);
+    std::string twice = once + once;
+    RenameDetector::Sketch a;
+    RenameDetector::Sketch b;
+    RenameDetector::sketch(std::vector<char>(once.begin(), once.end()), a);
+    RenameDetector::sketch(std::vector<char>(twice.begin(), twice.end()), b);
+    EXPECT_GE(RenameDetector::similarity(a, b), 30u);
+    EXPECT_LE(RenameDetector::similarity(a, b), 70u);
+}
+
+// Many moves at once all find their sources through the LSH buckets, with
+// sketches computed on several threads.
+TEST(RenameDetectorTest, ManyMovesPairThroughTheIndex) {
+    Contents contents;
+    std::unique_ptr<Executor> executor = Executor::create("threads", 4);
+    RenameDetector::Blobs before;
+    RenameDetector::Blobs after;
+    const int files = 300;
+    for (int i = 0; i < files; i++) {
+        before["src/f" + std::to_string(i)] = contents.add(linesOf(i * 1000, 40));
+        after["lib/f" + std::to_string(i)] = contents.add(linesOf(i * 1000, 36) + linesOf(i * 1000 + 500, 4));
+    }
+    std::vector<FileChange> changes = RenameDetector(contents.loader(), *executor).diff(before, after);
+    ASSERT_EQ(changes.size(), static_cast<size_t>(files));
+    for (const FileChange& change : changes) {
+        EXPECT_EQ(change.kind, FileChange::Kind::Renamed) << change.path;
+        EXPECT_EQ("lib/" + change.from.substr(4), change.path);
+    }
+}
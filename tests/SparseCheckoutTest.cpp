@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "Repo.h"
+#include "SparseCheckout.h"
+#include "SyntheticRepo.h"
+#include "Utils.h"
+
+// A directory pattern takes everything beneath it and nothing beside it,
+// while files at the top level stay in.
+TEST(SparseCheckoutTest, DirectoryPatternsIncludeTheirSubtree) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    SparseCheckout sparse(repo.getRoot() / ".gitlet");
+    EXPECT_FALSE(sparse.enabled());
+    EXPECT_TRUE(sparse.includes("other/x"));
+
+    sparse.set({"src/app/", "docs/*.md"});
+    EXPECT_TRUE(sparse.enabled());
+    EXPECT_EQ(sparse.getPatterns(), (std::vector<std::string>{"src/app/", "docs/*.md"}));
+    EXPECT_TRUE(sparse.includes("src/app/x"));
+    EXPECT_TRUE(sparse.includes("src/app/deep/x"));
+    EXPECT_TRUE(sparse.includes("Makefile"));
+    EXPECT_TRUE(sparse.includes("docs/guide.md"));
+    EXPECT_FALSE(sparse.includes("docs/guide.txt"));
+    EXPECT_FALSE(sparse.includes("src/application/x"));
+    EXPECT_FALSE(sparse.includes("src/x"));
+    EXPECT_FALSE(sparse.includes("other/x"));
+    EXPECT_TRUE(SparseCheckout(repo.getRoot() / ".gitlet").includes("src/app/x"));
+
+    sparse.disable();
+    EXPECT_FALSE(sparse.enabled());
+    EXPECT_TRUE(sparse.includes("other/x"));
+    EXPECT_FALSE(fs::exists(SparseCheckout::path(repo.getRoot() / ".gitlet")));
+}
+
+// Narrowing removes unmodified files outside the set, and widening writes
+// them back from the current commit.
+TEST(SparseCheckoutTest, RepoFollowsThePatterns) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    QuietStdout quiet;
+    fs::create_directories("src/app");
+    fs::create_directories("other");
+    Utils::writeStringToFile("app", "src/app/main.cpp", true);
+    Utils::writeStringToFile("other", "other/notes.txt", true);
+    Utils::writeStringToFile("edited", "other/edited.txt", true);
+    for (const char* name : {"src/app/main.cpp", "other/notes.txt", "other/edited.txt"}) {
+        Repo().add(name);
+    }
+    Repo().commitment("nested files");
+    Utils::writeStringToFile("changed", "other/edited.txt", true);
+
+    Repo().setSparseCheckout({"src/app/"});
+    EXPECT_TRUE(fs::exists("src/app/main.cpp"));
+    EXPECT_FALSE(fs::exists("other/notes.txt"));
+    EXPECT_EQ(Utils::readStringFromFile("other/edited.txt"), "changed");
+    EXPECT_TRUE(fs::exists(SyntheticRepo::fileName(0)));
+
+    Repo().disableSparseCheckout();
+    EXPECT_EQ(Utils::readStringFromFile("other/notes.txt"), "other");
+    EXPECT_EQ(Utils::readStringFromFile("other/edited.txt"), "changed");
+}
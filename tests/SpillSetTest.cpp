@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+#include "MemoryBudget.h"
+#include "SpillSet.h"
+#include "SyntheticRepo.h"
+
+namespace {
+// Sets a budget for one test and lifts it again however the test ends.
+class BudgetForTest {
+public:
+    BudgetForTest(uint64_t limit, const fs::path& spillDirectory) {
+        MemoryBudget::configure(limit, spillDirectory);
+    }
+    ~BudgetForTest() {
+        MemoryBudget::configure(0, {});
+    }
+};
+
+std::vector<ObjectId> randomIds(size_t count, std::mt19937& random) {
+    std::vector<ObjectId> ids(count);
+    for (ObjectId& id : ids) {
+        for (auto& byte : id.bytes) {
+            byte = static_cast<unsigned char>(random());
+        }
+    }
+    return ids;
+}
+
+size_t runFiles(const fs::path& dir) {
+    size_t count = 0;
+    if (!fs::exists(dir)) {
+        return count;
+    }
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        count += entry.path().filename().string().rfind("spill-", 0) == 0;
+    }
+    return count;
+}
+}
+
+// A set far over its share of the budget spills to runs, merges them past
+// maxRuns, and still answers every question as a plain set would.
+TEST(SpillSetTest, SpillsToRunsAndReadsThemBack) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    fs::path spillDir = repo.getRoot() / ".gitlet" / "tmp";
+    // A quarter of this holds 100 ids, so 2000 ids spill about 20 times.
+    BudgetForTest budget(4 * 64 * 100, spillDir);
+    std::mt19937 random(3);
+    std::vector<ObjectId> ids = randomIds(2000, random);
+    std::vector<ObjectId> absent = randomIds(200, random);
+    {
+        SpillSet set;
+        for (size_t i = 0; i < ids.size(); i++) {
+            EXPECT_TRUE(set.insert(ids[i]));
+            if (i % 7 == 0) {
+                EXPECT_FALSE(set.insert(ids[i / 2]));
+            }
+            ASSERT_LE(runFiles(spillDir), SpillSet::maxRuns);
+        }
+        EXPECT_GT(runFiles(spillDir), 0u);
+        EXPECT_EQ(set.size(), ids.size());
+        for (const ObjectId& id : ids) {
+            EXPECT_TRUE(set.contains(id));
+            EXPECT_FALSE(set.insert(id));
+        }
+        for (const ObjectId& id : absent) {
+            EXPECT_FALSE(set.contains(id));
+        }
+        std::set<ObjectId> visited;
+        set.forEach([&](const ObjectId& id) {
+            EXPECT_TRUE(visited.insert(id).second);
+        });
+        EXPECT_EQ(visited, std::set<ObjectId>(ids.begin(), ids.end()));
+
+        SpillSet moved = std::move(set);
+        EXPECT_EQ(moved.size(), ids.size());
+        EXPECT_TRUE(moved.contains(ids.front()));
+    }
+    EXPECT_EQ(runFiles(spillDir), 0u);
+}
+
+// Without a budget nothing is written out.
+TEST(SpillSetTest, StaysInMemoryWithoutABudget) {
+    SyntheticRepo repo({1, 16, 1, 0});
+    std::mt19937 random(5);
+    SpillSet set;
+    for (const ObjectId& id : randomIds(5000, random)) {
+        set.insert(id);
+    }
+    EXPECT_EQ(set.size(), 5000u);
+    EXPECT_EQ(runFiles(repo.getRoot() / ".gitlet" / "tmp"), 0u);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ObjectStore.h"
+#include "SyntheticRepo.h"
+#include "Transport.h"
+#include "Utils.h"
+
+namespace {
+// Sends the newest commit of a one-commit repository to an empty store
+// through a socket pair; damage, if set, edits the commit on disk first.
+std::optional<size_t> sendCommit(const std::function<void(std::string&)>& damage) {
+    SyntheticRepo source({1, 16, 1, 0});
+    ObjectStore objects(source.getRoot() / ".gitlet");
+    std::vector<ObjectId> commits = objects.list(ObjectType::Commit);
+    ObjectId newest;
+    for (const ObjectId& id : commits) {
+        std::vector<char> data = *objects.read(ObjectType::Commit, id.hex());
+        if (std::string(data.begin(), data.end()).find("commit 0") != std::string::npos) {
+            newest = id;
+        }
+    }
+    if (damage) {
+        fs::path path = objects.loosePath(ObjectType::Commit, newest.hex());
+        std::vector<char> data = Utils::readContents(path);
+        std::string text(data.begin(), data.end());
+        damage(text);
+        Utils::writeContents(path.string(), std::vector<char>(text.begin(), text.end()));
+    }
+
+    int fds[2];
+    EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    {
+        Channel out(fds[0], fds[0]);
+        PackStream::send(out, objects, {{ObjectType::Commit, newest}});
+    }
+    ::shutdown(fds[0], SHUT_WR);
+
+    SyntheticRepo target({0, 16, 1, 0});
+    ObjectStore received(target.getRoot() / ".gitlet");
+    Channel in(fds[1], fds[1]);
+    std::optional<size_t> count = PackStream::receive(in, received);
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return count;
+}
+}
+
+TEST(TransportTest, ReceivesAnIntactCommit) {
+    EXPECT_EQ(sendCommit(nullptr), std::optional<size_t>(1));
+}
+
+// The commit still names itself by its old id, but its message changed.
+TEST(TransportTest, RejectsACommitWhoseContentsDoNotHashToItsId) {
+    std::optional<size_t> count = sendCommit([](std::string& text) {
+        text.replace(text.find("commit 0"), 8, "commit 9");
+    });
+    EXPECT_FALSE(count);
+}